@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Compare two microbench JSON reports.
+
+Usage: compare_micro.py BASELINE.json CURRENT.json [--threshold PCT]
+
+Prints one row per benchmark with the relative change. Exits 1 if any
+benchmark regressed by more than the threshold (default 10%): ns/op going
+up or ops/s going down.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {r["name"]: r for r in json.load(f)["results"]}
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("baseline")
+    ap.add_argument("current")
+    ap.add_argument("--threshold", type=float, default=10.0)
+    args = ap.parse_args()
+
+    base, cur = load(args.baseline), load(args.current)
+    regressed = []
+    print(f"{'benchmark':44} {'baseline':>14} {'current':>14} {'change':>9}")
+    for name in sorted(set(base) | set(cur)):
+        if name not in base or name not in cur:
+            print(f"{name:44} {'(only in ' + ('current' if name in cur else 'baseline') + ')':>39}")
+            continue
+        b, c = base[name], cur[name]
+        unit = c["unit"]
+        pct = (c["value"] - b["value"]) / b["value"] * 100.0 if b["value"] else 0.0
+        # Positive "worse" means slower regardless of unit.
+        worse = pct if unit == "ns/op" else -pct
+        mark = "  REGRESSION" if worse > args.threshold else ""
+        print(f"{name:44} {b['value']:>12.1f}{'':2} {c['value']:>12.1f}{'':2} {pct:>+8.1f}%  {unit}{mark}")
+        if mark:
+            regressed.append(name)
+
+    if regressed:
+        print(f"\n{len(regressed)} benchmark(s) regressed by more than {args.threshold:.0f}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Page-cache hint benchmark: large downloads, big uploads and the hot-cold
+# mix with readahead, drop-behind and write-behind off, then on (the
+# defaults). Invoked by `make io-bench`; every BENCH_* knob of
+# run_bench.sh applies.
+#
+# For cold reads to hit the disk, drop the page cache between runs
+# (BENCH_DROP_CACHES=1, needs root: echo 3 > /proc/sys/vm/drop_caches).
+
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+export BENCH_ONLY="${BENCH_ONLY:-large-files upload-big hot-cold}"
+
+config() {
+	tag=$1 args=$2
+	if [ "${BENCH_DROP_CACHES:-0}" = 1 ]; then
+		sync && echo 3 > /proc/sys/vm/drop_caches
+	fi
+	echo "== $tag: MyHTTP $args"
+	BENCH_TAG=$tag BENCH_SERVER_ARGS=$args sh "$ROOT/bench/run_bench.sh"
+}
+
+config no-hints "--readahead 0 --drop-behind 0 --write-behind 0"
+config hints ""
@@ -0,0 +1,552 @@
+/* loadgen: epoll-based HTTP/1.1 load generator for MyHTTP.
+
+   Each thread owns an epoll instance and a share of the connections. Every
+   connection keeps up to 'pipeline' requests in flight. With a target rate
+   (-R) requests are scheduled on a fixed timetable and latency is measured
+   from the *intended* send time, not the actual one, so a stalled server
+   cannot hide its backlog (coordinated-omission correction, as in wrk2).
+   Without -R the generator runs closed-loop and latencies are uncorrected.
+
+   Usage: loadgen [options]
+     -a host        server address            (127.0.0.1)
+     -p port        server port               (8080)
+     -c conns       total connections         (16)
+     -t threads     generator threads         (1)
+     -d seconds     measurement duration      (5)
+     -P depth       pipelining depth          (1)
+     -R rate        target requests/sec total (0 = closed loop)
+     -K             no keep-alive: one request per connection
+     -u pattern     request path; "%d" is replaced by a key in [0, -n)
+     -n keys        key space for -u          (1)
+     -m mix         method mix, e.g. get=90,put=5,patch=5 (get=100)
+     -b bytes       body size for PUT/PATCH   (1024)
+     -L name        scenario label for the report
+     -j             print one JSON object instead of text */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PIPELINE 64
+#define RBUF_SZ      (64 * 1024)
+
+/* Log-linear latency histogram in nanoseconds (~3% resolution). */
+#define H_SUB_BITS   5
+#define H_SUB        (1u << H_SUB_BITS)
+#define H_MAX_EXP    40
+#define H_BUCKETS    (H_SUB + (H_MAX_EXP - H_SUB_BITS + 1) * H_SUB)
+
+enum { M_GET, M_PUT, M_PATCH, M_N };
+static const char *k_mnames[M_N] = { "GET", "PUT", "PATCH" };
+
+struct opts {
+	const char *host;
+	int    port;
+	int    conns;
+	int    threads;
+	double duration;
+	int    pipeline;
+	double rate;
+	int    keepalive;
+	const char *pattern;
+	int    keys;
+	int    mix[M_N];        // cumulative percent thresholds
+	size_t body;
+	const char *label;
+	int    json;
+};
+
+struct hist {
+	uint64_t b[H_BUCKETS];
+	uint64_t count;
+	uint64_t max;
+};
+
+struct conn {
+	int      fd;
+	int      connected;
+	/* outgoing */
+	char    *out;
+	size_t   out_len, out_off, out_cap;
+	/* in flight: intended send times, FIFO */
+	uint64_t intended[MAX_PIPELINE];
+	int      q_head, q_len;
+	uint64_t next_send;     // open loop: next scheduled send (ns)
+	/* response parser */
+	char     rbuf[RBUF_SZ];
+	size_t   rlen;
+	int      in_body;
+	long long body_left;    // -1: read until close
+	int      resp_close;
+	int      status;
+};
+
+struct tstate {
+	pthread_t tid;
+	int       id;
+	const struct opts *o;
+	struct conn *cs;
+	int       nconns;
+	double    rate_per_conn;
+	unsigned  seed;
+	struct hist lat;
+	uint64_t  done, errors, reconnects;
+	uint64_t  status_class[6];
+	uint64_t  bytes_in;
+};
+
+static struct sockaddr_storage g_addr;
+static socklen_t g_addrlen;
+static char *g_body;
+static volatile int g_stop;
+static uint64_t g_measure_start;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static unsigned h_index(uint64_t v) {
+	if (v < H_SUB) return (unsigned)v;
+	unsigned e = 63u - (unsigned)__builtin_clzll(v);
+	if (e > H_MAX_EXP) return H_BUCKETS - 1;
+	unsigned sub = (unsigned)(v >> (e - H_SUB_BITS)) & (H_SUB - 1);
+	return H_SUB + (e - H_SUB_BITS) * H_SUB + sub;
+}
+
+static double h_upper(unsigned i) {
+	if (i < H_SUB) return (double)i;
+	unsigned e   = (i - H_SUB) / H_SUB + H_SUB_BITS;
+	unsigned sub = (i - H_SUB) % H_SUB;
+	double w = (double)(1ull << (e - H_SUB_BITS));
+	return (double)(H_SUB + sub + 1) * w;
+}
+
+static void h_record(struct hist *h, uint64_t v) {
+	h->b[h_index(v)]++;
+	h->count++;
+	if (v > h->max) h->max = v;
+}
+
+static double h_quantile(const struct hist *h, double q) {
+	if (!h->count) return 0.0;
+	uint64_t rank = (uint64_t)(q * (double)h->count);
+	if (rank < 1) rank = 1;
+	uint64_t seen = 0;
+	for (unsigned i = 0; i < H_BUCKETS; i++) {
+		seen += h->b[i];
+		if (seen >= rank) {
+			double u = h_upper(i);
+			return u > (double)h->max ? (double)h->max : u;
+		}
+	}
+	return (double)h->max;
+}
+
+/* ---- connection handling ---- */
+
+static int conn_open(struct conn *c, int ep) {
+	c->fd = socket(g_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (c->fd < 0) return -1;
+	int one = 1;
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (connect(c->fd, (struct sockaddr *)&g_addr, g_addrlen) < 0 && errno != EINPROGRESS) {
+		close(c->fd); c->fd = -1;
+		return -1;
+	}
+	c->connected = 0;
+	c->out_len = c->out_off = 0;
+	c->q_head = c->q_len = 0;
+	c->rlen = 0;
+	c->in_body = 0;
+	struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.ptr = c };
+	return epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+}
+
+static void conn_close(struct conn *c) {
+	if (c->fd >= 0) close(c->fd);   // close() drops it from the epoll set
+	c->fd = -1;
+}
+
+static void out_append(struct conn *c, const char *p, size_t n) {
+	if (c->out_len + n > c->out_cap) {
+		size_t ncap = c->out_cap ? c->out_cap : 4096;
+		while (ncap < c->out_len + n) ncap *= 2;
+		c->out = (char *)realloc(c->out, ncap);
+		if (!c->out) { perror("realloc"); exit(1); }
+		c->out_cap = ncap;
+	}
+	memcpy(c->out + c->out_len, p, n);
+	c->out_len += n;
+}
+
+static void queue_request(struct tstate *ts, struct conn *c, uint64_t intended) {
+	const struct opts *o = ts->o;
+	int r = (int)(rand_r(&ts->seed) % 100u);
+	int m = M_GET;
+	while (m < M_N - 1 && r >= o->mix[m]) m++;
+
+	char path[1024];
+	int key = o->keys > 1 ? (int)(rand_r(&ts->seed) % (unsigned)o->keys) : 0;
+	if (strstr(o->pattern, "%d")) snprintf(path, sizeof(path), o->pattern, key);
+	else snprintf(path, sizeof(path), "%s", o->pattern);
+
+	char hdr[1400];
+	int n;
+	if (m == M_GET) {
+		n = snprintf(hdr, sizeof(hdr), "GET %s HTTP/1.1\r\nHost: bench\r\n%s\r\n",
+		             path, o->keepalive ? "" : "Connection: close\r\n");
+	} else {
+		n = snprintf(hdr, sizeof(hdr), "%s %s HTTP/1.1\r\nHost: bench\r\nContent-Length: %zu\r\n%s\r\n",
+		             k_mnames[m], path, o->body, o->keepalive ? "" : "Connection: close\r\n");
+	}
+	out_append(c, hdr, (size_t)n);
+	if (m != M_GET) out_append(c, g_body, o->body);
+
+	c->intended[(c->q_head + c->q_len) % MAX_PIPELINE] = intended;
+	c->q_len++;
+}
+
+/* Top up the pipeline: closed loop fills it, open loop follows the timetable. */
+static void fill(struct tstate *ts, struct conn *c, uint64_t now) {
+	if (c->fd < 0 || g_stop) return;
+	int depth = ts->o->keepalive ? ts->o->pipeline : 1;
+	while (c->q_len < depth) {
+		if (ts->rate_per_conn > 0) {
+			if (c->next_send > now) break;
+			queue_request(ts, c, c->next_send);
+			c->next_send += (uint64_t)(1e9 / ts->rate_per_conn);
+		} else {
+			queue_request(ts, c, now);
+		}
+	}
+}
+
+static int flush_out(struct conn *c) {
+	while (c->out_off < c->out_len) {
+		ssize_t n = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		c->out_off += (size_t)n;
+	}
+	c->out_off = c->out_len = 0;
+	return 0;
+}
+
+static void complete_one(struct tstate *ts, struct conn *c, uint64_t now) {
+	uint64_t intended = c->intended[c->q_head];
+	c->q_head = (c->q_head + 1) % MAX_PIPELINE;
+	c->q_len--;
+	if (intended >= g_measure_start) {
+		h_record(&ts->lat, now - intended);
+		ts->done++;
+		int cls = c->status / 100;
+		if (cls < 1 || cls > 5) cls = 0;
+		ts->status_class[cls]++;
+	}
+}
+
+/* Parse as many complete responses as rbuf holds. Returns -1 to reconnect. */
+static int parse_responses(struct tstate *ts, struct conn *c, uint64_t now) {
+	for (;;) {
+		if (!c->in_body) {
+			char *eoh = memmem(c->rbuf, c->rlen, "\r\n\r\n", 4);
+			if (!eoh) return 0;
+			size_t hlen = (size_t)(eoh - c->rbuf) + 4;
+			*eoh = '\0';
+			c->status = 0;
+			if (strncmp(c->rbuf, "HTTP/1.", 7) == 0) c->status = atoi(c->rbuf + 9);
+			c->body_left = -1;
+			c->resp_close = 0;
+			for (char *l = strstr(c->rbuf, "\r\n"); l; l = strstr(l + 2, "\r\n")) {
+				char *h = l + 2;
+				if (strncasecmp(h, "Content-Length:", 15) == 0) c->body_left = atoll(h + 15);
+				else if (strncasecmp(h, "Connection:", 11) == 0) {
+					const char *v = h + 11;
+					while (*v == ' ') v++;
+					if (strncasecmp(v, "close", 5) == 0) c->resp_close = 1;
+				}
+			}
+			if (c->status == 100) {  // interim response; the real one follows
+				memmove(c->rbuf, c->rbuf + hlen, c->rlen - hlen);
+				c->rlen -= hlen;
+				continue;
+			}
+			memmove(c->rbuf, c->rbuf + hlen, c->rlen - hlen);
+			c->rlen -= hlen;
+			c->in_body = 1;
+		}
+		if (c->body_left < 0) {       // delimited by close
+			c->rlen = 0;
+			return 0;
+		}
+		size_t take = (size_t)c->body_left < c->rlen ? (size_t)c->body_left : c->rlen;
+		memmove(c->rbuf, c->rbuf + take, c->rlen - take);
+		c->rlen -= take;
+		c->body_left -= (long long)take;
+		if (c->body_left > 0) return 0;
+
+		c->in_body = 0;
+		complete_one(ts, c, now);
+		if (c->resp_close || !ts->o->keepalive) return -1;
+	}
+}
+
+static void reconnect(struct tstate *ts, struct conn *c, int ep, uint64_t now) {
+	/* Anything still in flight is lost; count it as an error. */
+	if (c->q_len) ts->errors += (uint64_t)c->q_len;
+	conn_close(c);
+	if (g_stop) return;
+	ts->reconnects++;
+	if (conn_open(c, ep) == 0) fill(ts, c, now);
+}
+
+static void *thread_main(void *arg) {
+	struct tstate *ts = (struct tstate *)arg;
+	int ep = epoll_create1(EPOLL_CLOEXEC);
+	if (ep < 0) { perror("epoll_create1"); return NULL; }
+
+	uint64_t t0 = now_ns();
+	for (int i = 0; i < ts->nconns; i++) {
+		struct conn *c = &ts->cs[i];
+		c->fd = -1;
+		/* stagger the timetable so connections don't fire in lockstep */
+		c->next_send = t0 + (ts->rate_per_conn > 0
+		                     ? (uint64_t)((1e9 / ts->rate_per_conn) * i / ts->nconns) : 0);
+		if (conn_open(c, ep) < 0) { perror("connect"); continue; }
+		fill(ts, c, t0);
+	}
+
+	struct epoll_event evs[256];
+	while (!g_stop) {
+		int timeout_ms = 100;
+		if (ts->rate_per_conn > 0) timeout_ms = 1;
+		int n = epoll_wait(ep, evs, 256, timeout_ms);
+		uint64_t now = now_ns();
+		for (int i = 0; i < n; i++) {
+			struct conn *c = (struct conn *)evs[i].data.ptr;
+			if (c->fd < 0) continue;
+			if (evs[i].events & (EPOLLERR | EPOLLHUP)) {
+				if (!(evs[i].events & EPOLLIN)) { reconnect(ts, c, ep, now); continue; }
+			}
+			if (evs[i].events & EPOLLOUT) {
+				c->connected = 1;
+				if (flush_out(c) < 0) { reconnect(ts, c, ep, now); continue; }
+			}
+			if (evs[i].events & EPOLLIN) {
+				int must_reconnect = 0;
+				for (;;) {
+					ssize_t r = recv(c->fd, c->rbuf + c->rlen, sizeof(c->rbuf) - c->rlen, 0);
+					if (r > 0) {
+						ts->bytes_in += (uint64_t)r;
+						c->rlen += (size_t)r;
+						if (parse_responses(ts, c, now) < 0) { must_reconnect = 1; break; }
+						if (c->rlen == sizeof(c->rbuf)) { must_reconnect = 1; ts->errors++; break; }
+						continue;
+					}
+					if (r == 0) {
+						/* EOF: completes a close-delimited body, otherwise an error */
+						if (c->in_body && c->body_left < 0) {
+							c->in_body = 0;
+							complete_one(ts, c, now);
+						}
+						must_reconnect = 1;
+					} else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+						must_reconnect = 1;
+					}
+					break;
+				}
+				if (must_reconnect) { reconnect(ts, c, ep, now); continue; }
+			}
+			fill(ts, c, now);
+			if (c->out_len && flush_out(c) < 0) reconnect(ts, c, ep, now);
+		}
+		if (ts->rate_per_conn > 0) {
+			for (int i = 0; i < ts->nconns; i++) {
+				struct conn *c = &ts->cs[i];
+				if (c->fd < 0) continue;
+				int before = c->q_len;
+				fill(ts, c, now);
+				if (c->q_len != before && flush_out(c) < 0) reconnect(ts, c, ep, now);
+			}
+		}
+	}
+
+	for (int i = 0; i < ts->nconns; i++) { conn_close(&ts->cs[i]); free(ts->cs[i].out); }
+	close(ep);
+	return NULL;
+}
+
+/* ---- option parsing ---- */
+
+static int parse_mix(const char *s, int *cum) {
+	int pct[M_N] = { 0, 0, 0 };
+	char *dup = strdup(s), *save = NULL;
+	for (char *tok = strtok_r(dup, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		char *eq = strchr(tok, '=');
+		if (!eq) { free(dup); return -1; }
+		*eq = '\0';
+		int m = -1;
+		for (int k = 0; k < M_N; k++) if (strcasecmp(tok, k_mnames[k]) == 0) m = k;
+		if (m < 0) { free(dup); return -1; }
+		pct[m] = atoi(eq + 1);
+	}
+	free(dup);
+	int total = pct[0] + pct[1] + pct[2];
+	if (total != 100) return -1;
+	cum[0] = pct[0]; cum[1] = pct[0] + pct[1]; cum[2] = 100;
+	return 0;
+}
+
+static void usage(const char *prog) {
+	fprintf(stderr,
+	        "Usage: %s [-a host] [-p port] [-c conns] [-t threads] [-d secs] [-P depth]\n"
+	        "          [-R rate] [-K] [-u pattern] [-n keys] [-m get=..,put=..,patch=..]\n"
+	        "          [-b body_bytes] [-L label] [-j]\n", prog);
+}
+
+int main(int argc, char **argv) {
+	struct opts o = {
+		.host = "127.0.0.1", .port = 8080, .conns = 16, .threads = 1, .duration = 5,
+		.pipeline = 1, .rate = 0, .keepalive = 1, .pattern = "/", .keys = 1,
+		.mix = { 100, 100, 100 }, .body = 1024, .label = "custom", .json = 0
+	};
+	int opt;
+	while ((opt = getopt(argc, argv, "a:p:c:t:d:P:R:Ku:n:m:b:L:jh")) != -1) {
+		switch (opt) {
+			case 'a': o.host = optarg; break;
+			case 'p': o.port = atoi(optarg); break;
+			case 'c': o.conns = atoi(optarg); break;
+			case 't': o.threads = atoi(optarg); break;
+			case 'd': o.duration = atof(optarg); break;
+			case 'P': o.pipeline = atoi(optarg); break;
+			case 'R': o.rate = atof(optarg); break;
+			case 'K': o.keepalive = 0; break;
+			case 'u': o.pattern = optarg; break;
+			case 'n': o.keys = atoi(optarg); break;
+			case 'm': if (parse_mix(optarg, o.mix) < 0) { fprintf(stderr, "bad -m\n"); return 2; } break;
+			case 'b': o.body = (size_t)atol(optarg); break;
+			case 'L': o.label = optarg; break;
+			case 'j': o.json = 1; break;
+			default: usage(argv[0]); return 2;
+		}
+	}
+	if (o.conns < 1 || o.threads < 1 || o.duration <= 0 || o.pipeline < 1 || o.pipeline > MAX_PIPELINE) {
+		usage(argv[0]);
+		return 2;
+	}
+	if (o.threads > o.conns) o.threads = o.conns;
+
+	char portstr[16];
+	snprintf(portstr, sizeof(portstr), "%d", o.port);
+	struct addrinfo hints = { .ai_socktype = SOCK_STREAM }, *ai = NULL;
+	if (getaddrinfo(o.host, portstr, &hints, &ai) != 0 || !ai) {
+		fprintf(stderr, "cannot resolve %s\n", o.host);
+		return 1;
+	}
+	memcpy(&g_addr, ai->ai_addr, ai->ai_addrlen);
+	g_addrlen = ai->ai_addrlen;
+	freeaddrinfo(ai);
+
+	g_body = (char *)malloc(o.body ? o.body : 1);
+	memset(g_body, 'x', o.body);
+
+	struct tstate *ts = (struct tstate *)calloc((size_t)o.threads, sizeof(*ts));
+	struct conn *all = (struct conn *)calloc((size_t)o.conns, sizeof(*all));
+	if (!ts || !all) { perror("calloc"); return 1; }
+
+	/* 10% warm-up (at most 1s) is driven but not recorded */
+	double warm = o.duration * 0.1 > 1.0 ? 1.0 : o.duration * 0.1;
+	uint64_t start = now_ns();
+	g_measure_start = start + (uint64_t)(warm * 1e9);
+
+	int off = 0;
+	for (int i = 0; i < o.threads; i++) {
+		int n = o.conns / o.threads + (i < o.conns % o.threads ? 1 : 0);
+		ts[i].id = i;
+		ts[i].o = &o;
+		ts[i].cs = all + off;
+		ts[i].nconns = n;
+		ts[i].rate_per_conn = o.rate > 0 ? o.rate / o.conns : 0;
+		ts[i].seed = 0x9e3779b9u * (unsigned)(i + 1);
+		off += n;
+		pthread_create(&ts[i].tid, NULL, thread_main, &ts[i]);
+	}
+
+	struct timespec nap = { .tv_sec = (time_t)(warm + o.duration),
+	                        .tv_nsec = (long)(((warm + o.duration) - (double)(time_t)(warm + o.duration)) * 1e9) };
+	nanosleep(&nap, NULL);
+	g_stop = 1;
+	uint64_t end = now_ns();
+
+	struct tstate tot;
+	memset(&tot, 0, sizeof(tot));
+	for (int i = 0; i < o.threads; i++) {
+		pthread_join(ts[i].tid, NULL);
+		for (unsigned b = 0; b < H_BUCKETS; b++) tot.lat.b[b] += ts[i].lat.b[b];
+		tot.lat.count += ts[i].lat.count;
+		if (ts[i].lat.max > tot.lat.max) tot.lat.max = ts[i].lat.max;
+		tot.done += ts[i].done;
+		tot.errors += ts[i].errors;
+		tot.reconnects += ts[i].reconnects;
+		tot.bytes_in += ts[i].bytes_in;
+		for (int k = 0; k < 6; k++) tot.status_class[k] += ts[i].status_class[k];
+	}
+
+	double secs = (double)(end - g_measure_start) / 1e9;
+	double rps = secs > 0 ? (double)tot.done / secs : 0;
+	static const double qs[] = { 0.5, 0.9, 0.99, 0.999, 0.9999 };
+	static const char *qn[] = { "p50", "p90", "p99", "p999", "p9999" };
+
+	if (o.json) {
+		printf("{\"scenario\":\"%s\",\"connections\":%d,\"pipeline\":%d,\"keepalive\":%s,"
+		       "\"target_rate\":%.0f,\"co_corrected\":%s,\"seconds\":%.3f,\"requests\":%llu,"
+		       "\"rps\":%.1f,\"errors\":%llu,\"reconnects\":%llu,\"bytes_in\":%llu,",
+		       o.label, o.conns, o.pipeline, o.keepalive ? "true" : "false", o.rate,
+		       o.rate > 0 ? "true" : "false", secs, (unsigned long long)tot.done, rps,
+		       (unsigned long long)tot.errors, (unsigned long long)tot.reconnects,
+		       (unsigned long long)tot.bytes_in);
+		printf("\"status\":{\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,\"5xx\":%llu},\"latency_us\":{",
+		       (unsigned long long)tot.status_class[2], (unsigned long long)tot.status_class[3],
+		       (unsigned long long)tot.status_class[4], (unsigned long long)tot.status_class[5]);
+		for (size_t k = 0; k < sizeof(qs) / sizeof(qs[0]); k++)
+			printf("\"%s\":%.1f,", qn[k], h_quantile(&tot.lat, qs[k]) / 1e3);
+		printf("\"max\":%.1f}}\n", (double)tot.lat.max / 1e3);
+	} else {
+		printf("scenario %s: %d conns, pipeline %d, %s, %s\n", o.label, o.conns, o.pipeline,
+		       o.keepalive ? "keep-alive" : "close", o.rate > 0 ? "open loop (CO-corrected)" : "closed loop");
+		printf("  requests %llu in %.2fs = %.1f req/s, %.2f MB/s in\n",
+		       (unsigned long long)tot.done, secs, rps, (double)tot.bytes_in / secs / 1e6);
+		printf("  status 2xx=%llu 3xx=%llu 4xx=%llu 5xx=%llu errors=%llu reconnects=%llu\n",
+		       (unsigned long long)tot.status_class[2], (unsigned long long)tot.status_class[3],
+		       (unsigned long long)tot.status_class[4], (unsigned long long)tot.status_class[5],
+		       (unsigned long long)tot.errors, (unsigned long long)tot.reconnects);
+		printf("  latency");
+		for (size_t k = 0; k < sizeof(qs) / sizeof(qs[0]); k++)
+			printf(" %s=%.0fus", qn[k], h_quantile(&tot.lat, qs[k]) / 1e3);
+		printf(" max=%.0fus\n", (double)tot.lat.max / 1e3);
+	}
+
+	free(all);
+	free(ts);
+	free(g_body);
+	return 0;
+}
@@ -0,0 +1,390 @@
+/* Component microbenchmarks, linked against the server's own object files.
+
+   Single-threaded benchmarks calibrate an iteration count that fills the
+   per-run time budget, repeat it, and report the median ns/op. Threaded
+   ones (path locks, work queue) run for a fixed time and report ops/sec.
+   Results are one JSON document on stdout so runs can be diffed with
+   bench/compare_micro.py.
+
+   Usage: microbench [-t millis-per-run] [-r runs] [-f name-substring] */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE       // realpath
+
+#include "../src/http_parse.h"
+#include "../src/fs.h"
+#include "../src/pathlock.h"
+#include "../src/workq.h"
+#include "../src/arena.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_RUNS    32
+#define MAX_THREADS 16
+
+static int g_millis = 200;
+static int g_runs = 5;
+static const char *g_filter;
+static int g_nresults;
+
+/* Keeps the compiler from discarding results of benchmarked calls. */
+static volatile unsigned long g_sink;
+
+static double now_sec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int selected(const char *name) {
+	return !g_filter || strstr(name, g_filter) != NULL;
+}
+
+static void emit(const char *name, const char *unit, double value, double best,
+                 unsigned long iters, int threads) {
+	printf("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.2f, \"best\": %.2f, "
+	       "\"iters\": %lu, \"runs\": %d, \"threads\": %d}",
+	       g_nresults++ ? "," : "", name, unit, value, best, iters, g_runs, threads);
+	fflush(stdout);
+}
+
+static int cmp_double(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/* ---- single-threaded harness ---- */
+
+typedef void (*bm_fn)(void *ctx, unsigned long iters);
+
+static void run_st(const char *name, bm_fn fn, void *ctx) {
+	if (!selected(name)) return;
+
+	/* Calibrate: grow iters until one batch takes at least 1/10th of a run. */
+	unsigned long iters = 1;
+	for (;;) {
+		double t0 = now_sec();
+		fn(ctx, iters);
+		double dt = now_sec() - t0;
+		if (dt * 1e3 >= g_millis / 10.0 || iters >= (1ul << 40)) {
+			double per = dt / (double)iters;
+			iters = per > 0 ? (unsigned long)((g_millis / 1e3) / per) : iters * 10;
+			if (iters == 0) iters = 1;
+			break;
+		}
+		iters *= 4;
+	}
+
+	double ns[MAX_RUNS];
+	for (int r = 0; r < g_runs; r++) {
+		double t0 = now_sec();
+		fn(ctx, iters);
+		ns[r] = (now_sec() - t0) * 1e9 / (double)iters;
+	}
+	qsort(ns, (size_t)g_runs, sizeof(ns[0]), cmp_double);
+	emit(name, "ns/op", ns[g_runs / 2], ns[0], iters, 1);
+}
+
+/* ---- myhttp_parse_request ---- */
+
+struct parse_ctx {
+	const char *req;
+	size_t len;
+};
+
+static void bm_parse(void *arg, unsigned long iters) {
+	struct parse_ctx *c = (struct parse_ctx *)arg;
+	char buf[4096];
+	struct myhttp_req r;
+	for (unsigned long i = 0; i < iters; i++) {
+		/* the parser tokenizes in place, so it needs a fresh copy each time */
+		memcpy(buf, c->req, c->len);
+		myhttp_req_reset(&r);
+		g_sink += (unsigned long)myhttp_parse_request(buf, c->len, &r);
+	}
+}
+
+static const char k_req_curl[] =
+	"GET /index.html HTTP/1.1\r\n"
+	"Host: localhost:8080\r\n"
+	"User-Agent: curl/8.5.0\r\n"
+	"Accept: */*\r\n"
+	"\r\n";
+
+static const char k_req_browser[] =
+	"GET /static/js/app.bundle.min.js?v=20240611 HTTP/1.1\r\n"
+	"Host: www.example.com\r\n"
+	"Connection: keep-alive\r\n"
+	"sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+	"sec-ch-ua-mobile: ?0\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+	"sec-ch-ua-platform: \"Linux\"\r\n"
+	"Accept: */*\r\n"
+	"Sec-Fetch-Site: same-origin\r\n"
+	"Sec-Fetch-Mode: no-cors\r\n"
+	"Sec-Fetch-Dest: script\r\n"
+	"Referer: https://www.example.com/dashboard/overview\r\n"
+	"Accept-Encoding: gzip, deflate, br, zstd\r\n"
+	"Accept-Language: en-US,en;q=0.9,de;q=0.8\r\n"
+	"Cookie: session=4f9c2a77e1b04d2c9a8f0b6e5d3c1a29; theme=dark; _ga=GA1.1.1234567890.1700000000\r\n"
+	"If-None-Match: \"5e1f-61a2b3c4d5e6f\"\r\n"
+	"\r\n";
+
+static const char k_req_upload[] =
+	"PUT /uploads/reports/2024/q2-summary.json HTTP/1.1\r\n"
+	"Host: files.internal\r\n"
+	"User-Agent: python-requests/2.31.0\r\n"
+	"Accept: */*\r\n"
+	"Connection: keep-alive\r\n"
+	"Content-Type: application/json\r\n"
+	"Content-Length: 48213\r\n"
+	"Expect: 100-continue\r\n"
+	"\r\n";
+
+/* ---- myhttp_percent_decode_inplace ---- */
+
+static void bm_pct(void *arg, unsigned long iters) {
+	const char *src = (const char *)arg;
+	size_t len = strlen(src) + 1;
+	char buf[1024];
+	for (unsigned long i = 0; i < iters; i++) {
+		memcpy(buf, src, len);
+		g_sink += (unsigned long)myhttp_percent_decode_inplace(buf);
+	}
+}
+
+/* ---- fs_join_safe ---- */
+
+struct join_ctx {
+	const char *root;
+	struct mh_arena *arena;   // NULL: heap-backed fs_join_safe()
+	char path[PATH_MAX];
+};
+
+static void bm_join(void *arg, unsigned long iters) {
+	struct join_ctx *c = (struct join_ctx *)arg;
+	char out[PATH_MAX];
+	for (unsigned long i = 0; i < iters; i++) {
+		if (c->arena) {
+			arena_reset(c->arena);
+			g_sink += (unsigned long)fs_join_safe_arena(c->arena, c->root, c->path, out, sizeof(out));
+		} else {
+			g_sink += (unsigned long)fs_join_safe(c->root, c->path, out, sizeof(out));
+		}
+	}
+}
+
+/* Builds root/d0/d1/.../d{depth-1}/file.txt and the matching request path. */
+static int make_tree(const char *root, int depth, char *req, size_t reqlen) {
+	char abs[PATH_MAX];
+	size_t a = (size_t)snprintf(abs, sizeof(abs), "%s", root);
+	size_t r = 0;
+	for (int i = 0; i < depth; i++) {
+		a += (size_t)snprintf(abs + a, sizeof(abs) - a, "/d%d", i);
+		r += (size_t)snprintf(req + r, reqlen - r, "/d%d", i);
+		if (mkdir(abs, 0755) < 0 && errno != EEXIST) return -1;
+	}
+	snprintf(abs + a, sizeof(abs) - a, "/file.txt");
+	snprintf(req + r, reqlen - r, "/file.txt");
+	FILE *f = fopen(abs, "w");
+	if (!f) return -1;
+	fclose(f);
+	return 0;
+}
+
+/* ---- fs_mime_from_path ---- */
+
+static void bm_mime(void *arg, unsigned long iters) {
+	(void)arg;
+	static const char *paths[] = {
+		"/srv/www/index.html", "/srv/www/css/site.css", "/srv/www/js/app.js",
+		"/srv/www/img/logo.PNG", "/srv/www/docs/manual.pdf", "/srv/www/data/blob.bin",
+		"/srv/www/README", "/srv/www/photo.jpeg",
+	};
+	for (unsigned long i = 0; i < iters; i++)
+		g_sink += (unsigned long)(size_t)fs_mime_from_path(paths[i & 7]);
+}
+
+/* ---- threaded harness ---- */
+
+struct mt_run {
+	int nthreads;
+	int stop;
+	pthread_barrier_t start;
+	struct mh_workq q;
+};
+
+struct mt_worker {
+	struct mt_run *run;
+	int id;
+	unsigned long ops;
+	char pad[64];
+};
+
+static double run_mt(void *(*fn)(void *), struct mt_run *r, int nthreads) {
+	struct mt_worker ws[MAX_THREADS];
+	pthread_t tids[MAX_THREADS];
+
+	r->nthreads = nthreads;
+	r->stop = 0;
+	pthread_barrier_init(&r->start, NULL, (unsigned)nthreads + 1);
+	for (int i = 0; i < nthreads; i++) {
+		ws[i].run = r; ws[i].id = i; ws[i].ops = 0;
+		pthread_create(&tids[i], NULL, fn, &ws[i]);
+	}
+	pthread_barrier_wait(&r->start);
+	double t0 = now_sec();
+	struct timespec ts = { .tv_sec = g_millis / 1000, .tv_nsec = (long)(g_millis % 1000) * 1000000L };
+	nanosleep(&ts, NULL);
+	__atomic_store_n(&r->stop, 1, __ATOMIC_RELAXED);
+	if (r->q.ring) workq_close(&r->q);   // unblock queue waiters
+
+	unsigned long total = 0;
+	for (int i = 0; i < nthreads; i++) {
+		pthread_join(tids[i], NULL);
+		total += ws[i].ops;
+	}
+	double dt = now_sec() - t0;
+	pthread_barrier_destroy(&r->start);
+	return (double)total / dt;
+}
+
+#define HOT_PATHS 4
+
+static void *plock_worker(void *arg) {
+	struct mt_worker *w = (struct mt_worker *)arg;
+	char path[64];
+	pthread_barrier_wait(&w->run->start);
+	unsigned long n = 0;
+	while (!__atomic_load_n(&w->run->stop, __ATOMIC_RELAXED)) {
+		snprintf(path, sizeof(path), "/srv/docroot/hot/%lu.bin", n % HOT_PATHS);
+		struct path_lock *pl = plock_acquire_wr(path);
+		if (!pl) break;
+		plock_release(pl);
+		n++;
+	}
+	w->ops = n;
+	return NULL;
+}
+
+/* Even ids produce, odd ids consume; ops counts dequeued jobs. */
+static void *workq_worker(void *arg) {
+	struct mt_worker *w = (struct mt_worker *)arg;
+	struct mh_workq *q = &w->run->q;
+	struct mh_job j;
+	memset(&j, 0, sizeof(j));
+	pthread_barrier_wait(&w->run->start);
+	unsigned long n = 0;
+	if (w->id % 2 == 0) {
+		while (!__atomic_load_n(&w->run->stop, __ATOMIC_RELAXED)) {
+			j.client_fd = (int)n++;
+			if (workq_enqueue(q, j) != 0) break;
+		}
+		n = 0;
+	} else {
+		while (workq_dequeue(q, &j) == 0) n++;
+	}
+	w->ops = n;
+	return NULL;
+}
+
+static void run_threaded(const char *base, void *(*fn)(void *), int use_queue,
+                         const int *threads, int nthreads_cfg) {
+	char name[128];
+	for (int k = 0; k < nthreads_cfg; k++) {
+		int nt = threads[k];
+		snprintf(name, sizeof(name), "%s/threads=%d", base, nt);
+		if (!selected(name)) continue;
+		double ops[MAX_RUNS];
+		for (int r = 0; r < g_runs; r++) {
+			struct mt_run run;
+			memset(&run, 0, sizeof(run));
+			if (use_queue && workq_init(&run.q, 1024) != 0) { perror("workq_init"); return; }
+			ops[r] = run_mt(fn, &run, nt);
+			if (use_queue) workq_destroy(&run.q);
+		}
+		qsort(ops, (size_t)g_runs, sizeof(ops[0]), cmp_double);
+		emit(name, "ops/s", ops[g_runs / 2], ops[g_runs - 1], 0, nt);
+	}
+}
+
+int main(int argc, char **argv) {
+	int opt;
+	while ((opt = getopt(argc, argv, "t:r:f:")) != -1) {
+		switch (opt) {
+			case 't': g_millis = atoi(optarg); break;
+			case 'r': g_runs = atoi(optarg); break;
+			case 'f': g_filter = optarg; break;
+			default:
+				fprintf(stderr, "Usage: %s [-t millis-per-run] [-r runs] [-f filter]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (g_millis <= 0) g_millis = 200;
+	if (g_runs < 1 || g_runs > MAX_RUNS) g_runs = 5;
+
+	printf("{\n  \"suite\": \"myhttp-microbench\",\n  \"timestamp\": %ld,\n"
+	       "  \"millis_per_run\": %d,\n  \"results\": [", (long)time(NULL), g_millis);
+
+	struct parse_ctx pc_curl    = { k_req_curl,    sizeof(k_req_curl) - 1 };
+	struct parse_ctx pc_browser = { k_req_browser, sizeof(k_req_browser) - 1 };
+	struct parse_ctx pc_upload  = { k_req_upload,  sizeof(k_req_upload) - 1 };
+	run_st("parse_request/curl",    bm_parse, &pc_curl);
+	run_st("parse_request/browser", bm_parse, &pc_browser);
+	run_st("parse_request/upload",  bm_parse, &pc_upload);
+
+	run_st("percent_decode/plain", bm_pct, (void *)"/static/js/app.bundle.min.js");
+	run_st("percent_decode/encoded", bm_pct,
+	       (void *)"/files/%E6%97%A5%E6%9C%AC%E8%AA%9E/My%20Report%20%282024%29%20final%21.pdf");
+
+	char tmpl[] = "/tmp/myhttp-micro.XXXXXX";
+	char root[PATH_MAX];
+	if (mkdtemp(tmpl) && realpath(tmpl, root)) {
+		static const int depths[] = { 1, 4, 16 };
+		struct mh_arena arena;
+		int have_arena = arena_init(&arena, 32 * 1024) == 0;
+		for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+			struct join_ctx jc = { .root = root };
+			char name[64];
+			snprintf(name, sizeof(name), "fs_join_safe/depth=%d", depths[i]);
+			if (make_tree(root, depths[i], jc.path, sizeof(jc.path)) != 0) continue;
+			run_st(name, bm_join, &jc);
+			if (have_arena) {
+				jc.arena = &arena;
+				snprintf(name, sizeof(name), "fs_join_safe_arena/depth=%d", depths[i]);
+				run_st(name, bm_join, &jc);
+			}
+		}
+		if (have_arena) arena_destroy(&arena);
+		struct join_ctx miss = { .root = root };
+		snprintf(miss.path, sizeof(miss.path), "/d0/d1/d2/d3/missing.txt");
+		run_st("fs_join_safe/missing", bm_join, &miss);
+		char cmd[PATH_MAX + 16];
+		snprintf(cmd, sizeof(cmd), "rm -rf '%s'", root);
+		if (system(cmd) != 0) fprintf(stderr, "microbench: could not remove %s\n", root);
+	} else {
+		perror("mkdtemp");
+	}
+
+	run_st("mime_from_path", bm_mime, NULL);
+
+	static const int plock_threads[] = { 1, 2, 4, 8 };
+	plock_global_init();
+	run_threaded("plock_wr_contended", plock_worker, 0, plock_threads, 4);
+	plock_global_destroy();
+
+	/* producers + consumers, half each */
+	static const int q_threads[] = { 2, 4, 8 };
+	run_threaded("workq_enqueue_dequeue", workq_worker, 1, q_threads, 3);
+
+	printf("\n  ]\n}\n");
+	return 0;
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Worker placement benchmark: the same scenarios with workers left to the
+# scheduler, pinned with their memory on a remote NUMA node, pinned with
+# local memory, and pinned with per-node SO_REUSEPORT listeners.
+# Invoked by `make numa-bench`; every BENCH_* knob of run_bench.sh applies.
+#
+# The cross-node and node-local runs need numactl and at least two nodes;
+# elsewhere they are skipped and only the pinning overhead is measured.
+
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+export BENCH_ONLY="${BENCH_ONLY:-small-files small-pipe large-files}"
+
+nodes=$(ls -d /sys/devices/system/node/node[0-9]* 2>/dev/null | wc -l)
+
+config() {
+	tag=$1 wrap=$2 args=$3
+	echo "== $tag: ${wrap:+$wrap }MyHTTP $args"
+	BENCH_TAG=$tag BENCH_SERVER_WRAP=$wrap BENCH_SERVER_ARGS=$args sh "$ROOT/bench/run_bench.sh"
+}
+
+config unpinned "" ""
+if command -v numactl >/dev/null 2>&1 && [ "$nodes" -ge 2 ]; then
+	# Same CPUs (node 0) both times; only where the memory lives differs.
+	config cross-node "numactl --cpunodebind=0 --membind=1" "--pin-workers"
+	config node-local "numactl --cpunodebind=0 --membind=0" "--pin-workers"
+else
+	echo "== cross-node / node-local: skipped (need numactl and 2+ NUMA nodes; found $nodes)"
+fi
+config pinned "" "--pin-workers"
+config reuseport "" "--reuseport"
@@ -0,0 +1,102 @@
+/* Path-lock contention benchmark.
+   Runs plock_acquire_wr()/plock_release() from 1..64 threads on
+   - disjoint paths    (every thread has its own path), and
+   - overlapping paths (all threads share a handful of hot paths),
+   and prints acquire/release pairs per second for each combination.
+
+   Usage: plock_bench [millis-per-run]   (default 200) */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../src/pathlock.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_THREADS  64
+#define HOT_PATHS    4
+
+struct run {
+	int mode_overlap;
+	int nthreads;
+	volatile int stop;
+	pthread_barrier_t start;
+};
+
+struct worker {
+	struct run *run;
+	int id;
+	unsigned long ops;
+	char pad[64];
+};
+
+static double now_sec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *worker_main(void *arg) {
+	struct worker *w = (struct worker *)arg;
+	struct run *r = w->run;
+	char path[64];
+
+	pthread_barrier_wait(&r->start);
+	unsigned long n = 0;
+	while (!__atomic_load_n(&r->stop, __ATOMIC_RELAXED)) {
+		int key = r->mode_overlap ? (int)(n % HOT_PATHS) : w->id;
+		snprintf(path, sizeof(path), "/srv/docroot/bench/%d.bin", key);
+		struct path_lock *pl = plock_acquire_wr(path);
+		if (!pl) { perror("plock_acquire_wr"); break; }
+		plock_release(pl);
+		n++;
+	}
+	w->ops = n;
+	return NULL;
+}
+
+static double run_once(int overlap, int nthreads, int millis) {
+	struct run r = { .mode_overlap = overlap, .nthreads = nthreads, .stop = 0 };
+	struct worker ws[MAX_THREADS];
+	pthread_t tids[MAX_THREADS];
+
+	pthread_barrier_init(&r.start, NULL, (unsigned)nthreads + 1);
+	for (int i = 0; i < nthreads; i++) {
+		ws[i].run = &r; ws[i].id = i; ws[i].ops = 0;
+		pthread_create(&tids[i], NULL, worker_main, &ws[i]);
+	}
+	pthread_barrier_wait(&r.start);
+	double t0 = now_sec();
+	struct timespec ts = { .tv_sec = millis / 1000, .tv_nsec = (long)(millis % 1000) * 1000000L };
+	nanosleep(&ts, NULL);
+	__atomic_store_n(&r.stop, 1, __ATOMIC_RELAXED);
+
+	unsigned long total = 0;
+	for (int i = 0; i < nthreads; i++) {
+		pthread_join(tids[i], NULL);
+		total += ws[i].ops;
+	}
+	double dt = now_sec() - t0;
+	pthread_barrier_destroy(&r.start);
+	return (double)total / dt;
+}
+
+int main(int argc, char **argv) {
+	int millis = argc > 1 ? atoi(argv[1]) : 200;
+	if (millis <= 0) millis = 200;
+
+	plock_global_init();
+	printf("%-12s %8s %16s\n", "mode", "threads", "ops/sec");
+	for (int overlap = 0; overlap <= 1; overlap++) {
+		for (int n = 1; n <= MAX_THREADS; n *= 2) {
+			double ops = run_once(overlap, n, millis);
+			printf("%-12s %8d %16.0f\n", overlap ? "overlapping" : "disjoint", n, ops);
+			fflush(stdout);
+		}
+	}
+	plock_global_destroy();
+	return 0;
+}
@@ -0,0 +1,126 @@
+#!/bin/sh
+# Standard MyHTTP benchmark scenarios. Invoked by `make bench`.
+#
+# Generates a throwaway docroot, starts ./MyHTTP on it and drives each
+# scenario with build/loadgen. Tunables (environment):
+#   BENCH_PORT      server port                  (18080)
+#   BENCH_DURATION  seconds per scenario         (5)
+#   BENCH_CONNS     connections per scenario     (32)
+#   BENCH_THREADS   loadgen threads              (2)
+#   BENCH_RATE      target req/s; 0 = closed loop (0)
+#   BENCH_JSON      1 to emit one JSON line per scenario
+#   BENCH_ONLY      space-separated scenario names to run (default: all)
+#   BENCH_SERVER_ARGS  extra MyHTTP flags (e.g. --pin-workers)
+#   BENCH_SERVER_WRAP  command to start MyHTTP under (e.g. numactl ...)
+#   BENCH_TAG       prefix for scenario labels (tag/name)
+#   BENCH_COLD_MB   size of each cold file for hot-cold, MiB (96)
+
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+SERVER="$ROOT/MyHTTP"
+LOADGEN="$ROOT/build/loadgen"
+
+PORT=${BENCH_PORT:-18080}
+DUR=${BENCH_DURATION:-5}
+CONNS=${BENCH_CONNS:-32}
+THREADS=${BENCH_THREADS:-2}
+RATE=${BENCH_RATE:-0}
+ONLY=${BENCH_ONLY:-}
+SERVER_ARGS=${BENCH_SERVER_ARGS:-}
+SERVER_WRAP=${BENCH_SERVER_WRAP:-}
+TAG=${BENCH_TAG:+$BENCH_TAG/}
+COLD_MB=${BENCH_COLD_MB:-96}
+
+[ -x "$SERVER" ]  || { echo "missing $SERVER (run make)" >&2; exit 1; }
+[ -x "$LOADGEN" ] || { echo "missing $LOADGEN (run make bench)" >&2; exit 1; }
+
+DOCROOT=$(mktemp -d "${TMPDIR:-/tmp}/myhttp-bench.XXXXXX")
+SERVER_PID=
+cleanup() {
+	status=$?
+	if [ -n "$SERVER_PID" ]; then
+		kill "$SERVER_PID" 2>/dev/null || :
+		wait "$SERVER_PID" 2>/dev/null || :
+	fi
+	rm -rf "$DOCROOT"
+	exit $status
+}
+trap cleanup EXIT INT TERM
+
+selected() {
+	[ -z "$ONLY" ] && return 0
+	case " $ONLY " in *" $1 "*) return 0 ;; esac
+	return 1
+}
+
+# ---- docroot ----
+echo "Generating docroot in $DOCROOT ..."
+mkdir -p "$DOCROOT/small" "$DOCROOT/large" "$DOCROOT/listing" "$DOCROOT/uploads"
+head -c 1024 /dev/urandom > "$DOCROOT/small/.seed"
+i=0
+while [ $i -lt 1000 ]; do
+	cp "$DOCROOT/small/.seed" "$DOCROOT/small/f$i.txt"
+	i=$((i + 1))
+done
+rm -f "$DOCROOT/small/.seed"
+i=0
+while [ $i -lt 4 ]; do
+	head -c $((16 * 1024 * 1024)) /dev/urandom > "$DOCROOT/large/big$i.bin"
+	i=$((i + 1))
+done
+i=0
+while [ $i -lt 500 ]; do
+	: > "$DOCROOT/listing/entry-$i.dat"
+	i=$((i + 1))
+done
+i=0
+while [ $i -lt 64 ]; do
+	printf 'seed\n' > "$DOCROOT/uploads/u$i.txt"
+	i=$((i + 1))
+done
+# One-off downloads much larger than the hot set (only when hot-cold runs).
+if selected hot-cold; then
+	mkdir -p "$DOCROOT/cold"
+	i=0
+	while [ $i -lt 4 ]; do
+		head -c $((COLD_MB * 1024 * 1024)) /dev/urandom > "$DOCROOT/cold/c$i.bin"
+		i=$((i + 1))
+	done
+fi
+
+# ---- server ----
+# shellcheck disable=SC2086  # word-split the optional wrapper and flags
+$SERVER_WRAP "$SERVER" -p "$PORT" -d "$DOCROOT" $SERVER_ARGS >/dev/null 2>&1 &
+SERVER_PID=$!
+sleep 0.5
+kill -0 "$SERVER_PID" 2>/dev/null || { echo "server failed to start" >&2; exit 1; }
+
+# ---- scenarios ----
+run() {
+	name=$1; shift
+	selected "$name" || return 0
+	set -- -p "$PORT" -c "$CONNS" -t "$THREADS" -d "$DUR" -R "$RATE" -L "$TAG$name" "$@"
+	[ "${BENCH_JSON:-0}" = 1 ] && set -- "$@" -j
+	"$LOADGEN" "$@"
+}
+
+run small-files  -u '/small/f%d.txt' -n 1000
+run small-pipe   -u '/small/f%d.txt' -n 1000 -P 8
+run small-close  -u '/small/f%d.txt' -n 1000 -K
+run large-files  -u '/large/big%d.bin' -n 4 -c 4
+run 404-storm    -u '/missing/nope%d.html' -n 100000
+run dir-listing  -u '/listing/' -K
+run upload-mix   -u '/uploads/u%d.txt' -n 64 -m get=60,put=30,patch=10 -b 4096
+run upload-big   -u '/uploads/big%d.bin' -n 4 -c 4 -m put=100 -b $((8 * 1024 * 1024))
+
+# Hot small files measured while cold huge files stream alongside; with
+# page-cache hints the cold stream should not push the hot set out.
+if selected hot-cold; then
+	"$LOADGEN" -p "$PORT" -c 2 -t 1 -d "$DUR" -u '/cold/c%d.bin' -n 4 -L "${TAG}hot-cold/cold" \
+		$([ "${BENCH_JSON:-0}" = 1 ] && echo -j) &
+	COLD_PID=$!
+	sleep 0.3   # cold connections take their workers first
+	run hot-cold -u '/small/f%d.txt' -n 1000
+	wait "$COLD_PID"
+fi
@@ -0,0 +1,117 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "admit.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* Moving-average windows, in samples (one per dequeued connection). */
+#define SHORT_WINDOW 8.0
+#define LONG_WINDOW  256.0
+/* Fraction of each new estimate blended into the limit. */
+#define SMOOTHING    0.2
+/* Samples before the baseline means anything: until then the limit holds,
+   so a fresh server's first burst is queued rather than shed. */
+#define WARMUP       LONG_WINDOW
+
+static struct {
+	pthread_mutex_t mtx;      // guards the averages and limit_f
+	double   short_ns, long_ns;
+	double   limit_f;
+	unsigned samples;         // up to WARMUP
+	size_t   min, max;
+	int      adaptive;
+
+	size_t   limit;           // atomic: read by the accept loop
+	size_t   inflight;        // atomic
+	uint64_t admitted, shed;  // atomic
+} g_ad = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.min = 1, .max = SIZE_MAX, .limit = SIZE_MAX,
+};
+
+
+// ---- Internal helpers ----
+
+static double sqrt_approx(double x) {
+	double r = x > 1.0 ? x / 2.0 : 1.0;
+	for (int i = 0; i < 20; i++) r = (r + x / r) / 2.0;   // Newton; x is small
+	return r;
+}
+
+
+//----- API ----------
+
+void admit_init(size_t min_limit, size_t max_limit, int adaptive) {
+	if (min_limit < 1) min_limit = 1;
+	if (max_limit < min_limit) max_limit = min_limit;
+	pthread_mutex_lock(&g_ad.mtx);
+	g_ad.min = min_limit;
+	g_ad.max = max_limit;
+	g_ad.adaptive = adaptive;
+	g_ad.short_ns = g_ad.long_ns = 0;
+	g_ad.samples = 0;
+	g_ad.limit_f = (double)max_limit;      // start optimistic; overload pulls it down
+	__atomic_store_n(&g_ad.limit, max_limit, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&g_ad.mtx);
+}
+
+int admit_try(void) {
+	size_t n = __atomic_add_fetch(&g_ad.inflight, 1, __ATOMIC_RELAXED);
+	if (n > __atomic_load_n(&g_ad.limit, __ATOMIC_RELAXED)) {
+		__atomic_sub_fetch(&g_ad.inflight, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&g_ad.shed, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	__atomic_add_fetch(&g_ad.admitted, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+void admit_cancel(void) {
+	__atomic_sub_fetch(&g_ad.inflight, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&g_ad.admitted, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&g_ad.shed, 1, __ATOMIC_RELAXED);
+}
+
+void admit_done(void) {
+	__atomic_sub_fetch(&g_ad.inflight, 1, __ATOMIC_RELAXED);
+}
+
+void admit_observe_wait(uint64_t wait_ns) {
+	if (!g_ad.adaptive) return;
+	const double s = (double)(wait_ns > ADMIT_WAIT_FLOOR_NS ? wait_ns : ADMIT_WAIT_FLOOR_NS);
+
+	pthread_mutex_lock(&g_ad.mtx);
+	if (g_ad.long_ns == 0) g_ad.short_ns = g_ad.long_ns = s;
+	g_ad.short_ns += (s - g_ad.short_ns) / SHORT_WINDOW;
+	g_ad.long_ns  += (s - g_ad.long_ns) / LONG_WINDOW;
+	// After a burst the baseline lags far above the present: let it recover.
+	if (g_ad.long_ns > 2.0 * g_ad.short_ns) g_ad.long_ns *= 0.95;
+	if (g_ad.samples < WARMUP) {
+		g_ad.samples++;
+		pthread_mutex_unlock(&g_ad.mtx);
+		return;
+	}
+
+	double grad = ADMIT_TOLERANCE * g_ad.long_ns / g_ad.short_ns;
+	if (grad > 1.0) grad = 1.0;
+	if (grad < 0.5) grad = 0.5;
+	const double target = g_ad.limit_f * grad + sqrt_approx(g_ad.limit_f);
+	double l = g_ad.limit_f * (1.0 - SMOOTHING) + target * SMOOTHING;
+	if (l < (double)g_ad.min) l = (double)g_ad.min;
+	if (l > (double)g_ad.max) l = (double)g_ad.max;
+	g_ad.limit_f = l;
+	__atomic_store_n(&g_ad.limit, (size_t)l, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&g_ad.mtx);
+}
+
+size_t admit_limit(void) {
+	return __atomic_load_n(&g_ad.limit, __ATOMIC_RELAXED);
+}
+
+void admit_get_stats(struct admit_stats *out) {
+	out->limit    = __atomic_load_n(&g_ad.limit, __ATOMIC_RELAXED);
+	out->inflight = __atomic_load_n(&g_ad.inflight, __ATOMIC_RELAXED);
+	out->admitted = __atomic_load_n(&g_ad.admitted, __ATOMIC_RELAXED);
+	out->shed     = __atomic_load_n(&g_ad.shed, __ATOMIC_RELAXED);
+}
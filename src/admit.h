@@ -0,0 +1,71 @@
+#ifndef MYHTTP_ADMIT_H
+#define MYHTTP_ADMIT_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+/* Process-wide admission control for accepted connections.
+
+   A connection is in flight from the moment the accept loop admits it until
+   its worker is done with it (queued + being served). The accept loop
+   admits one only while fewer than admit_limit() are in flight; the rest
+   are shed at once with ADMIT_503 rather than waiting, unseen, in the
+   queue or the kernel backlog.
+
+   In gradient mode the limit follows queueing delay, the time admitted
+   connections wait for a worker: a short moving average of that wait is
+   compared with a long-run baseline. Each sample moves the limit a fifth
+   of the way toward limit * gradient + sqrt(limit), where the gradient is
+   ADMIT_TOLERANCE times the baseline over the short average, clamped to
+   [0.5, 1]: while the short average runs high the limit shrinks by up to
+   about 10% per sample, and once it doesn't the limit grows back by about
+   0.2 * sqrt(limit) per sample. Admitted connections therefore keep seeing the latency of a
+   healthy server while the overflow gets a fast, cheap refusal. The limit
+   only starts moving once the baseline has seen a long window of samples.
+   In fixed mode the limit stays at its maximum. */
+
+#ifndef ADMIT_TOLERANCE
+#define ADMIT_TOLERANCE   2.0             // short/long wait ratio tolerated
+#endif
+
+#ifndef ADMIT_WAIT_FLOOR_NS
+#define ADMIT_WAIT_FLOOR_NS 1000000ull    // waits under 1 ms count as 1 ms
+#endif
+
+/* Pre-rendered shed response; the connection is closed after it. */
+#define ADMIT_503 "HTTP/1.1 503 Service Unavailable\r\n" \
+                  "Content-Type: text/plain; charset=utf-8\r\n" \
+                  "Content-Length: 12\r\n" \
+                  "Retry-After: 1\r\n" \
+                  "Connection: close\r\n" \
+                  "\r\n" \
+                  "overloaded\r\n"
+
+struct admit_stats {
+	size_t   limit;        // current in-flight limit
+	size_t   inflight;     // admitted, not yet finished
+	uint64_t admitted;
+	uint64_t shed;
+};
+
+/* Configure: the limit moves within [min_limit, max_limit]; 'adaptive' 0
+   pins it at max_limit. Call before the first admit_try(). */
+void   admit_init(size_t min_limit, size_t max_limit, int adaptive);
+
+/* Accept loop: reserve an in-flight slot. Returns 1 if admitted, 0 if the
+   connection should be shed (counted). */
+int    admit_try(void);
+
+/* Take back an admission the queue could not hold; counted as shed. */
+void   admit_cancel(void);
+
+/* Worker: a connection was dequeued after waiting 'wait_ns' (adjusts the
+   limit), and later, finished. */
+void   admit_observe_wait(uint64_t wait_ns);
+void   admit_done(void);
+
+size_t admit_limit(void);
+
+void   admit_get_stats(struct admit_stats *out);
+
+#endif /* MYHTTP_ADMIT_H */
@@ -0,0 +1,70 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "allochook.h"
+
+#include <stddef.h>
+
+#ifdef MYHTTP_ALLOC_HOOK
+
+#include <errno.h>
+
+/* glibc keeps its allocator reachable under these names, so the wrappers
+   below can forward without dlsym() (which itself allocates). */
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t n, size_t sz);
+extern void *__libc_realloc(void *p, size_t n);
+extern void *__libc_memalign(size_t align, size_t n);
+extern void  __libc_free(void *p);
+
+static _Thread_local uint64_t tl_allocs;   // static TLS: safe inside malloc
+static uint64_t g_allocs;
+
+static inline void count(void) {
+	tl_allocs++;
+	__atomic_fetch_add(&g_allocs, 1, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t n) {
+	count();
+	return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t sz) {
+	count();
+	return __libc_calloc(n, sz);
+}
+
+void *realloc(void *p, size_t n) {
+	count();
+	return __libc_realloc(p, n);
+}
+
+void *aligned_alloc(size_t align, size_t n) {
+	count();
+	return __libc_memalign(align, n);
+}
+
+int posix_memalign(void **out, size_t align, size_t n) {
+	if (align < sizeof(void *) || (align & (align - 1)) != 0) return EINVAL;
+	count();
+	void *p = __libc_memalign(align, n);
+	if (!p) return ENOMEM;
+	*out = p;
+	return 0;
+}
+
+void free(void *p) {
+	__libc_free(p);
+}
+
+int allochook_enabled(void) { return 1; }
+uint64_t allochook_thread_allocs(void) { return tl_allocs; }
+uint64_t allochook_total_allocs(void) { return __atomic_load_n(&g_allocs, __ATOMIC_RELAXED); }
+
+#else
+
+int allochook_enabled(void) { return 0; }
+uint64_t allochook_thread_allocs(void) { return 0; }
+uint64_t allochook_total_allocs(void) { return 0; }
+
+#endif /* MYHTTP_ALLOC_HOOK */
@@ -0,0 +1,22 @@
+#ifndef MYHTTP_ALLOCHOOK_H
+#define MYHTTP_ALLOCHOOK_H
+
+#include <stdint.h>   // uint64_t
+
+/* Heap-allocation counting for tests.
+
+   Built with -DMYHTTP_ALLOC_HOOK (the `MyHTTP-allochook` binary), this file
+   interposes malloc/calloc/realloc/aligned_alloc/posix_memalign and counts
+   every allocation, including ones made inside libc (strdup, opendir, ...).
+   In a normal build the counters are always 0 and cost one call. */
+
+/* 1 when the hook is compiled in. */
+int      allochook_enabled(void);
+
+/* Allocations made by the calling thread so far. */
+uint64_t allochook_thread_allocs(void);
+
+/* Allocations made by the whole process so far. */
+uint64_t allochook_total_allocs(void);
+
+#endif /* MYHTTP_ALLOCHOOK_H */
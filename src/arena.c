@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "arena.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct arena_spill {
+	struct arena_spill *next;
+	size_t _pad;                  // keeps the payload ARENA_ALIGN-aligned
+};
+
+
+// ---- Internal helpers ----
+
+static inline size_t align_up(size_t n) {
+	return (n + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static void free_spills(struct mh_arena *a) {
+	struct arena_spill *s = a->spill;
+	while (s) {
+		struct arena_spill *next = s->next;
+		free(s);
+		s = next;
+	}
+	a->spill = NULL;
+}
+
+
+//----- API ----------
+
+int arena_init(struct mh_arena *a, size_t cap) {
+	memset(a, 0, sizeof(*a));
+	cap = align_up(cap);
+	if (cap) {
+		a->base = (char *)aligned_alloc(ARENA_ALIGN, cap);
+		if (!a->base) { errno = ENOMEM; return -1; }
+	}
+	a->cap = cap;
+	return 0;
+}
+
+void arena_destroy(struct mh_arena *a) {
+	if (!a) return;
+	free_spills(a);
+	if (!a->borrowed) free(a->base);
+	a->base = NULL;
+	a->cap = a->used = 0;
+	a->borrowed = 0;
+}
+
+void arena_attach(struct mh_arena *a, void *block, size_t cap) {
+	if (!a->borrowed) free(a->base);
+	a->base = (char *)block;
+	a->cap = block ? (cap & ~(size_t)(ARENA_ALIGN - 1)) : 0;
+	a->used = 0;
+	a->borrowed = block != NULL;
+}
+
+void *arena_detach(struct mh_arena *a) {
+	arena_reset(a);
+	void *block = a->borrowed ? a->base : NULL;
+	if (!a->borrowed) free(a->base);
+	a->base = NULL;
+	a->cap = 0;
+	a->borrowed = 0;
+	return block;
+}
+
+void arena_reset(struct mh_arena *a) {
+	if (a->spill) free_spills(a);
+	a->used = 0;
+}
+
+void *arena_alloc(struct mh_arena *a, size_t n) {
+	size_t need = align_up(n ? n : 1);
+	if (need <= a->cap - a->used) {
+		void *p = a->base + a->used;
+		a->used += need;
+		if (a->used > a->peak) a->peak = a->used;
+		return p;
+	}
+
+	if (need > SIZE_MAX - sizeof(struct arena_spill)) { errno = ENOMEM; return NULL; }
+	struct arena_spill *s = (struct arena_spill *)malloc(sizeof(*s) + need);
+	if (!s) { errno = ENOMEM; return NULL; }
+	s->next = a->spill;
+	a->spill = s;
+	a->spills++;
+	return s + 1;
+}
+
+char *arena_strndup(struct mh_arena *a, const char *s, size_t n) {
+	char *p = (char *)arena_alloc(a, n + 1);
+	if (!p) return NULL;
+	memcpy(p, s, n);
+	p[n] = '\0';
+	return p;
+}
+
+char *arena_strdup(struct mh_arena *a, const char *s) {
+	return arena_strndup(a, s, strlen(s));
+}
@@ -0,0 +1,58 @@
+#ifndef MYHTTP_ARENA_H
+#define MYHTTP_ARENA_H
+
+#include <stddef.h>   // size_t
+
+/* Bump allocator for one request's scratch memory.
+
+   Each connection owns one arena; it is reset between requests, so the
+   parser, resolver, header builder and listing generator can allocate
+   freely without free(). Allocations are 16-byte aligned. When the block
+   runs out, requests spill into individually malloc'd chunks that are
+   released on the next reset (counted in 'spills' so a too-small arena
+   shows up in tuning). */
+
+#ifndef ARENA_ALIGN
+#define ARENA_ALIGN 16u
+#endif
+
+struct arena_spill;
+
+struct mh_arena {
+	char  *base;
+	size_t cap;
+	size_t used;
+	size_t peak;                  // high-water mark of 'used' since init
+	unsigned long spills;         // allocations that did not fit
+	struct arena_spill *spill;    // overflow chunks, freed on reset
+	int    borrowed;              // 'base' belongs to the caller (arena_attach)
+};
+
+/* Allocate a 'cap'-byte block (cap may be 0: everything spills).
+   Returns 0, or -1 with errno set. */
+int   arena_init(struct mh_arena *a, size_t cap);
+void  arena_destroy(struct mh_arena *a);
+
+/* Run on a caller-owned block (e.g. from the buffer pool) instead of one
+   of our own; arena_detach() resets and hands the block back (NULL if
+   none is attached). A detached arena spills everything until the next
+   attach. */
+void  arena_attach(struct mh_arena *a, void *block, size_t cap);
+void *arena_detach(struct mh_arena *a);
+
+/* Forget every allocation; keeps the block, frees spill chunks. */
+void  arena_reset(struct mh_arena *a);
+
+/* n bytes, ARENA_ALIGN-aligned. NULL with errno = ENOMEM on failure. */
+void *arena_alloc(struct mh_arena *a, size_t n);
+char *arena_strdup(struct mh_arena *a, const char *s);
+char *arena_strndup(struct mh_arena *a, const char *s, size_t n);
+
+/* Scoped use within a request: release everything allocated after 'mark'
+   from the main block (spill chunks live until reset). */
+static inline size_t arena_mark(const struct mh_arena *a) { return a->used; }
+static inline void   arena_release(struct mh_arena *a, size_t mark) {
+	if (mark <= a->used) a->used = mark;
+}
+
+#endif /* MYHTTP_ARENA_H */
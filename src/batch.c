@@ -0,0 +1,628 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE           // renameat2, syncfs, nftw
+
+#include "batch.h"
+#include "pathlock.h"
+#include "dcache.h"
+#include "bufpool.h"
+#include "iohint.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TAR_BLOCK    512
+#define TAR_SIZE_MAX 077777777777ull   /* 11 octal digits */
+#define TAR_PAX_MAX  (64 * 1024)       /* largest pax extended header read */
+
+static struct {
+	uint64_t      requests, files, failed, bytes, uploads, unpacked;
+	unsigned long seq;
+} g_batch;
+
+static const char k_zeros[2 * TAR_BLOCK];
+
+/* Paths that could not be sent, for the tar's last member. */
+struct errbuf {
+	char  *p;
+	size_t len, cap;
+	int    oom;
+};
+
+
+// ---- Internal helpers ----
+
+static void eb_printf(struct errbuf *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void eb_printf(struct errbuf *b, const char *fmt, ...) {
+	if (b->oom) return;
+	for (;;) {
+		va_list ap;
+		va_start(ap, fmt);
+		int n = vsnprintf(b->p ? b->p + b->len : NULL, b->p ? b->cap - b->len : 0, fmt, ap);
+		va_end(ap);
+		if (n < 0) { b->oom = 1; return; }
+		if (b->p && (size_t)n < b->cap - b->len) { b->len += (size_t)n; return; }
+		size_t cap = b->cap * 2 + (size_t)n + 256;
+		char *np = (char *)realloc(b->p, cap);
+		if (!np) { b->oom = 1; return; }
+		b->p = np;
+		b->cap = cap;
+	}
+}
+
+static const char *reason_of(int status) {
+	switch (status) {
+		case 400: return "Bad Request";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 413: return "Payload Too Large";
+		default:  return "Internal Server Error";
+	}
+}
+
+/* Names go into tar headers and part headers as they are: no control
+   characters, and no ".." segment for an extractor to follow. */
+static int bad_name(const char *path) {
+	for (const unsigned char *p = (const unsigned char *)path; *p; p++)
+		if (*p < 0x20 || *p == 0x7f) return 1;
+	for (const char *s = path; (s = strstr(s, "..")) != NULL; s += 2)
+		if (s[-1] == '/' && (s[2] == '/' || s[2] == '\0')) return 1;
+	return path[1] == '\0';   // "/" names no file
+}
+
+// 'path' for echoing back, control bytes percent-escaped: a rejected name
+// must not be able to end the part header it is written into.
+static void shown_name(char dst[3 * PATH_MAX], const char *path) {
+	static const char hex[] = "0123456789ABCDEF";
+	char *o = dst;
+	for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+		if (*p < 0x20 || *p == 0x7f) {
+			*o++ = '%';
+			*o++ = hex[*p >> 4];
+			*o++ = hex[*p & 15];
+		} else {
+			*o++ = (char)*p;
+		}
+	}
+	*o = '\0';
+}
+
+static int write_str(const struct batch_ops *ops, void *ctx, const char *s, size_t n) {
+	return ops->write(ctx, s, n);
+}
+
+static int chunk_begin(const struct batch_ops *ops, void *ctx, size_t n) {
+	char line[24];
+	const int k = snprintf(line, sizeof(line), "%zx\r\n", n);
+	return write_str(ops, ctx, line, (size_t)k);
+}
+
+// Zero-padded octal filling 'width' bytes, the last one NUL.
+static void tar_octal(char *dst, size_t width, unsigned long long v) {
+	dst[width - 1] = '\0';
+	for (size_t i = width - 1; i-- > 0; v >>= 3) dst[i] = (char)('0' + (v & 7));
+}
+
+/* ustar header for 'name' (no leading '/'), split into prefix and name
+   fields if it is longer than 100 bytes. -1 if it does not fit. */
+static int tar_header(char h[TAR_BLOCK], const char *name, size_t size, time_t mtime) {
+	const size_t n = strlen(name);
+	const char *base = name;
+	size_t plen = 0;
+	if (n > 100) {
+		const char *q = strchr(name + n - 101, '/');
+		if (!q) return -1;
+		plen = (size_t)(q - name);
+		base = q + 1;
+		if (plen > 155 || *base == '\0') return -1;
+	}
+	if ((unsigned long long)size > TAR_SIZE_MAX) return -1;
+
+	memset(h, 0, TAR_BLOCK);
+	memcpy(h, base, strlen(base));
+	tar_octal(h + 100, 8, 0644);                  // mode
+	tar_octal(h + 108, 8, 0);                     // uid
+	tar_octal(h + 116, 8, 0);                     // gid
+	tar_octal(h + 124, 12, (unsigned long long)size);
+	tar_octal(h + 136, 12, mtime > 0 ? (unsigned long long)mtime : 0);
+	h[156] = '0';                                 // regular file
+	memcpy(h + 257, "ustar", 6);
+	memcpy(h + 263, "00", 2);
+	memcpy(h + 345, name, plen);
+
+	memset(h + 148, ' ', 8);                      // checksum: over itself as spaces
+	unsigned sum = 0;
+	for (size_t i = 0; i < TAR_BLOCK; i++) sum += (unsigned char)h[i];
+	tar_octal(h + 148, 7, sum);
+	h[155] = ' ';
+	return 0;
+}
+
+// One tar member (header, body, padding) as one chunk.
+static int send_tar_member(const struct batch_ops *ops, void *ctx, const char *hdr,
+                           const struct batch_file *f) {
+	const size_t pad = (TAR_BLOCK - f->size % TAR_BLOCK) % TAR_BLOCK;
+	if (chunk_begin(ops, ctx, TAR_BLOCK + f->size + pad) < 0 ||
+	    ops->write(ctx, hdr, TAR_BLOCK) < 0 ||
+	    (f->size && ops->write_file(ctx, f) < 0) ||
+	    (pad && ops->write(ctx, k_zeros, pad) < 0))
+		return -1;
+	return write_str(ops, ctx, "\r\n", 2);
+}
+
+// One multipart part as one chunk; a failed path gets an empty part.
+static int send_part(const struct batch_ops *ops, void *ctx, const char *boundary,
+                     const char *path, int status, const struct batch_file *f) {
+	char ph[3 * PATH_MAX + 256];
+	const size_t size = status ? 0 : f->size;
+	int n = status
+		? snprintf(ph, sizeof(ph), "--%s\r\nContent-Location: %s\r\nX-Batch-Status: %d %s\r\n"
+		                           "Content-Length: 0\r\n\r\n", boundary, path, status, reason_of(status))
+		: snprintf(ph, sizeof(ph), "--%s\r\nContent-Location: %s\r\nContent-Type: %s\r\n"
+		                           "Content-Length: %zu\r\n\r\n", boundary, path, f->ctype, size);
+	if (n < 0 || (size_t)n >= sizeof(ph)) return -1;
+	if (chunk_begin(ops, ctx, (size_t)n + size + 2) < 0 || ops->write(ctx, ph, (size_t)n) < 0 ||
+	    (size && ops->write_file(ctx, f) < 0))
+		return -1;
+	return write_str(ops, ctx, "\r\n\r\n", 4);   // the part's, then the chunk's
+}
+
+static int send_path(const struct batch_ops *ops, void *ctx, int format, const char *boundary,
+                     const char *path, struct errbuf *errs) {
+	struct batch_file f = { .fd = -1 };
+	char hdr[TAR_BLOCK];
+	int status = bad_name(path) ? 400 : ops->open(ctx, path, &f);
+	if (status == 0 && format == BATCH_TAR && tar_header(hdr, path + 1, f.size, f.mtime) < 0) {
+		ops->close(ctx, &f);
+		status = f.size > TAR_SIZE_MAX ? 413 : 400;
+	}
+	if (status) {
+		char shown[3 * PATH_MAX];
+		__atomic_add_fetch(&g_batch.failed, 1, __ATOMIC_RELAXED);
+		shown_name(shown, path);
+		if (format == BATCH_MULTIPART) return send_part(ops, ctx, boundary, shown, status, NULL);
+		eb_printf(errs, "%d %s %s\n", status, reason_of(status), shown);
+		return 0;
+	}
+	int rc = format == BATCH_TAR ? send_tar_member(ops, ctx, hdr, &f)
+	                             : send_part(ops, ctx, boundary, path, 0, &f);
+	ops->close(ctx, &f);
+	if (rc == 0) {
+		__atomic_add_fetch(&g_batch.files, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&g_batch.bytes, f.size, __ATOMIC_RELAXED);
+	}
+	return rc;
+}
+
+/* The request body, as the archive: 'prefill' first, then 'src'. */
+struct tar_in {
+	fs_source_fn src;
+	void        *ctx;
+	const char  *pre;
+	size_t       pre_len;
+	size_t       left;       // body bytes not yet read, prefill included
+};
+
+static int tin_read(struct tar_in *t, void *buf, size_t n) {
+	if (n > t->left) { errno = EPROTO; return -1; }   // archive cut short
+	char *d = (char *)buf;
+	while (n) {
+		size_t k;
+		if (t->pre_len) {
+			k = n < t->pre_len ? n : t->pre_len;
+			memcpy(d, t->pre, k);
+			t->pre += k;
+			t->pre_len -= k;
+		} else {
+			ssize_t r = t->src(t->ctx, d, n);
+			if (r <= 0) { if (r == 0) errno = EIO; return -1; }
+			k = (size_t)r;
+		}
+		d += k;
+		n -= k;
+		t->left -= k;
+	}
+	return 0;
+}
+
+static int tin_skip(struct tar_in *t, size_t n, char *buf, size_t cap) {
+	while (n) {
+		const size_t k = n < cap ? n : cap;
+		if (tin_read(t, buf, k) < 0) return -1;
+		n -= k;
+	}
+	return 0;
+}
+
+static int write_full(int fd, const char *p, size_t n) {
+	while (n) {
+		ssize_t w = write(fd, p, n);
+		if (w < 0 && errno == EINTR) continue;
+		if (w < 0) return -1;
+		p += w;
+		n -= (size_t)w;
+	}
+	return 0;
+}
+
+// Octal (NUL/space terminated) or GNU base-256 numeric field.
+static int tar_number(const char *f, size_t width, unsigned long long *out) {
+	unsigned long long v = 0;
+	if ((unsigned char)f[0] & 0x80) {
+		v = (unsigned char)f[0] & 0x3f;
+		for (size_t i = 1; i < width; i++) {
+			if (v >> 55) return -1;
+			v = v << 8 | (unsigned char)f[i];
+		}
+		*out = v;
+		return 0;
+	}
+	size_t i = 0;
+	while (i < width && f[i] == ' ') i++;
+	for (; i < width && f[i] >= '0' && f[i] <= '7'; i++) {
+		if (v >> 60) return -1;
+		v = v << 3 | (unsigned)(f[i] - '0');
+	}
+	if (i < width && f[i] != ' ' && f[i] != '\0') return -1;
+	*out = v;
+	return 0;
+}
+
+static int tar_sum_ok(const char h[TAR_BLOCK]) {
+	unsigned long long want;
+	if (tar_number(h + 148, 8, &want) < 0) return 0;
+	unsigned sum = 0;
+	for (size_t i = 0; i < TAR_BLOCK; i++)
+		sum += (i >= 148 && i < 156) ? ' ' : (unsigned char)h[i];
+	return sum == want;
+}
+
+/* The "path" (and "size") records of a pax extended header. */
+static int pax_parse(char *p, size_t n, char *path, size_t pathlen,
+                     unsigned long long *size, int *have_size) {
+	for (size_t off = 0; off < n; ) {
+		// "<len> <key>=<value>\n", where <len> counts the whole record.
+		size_t len = 0, d = off;
+		for (; d < n && p[d] >= '0' && p[d] <= '9'; d++) {
+			len = len * 10 + (size_t)(p[d] - '0');
+			if (len > n - off) return -1;
+		}
+		if (d == off || d == n || p[d] != ' ' || len == 0 || p[off + len - 1] != '\n') return -1;
+		char *sp = p + d, *end = p + off + len - 1;
+		if (sp + 1 >= end) return -1;   // the space must fall inside the record
+		char *kv = sp + 1;
+		char *eq = (char *)memchr(kv, '=', (size_t)(end - kv));
+		if (!eq) return -1;
+		const size_t klen = (size_t)(eq - kv), vlen = (size_t)(end - eq - 1);
+		if (klen == 4 && memcmp(kv, "path", 4) == 0) {
+			if (vlen >= pathlen) return -1;
+			memcpy(path, eq + 1, vlen);
+			path[vlen] = '\0';
+		} else if (klen == 4 && memcmp(kv, "size", 4) == 0) {
+			*end = '\0';
+			*size = strtoull(eq + 1, NULL, 10);
+			*have_size = 1;
+		}
+		off += len;
+	}
+	return 0;
+}
+
+/* Member name -> "/a/b" in 'out' (empty for the archive's root entry).
+   Returns 0, or -1 for a name that must not be extracted. */
+static int member_path(const char *name, char *out, size_t outlen) {
+	while (name[0] == '/' || (name[0] == '.' && (name[1] == '/' || name[1] == '\0')))
+		name += name[0] == '/' ? 1 : 1 + (name[1] == '/');
+	size_t n = strlen(name);
+	while (n && name[n - 1] == '/') n--;
+	if (n + 2 > outlen) return -1;
+	out[0] = '\0';
+	if (n == 0) return 0;
+	out[0] = '/';
+	memcpy(out + 1, name, n);
+	out[n + 1] = '\0';
+	return bad_name(out) ? -1 : 0;
+}
+
+// mkdir -p for the directories between 'base' (exists) and the leaf of 'abs'.
+static int make_parents(char *abs, size_t base) {
+	for (char *s = abs + base + 1; (s = strchr(s, '/')) != NULL; s++) {
+		*s = '\0';
+		const int rc = mkdir(abs, 0755);
+		*s = '/';
+		if (rc < 0 && errno != EEXIST) return -1;
+	}
+	return 0;
+}
+
+static int rm_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+	(void)st; (void)flag; (void)ftw;
+	(void)remove(path);
+	return 0;
+}
+
+static void remove_tree(const char *dir) {
+	(void)nftw(dir, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/* Extract every member of the archive in 't' under 'root' (an existing,
+   canonical directory). Returns the number of files, or -1. */
+static long unpack_into(const char *root, struct tar_in *t, char *buf, size_t cap) {
+	const size_t rootlen = strlen(root);
+	char h[TAR_BLOCK];
+	char name[PATH_MAX], path[PATH_MAX], abs[PATH_MAX];
+	int have_name = 0;
+	unsigned long long pax_size = 0;
+	int have_size = 0;
+	long files = 0;
+
+	for (;;) {
+		if (t->left == 0) return files;   // no end-of-archive blocks: accept
+		if (tin_read(t, h, TAR_BLOCK) < 0) return -1;
+		if (memcmp(h, k_zeros, TAR_BLOCK) == 0) return files;
+		if (!tar_sum_ok(h)) { errno = EPROTO; return -1; }
+
+		unsigned long long size;
+		if (tar_number(h + 124, 12, &size) < 0) { errno = EPROTO; return -1; }
+		if (have_size) size = pax_size;
+		const size_t pad = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+		const char type = h[156];
+
+		if (type == 'x' || type == 'L') {
+			// Metadata for the next member.
+			if (size >= (type == 'x' ? TAR_PAX_MAX : sizeof(name))) { errno = EPROTO; return -1; }
+			char *meta = type == 'x' ? (char *)malloc(size + 1) : name;
+			if (!meta) return -1;
+			int rc = tin_read(t, meta, size);
+			if (rc == 0) rc = tin_skip(t, pad, buf, cap);
+			if (rc == 0 && type == 'L') {
+				name[size] = '\0';
+				have_name = 1;
+			} else if (rc == 0) {
+				name[0] = '\0';
+				if (pax_parse(meta, size, name, sizeof(name), &pax_size, &have_size) < 0) {
+					errno = EPROTO;
+					rc = -1;
+				}
+				have_name = name[0] != '\0';
+			}
+			if (type == 'x') free(meta);
+			if (rc < 0) return -1;
+			continue;
+		}
+		if (type == 'g' || type == 'K') {   // global pax header, GNU long link name
+			if (tin_skip(t, size + pad, buf, cap) < 0) return -1;
+			continue;
+		}
+
+		if (!have_name) {
+			const size_t nlen = strnlen(h, 100), plen = memcmp(h + 257, "ustar", 5) == 0 ? strnlen(h + 345, 155) : 0;
+			if (plen) {
+				memcpy(name, h + 345, plen);
+				name[plen] = '/';
+			}
+			memcpy(name + plen + (plen != 0), h, nlen);
+			name[plen + (plen != 0) + nlen] = '\0';
+		}
+		have_name = have_size = 0;
+		const int is_dir = type == '5' || ((type == '0' || type == '\0') && name[0] && name[strlen(name) - 1] == '/');
+		if (!is_dir && type != '0' && type != '\0' && type != '7') { errno = EPROTO; return -1; }   // links, devices
+		if (member_path(name, path, sizeof(path)) < 0) { errno = EPROTO; return -1; }
+		if (path[0] == '\0') {   // "./"
+			if (tin_skip(t, size + pad, buf, cap) < 0) return -1;
+			continue;
+		}
+
+		if (fs_join_safe(root, path, abs, sizeof(abs)) < 0 || strncmp(abs, root, rootlen) != 0 ||
+		    make_parents(abs, rootlen) < 0)
+			return -1;
+		if (is_dir) {
+			if (mkdir(abs, 0755) < 0 && errno != EEXIST) return -1;
+			if (tin_skip(t, size + pad, buf, cap) < 0) return -1;
+			continue;
+		}
+
+		const int fd = open(abs, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0644);
+		if (fd < 0) return -1;
+		struct iohint_write wb;
+		iohint_write_begin(&wb, fd);
+		int rc = 0;
+		for (unsigned long long left = size; rc == 0 && left; ) {
+			const size_t k = left < cap ? (size_t)left : cap;
+			rc = tin_read(t, buf, k);
+			if (rc == 0) rc = write_full(fd, buf, k);
+			if (rc == 0) iohint_write_done(&wb, k);
+			left -= k;
+		}
+		unsigned long long mtime = 0;
+		if (rc == 0 && tar_number(h + 136, 12, &mtime) == 0) {
+			const struct timespec ts[2] = { { (time_t)mtime, 0 }, { (time_t)mtime, 0 } };
+			(void)futimens(fd, ts);
+		}
+		const int e = errno;
+		close(fd);
+		errno = e;
+		if (rc < 0 || tin_skip(t, pad, buf, cap) < 0) return -1;
+		files++;
+	}
+}
+
+
+//----- API ----------
+
+int batch_format_for(const char *accept) {
+	for (const char *a = accept; a && *a; a++)
+		if (strncasecmp(a, "multipart/mixed", 15) == 0) return BATCH_MULTIPART;
+	return BATCH_TAR;
+}
+
+int batch_stream(const char *list, size_t len, int format, const struct batch_ops *ops, void *ctx) {
+	char boundary[64];
+	snprintf(boundary, sizeof(boundary), "myhttp-batch-%llx-%lx", (unsigned long long)time(NULL),
+	         __atomic_add_fetch(&g_batch.seq, 1, __ATOMIC_RELAXED));
+	char hdr[256];
+	int n = snprintf(hdr, sizeof(hdr),
+	                 "HTTP/1.1 200 OK\r\n"
+	                 "Content-Type: %s%s\r\n"
+	                 "Transfer-Encoding: chunked\r\n"
+	                 "\r\n",
+	                 format == BATCH_MULTIPART ? "multipart/mixed; boundary=" : "application/x-tar",
+	                 format == BATCH_MULTIPART ? boundary : "");
+	__atomic_add_fetch(&g_batch.requests, 1, __ATOMIC_RELAXED);
+	if (ops->write(ctx, hdr, (size_t)n) < 0) return -1;
+
+	struct errbuf errs = { 0 };
+	char path[PATH_MAX];
+	int rc = 0;
+	for (const char *line = list, *end = list + len; rc == 0 && line < end; ) {
+		const char *nl = (const char *)memchr(line, '\n', (size_t)(end - line));
+		const char *next = nl ? nl + 1 : end;
+		const char *e = nl ? nl : end;
+		while (e > line && (e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t')) e--;
+		while (line < e && (*line == ' ' || *line == '\t')) line++;
+		if (line < e && *line != '#') {
+			const size_t k = (size_t)(e - line);
+			const size_t lead = *line != '/';
+			if (k + lead < sizeof(path)) {
+				path[0] = '/';
+				memcpy(path + lead, line, k);
+				path[k + lead] = '\0';
+				rc = send_path(ops, ctx, format, boundary, path, &errs);
+			} else {
+				__atomic_add_fetch(&g_batch.failed, 1, __ATOMIC_RELAXED);
+				eb_printf(&errs, "400 %s (path too long)\n", reason_of(400));
+			}
+		}
+		line = next;
+	}
+
+	if (rc == 0 && format == BATCH_TAR) {
+		char th[TAR_BLOCK];
+		if (errs.len && !errs.oom && tar_header(th, BATCH_ERRORS_NAME, errs.len, time(NULL)) == 0) {
+			// Copied, not queued by reference: freed below.
+			const size_t pad = (TAR_BLOCK - errs.len % TAR_BLOCK) % TAR_BLOCK;
+			if (chunk_begin(ops, ctx, TAR_BLOCK + errs.len + pad) < 0 || ops->write(ctx, th, TAR_BLOCK) < 0 ||
+			    ops->write(ctx, errs.p, errs.len) < 0 || (pad && ops->write(ctx, k_zeros, pad) < 0) ||
+			    write_str(ops, ctx, "\r\n", 2) < 0)
+				rc = -1;
+		}
+		if (rc == 0 && (chunk_begin(ops, ctx, sizeof(k_zeros)) < 0 ||   // end of archive
+		                ops->write(ctx, k_zeros, sizeof(k_zeros)) < 0 || write_str(ops, ctx, "\r\n", 2) < 0))
+			rc = -1;
+	} else if (rc == 0) {
+		n = snprintf(hdr, sizeof(hdr), "--%s--\r\n", boundary);
+		if (chunk_begin(ops, ctx, (size_t)n) < 0 || ops->write(ctx, hdr, (size_t)n) < 0 ||
+		    write_str(ops, ctx, "\r\n", 2) < 0)
+			rc = -1;
+	}
+	free(errs.p);
+	if (rc == 0) rc = write_str(ops, ctx, "0\r\n\r\n", 5);
+	return rc;
+}
+
+int batch_unpack(const char *docroot_real, const char *decoded_dir,
+                 fs_source_fn src, void *src_ctx, size_t content_len,
+                 const void *prefill, size_t prefill_len) {
+	if (prefill_len > content_len) { errno = EPROTO; return -1; }
+
+	char dir_abs[PATH_MAX], stage[PATH_MAX];
+	if (fs_join_safe(docroot_real, decoded_dir, dir_abs, sizeof(dir_abs)) < 0) return -1;
+	if (strcmp(dir_abs, docroot_real) == 0) { errno = EBUSY; return -1; }
+	struct stat st;
+	if (lstat(dir_abs, &st) == 0 && !S_ISDIR(st.st_mode)) { errno = ENOTDIR; return -1; }
+
+	// Staged next to the target, so the swap is a rename in one directory.
+	const char *slash = strrchr(dir_abs, '/');
+	const int n = snprintf(stage, sizeof(stage), "%.*s/.%s.tmp.XXXXXX",
+	                       (int)(slash - dir_abs), dir_abs, slash + 1);
+	if (n < 0 || (size_t)n >= sizeof(stage) - 4) { errno = ENAMETOOLONG; return -1; }
+	if (!mkdtemp(stage)) return -1;
+	(void)chmod(stage, 0755);
+
+	size_t cap;
+	char *buf = (char *)bufpool_get(BUFPOOL_LARGE, &cap);
+	if (!buf) { remove_tree(stage); return -1; }
+	struct tar_in t = { src, src_ctx, (const char *)prefill, prefill_len, content_len };
+	uint64_t tr = trace_begin(TR_BODY);
+	long files = unpack_into(stage, &t, buf, cap);
+	trace_end(TR_BODY, tr);
+	if (files >= 0 && tin_skip(&t, t.left, buf, cap) < 0) files = -1;   // trailing padding
+	int e = errno;
+	bufpool_put(buf, cap);
+
+	/* One flush for the whole tree: syncfs() writes back every file and
+	   directory entry staged above (writeback of each file was started
+	   as it was written) instead of one fsync() per file. It flushes the
+	   rest of the filesystem's dirty data too, which a deploy can live with. */
+	if (files >= 0) {
+		const int dfd = open(stage, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		tr = trace_begin(TR_FSYNC);
+		if (dfd < 0 || syncfs(dfd) < 0) { e = errno; files = -1; }
+		trace_end(TR_FSYNC, tr);
+		if (dfd >= 0) close(dfd);
+	}
+	if (files < 0) {
+		remove_tree(stage);
+		errno = e;
+		return -1;
+	}
+
+	struct path_lock *lk = plock_acquire_wr(dir_abs);
+	if (!lk) { e = errno; remove_tree(stage); errno = e; return -1; }
+	tr = trace_begin(TR_RENAME);
+	int existed = lstat(dir_abs, &st) == 0;
+	int rc = existed ? renameat2(AT_FDCWD, stage, AT_FDCWD, dir_abs, RENAME_EXCHANGE)
+	                 : rename(stage, dir_abs);
+	char old[PATH_MAX];
+	snprintf(old, sizeof(old), "%s", stage);   // after a swap, the old tree
+	if (rc < 0 && existed && (errno == EINVAL || errno == ENOSYS)) {
+		// No RENAME_EXCHANGE here: move the old tree aside first.
+		snprintf(old, sizeof(old), "%s.old", stage);
+		rc = rename(dir_abs, old);
+		if (rc == 0 && (rc = rename(stage, dir_abs)) < 0) {
+			e = errno;
+			(void)rename(old, dir_abs);
+			errno = e;
+		}
+	}
+	e = errno;
+	trace_end(TR_RENAME, tr);
+	dcache_invalidate();
+	plock_release(lk);
+	if (rc < 0) {
+		remove_tree(stage);
+		errno = e;
+		return -1;
+	}
+
+	// The swap itself is made durable with the parent directory.
+	*strrchr(stage, '/') = '\0';
+	const int parent = open(stage, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (parent >= 0) {
+		(void)fsync(parent);
+		close(parent);
+	}
+	if (existed) remove_tree(old);
+
+	__atomic_add_fetch(&g_batch.uploads, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&g_batch.unpacked, (uint64_t)files, __ATOMIC_RELAXED);
+	return existed ? 0 : 1;
+}
+
+void batch_get_stats(struct batch_stats *out) {
+	out->requests = __atomic_load_n(&g_batch.requests, __ATOMIC_RELAXED);
+	out->files = __atomic_load_n(&g_batch.files, __ATOMIC_RELAXED);
+	out->failed = __atomic_load_n(&g_batch.failed, __ATOMIC_RELAXED);
+	out->bytes = __atomic_load_n(&g_batch.bytes, __ATOMIC_RELAXED);
+	out->uploads = __atomic_load_n(&g_batch.uploads, __ATOMIC_RELAXED);
+	out->unpacked = __atomic_load_n(&g_batch.unpacked, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,93 @@
+#ifndef MYHTTP_BATCH_H
+#define MYHTTP_BATCH_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+#include <time.h>     // time_t
+
+#include "fs.h"       // fs_source_fn
+
+/* Batch reads: many files in one response.
+
+   POST BATCH_URL with a list of paths in the body, or GET BATCH_URL
+   followed by the path of a list file in the docroot, and every listed
+   file comes back in one chunked response: an uncompressed ustar archive
+   by default, or multipart/mixed when the client's Accept asks for it.
+   Each member is framed as it is sent (its tar header or part headers
+   built in place, the body queued from the open file), so nothing
+   buffers more than one member's headers.
+
+   The list has one URL path per line (percent-decoded, leading '/'
+   optional); blank lines and lines starting with '#' are skipped.
+   Paths that can't be served are reported instead of failing the whole
+   response: as a part with an X-Batch-Status header in multipart, or
+   listed in a last tar member, BATCH_ERRORS_NAME.
+
+   The other way, PUT BATCH_URL followed by a directory path with a tar
+   archive as the body replaces that directory with the archive's
+   contents in one step (batch_unpack()). */
+
+#define BATCH_URL          "/_batch"
+#define BATCH_ERRORS_NAME  "_batch_errors.txt"
+
+#ifndef BATCH_LIST_MAX
+#define BATCH_LIST_MAX     (1024 * 1024)   /* largest path list, in bytes */
+#endif
+
+enum batch_format { BATCH_TAR, BATCH_MULTIPART };
+
+/* A listed file, opened: either in memory ('data') or an open 'fd'. */
+struct batch_file {
+	const char *data;
+	int         fd;
+	size_t      size;
+	time_t      mtime;
+	const char *ctype;
+};
+
+struct batch_ops {
+	/* Open decoded URL path 'path': 0 with 'f' filled, or an HTTP status. */
+	int  (*open)(void *ctx, const char *path, struct batch_file *f);
+	void (*close)(void *ctx, struct batch_file *f);
+	/* Queue a copy of buf[0..len), or the body of 'f'. 0, or -1 on error. */
+	int  (*write)(void *ctx, const void *buf, size_t len);
+	int  (*write_file)(void *ctx, const struct batch_file *f);
+};
+
+/* The format a request's Accept header (may be NULL) asks for. */
+int    batch_format_for(const char *accept);
+
+/* Write the whole HTTP/1.1 200 response for the paths in list[0..len)
+   through 'ops'. Returns 0, or -1 once a write fails (the response is
+   cut short: close the connection). */
+int    batch_stream(const char *list, size_t len, int format, const struct batch_ops *ops, void *ctx);
+
+/* Bulk upload: unpack the tar archive in the body (content_len bytes, the
+   first prefill_len of them in 'prefill', the rest read through 'src')
+   into a new directory next to 'decoded_dir', flush it with one syncfs(),
+   then swap it in for 'decoded_dir' under the path's write lock, so
+   readers see either the old tree or the new one. The old tree is
+   removed afterwards. Members may be files and directories only (names
+   from ustar, GNU long-name and pax headers); files get mode 0644 and
+   their archived mtime.
+
+   Returns 1 if the directory was created, 0 if it was replaced, or -1
+   with errno set: EPROTO for a malformed archive or unsafe member name,
+   EBUSY for the docroot itself, ENOTDIR if the target is not a directory,
+   ENOENT if its parent is missing, ETIMEDOUT if the body stopped coming. */
+int    batch_unpack(const char *docroot_real, const char *decoded_dir,
+                    fs_source_fn src, void *src_ctx, size_t content_len,
+                    const void *prefill, size_t prefill_len);
+
+struct batch_stats {
+	uint64_t requests;
+	uint64_t files;       // members sent
+	uint64_t failed;      // listed paths that could not be sent
+	uint64_t bytes;       // file bytes sent
+	uint64_t uploads;     // archives unpacked and published
+	uint64_t unpacked;    // files they held
+};
+
+void   batch_get_stats(struct batch_stats *out);
+
+#endif /* MYHTTP_BATCH_H */
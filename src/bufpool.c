@@ -0,0 +1,198 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bufpool.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct bp_free {
+	struct bp_free *next;
+};
+
+struct bp_class {
+	pthread_mutex_t mtx;
+	struct bp_free *head;     // cached buffers
+	size_t   nfree;
+	size_t   in_use;
+	uint64_t gets, hits, puts;
+} __attribute__((aligned(64)));   // one class per cache line
+
+static const size_t k_class_size[BUFPOOL_NCLASSES] = {
+	BUFPOOL_SMALL, BUFPOOL_MEDIUM, BUFPOOL_LARGE
+};
+
+#define BP_CLASS_INIT { .mtx = PTHREAD_MUTEX_INITIALIZER }
+#define BP_NODE_INIT  { BP_CLASS_INIT, BP_CLASS_INIT, BP_CLASS_INIT }
+_Static_assert(BUFPOOL_NCLASSES == 3 && BUFPOOL_NODES == 4, "update the initializers below");
+
+static struct {
+	struct bp_class cls[BUFPOOL_NODES][BUFPOOL_NCLASSES];   // free lists per NUMA node
+	size_t   bytes_total;     // atomic: handed out + cached
+	size_t   bytes_cached;    // atomic
+	size_t   limit;           // atomic; 0 = unlimited
+	size_t   cache_max;       // atomic
+	uint64_t failures;        // atomic
+} g_bp = {
+	.cls = { BP_NODE_INIT, BP_NODE_INIT, BP_NODE_INIT, BP_NODE_INIT },
+	.limit = BUFPOOL_LIMIT,
+	.cache_max = BUFPOOL_CACHE_MAX,
+};
+
+static _Thread_local int tl_node;   // free lists this thread uses
+
+
+// ---- Internal helpers ----
+
+static int class_of(size_t size) {
+	for (int i = 0; i < BUFPOOL_NCLASSES; i++)
+		if (size <= k_class_size[i]) return i;
+	return -1;
+}
+
+// Pop every cached buffer of class 'i' on node 'node' and free it.
+static void drain_class(int node, int i) {
+	struct bp_class *c = &g_bp.cls[node][i];
+	pthread_mutex_lock(&c->mtx);
+	struct bp_free *f = c->head;
+	size_t n = c->nfree;
+	c->head = NULL;
+	c->nfree = 0;
+	pthread_mutex_unlock(&c->mtx);
+
+	size_t bytes = n * k_class_size[i];
+	__atomic_sub_fetch(&g_bp.bytes_cached, bytes, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&g_bp.bytes_total, bytes, __ATOMIC_RELAXED);
+	while (f) {
+		struct bp_free *next = f->next;
+		free(f);
+		f = next;
+	}
+}
+
+// Account 'size' new bytes against the limit; 0 on success.
+static int charge(size_t size) {
+	size_t limit = __atomic_load_n(&g_bp.limit, __ATOMIC_RELAXED);
+	size_t now = __atomic_add_fetch(&g_bp.bytes_total, size, __ATOMIC_RELAXED);
+	if (!limit || now <= limit) return 0;
+	__atomic_sub_fetch(&g_bp.bytes_total, size, __ATOMIC_RELAXED);
+	return -1;
+}
+
+
+//----- API ----------
+
+void *bufpool_get(size_t min_size, size_t *cap) {
+	int i = class_of(min_size ? min_size : 1);
+	if (i < 0) { errno = EMSGSIZE; return NULL; }
+	struct bp_class *c = &g_bp.cls[tl_node][i];
+	const size_t size = k_class_size[i];
+
+	pthread_mutex_lock(&c->mtx);
+	struct bp_free *f = c->head;
+	if (f) {
+		c->head = f->next;
+		c->nfree--;
+		c->hits++;
+		c->gets++;
+		c->in_use++;
+		pthread_mutex_unlock(&c->mtx);
+		__atomic_sub_fetch(&g_bp.bytes_cached, size, __ATOMIC_RELAXED);
+		if (cap) *cap = size;
+		return f;
+	}
+	pthread_mutex_unlock(&c->mtx);
+
+	// Cache miss: new memory (first touched by this thread, so on its node
+	// under the default policy), within the limit. Give back other classes'
+	// and other nodes' cached buffers before refusing.
+	if (charge(size) < 0) {
+		for (int n = 0; n < BUFPOOL_NODES; n++)
+			for (int k = 0; k < BUFPOOL_NCLASSES; k++)
+				if (k != i || n != tl_node) drain_class(n, k);
+		if (charge(size) < 0) {
+			__atomic_add_fetch(&g_bp.failures, 1, __ATOMIC_RELAXED);
+			errno = ENOBUFS;
+			return NULL;
+		}
+	}
+	void *p = malloc(size);
+	if (!p) {
+		__atomic_sub_fetch(&g_bp.bytes_total, size, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&g_bp.failures, 1, __ATOMIC_RELAXED);
+		errno = ENOMEM;
+		return NULL;
+	}
+	pthread_mutex_lock(&c->mtx);
+	c->gets++;
+	c->in_use++;
+	pthread_mutex_unlock(&c->mtx);
+	if (cap) *cap = size;
+	return p;
+}
+
+void bufpool_put(void *buf, size_t cap) {
+	if (!buf) return;
+	int i = class_of(cap);
+	if (i < 0 || k_class_size[i] != cap) { free(buf); return; }   // not ours
+	struct bp_class *c = &g_bp.cls[tl_node][i];
+
+	size_t cached = __atomic_add_fetch(&g_bp.bytes_cached, cap, __ATOMIC_RELAXED);
+	int keep = cached <= __atomic_load_n(&g_bp.cache_max, __ATOMIC_RELAXED);
+	if (!keep) __atomic_sub_fetch(&g_bp.bytes_cached, cap, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&c->mtx);
+	c->puts++;
+	c->in_use--;
+	if (keep) {
+		struct bp_free *f = (struct bp_free *)buf;
+		f->next = c->head;
+		c->head = f;
+		c->nfree++;
+	}
+	pthread_mutex_unlock(&c->mtx);
+
+	if (!keep) {
+		__atomic_sub_fetch(&g_bp.bytes_total, cap, __ATOMIC_RELAXED);
+		free(buf);
+	}
+}
+
+void bufpool_set_limit(size_t bytes) {
+	__atomic_store_n(&g_bp.limit, bytes, __ATOMIC_RELAXED);
+}
+
+void bufpool_set_cache_max(size_t bytes) {
+	__atomic_store_n(&g_bp.cache_max, bytes, __ATOMIC_RELAXED);
+	if (__atomic_load_n(&g_bp.bytes_cached, __ATOMIC_RELAXED) > bytes) bufpool_trim();
+}
+
+void bufpool_set_node(int node) {
+	tl_node = node < 0 ? 0 : node % BUFPOOL_NODES;
+}
+
+void bufpool_trim(void) {
+	for (int n = 0; n < BUFPOOL_NODES; n++)
+		for (int i = 0; i < BUFPOOL_NCLASSES; i++) drain_class(n, i);
+}
+
+void bufpool_get_stats(struct bufpool_stats *out) {
+	memset(out, 0, sizeof(*out));
+	for (int i = 0; i < BUFPOOL_NCLASSES; i++) {
+		out->cls[i].size = k_class_size[i];
+		for (int n = 0; n < BUFPOOL_NODES; n++) {
+			struct bp_class *c = &g_bp.cls[n][i];
+			pthread_mutex_lock(&c->mtx);
+			out->cls[i].gets   += c->gets;
+			out->cls[i].hits   += c->hits;
+			out->cls[i].puts   += c->puts;
+			out->cls[i].in_use += c->in_use;
+			out->cls[i].cached += c->nfree;
+			pthread_mutex_unlock(&c->mtx);
+		}
+	}
+	out->bytes_total = __atomic_load_n(&g_bp.bytes_total, __ATOMIC_RELAXED);
+	out->limit       = __atomic_load_n(&g_bp.limit, __ATOMIC_RELAXED);
+	out->failures    = __atomic_load_n(&g_bp.failures, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,75 @@
+#ifndef MYHTTP_BUFPOOL_H
+#define MYHTTP_BUFPOOL_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+/* Process-wide pool of I/O buffers in three size classes.
+
+   Connections borrow buffers only while they have work in flight and hand
+   them back when they go idle, so an idle keep-alive connection holds no
+   buffer memory at all. Freed buffers are cached per class (up to
+   BUFPOOL_CACHE_MAX bytes in total) and reused without touching malloc.
+   BUFPOOL_LIMIT caps everything the pool has handed out plus what it has
+   cached; a request past the cap fails with ENOBUFS after cached buffers
+   of other classes have been released.
+
+   Free lists are kept per NUMA node (BUFPOOL_NODES; higher nodes share
+   lists modulo that): a worker pinned to a node reuses buffers that were
+   first touched, and so placed, on that node. */
+
+#define BUFPOOL_NCLASSES 3
+#define BUFPOOL_SMALL    (4 * 1024)
+#define BUFPOOL_MEDIUM   (16 * 1024)
+#define BUFPOOL_LARGE    (64 * 1024)
+
+#define BUFPOOL_NODES    4
+
+#ifndef BUFPOOL_CACHE_MAX
+#define BUFPOOL_CACHE_MAX (16u * 1024 * 1024)
+#endif
+
+#ifndef BUFPOOL_LIMIT
+#define BUFPOOL_LIMIT     (256u * 1024 * 1024)
+#endif
+
+struct bufpool_class_stats {
+	size_t   size;          // buffer size of this class
+	uint64_t gets;          // successful bufpool_get() calls
+	uint64_t hits;          // ... served from the cache
+	uint64_t puts;
+	size_t   in_use;        // buffers currently handed out
+	size_t   cached;        // buffers on the free list
+};
+
+struct bufpool_stats {
+	struct bufpool_class_stats cls[BUFPOOL_NCLASSES];
+	size_t   bytes_total;   // handed out + cached
+	size_t   limit;
+	uint64_t failures;      // gets refused by the limit (or malloc)
+};
+
+/* Borrow a buffer of at least 'min_size' bytes (<= BUFPOOL_LARGE); its real
+   size is stored in '*cap'. Returns NULL with errno = EMSGSIZE, ENOBUFS or
+   ENOMEM on failure. */
+void *bufpool_get(size_t min_size, size_t *cap);
+
+/* Return a buffer obtained from bufpool_get() ('cap' as reported). */
+void  bufpool_put(void *buf, size_t cap);
+
+/* Change BUFPOOL_LIMIT at runtime (0 = unlimited). */
+void  bufpool_set_limit(size_t bytes);
+
+/* Change BUFPOOL_CACHE_MAX at runtime; lowering it below what is cached
+   now frees the cache. */
+void  bufpool_set_cache_max(size_t bytes);
+
+/* Use node 'node's free lists for the calling thread (default 0). */
+void  bufpool_set_node(int node);
+
+/* Free every cached buffer. */
+void  bufpool_trim(void);
+
+void  bufpool_get_stats(struct bufpool_stats *out);
+
+#endif /* MYHTTP_BUFPOOL_H */
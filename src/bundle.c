@@ -0,0 +1,405 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bundle.h"
+#include "fs.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define BD_MAGIC    "MHBUNDL"
+#define BD_VERSION  1u
+#define BD_ORDER    0x01020304u    /* as written: same byte order as ours */
+#define BD_ALIGN    4096u          /* data starts on a page boundary */
+#define BD_ETAG_LEN 18             /* "\"" + 16 hex digits + "\"" */
+#define BD_MAX_DEPTH 32
+
+/* On-disk layout: header, index, strings, data, each at an offset from
+   the start of the file. */
+struct bd_header {
+	char     magic[8];
+	uint32_t version;
+	uint32_t order;
+	uint64_t size;        /* whole file */
+	uint64_t nent;
+	uint64_t index_off;   /* struct bd_ent[nent], sorted by hash */
+	uint64_t str_off;     /* NUL-terminated strings */
+	uint64_t str_len;
+	uint64_t data_off;
+};
+
+struct bd_ent {
+	uint64_t hash;        /* of the key */
+	uint64_t off;         /* from data_off */
+	uint64_t len;
+	uint32_t key_off;     /* URL path: "/a/b.txt" */
+	uint32_t mime_off;
+	uint32_t etag_off;
+	uint32_t pad;
+};
+
+static struct {
+	const char             *base;   /* NULL: none mapped */
+	size_t                  len;
+	const struct bd_header *hdr;
+	const struct bd_ent    *ent;
+	const char             *str;
+	const char             *data;
+	uint64_t                hits;
+} g_bd;
+
+
+// ---- Internal helpers ----
+
+static uint64_t fnv1a_64(const void *p, size_t n, uint64_t h) {
+	const unsigned char *s = (const unsigned char *)p;
+	for (size_t i = 0; i < n; i++) {
+		h ^= s[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+#define FNV_SEED 1469598103934665603ull
+
+static int is_upload_temp(const char *name) {
+	return name[0] == '.' && strstr(name, ".tmp.") != NULL;
+}
+
+// Entry for key[0..n), or NULL. Entries are sorted by hash; the few that
+// share one are told apart by their keys.
+static const struct bd_ent *find(const char *key, size_t n) {
+	const uint64_t h = fnv1a_64(key, n, FNV_SEED);
+	size_t lo = 0, hi = (size_t)g_bd.hdr->nent;
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		if (g_bd.ent[mid].hash < h) lo = mid + 1;
+		else                        hi = mid;
+	}
+	for (; lo < g_bd.hdr->nent && g_bd.ent[lo].hash == h; lo++) {
+		const char *k = g_bd.str + g_bd.ent[lo].key_off;
+		if (strncmp(k, key, n) == 0 && k[n] == '\0') return &g_bd.ent[lo];
+	}
+	return NULL;
+}
+
+/* Entry answering decoded URL path 'key' (see bundle_lookup()), or NULL. */
+static const struct bd_ent *entry_for(const char *key) {
+	if (!g_bd.base || !key || key[0] != '/') return NULL;
+	size_t n = strlen(key);
+	if (n + sizeof("/index.html") > PATH_MAX) return NULL;
+
+	const struct bd_ent *e = key[n - 1] == '/' ? NULL : find(key, n);
+	if (!e) {
+		// A directory is answered by its index.html.
+		char idx[PATH_MAX];
+		memcpy(idx, key, n);
+		if (key[n - 1] == '/') n--;
+		memcpy(idx + n, "/index.html", sizeof("/index.html"));
+		e = find(idx, n + sizeof("/index.html") - 1);
+	}
+	return e;
+}
+
+
+// ---- Packing ----
+
+struct bd_file {
+	char    *key;
+	uint64_t hash;
+	uint64_t size;
+	int64_t  mtime_ns;
+};
+
+struct bd_build {
+	struct bd_file *f;
+	size_t          n, cap;
+	size_t          max_file;
+};
+
+static int64_t mtime_ns(const struct stat *st) {
+	return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static int add_file(struct bd_build *b, const char *key, size_t n, const struct stat *st) {
+	if (b->n == b->cap) {
+		size_t cap = b->cap ? b->cap * 2 : 1024;
+		struct bd_file *nf = (struct bd_file *)realloc(b->f, cap * sizeof(*nf));
+		if (!nf) return -1;
+		b->f = nf;
+		b->cap = cap;
+	}
+	struct bd_file *f = &b->f[b->n];
+	f->key = (char *)malloc(n + 1);
+	if (!f->key) return -1;
+	memcpy(f->key, key, n + 1);
+	f->hash = fnv1a_64(key, n, FNV_SEED);
+	f->size = (uint64_t)st->st_size;
+	f->mtime_ns = mtime_ns(st);
+	b->n++;
+	return 0;
+}
+
+/* Collect the files of directory 'dfd' (consumed), whose key is
+   key[0..klen) ("" for the docroot), and recurse into subdirectories. */
+static int crawl(struct bd_build *b, int dfd, char *key, size_t klen, int depth) {
+	DIR *d = fdopendir(dfd);
+	if (!d) { close(dfd); return -1; }
+	int rc = 0;
+	struct dirent *de;
+	while (rc == 0 && (de = readdir(d)) != NULL) {
+		const char *name = de->d_name;
+		if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || is_upload_temp(name)) continue;
+		const size_t nl = strlen(name);
+		if (klen + 1 + nl >= PATH_MAX) continue;
+		struct stat st;
+		if (fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+
+		key[klen] = '/';
+		memcpy(key + klen + 1, name, nl + 1);
+		if (S_ISREG(st.st_mode) && (size_t)st.st_size <= b->max_file) {
+			rc = add_file(b, key, klen + 1 + nl, &st);
+		} else if (S_ISDIR(st.st_mode) && depth < BD_MAX_DEPTH) {
+			int cfd = openat(dirfd(d), name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+			if (cfd >= 0) rc = crawl(b, cfd, key, klen + 1 + nl, depth + 1);
+		}
+	}
+	closedir(d);
+	return rc;
+}
+
+static int cmp_ent(const void *a, const void *b) {
+	const struct bd_ent *x = (const struct bd_ent *)a, *y = (const struct bd_ent *)b;
+	if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+	return x->off < y->off ? -1 : x->off > y->off;
+}
+
+/* Copy file 'f' (under 'root') to 'out', checking it is still what the
+   crawl saw; 'etag' gets the hash of what was copied. */
+static int copy_file(int root, const struct bd_file *f, FILE *out, uint64_t *etag) {
+	int fd = openat(root, f->key + 1, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0) return -1;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	    (uint64_t)st.st_size != f->size || mtime_ns(&st) != f->mtime_ns) {
+		close(fd);
+		errno = EAGAIN;
+		return -1;
+	}
+	char buf[64 * 1024];
+	uint64_t h = FNV_SEED, got = 0;
+	ssize_t r;
+	while ((r = read(fd, buf, sizeof(buf))) != 0) {
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			close(fd);
+			return -1;
+		}
+		if (fwrite(buf, 1, (size_t)r, out) != (size_t)r) { close(fd); return -1; }
+		h = fnv1a_64(buf, (size_t)r, h);
+		got += (uint64_t)r;
+	}
+	/* Grew or shrank under us: the index already promised f->size. */
+	if (got != f->size || fstat(fd, &st) < 0 || mtime_ns(&st) != f->mtime_ns) {
+		close(fd);
+		errno = EAGAIN;
+		return -1;
+	}
+	close(fd);
+	*etag = h;
+	return 0;
+}
+
+/* Lay out 'b' at 'path': strings (keys, one copy of each MIME type, ETags
+   filled in as the data is copied), then the header and index in front. */
+static int write_bundle(struct bd_build *b, int root, const char *path) {
+	struct bd_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, BD_MAGIC, sizeof(h.magic));
+	h.version = BD_VERSION;
+	h.order = BD_ORDER;
+	h.nent = b->n;
+	h.index_off = sizeof(h);
+	h.str_off = h.index_off + b->n * sizeof(struct bd_ent);
+
+	struct bd_ent *ent = (struct bd_ent *)calloc(b->n ? b->n : 1, sizeof(*ent));
+	const char *mimes[32];
+	uint32_t mime_off[32];
+	size_t nmimes = 0;
+	size_t scap = 0;
+	for (size_t i = 0; i < b->n; i++) scap += strlen(b->f[i].key) + 1 + BD_ETAG_LEN + 1;
+	scap += sizeof(mimes) / sizeof(mimes[0]) * 64;
+	char *str = (char *)malloc(scap);
+	if (!ent || !str || scap > UINT32_MAX) {
+		free(ent); free(str);
+		errno = ent && str ? EFBIG : ENOMEM;
+		return -1;
+	}
+
+	size_t slen = 0;
+	uint64_t off = 0;
+	for (size_t i = 0; i < b->n; i++) {
+		const struct bd_file *f = &b->f[i];
+		struct bd_ent *e = &ent[i];
+		e->hash = f->hash;
+		e->off = off;
+		e->len = f->size;
+		e->key_off = (uint32_t)slen;
+		slen += (size_t)sprintf(str + slen, "%s", f->key) + 1;
+
+		const char *mime = fs_mime_from_path(f->key);
+		size_t m = 0;
+		while (m < nmimes && strcmp(mimes[m], mime) != 0) m++;
+		if (m == nmimes && nmimes < sizeof(mimes) / sizeof(mimes[0])) {
+			mimes[nmimes] = mime;
+			mime_off[nmimes++] = (uint32_t)slen;
+			slen += (size_t)sprintf(str + slen, "%s", mime) + 1;
+		}
+		e->mime_off = m < nmimes ? mime_off[m] : mime_off[0];
+
+		e->etag_off = (uint32_t)slen;   // filled in once the content is hashed
+		memset(str + slen, 0, BD_ETAG_LEN + 1);
+		slen += BD_ETAG_LEN + 1;
+		off += f->size;
+	}
+	h.str_len = slen;
+	h.data_off = (h.str_off + slen + BD_ALIGN - 1) / BD_ALIGN * BD_ALIGN;
+
+	char tmp[PATH_MAX];
+	int n = snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+	if (n < 0 || (size_t)n >= sizeof(tmp)) { free(ent); free(str); errno = ENAMETOOLONG; return -1; }
+	int fd = mkstemp(tmp);
+	if (fd < 0) { free(ent); free(str); return -1; }
+	FILE *out = fdopen(fd, "wb");
+	if (!out) { close(fd); unlink(tmp); free(ent); free(str); return -1; }
+
+	/* Data in crawl order (files of a directory together), index by hash. */
+	int ok = fseeko(out, (off_t)h.data_off, SEEK_SET) == 0;
+	for (size_t i = 0; ok && i < b->n; i++) {
+		uint64_t etag;
+		ok = copy_file(root, &b->f[i], out, &etag) == 0;
+		if (ok) snprintf(str + ent[i].etag_off, BD_ETAG_LEN + 1, "\"%016llx\"", (unsigned long long)etag);
+	}
+	const int copy_err = ok ? 0 : errno;
+	h.size = h.data_off + off;
+	qsort(ent, b->n, sizeof(*ent), cmp_ent);
+
+	ok = ok && fseeko(out, 0, SEEK_SET) == 0 &&
+	     fwrite(&h, sizeof(h), 1, out) == 1 &&
+	     (b->n == 0 || fwrite(ent, sizeof(*ent), b->n, out) == b->n) &&
+	     fwrite(str, 1, slen, out) == slen;
+	free(ent);
+	free(str);
+	ok = fflush(out) == 0 && ok;
+	ok = fchmod(fileno(out), 0644) == 0 && ok;
+	ok = fclose(out) == 0 && ok;
+	if (!ok || rename(tmp, path) < 0) {
+		int e = copy_err ? copy_err : errno;
+		unlink(tmp);
+		errno = e ? e : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+
+//----- API ----------
+
+long bundle_write(const char *docroot, const char *path, size_t max_file) {
+	struct bd_build b;
+	memset(&b, 0, sizeof(b));
+	b.max_file = max_file;
+	char key[PATH_MAX];
+	int root = open(docroot, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (root < 0) return -1;
+	int dfd = dup(root);   // consumed by the crawl; 'root' opens the files
+	int rc = dfd < 0 ? -1 : crawl(&b, dfd, key, 0, 1);
+	if (rc == 0) rc = write_bundle(&b, root, path);
+	int e = errno;
+	close(root);
+	for (size_t i = 0; i < b.n; i++) free(b.f[i].key);
+	free(b.f);
+	errno = e;
+	return rc < 0 ? -1 : (long)b.n;
+}
+
+int bundle_open(const char *path) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return -1;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct bd_header)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) return -1;
+
+	const size_t len = (size_t)st.st_size;
+	const struct bd_header *h = (const struct bd_header *)p;
+	const char *base = (const char *)p;
+	int ok = memcmp(h->magic, BD_MAGIC, sizeof(h->magic)) == 0 && h->version == BD_VERSION &&
+	         h->order == BD_ORDER && h->size == len &&
+	         h->index_off <= len && h->index_off % 8 == 0 &&
+	         h->nent <= (len - h->index_off) / sizeof(struct bd_ent) &&
+	         h->str_off <= len && h->str_len <= len - h->str_off &&
+	         (h->str_len == 0 || base[h->str_off + h->str_len - 1] == '\0') &&
+	         h->data_off <= len;
+	/* Checked once here, so lookups can trust every offset. */
+	const struct bd_ent *ent = (const struct bd_ent *)(base + h->index_off);
+	for (uint64_t i = 0; ok && i < h->nent; i++) {
+		const struct bd_ent *e = &ent[i];
+		ok = e->key_off < h->str_len && e->mime_off < h->str_len && e->etag_off < h->str_len &&
+		     e->off <= len - h->data_off && e->len <= len - h->data_off - e->off &&
+		     (i == 0 || ent[i - 1].hash <= e->hash);
+	}
+	if (!ok) {
+		munmap(p, len);
+		errno = EINVAL;
+		return -1;
+	}
+	/* The index is touched by every lookup; the data as it is asked for. */
+	(void)posix_madvise(p, (size_t)h->data_off, POSIX_MADV_WILLNEED);
+
+	if (g_bd.base) munmap((void *)g_bd.base, g_bd.len);
+	g_bd.base = base;
+	g_bd.len = len;
+	g_bd.hdr = h;
+	g_bd.ent = ent;
+	g_bd.str = base + h->str_off;
+	g_bd.data = base + h->data_off;
+	return 0;
+}
+
+int bundle_lookup(const char *key, struct bundle_entry *out) {
+	const struct bd_ent *e = entry_for(key);
+	if (!e) return 0;
+	out->data = g_bd.data + e->off;
+	out->len = (size_t)e->len;
+	out->ctype = g_bd.str + e->mime_off;
+	out->etag = g_bd.str + e->etag_off;
+	__atomic_add_fetch(&g_bd.hits, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+int bundle_holds(const char *key) {
+	return entry_for(key) != NULL;
+}
+
+void bundle_get_stats(struct bundle_stats *out) {
+	memset(out, 0, sizeof(*out));
+	if (g_bd.base) out->entries = (size_t)g_bd.hdr->nent;
+	out->hits = __atomic_load_n(&g_bd.hits, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,53 @@
+#ifndef MYHTTP_BUNDLE_H
+#define MYHTTP_BUNDLE_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+/* Packed asset bundle: the small files of a docroot packed into one file
+   by tools/mhpack, with an index (URL path hash, offset, length, MIME
+   type, ETag) in front of the data. The server maps it once at startup;
+   a GET it holds is a binary search over the index and a reply that
+   points straight into the mapping, with no open(), stat() or path walk.
+
+   A bundle is a build artifact: it is never updated in place, and paths
+   it holds are read-only while it is mapped. Paths it does not hold are
+   served from the docroot as usual. */
+
+#ifndef BUNDLE_MAX_FILE
+#define BUNDLE_MAX_FILE (1u << 20)  /* larger files are left to the docroot */
+#endif
+
+struct bundle_entry {
+	const char *data;     // inside the mapping; valid until exit
+	size_t      len;
+	const char *ctype;
+	const char *etag;     // quoted, strong: hash of the content
+};
+
+/* Pack the regular files under 'docroot' of at most 'max_file' bytes into
+   a bundle at 'path' (written aside, then renamed). Symlinks and special
+   files are left out. Returns the number of files packed, or -1 with
+   errno set (EAGAIN: a file changed while it was being packed). */
+long   bundle_write(const char *docroot, const char *path, size_t max_file);
+
+/* Map the bundle at 'path'. Returns 0, or -1 with errno set (EINVAL: not
+   a bundle). */
+int    bundle_open(const char *path);
+
+/* Look up decoded URL path 'key'; a directory ("/", "/a/") is looked up
+   as its index.html. Returns 1 with 'out' filled, 0 when the bundle does
+   not hold it (or none is mapped). */
+int    bundle_lookup(const char *key, struct bundle_entry *out);
+
+/* Whether the bundle holds 'key', as bundle_lookup() but not counted. */
+int    bundle_holds(const char *key);
+
+struct bundle_stats {
+	size_t   entries;    // files in the mapped bundle (0 while none)
+	uint64_t hits;       // GETs it answered
+};
+
+void   bundle_get_stats(struct bundle_stats *out);
+
+#endif /* MYHTTP_BUNDLE_H */
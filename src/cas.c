@@ -0,0 +1,321 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE       // realpath
+
+#include "cas.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef MYHTTP_NO_TLS
+#include <openssl/evp.h>
+#endif
+
+static struct {
+	int             on;
+	char            dir[PATH_MAX];
+	pthread_mutex_t mtx;              // guards the index
+	unsigned char (*slots)[CAS_DIGEST_LEN];   // open addressing; all zeros = empty
+	size_t          cap, used;
+	uint64_t        stored, dedups, dedup_bytes;
+} g_cas = { .mtx = PTHREAD_MUTEX_INITIALIZER };
+
+
+// ---- Internal helpers ----
+
+#ifdef MYHTTP_NO_TLS
+/* Portable SHA-256 (FIPS 180-4), for builds without OpenSSL. */
+static const uint32_t k_sha[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n) ((x) >> (n) | (x) << (32 - (n)))
+
+static void sha_block(uint32_t h[8], const unsigned char *p) {
+	uint32_t w[64];
+	for (int i = 0; i < 16; i++)
+		w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+	for (int i = 16; i < 64; i++) {
+		const uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		const uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+	uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+	for (int i = 0; i < 64; i++) {
+		const uint32_t t1 = k + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + k_sha[i] + w[i];
+		const uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		k = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+#endif /* MYHTTP_NO_TLS */
+
+static size_t slot_of(const unsigned char *d, size_t cap) {
+	uint64_t v;
+	memcpy(&v, d, sizeof(v));   // already uniform
+	return (size_t)v & (cap - 1);
+}
+
+static int is_empty(const unsigned char *s) {
+	static const unsigned char zero[CAS_DIGEST_LEN];
+	return memcmp(s, zero, CAS_DIGEST_LEN) == 0;
+}
+
+// Callers hold g_cas.mtx.
+static int index_has(const unsigned char *d) {
+	if (!g_cas.cap) return 0;
+	for (size_t i = slot_of(d, g_cas.cap); !is_empty(g_cas.slots[i]); i = (i + 1) & (g_cas.cap - 1))
+		if (memcmp(g_cas.slots[i], d, CAS_DIGEST_LEN) == 0) return 1;
+	return 0;
+}
+
+static int index_add(const unsigned char *d) {
+	if (index_has(d)) return 0;
+	if ((g_cas.used + 1) * 2 > g_cas.cap) {
+		const size_t ncap = g_cas.cap ? g_cas.cap * 2 : 1024;
+		unsigned char (*ns)[CAS_DIGEST_LEN] = calloc(ncap, CAS_DIGEST_LEN);
+		if (!ns) return -1;
+		for (size_t i = 0; i < g_cas.cap; i++) {
+			if (is_empty(g_cas.slots[i])) continue;
+			size_t j = slot_of(g_cas.slots[i], ncap);
+			while (!is_empty(ns[j])) j = (j + 1) & (ncap - 1);
+			memcpy(ns[j], g_cas.slots[i], CAS_DIGEST_LEN);
+		}
+		free(g_cas.slots);
+		g_cas.slots = ns;
+		g_cas.cap = ncap;
+	}
+	size_t i = slot_of(d, g_cas.cap);
+	while (!is_empty(g_cas.slots[i])) i = (i + 1) & (g_cas.cap - 1);
+	memcpy(g_cas.slots[i], d, CAS_DIGEST_LEN);
+	g_cas.used++;
+	return 0;
+}
+
+// Backward-shift deletion keeps every probe chain unbroken.
+static void index_remove(const unsigned char *d) {
+	if (!g_cas.cap) return;
+	const size_t mask = g_cas.cap - 1;
+	size_t i = slot_of(d, g_cas.cap);
+	for (; !is_empty(g_cas.slots[i]); i = (i + 1) & mask)
+		if (memcmp(g_cas.slots[i], d, CAS_DIGEST_LEN) == 0) break;
+	if (is_empty(g_cas.slots[i])) return;
+	for (size_t j = (i + 1) & mask; !is_empty(g_cas.slots[j]); j = (j + 1) & mask) {
+		const size_t home = slot_of(g_cas.slots[j], g_cas.cap);
+		if (((j - home) & mask) >= ((j - i) & mask)) {   // may move into the hole
+			memcpy(g_cas.slots[i], g_cas.slots[j], CAS_DIGEST_LEN);
+			i = j;
+		}
+	}
+	memset(g_cas.slots[i], 0, CAS_DIGEST_LEN);
+	g_cas.used--;
+}
+
+// <dir>/ab/cdef... for 'd'.
+static int blob_path(const unsigned char *d, char *out, size_t outlen) {
+	static const char hex[] = "0123456789abcdef";
+	char name[2 * CAS_DIGEST_LEN + 2];
+	size_t o = 0;
+	for (size_t i = 0; i < CAS_DIGEST_LEN; i++) {
+		name[o++] = hex[d[i] >> 4];
+		name[o++] = hex[d[i] & 15];
+		if (i == 0) name[o++] = '/';
+	}
+	name[o] = '\0';
+	const int n = snprintf(out, outlen, "%s/%s", g_cas.dir, name);
+	return n < 0 || (size_t)n >= outlen ? -1 : 0;
+}
+
+static int unhex(const char *s, size_t n, unsigned char *out) {
+	for (size_t i = 0; i < n; i++) {
+		const char c = s[i];
+		const int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+		if (v < 0) return -1;
+		out[i / 2] = (unsigned char)(i % 2 ? out[i / 2] | v : v << 4);
+	}
+	return 0;
+}
+
+/* Index the blobs in the store; drop the ones nothing links to. */
+static void scan_store(void) {
+	DIR *top = opendir(g_cas.dir);
+	if (!top) return;
+	struct dirent *de;
+	while ((de = readdir(top)) != NULL) {
+		unsigned char d[CAS_DIGEST_LEN];
+		if (strlen(de->d_name) != 2 || unhex(de->d_name, 2, d) < 0) continue;
+		const int sfd = openat(dirfd(top), de->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		DIR *sub = sfd < 0 ? NULL : fdopendir(sfd);
+		if (!sub) { if (sfd >= 0) close(sfd); continue; }
+		struct dirent *be;
+		while ((be = readdir(sub)) != NULL) {
+			struct stat st;
+			if (strlen(be->d_name) != 2 * CAS_DIGEST_LEN - 2 ||
+			    unhex(be->d_name, 2 * CAS_DIGEST_LEN - 2, d + 1) < 0 ||
+			    fstatat(sfd, be->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0 || !S_ISREG(st.st_mode))
+				continue;
+			if (st.st_nlink < 2) (void)unlinkat(sfd, be->d_name, 0);
+			else                 (void)index_add(d);
+		}
+		closedir(sub);
+	}
+	closedir(top);
+}
+
+
+//----- API ----------
+
+int cas_open(const char *dir, const char *docroot_real) {
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST) return -1;
+	if (!realpath(dir, g_cas.dir)) return -1;
+	const size_t dl = strlen(docroot_real);
+	if (strncmp(g_cas.dir, docroot_real, dl) == 0 && (g_cas.dir[dl] == '\0' || g_cas.dir[dl] == '/')) {
+		errno = EINVAL;
+		return -1;
+	}
+	struct stat a, b;
+	if (stat(g_cas.dir, &a) < 0 || stat(docroot_real, &b) < 0) return -1;
+	if (a.st_dev != b.st_dev) { errno = EXDEV; return -1; }   // no hard links across
+
+	pthread_mutex_lock(&g_cas.mtx);
+	scan_store();
+	pthread_mutex_unlock(&g_cas.mtx);
+	g_cas.on = 1;
+	return 0;
+}
+
+int cas_enabled(void) {
+	return g_cas.on;
+}
+
+int cas_hash_init(struct cas_hash *h) {
+#ifndef MYHTTP_NO_TLS
+	EVP_MD_CTX *md = EVP_MD_CTX_new();
+	if (!md || EVP_DigestInit_ex(md, EVP_sha256(), NULL) != 1) {
+		EVP_MD_CTX_free(md);
+		errno = ENOMEM;
+		return -1;
+	}
+	h->evp = md;
+#else
+	static const uint32_t iv[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+	h->evp = NULL;
+	memcpy(h->h, iv, sizeof(iv));
+	h->len = 0;
+#endif
+	return 0;
+}
+
+void cas_hash_update(struct cas_hash *h, const void *p, size_t n) {
+#ifndef MYHTTP_NO_TLS
+	(void)EVP_DigestUpdate((EVP_MD_CTX *)h->evp, p, n);
+#else
+	const unsigned char *s = (const unsigned char *)p;
+	size_t fill = (size_t)(h->len % 64);
+	h->len += n;
+	if (fill) {
+		const size_t k = n < 64 - fill ? n : 64 - fill;
+		memcpy(h->buf + fill, s, k);
+		s += k;
+		n -= k;
+		if (fill + k < 64) return;
+		sha_block(h->h, h->buf);
+	}
+	for (; n >= 64; s += 64, n -= 64) sha_block(h->h, s);
+	memcpy(h->buf, s, n);
+#endif
+}
+
+void cas_hash_final(struct cas_hash *h, unsigned char out[CAS_DIGEST_LEN]) {
+#ifndef MYHTTP_NO_TLS
+	unsigned int n = 0;
+	(void)EVP_DigestFinal_ex((EVP_MD_CTX *)h->evp, out, &n);
+	EVP_MD_CTX_free((EVP_MD_CTX *)h->evp);
+	h->evp = NULL;
+#else
+	const uint64_t bits = h->len * 8;
+	size_t fill = (size_t)(h->len % 64);
+	h->buf[fill++] = 0x80;
+	if (fill > 56) {
+		memset(h->buf + fill, 0, 64 - fill);
+		sha_block(h->h, h->buf);
+		fill = 0;
+	}
+	memset(h->buf + fill, 0, 56 - fill);
+	for (int i = 0; i < 8; i++) h->buf[56 + i] = (unsigned char)(bits >> (56 - 8 * i));
+	sha_block(h->h, h->buf);
+	for (int i = 0; i < 8; i++)
+		for (int j = 0; j < 4; j++) out[4 * i + j] = (unsigned char)(h->h[i] >> (24 - 8 * j));
+#endif
+}
+
+void cas_hash_abort(struct cas_hash *h) {
+#ifndef MYHTTP_NO_TLS
+	EVP_MD_CTX_free((EVP_MD_CTX *)h->evp);
+	h->evp = NULL;
+#else
+	(void)h;
+#endif
+}
+
+int cas_link(const unsigned char digest[CAS_DIGEST_LEN], size_t size, const char *path) {
+	char blob[PATH_MAX];
+	pthread_mutex_lock(&g_cas.mtx);
+	const int known = index_has(digest);
+	pthread_mutex_unlock(&g_cas.mtx);
+	if (!known || blob_path(digest, blob, sizeof(blob)) < 0) { errno = ENOENT; return -1; }
+	if (link(blob, path) < 0) {
+		const int e = errno;
+		if (e == ENOENT) {   // removed behind our back
+			pthread_mutex_lock(&g_cas.mtx);
+			index_remove(digest);
+			pthread_mutex_unlock(&g_cas.mtx);
+		}
+		errno = e;
+		return -1;
+	}
+	__atomic_add_fetch(&g_cas.dedups, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&g_cas.dedup_bytes, (uint64_t)size, __ATOMIC_RELAXED);
+	return 0;
+}
+
+void cas_store(const unsigned char digest[CAS_DIGEST_LEN], const char *path) {
+	char blob[PATH_MAX];
+	if (blob_path(digest, blob, sizeof(blob)) < 0) return;
+	char *slash = strrchr(blob, '/');
+	*slash = '\0';
+	(void)mkdir(blob, 0755);
+	*slash = '/';
+	if (link(path, blob) < 0 && errno != EEXIST) return;
+	pthread_mutex_lock(&g_cas.mtx);
+	const size_t before = g_cas.used;
+	(void)index_add(digest);
+	if (g_cas.used > before) g_cas.stored++;
+	pthread_mutex_unlock(&g_cas.mtx);
+}
+
+void cas_get_stats(struct cas_stats *out) {
+	pthread_mutex_lock(&g_cas.mtx);
+	out->blobs = g_cas.used;
+	out->stored = g_cas.stored;
+	pthread_mutex_unlock(&g_cas.mtx);
+	out->dedups = __atomic_load_n(&g_cas.dedups, __ATOMIC_RELAXED);
+	out->dedup_bytes = __atomic_load_n(&g_cas.dedup_bytes, __ATOMIC_RELAXED);
+}
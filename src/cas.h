@@ -0,0 +1,66 @@
+#ifndef MYHTTP_CAS_H
+#define MYHTTP_CAS_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint32_t, uint64_t
+
+/* Content-addressed upload store (--cas <dir>).
+
+   PUT bodies are hashed (SHA-256) as they stream into their temp file.
+   Each distinct body is kept once, as a blob under the store directory
+   named by its digest (<dir>/ab/cdef...), hard-linked to the paths that
+   hold it. An upload whose digest the in-memory index already knows
+   skips its fsync: the temp file is dropped and the stored blob linked
+   into place instead, so the bytes take disk and page cache once.
+   Hashed uploads get no write-behind (iohint.h), so a duplicate's dirty
+   pages are dropped before writeback starts; the cost is that a new
+   body's pages stay dirty until its fsync.
+
+   Blobs are hard links, not reflinks: every name shares one inode and
+   one copy in the page cache. Paths linked to a blob must not be written
+   in place, so a PATCH first copies its file (fs.c). The store must be on
+   the docroot's filesystem and outside it. At startup the store is
+   scanned to rebuild the index, and blobs no path links to any more are
+   removed. */
+
+#define CAS_DIGEST_LEN 32
+
+/* Running SHA-256 of one upload. */
+struct cas_hash {
+	void         *evp;        // OpenSSL digest context, when built with TLS
+	uint32_t      h[8];       // otherwise the portable one below
+	uint64_t      len;
+	unsigned char buf[64];
+};
+
+/* Open (creating it if needed) the store at 'dir' and index its blobs.
+   Returns 0, or -1 with errno set (EXDEV: not on the docroot's
+   filesystem; EINVAL: inside the docroot). */
+int  cas_open(const char *dir, const char *docroot_real);
+
+/* Nonzero once cas_open() succeeded. */
+int  cas_enabled(void);
+
+int  cas_hash_init(struct cas_hash *h);               // 0, or -1 (ENOMEM)
+void cas_hash_update(struct cas_hash *h, const void *p, size_t n);
+void cas_hash_final(struct cas_hash *h, unsigned char out[CAS_DIGEST_LEN]);
+void cas_hash_abort(struct cas_hash *h);
+
+/* Link the blob for 'digest' ('size' bytes) to the new name 'path'.
+   Returns 0, or -1 with errno set (ENOENT: not stored). */
+int  cas_link(const unsigned char digest[CAS_DIGEST_LEN], size_t size, const char *path);
+
+/* Keep the durable file at 'path' as the blob for 'digest'. Best effort:
+   a file that cannot be stored is simply not deduplicated. */
+void cas_store(const unsigned char digest[CAS_DIGEST_LEN], const char *path);
+
+struct cas_stats {
+	size_t   blobs;           // distinct bodies indexed
+	uint64_t stored;          // blobs added since startup
+	uint64_t dedups;          // uploads linked to a stored blob
+	uint64_t dedup_bytes;     // their bytes, not written or fsync'd again
+};
+
+void cas_get_stats(struct cas_stats *out);
+
+#endif /* MYHTTP_CAS_H */
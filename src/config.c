@@ -0,0 +1,417 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "config.h"
+#include "bufpool.h"
+#include "conn.h"
+#include "dcache.h"
+#include "hotkeys.h"
+#include "iohint.h"
+#include "iopool.h"
+#include "pathlock.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum key_type { K_INT, K_SIZE, K_SECONDS, K_BOOL, K_PATH, K_ADMISSION };
+
+struct key {
+	const char        *name;
+	enum key_type      type;
+	size_t             off;       // field in struct mh_config
+	int                reload;    // applied in place on SIGHUP
+	unsigned long long min, max;
+	const char        *help;
+};
+
+#define F(field) offsetof(struct mh_config, field)
+#define SZ_MAX   ((unsigned long long)SIZE_MAX)
+
+static const struct key k_keys[] = {
+	{ "port",           K_INT,       F(port),           0, 21, 65535,    "port to listen on" },
+	{ "root",           K_PATH,      F(root),           0, 1, 0,         "document root" },
+	{ "tls-cert",       K_PATH,      F(tls_cert),       0, 0, 0,         "certificate chain (PEM); with tls-key serves HTTPS" },
+	{ "tls-key",        K_PATH,      F(tls_key),        0, 0, 0,         "private key (PEM)" },
+	{ "workers",        K_INT,       F(workers),        1, 1, MAX_WORKERS, "worker threads" },
+	{ "io-workers",     K_INT,       F(io_workers),     1, 0, IOPOOL_MAX, "threads for blocking filesystem steps (0: network workers take them)" },
+	{ "recv-buf",       K_SIZE,      F(recv_buf),       1, CONN_IN_MIN, BUFPOOL_LARGE, "largest request header block" },
+	{ "backlog",        K_INT,       F(backlog),        1, 1, 65535,     "listen() backlog" },
+	{ "queue-capacity", K_SIZE,      F(queue_capacity), 0, 1, 1u << 24,  "accepted connections waiting for a worker" },
+	{ "plock-buckets",  K_SIZE,      F(plock_buckets),  0, 1, 1u << 24,  "path-lock hash buckets" },
+	{ "dcache-entries", K_SIZE,      F(dcache_entries), 1, 0, 1u << 24,  "path-resolution cache slots (0 disables)" },
+	{ "manifest",       K_PATH,      F(manifest),       0, 0, 0,         "docroot manifest file, mapped at startup (built if missing)" },
+	{ "bundle",         K_PATH,      F(bundle),         0, 0, 0,         "asset bundle (tools/mhpack) served ahead of the docroot" },
+	{ "cas",            K_PATH,      F(cas),            0, 0, 0,         "content-addressed store: PUT bodies kept once, hard-linked into place" },
+	{ "bufpool-limit",  K_SIZE,      F(bufpool_limit),  1, 0, SZ_MAX,    "cap on buffer-pool memory (0 = none)" },
+	{ "bufpool-cache",  K_SIZE,      F(bufpool_cache),  1, 0, SZ_MAX,    "free buffers kept for reuse" },
+	{ "readahead",      K_SIZE,      F(readahead),      1, 0, 1u << 30,  "readahead window kept ahead of large downloads (0 disables)" },
+	{ "drop-behind",    K_SIZE,      F(drop_behind),    1, 0, SZ_MAX,    "drop one-off downloads this large from the page cache (0 never)" },
+	{ "write-behind",   K_SIZE,      F(write_behind),   1, 0, 1u << 30,  "start upload writeback every this many bytes (0 disables)" },
+	{ "max-inflight",   K_SIZE,      F(max_inflight),   1, 0, 1u << 30,  "connections queued or served before 503 (0 = workers + queue)" },
+	{ "admission",      K_ADMISSION, F(adaptive),       1, 0, 0,         "gradient: lower the limit as queue wait rises; fixed" },
+	{ "pin-workers",    K_BOOL,      F(pin_workers),    0, 0, 0,         "pin each worker to a CPU" },
+	{ "reuseport",      K_BOOL,      F(reuseport),      0, 0, 0,         "per-node SO_REUSEPORT listeners and queues (implies pin-workers)" },
+	{ "idle-timeout",   K_SECONDS,   F(idle_ms),        1, 0, 86400,     "keep-alive connection without a request" },
+	{ "header-timeout", K_SECONDS,   F(header_ms),      1, 0, 86400,     "receiving a header block (and the TLS handshake)" },
+	{ "body-timeout",   K_SECONDS,   F(body_ms),        1, 0, 86400,     "gap between reads of a request body" },
+	{ "write-timeout",  K_SECONDS,   F(write_ms),       1, 0, 86400,     "response making no progress" },
+	{ "upgrade-socket", K_PATH,      F(upgrade_socket), 0, 0, 0,         "Unix socket for handing the listeners to a new binary" },
+	{ "drain-timeout",  K_SECONDS,   F(drain_ms),       1, 0, 86400,     "after a handoff, wait this long for connections to finish" },
+	{ "hot-keys",       K_INT,       F(hot_keys),       1, 0, HOT_MAX,   "hottest GET paths to pin open and in memory (0 disables)" },
+	{ "trace-sample",   K_INT,       F(trace_sample),   1, 0, 1 << 20,   "trace the phases of one request in this many, per thread (0 disables)" },
+};
+
+#define NKEYS (sizeof(k_keys) / sizeof(k_keys[0]))
+
+
+// ---- Internal helpers ----
+
+static void set_err(char *err, size_t errlen, const char *fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(err, errlen, fmt, ap);
+	va_end(ap);
+}
+
+static void defaults(struct mh_config *c) {
+	memset(c, 0, sizeof(*c));
+	c->port = 8080;
+	strcpy(c->root, ".");
+	c->workers = N_WORKERS;
+	c->io_workers = IOPOOL_THREADS;
+	c->recv_buf = RECV_BUF_SZ;
+	c->backlog = BACKLOG;
+	c->queue_capacity = WORKQ_CAP;
+	c->plock_buckets = PLOCK_NBUCKETS;
+	c->dcache_entries = DCACHE_ENTRIES;
+	c->bufpool_limit = BUFPOOL_LIMIT;
+	c->bufpool_cache = BUFPOOL_CACHE_MAX;
+	c->readahead = IOHINT_READAHEAD;
+	c->drop_behind = IOHINT_DROP_BEHIND;
+	c->write_behind = IOHINT_WRITE_BEHIND;
+	c->adaptive = 1;
+	c->idle_ms = IDLE_TIMEOUT_MS;
+	c->header_ms = HEADER_TIMEOUT_MS;
+	c->body_ms = BODY_TIMEOUT_MS;
+	c->write_ms = WRITE_TIMEOUT_MS;
+	c->drain_ms = DRAIN_TIMEOUT_MS;
+	c->hot_keys = HOT_KEYS;
+	c->trace_sample = TRACE_SAMPLE;
+}
+
+static const struct key *find_key(const char *name, size_t len) {
+	for (size_t i = 0; i < NKEYS; i++)
+		if (strlen(k_keys[i].name) == len && strncmp(k_keys[i].name, name, len) == 0)
+			return &k_keys[i];
+	return NULL;
+}
+
+static size_t field_size(const struct key *k) {
+	switch (k->type) {
+	case K_SIZE:    return sizeof(size_t);
+	case K_SECONDS: return sizeof(unsigned);
+	case K_PATH:    return PATH_MAX;
+	default:        return sizeof(int);
+	}
+}
+
+// Integer with an optional K/M/G (binary) suffix for sizes.
+static int parse_number(const char *v, int suffixes, unsigned long long *out) {
+	if (!(*v >= '0' && *v <= '9')) return -1;
+	char *end = NULL;
+	errno = 0;
+	unsigned long long n = strtoull(v, &end, 10);
+	if (errno) return -1;
+	unsigned shift = 0;
+	if (suffixes && *end) {
+		switch (*end) {
+		case 'k': case 'K': shift = 10; break;
+		case 'm': case 'M': shift = 20; break;
+		case 'g': case 'G': shift = 30; break;
+		default: return -1;
+		}
+		end++;
+	}
+	if (*end) return -1;
+	if (shift && n > (~0ull >> shift)) return -1;
+	*out = n << shift;
+	return 0;
+}
+
+static int parse_bool(const char *v, int *out) {
+	static const char *const on[]  = { "on", "yes", "true", "1" };
+	static const char *const off[] = { "off", "no", "false", "0" };
+	for (int i = 0; i < 4; i++) {
+		if (strcmp(v, on[i]) == 0)  { *out = 1; return 0; }
+		if (strcmp(v, off[i]) == 0) { *out = 0; return 0; }
+	}
+	return -1;
+}
+
+// Store 'v' into k's field of 'c'; -1 with a message on a bad value.
+static int set_value(struct mh_config *c, const struct key *k, const char *v, char *err, size_t errlen) {
+	char *field = (char *)c + k->off;
+	unsigned long long n = 0;
+	switch (k->type) {
+	case K_INT:
+	case K_SIZE:
+		if (parse_number(v, k->type == K_SIZE, &n) < 0) break;
+		if (n < k->min || n > k->max) {
+			set_err(err, errlen, "%s: %s is out of range [%llu, %llu]", k->name, v, k->min, k->max);
+			return -1;
+		}
+		if (k->type == K_INT) *(int *)field = (int)n;
+		else                  *(size_t *)field = (size_t)n;
+		return 0;
+	case K_SECONDS: {
+		char *end = NULL;
+		double s = strtod(v, &end);
+		if (!v[0] || *end || !(s >= 0) || s > (double)k->max) break;
+		*(unsigned *)field = (unsigned)(s * 1000 + 0.5);
+		return 0;
+	}
+	case K_BOOL:
+		if (parse_bool(v, (int *)field) < 0) break;
+		return 0;
+	case K_PATH:   // min 1: required; otherwise "" unsets it
+		if ((!v[0] && k->min) || strlen(v) >= PATH_MAX) break;
+		strcpy(field, v);
+		return 0;
+	case K_ADMISSION:
+		if (strcmp(v, "gradient") == 0)   *(int *)field = 1;
+		else if (strcmp(v, "fixed") == 0) *(int *)field = 0;
+		else break;
+		return 0;
+	}
+	set_err(err, errlen, "invalid value for %s: '%s'", k->name, v);
+	return -1;
+}
+
+static void format_value(const struct mh_config *c, const struct key *k, char *out, size_t outlen) {
+	const char *field = (const char *)c + k->off;
+	switch (k->type) {
+	case K_INT:
+		snprintf(out, outlen, "%d", *(const int *)field);
+		break;
+	case K_SIZE: {
+		size_t v = *(const size_t *)field;
+		if (v && v % (1u << 30) == 0)      snprintf(out, outlen, "%zuG", v >> 30);
+		else if (v && v % (1u << 20) == 0) snprintf(out, outlen, "%zuM", v >> 20);
+		else if (v && v % (1u << 10) == 0) snprintf(out, outlen, "%zuK", v >> 10);
+		else                               snprintf(out, outlen, "%zu", v);
+		break;
+	}
+	case K_SECONDS:
+		snprintf(out, outlen, "%g", *(const unsigned *)field / 1e3);
+		break;
+	case K_BOOL:
+		snprintf(out, outlen, "%s", *(const int *)field ? "on" : "off");
+		break;
+	case K_PATH:
+		snprintf(out, outlen, "%s", field);
+		break;
+	case K_ADMISSION:
+		snprintf(out, outlen, "%s", *(const int *)field ? "gradient" : "fixed");
+		break;
+	}
+}
+
+static char *trim(char *s) {
+	while (*s == ' ' || *s == '\t') s++;
+	char *e = s + strlen(s);
+	while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\n' || e[-1] == '\r')) e--;
+	*e = '\0';
+	return s;
+}
+
+// Apply every "key = value" line of 'path'.
+static int load_file(struct mh_config *c, const char *path, char *err, size_t errlen) {
+	FILE *f = fopen(path, "r");
+	if (!f) { set_err(err, errlen, "%s: %s", path, strerror(errno)); return -1; }
+
+	char *line = NULL;
+	size_t cap = 0;
+	unsigned lineno = 0;
+	int rc = 0;
+	while (rc == 0 && getline(&line, &cap, f) >= 0) {
+		lineno++;
+		// '#' starts a comment at the start of a line or after blanks.
+		for (char *h = strchr(line, '#'); h; h = strchr(h + 1, '#')) {
+			if (h == line || h[-1] == ' ' || h[-1] == '\t') { *h = '\0'; break; }
+		}
+		char *s = trim(line);
+		if (!*s) continue;
+
+		char *eq = strchr(s, '=');
+		if (!eq) {
+			set_err(err, errlen, "%s:%u: expected 'key = value'", path, lineno);
+			rc = -1;
+			break;
+		}
+		*eq = '\0';
+		char *name = trim(s), *value = trim(eq + 1);
+		const struct key *k = find_key(name, strlen(name));
+		if (!k) {
+			set_err(err, errlen, "%s:%u: unknown key '%s'", path, lineno, name);
+			rc = -1;
+		} else if (set_value(c, k, value, err, errlen) < 0) {
+			// Prefix the location; the value message is already in 'err'.
+			char msg[256];
+			snprintf(msg, sizeof(msg), "%s", err);
+			set_err(err, errlen, "%s:%u: %s", path, lineno, msg);
+			rc = -1;
+		}
+	}
+	if (rc == 0 && ferror(f)) {
+		set_err(err, errlen, "%s: read error", path);
+		rc = -1;
+	}
+	free(line);
+	fclose(f);
+	return rc;
+}
+
+static const char *arg_hint(enum key_type t) {
+	switch (t) {
+	case K_INT:       return "<n>";
+	case K_SIZE:      return "<bytes>";
+	case K_SECONDS:   return "<s>";
+	case K_PATH:      return "<path>";
+	case K_ADMISSION: return "<mode>";
+	default:          return "";
+	}
+}
+
+
+//----- API ----------
+
+int config_build(struct mh_config *out, int argc, char **argv, char *err, size_t errlen) {
+	defaults(out);
+
+	// The file comes first, wherever --config appears: flags override it.
+	for (int i = 1; i < argc; i++) {
+		const char *file = NULL;
+		if (strcmp(argv[i], "--config") == 0) {
+			if (i + 1 >= argc) { set_err(err, errlen, "--config requires an argument"); return -1; }
+			file = argv[++i];
+		} else if (strncmp(argv[i], "--config=", 9) == 0) {
+			file = argv[i] + 9;
+		}
+		if (!file) continue;
+		if (strlen(file) >= PATH_MAX) { set_err(err, errlen, "--config: path too long"); return -1; }
+		strcpy(out->config_file, file);
+	}
+	if (out->config_file[0] && load_file(out, out->config_file, err, errlen) < 0) return -1;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const struct key *k = NULL;
+		const char *value = NULL;
+
+		if (strcmp(arg, "-p") == 0)      k = find_key("port", 4);
+		else if (strcmp(arg, "-d") == 0) k = find_key("root", 4);
+		else if (strncmp(arg, "--", 2) == 0) {
+			const char *name = arg + 2, *eq = strchr(name, '=');
+			size_t len = eq ? (size_t)(eq - name) : strlen(name);
+			if (len == 6 && strncmp(name, "config", 6) == 0) {
+				if (!eq) i++;   // loaded above
+				continue;
+			}
+			k = find_key(name, len);
+			if (eq) value = eq + 1;
+		}
+		if (!k) { set_err(err, errlen, "unknown argument %s", arg); return -1; }
+
+		if (!value && k->type == K_BOOL) {
+			value = "on";             // a bare flag
+		} else if (!value) {
+			if (i + 1 >= argc) { set_err(err, errlen, "%s requires an argument", arg); return -1; }
+			value = argv[++i];
+		}
+		if (set_value(out, k, value, err, errlen) < 0) return -1;
+	}
+
+	if (!out->tls_cert[0] != !out->tls_key[0]) {
+		set_err(err, errlen, "tls-cert and tls-key go together");
+		return -1;
+	}
+	if (out->reuseport) out->pin_workers = 1;
+	return 0;
+}
+
+const char *config_restart_key(const struct mh_config *a, const struct mh_config *b) {
+	char va[PATH_MAX], vb[PATH_MAX];
+	for (size_t i = 0; i < NKEYS; i++) {
+		if (k_keys[i].reload) continue;
+		format_value(a, &k_keys[i], va, sizeof(va));
+		format_value(b, &k_keys[i], vb, sizeof(vb));
+		if (strcmp(va, vb) != 0) return k_keys[i].name;
+	}
+	return NULL;
+}
+
+void config_keep_restart_keys(struct mh_config *to, const struct mh_config *from) {
+	for (size_t i = 0; i < NKEYS; i++) {
+		if (k_keys[i].reload) continue;
+		memcpy((char *)to + k_keys[i].off, (const char *)from + k_keys[i].off, field_size(&k_keys[i]));
+	}
+}
+
+/* One pass of config_render() into 'buf' ('cap' bytes; NULL to only
+   measure). Returns the rendered length, or -1 if a line cannot be
+   formatted. */
+static long render_into(const struct mh_config *c, const char *header, char *buf, size_t cap) {
+	size_t len = 0;
+	int n;
+	// Header: every line a comment.
+	for (const char *h = header; *h; ) {
+		size_t hn = strcspn(h, "\n");
+		if (hn > INT_MAX) return -1;
+		n = snprintf(buf ? buf + len : NULL, buf ? cap - len : 0, "# %.*s\n", (int)hn, h);
+		if (n < 0 || (buf && (size_t)n >= cap - len)) return -1;
+		len += (size_t)n;
+		h += hn;
+		if (*h) h++;
+	}
+	char v[PATH_MAX];
+	for (size_t i = 0; i < NKEYS; i++) {
+		format_value(c, &k_keys[i], v, sizeof(v));
+		n = snprintf(buf ? buf + len : NULL, buf ? cap - len : 0, "%-15s = %s\n", k_keys[i].name, v);
+		if (n < 0 || (buf && (size_t)n >= cap - len)) return -1;
+		len += (size_t)n;
+	}
+	return (long)len;
+}
+
+int config_render(const struct mh_config *c, const char *header, char **out, size_t *outlen) {
+	// Measure first, so no value can outgrow the buffer.
+	long need = render_into(c, header, NULL, 0);
+	if (need < 0) { errno = EINVAL; return -1; }
+	size_t cap = (size_t)need + 1;
+	char *buf = (char *)malloc(cap);
+	if (!buf) { errno = ENOMEM; return -1; }
+	long len = render_into(c, header, buf, cap);
+	if (len != need) { free(buf); errno = EINVAL; return -1; }
+	*out = buf;
+	*outlen = (size_t)len;
+	return 0;
+}
+
+void config_usage(FILE *f) {
+	struct mh_config d;
+	defaults(&d);
+	char v[PATH_MAX];
+	fprintf(f, "Options (also 'key = value' lines in the --config file; * = applied on SIGHUP):\n");
+	fprintf(f, "  --config <path>           read settings from a file first\n");
+	for (size_t i = 0; i < NKEYS; i++) {
+		const struct key *k = &k_keys[i];
+		char flag[48];
+		snprintf(flag, sizeof(flag), "--%s %s", k->name, arg_hint(k->type));
+		format_value(&d, k, v, sizeof(v));
+		fprintf(f, " %c%-25s %s (%s)\n", k->reload ? '*' : ' ', flag, k->help, v[0] ? v : "none");
+	}
+	fprintf(f, "  -p and -d are short for --port and --root; sizes take K/M/G, timeouts are seconds (0 disables).\n");
+}
@@ -0,0 +1,133 @@
+#ifndef MYHTTP_CONFIG_H
+#define MYHTTP_CONFIG_H
+
+#include <limits.h>   // PATH_MAX
+#include <stddef.h>   // size_t
+#include <stdio.h>    // FILE
+
+/* Runtime configuration: every tunable, from defaults < config file <
+   command line.
+
+   The file holds "key = value" lines ('#' starts a comment); the same keys
+   work as "--key value" flags (booleans as a bare "--key"), plus the short
+   forms -p (port) and -d (root). Sizes take K/M/G suffixes, timeouts are
+   seconds with fractions.
+
+   Keys marked reloadable are re-applied in place on SIGHUP (the file is
+   re-read and the original command line re-applied on top); the others
+   only change at the next start. The effective configuration is served
+   on CONFIG_URL in the same format, so it can be saved as a config file. */
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+/* Reserved URL the effective configuration is served on. */
+#define CONFIG_URL "/_config"
+
+/* ---- Build-time defaults ---- */
+
+#ifndef N_WORKERS
+#define N_WORKERS 8
+#endif
+
+#ifndef MAX_WORKERS
+#define MAX_WORKERS 256
+#endif
+
+#ifndef BACKLOG
+#define BACKLOG 128
+#endif
+
+/* Largest request header block; the receive buffer starts at CONN_IN_MIN
+   and only grows toward this for large headers. */
+#ifndef RECV_BUF_SZ
+#define RECV_BUF_SZ (64 * 1024)
+#endif
+
+/* Accepted connections waiting for a worker, at most. */
+#ifndef WORKQ_CAP
+#define WORKQ_CAP 1024
+#endif
+
+/* Connection deadlines (ms; 0 disables). Idle: waiting for the next
+   request on a kept-alive connection. Header: from the first byte (or the
+   accept) until the header block is complete. Body: between successive
+   reads of a request body (and of HTTP/2 frames on a busy session).
+   Write: a response making no progress. */
+#ifndef IDLE_TIMEOUT_MS
+#define IDLE_TIMEOUT_MS   60000
+#endif
+#ifndef HEADER_TIMEOUT_MS
+#define HEADER_TIMEOUT_MS 15000
+#endif
+#ifndef BODY_TIMEOUT_MS
+#define BODY_TIMEOUT_MS   30000
+#endif
+#ifndef WRITE_TIMEOUT_MS
+#define WRITE_TIMEOUT_MS  30000
+#endif
+
+/* After handing the listeners to a new binary (upgrade.h): how long the
+   old process waits for its connections to finish before exiting. */
+#ifndef DRAIN_TIMEOUT_MS
+#define DRAIN_TIMEOUT_MS  30000
+#endif
+
+struct mh_config {
+	char     config_file[PATH_MAX];   // "" = none
+	int      port;
+	char     root[PATH_MAX];
+	char     tls_cert[PATH_MAX];      // both set: the port speaks TLS
+	char     tls_key[PATH_MAX];
+
+	int      workers;
+	int      io_workers;              // blocking-I/O pool (iopool.h); 0 = none
+	size_t   recv_buf;                // RECV_BUF_SZ
+	int      backlog;
+	size_t   queue_capacity;          // per accept loop
+	size_t   plock_buckets;
+	size_t   dcache_entries;          // 0 disables
+	char     manifest[PATH_MAX];      // "" = none (manifest.h)
+	char     bundle[PATH_MAX];        // "" = none (bundle.h)
+	char     cas[PATH_MAX];           // "" = no upload deduplication (cas.h)
+	size_t   bufpool_limit;           // 0 = unlimited
+	size_t   bufpool_cache;
+	size_t   readahead;               // page-cache hints (iohint.h); 0 disables each
+	size_t   drop_behind;
+	size_t   write_behind;
+
+	size_t   max_inflight;            // admission limit ceiling (admit.h); 0 = workers + queue
+	int      adaptive;                // let queueing delay lower it
+	int      pin_workers;             // one CPU per worker (topo.h)
+	int      reuseport;               // per-node listeners and queues
+
+	unsigned idle_ms, header_ms, body_ms, write_ms;
+
+	char     upgrade_socket[PATH_MAX];  // "" = no binary upgrades
+	unsigned drain_ms;
+
+	int      hot_keys;                // paths pinned by hotkeys.c; 0 = off
+	int      trace_sample;            // phase tracing (trace.h); 0 = off
+};
+
+/* Build the configuration for this command line: defaults, then the file
+   named by --config (if any), then the flags. On error returns -1 with a
+   message in 'err'. */
+int  config_build(struct mh_config *out, int argc, char **argv, char *err, size_t errlen);
+
+/* Name of the first non-reloadable key whose value differs, or NULL. */
+const char *config_restart_key(const struct mh_config *a, const struct mh_config *b);
+
+/* Copy the non-reloadable keys of 'from' into 'to'. */
+void config_keep_restart_keys(struct mh_config *to, const struct mh_config *from);
+
+/* Render as a config file ('*out' malloc'd, caller frees); 'header' is
+   emitted first as comment lines. The buffer is sized to fit. Returns 0,
+   or -1 with errno set (ENOMEM). */
+int  config_render(const struct mh_config *c, const char *header, char **out, size_t *outlen);
+
+/* Flag summary for usage(). */
+void config_usage(FILE *f);
+
+#endif /* MYHTTP_CONFIG_H */
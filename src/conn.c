@@ -0,0 +1,473 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "conn.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+_Static_assert(sizeof(struct mh_conn) <= 1024, "idle connection state must stay under 1 KiB");
+
+
+// ---- Internal helpers ----
+
+static inline char *stage_tail(struct mh_conn *c) {
+	return c->stage + c->stage_len;
+}
+
+// Append [p, p+len) as an iov entry, merging with the previous one when
+// they are adjacent (consecutive staging writes). Caller checked capacity.
+static void iov_push(struct mh_conn *c, const void *p, size_t len) {
+	if (c->niov > 0) {
+		struct iovec *last = &c->iov[c->niov - 1];
+		if ((const char *)last->iov_base + last->iov_len == (const char *)p) {
+			last->iov_len += len;
+			c->out_queued += len;
+			return;
+		}
+	}
+	c->iov[c->niov].iov_base = (void *)p;
+	c->iov[c->niov].iov_len = len;
+	c->niov++;
+	c->out_queued += len;
+}
+
+// Move staged bytes into a pooled buffer of at least 'want' bytes,
+// repointing the iov entries that reference the old one.
+static int stage_grow(struct mh_conn *c, size_t want) {
+	size_t cap;
+	char *ns = (char *)bufpool_get(want, &cap);
+	if (!ns) return -1;
+	if (c->stage) {
+		memcpy(ns, c->stage, c->stage_len);
+		for (int i = 0; i < c->niov; i++) {
+			char *b = (char *)c->iov[i].iov_base;
+			if (b >= c->stage && b < c->stage + c->stage_cap)
+				c->iov[i].iov_base = ns + (b - c->stage);
+		}
+		bufpool_put(c->stage, c->stage_cap);
+	}
+	c->stage = ns;
+	c->stage_cap = cap;
+	return 0;
+}
+
+// Make room for one more entry of 'len' bytes (stage_need of them staged).
+// The stage grows in place while it can; only past CONN_STAGE_MAX do we flush.
+static int make_room(struct mh_conn *c, size_t len, size_t stage_need) {
+	if (c->niov == CONN_IOV_MAX || c->out_queued + len > CONN_OUT_MAX) {
+		if (conn_flush(c) < 0) return -1;
+	}
+	if (stage_need == 0 || c->stage_len + stage_need <= c->stage_cap) return 0;
+	if (c->stage_len + stage_need > CONN_STAGE_MAX) {
+		if (conn_flush(c) < 0) return -1;
+		if (stage_need <= c->stage_cap) return 0;
+	}
+	return stage_grow(c, c->stage_len + stage_need);
+}
+
+// Swap the input buffer for one of at least 'want' bytes, keeping unparsed data.
+static int in_grow(struct mh_conn *c, size_t want) {
+	size_t cap;
+	char *ni = (char *)bufpool_get(want, &cap);
+	if (!ni) return -1;
+	if (c->in) {
+		memcpy(ni, c->in + c->in_off, c->in_len - c->in_off);
+		bufpool_put(c->in, c->in_cap);
+	}
+	c->in_len -= c->in_off;
+	c->in_off = 0;
+	c->in = ni;
+	c->in_cap = cap;
+	return 0;
+}
+
+static void rd_expire(struct mh_timer *t) { ((struct mh_conn *)t->arg)->rd_expired = 1; }
+static void wr_expire(struct mh_timer *t) { ((struct mh_conn *)t->arg)->wr_expired = 1; }
+
+static unsigned timeout_ms(const struct mh_conn *c, int kind) {
+	switch (kind) {
+	case CONN_T_IDLE:   return __atomic_load_n(&c->to->idle_ms, __ATOMIC_RELAXED);
+	case CONN_T_HEADER: return __atomic_load_n(&c->to->header_ms, __ATOMIC_RELAXED);
+	case CONN_T_BODY:   return __atomic_load_n(&c->to->body_ms, __ATOMIC_RELAXED);
+	case CONN_T_WRITE:  return __atomic_load_n(&c->to->write_ms, __ATOMIC_RELAXED);
+	default:            return 0;
+	}
+}
+
+// (Re)start the read deadline as 'kind'.
+static void rd_arm(struct mh_conn *c, int kind) {
+	c->rd_kind = (unsigned char)kind;
+	c->rd_expired = 0;
+	if (!c->wheel) return;
+	unsigned ms = timeout_ms(c, kind);
+	if (ms) twheel_arm(c->wheel, &c->rd_timer, twheel_now_ms() + ms);
+	else    twheel_cancel(c->wheel, &c->rd_timer);
+}
+
+// Bytes moved: the body deadline counts from the last progress, and the
+// next blocked write gets a fresh write deadline.
+static void progress(struct mh_conn *c) {
+	if (!c->wheel) return;
+	if (c->rd_kind == CONN_T_BODY) rd_arm(c, CONN_T_BODY);
+	twheel_cancel(c->wheel, &c->wr_timer);
+	c->wr_expired = 0;
+}
+
+// Wait for the socket (for reading or writing; TLS may need the other
+// direction), firing the wheel's timers as time passes. Returns -1 with
+// ETIMEDOUT once the deadline for this direction has expired.
+static int conn_wait(struct mh_conn *c, int for_write) {
+	if (!for_write && c->tls && tls_pending(c->tls)) return 0;
+	const unsigned wr_ms = for_write ? timeout_ms(c, CONN_T_WRITE) : 0;
+	if (wr_ms && c->wheel && !timer_armed(&c->wr_timer) && !c->wr_expired)
+		twheel_arm(c->wheel, &c->wr_timer, twheel_now_ms() + wr_ms);
+
+	short events = for_write ? POLLOUT : POLLIN;
+	if (!for_write && c->tls && tls_want_write(c->tls)) events = POLLOUT;   // handshake flight
+	for (;;) {
+		int ms = c->wheel ? twheel_timeout_ms(c->wheel, twheel_now_ms()) : -1;
+		struct pollfd pfd = { .fd = c->fd, .events = events };
+		int r = poll(&pfd, 1, ms);
+		if (r < 0 && errno != EINTR) return -1;
+		if (c->wheel) twheel_advance(c->wheel, twheel_now_ms());
+
+		if (for_write ? c->wr_expired : c->rd_expired) {
+			static const int k_mx[] = {
+				[CONN_T_IDLE] = MX_TO_IDLE, [CONN_T_HEADER] = MX_TO_HEADER,
+				[CONN_T_BODY] = MX_TO_BODY, [CONN_T_WRITE] = MX_TO_WRITE,
+			};
+			metrics_add_timeout(k_mx[for_write ? CONN_T_WRITE : c->rd_kind]);
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		if (r > 0) return 0;
+	}
+}
+
+// recv() or TLS read into buf, waiting out EAGAIN; EINTR is retried.
+static ssize_t sock_read(struct mh_conn *c, void *buf, size_t len) {
+	for (;;) {
+		ssize_t n = c->tls ? tls_read(c->tls, buf, len) : recv(c->fd, buf, len, 0);
+		if (n > 0) progress(c);
+		if (n >= 0) return n;
+		if (errno == EINTR) continue;
+		if (errno != EAGAIN || conn_wait(c, 0) < 0) return -1;
+	}
+}
+
+static int write_through(struct mh_conn *c, const char *p, size_t len) {
+	while (len > 0) {
+		ssize_t n = c->tls ? tls_write(c->tls, p, len) : send(c->fd, p, len, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN && conn_wait(c, 1) == 0) continue;
+			return -1;
+		}
+		progress(c);
+		metrics_add_bytes_out((size_t)n);
+		p += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+// Userspace TLS: gather the batch into record-sized chunks, so small
+// entries don't each become a record (and a write) of their own.
+static int flush_tls(struct mh_conn *c) {
+	size_t cap;
+	char *rec = (char *)bufpool_get(CONN_TLS_RECORD, &cap);
+	if (!rec) return -1;
+	int rc = 0;
+	size_t used = 0;
+	for (int i = 0; i < c->niov && rc == 0; i++) {
+		const char *p = (const char *)c->iov[i].iov_base;
+		size_t left = c->iov[i].iov_len;
+		while (left > 0) {
+			size_t n = cap - used < left ? cap - used : left;
+			memcpy(rec + used, p, n);
+			used += n;
+			p += n;
+			left -= n;
+			if (used == cap) {
+				if (write_through(c, rec, used) < 0) { rc = -1; break; }
+				used = 0;
+			}
+		}
+	}
+	if (rc == 0 && used > 0) rc = write_through(c, rec, used);
+	int saved = errno;
+	bufpool_put(rec, cap);
+	errno = saved;
+	return rc;
+}
+
+
+//----- API ----------
+
+int conn_init(struct mh_conn *c, int fd, size_t in_max) {
+	memset(c, 0, sizeof(*c));
+	if (in_max < CONN_IN_MIN || in_max > BUFPOOL_LARGE) { errno = EINVAL; return -1; }
+	c->fd = fd;
+	c->in_max = in_max;
+	(void)arena_init(&c->arena, 0);   // block attached per request
+
+	int one = 1;
+	(void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return 0;
+}
+
+void conn_free(struct mh_conn *c) {
+	if (!c) return;
+	c->in_off = c->in_len = 0;
+	c->niov = 0;
+	c->stage_len = c->out_queued = 0;
+	conn_release_idle(c);
+	arena_destroy(&c->arena);
+	tls_close(c->tls);
+	c->tls = NULL;
+	if (c->wheel) {
+		twheel_cancel(c->wheel, &c->rd_timer);
+		twheel_cancel(c->wheel, &c->wr_timer);
+		c->wheel = NULL;
+	}
+}
+
+int conn_set_timers(struct mh_conn *c, struct mh_twheel *w, const struct conn_timeouts *to) {
+	int fl = fcntl(c->fd, F_GETFL);
+	if (fl < 0 || fcntl(c->fd, F_SETFL, fl | O_NONBLOCK) < 0) return -1;
+	c->wheel = w;
+	c->to = to;
+	timer_init(&c->rd_timer, rd_expire, c);
+	timer_init(&c->wr_timer, wr_expire, c);
+	return 0;
+}
+
+void conn_detach(struct mh_conn *c) {
+	if (c->wheel) {
+		twheel_cancel(c->wheel, &c->rd_timer);
+		twheel_cancel(c->wheel, &c->wr_timer);
+		c->wheel = NULL;
+	}
+	c->rd_kind = CONN_T_NONE;
+	c->rd_expired = c->wr_expired = 0;
+}
+
+void conn_expect(struct mh_conn *c, enum conn_timer kind) {
+	if (kind != c->rd_kind) rd_arm(c, kind);
+}
+
+int conn_start_tls(struct mh_conn *c) {
+	c->tls = tls_new(c->fd);
+	if (!c->tls) return -1;
+	conn_expect(c, CONN_T_HEADER);
+	while (tls_handshake(c->tls) < 0) {
+		if (errno != EAGAIN || conn_wait(c, 0) < 0) return -1;
+	}
+	return 0;
+}
+
+int conn_readable(struct mh_conn *c, int timeout_ms) {
+	if (c->tls && tls_pending(c->tls)) return 1;
+	struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+	for (;;) {
+		int r = poll(&pfd, 1, timeout_ms);
+		if (r >= 0) return r > 0;
+		if (errno != EINTR) return -1;
+	}
+}
+
+ssize_t conn_read(struct mh_conn *c, void *buf, size_t len) {
+	conn_expect(c, CONN_T_BODY);
+	ssize_t n = sock_read(c, buf, len);
+	if (n > 0) metrics_add_bytes_in((size_t)n);
+	return n;
+}
+
+ssize_t conn_fill(struct mh_conn *c) {
+	if (!c->in) {
+		// Idle: wait for the next request without holding a buffer.
+		if (conn_wait(c, 0) < 0) return -1;
+		if (in_grow(c, CONN_IN_MIN) < 0) return -1;
+	}
+	if (c->in_off == c->in_len) {
+		c->in_off = c->in_len = 0;
+	} else if (c->in_len == c->in_cap && c->in_off > 0) {
+		// Compact only when the tail is out of room.
+		memmove(c->in, c->in + c->in_off, c->in_len - c->in_off);
+		c->in_len -= c->in_off;
+		c->in_off = 0;
+	}
+	if (c->in_len == c->in_cap) {
+		if (c->in_cap >= c->in_max) return 0;
+		if (in_grow(c, c->in_cap + 1) < 0) return -1;   // next size class
+	}
+
+	ssize_t n = sock_read(c, c->in + c->in_len, c->in_cap - c->in_len);
+	if (n > 0) {
+		c->in_len += (size_t)n;
+		metrics_add_bytes_in((size_t)n);
+	}
+	return n;
+}
+
+void conn_begin_request(struct mh_conn *c) {
+	conn_expect(c, CONN_T_NONE);
+	if (!c->arena_cap) {
+		size_t cap;
+		void *block = bufpool_get(CONN_ARENA_SZ, &cap);
+		if (block) {                 // otherwise the arena just spills
+			arena_attach(&c->arena, block, cap);
+			c->arena_cap = cap;
+		}
+	}
+	arena_reset(&c->arena);
+}
+
+void conn_release_idle(struct mh_conn *c) {
+	if (conn_avail(c) != 0 || c->niov != 0) return;
+	if (c->in) {
+		bufpool_put(c->in, c->in_cap);
+		c->in = NULL;
+		c->in_cap = c->in_off = c->in_len = 0;
+	}
+	if (c->stage) {
+		bufpool_put(c->stage, c->stage_cap);
+		c->stage = NULL;
+		c->stage_cap = c->stage_len = 0;
+	}
+	if (c->arena_cap) {
+		bufpool_put(arena_detach(&c->arena), c->arena_cap);
+		c->arena_cap = 0;
+	}
+}
+
+char *conn_stage_reserve(struct mh_conn *c, size_t max) {
+	if (max > CONN_STAGE_MAX) { errno = EMSGSIZE; return NULL; }
+	if (make_room(c, max, max) < 0) return NULL;
+	return stage_tail(c);
+}
+
+void conn_stage_commit(struct mh_conn *c, size_t n) {
+	if (n == 0) return;
+	iov_push(c, stage_tail(c), n);
+	c->stage_len += n;
+}
+
+int conn_queue_copy(struct mh_conn *c, const void *buf, size_t len) {
+	if (len == 0) return 0;
+	if (len > CONN_STAGE_MAX) {
+		if (conn_flush(c) < 0) return -1;
+		return write_through(c, (const char *)buf, len);
+	}
+	char *dst = conn_stage_reserve(c, len);
+	if (!dst) return -1;
+	memcpy(dst, buf, len);
+	conn_stage_commit(c, len);
+	return 0;
+}
+
+int conn_queue_ref(struct mh_conn *c, const void *buf, size_t len) {
+	if (len == 0) return 0;
+	if (make_room(c, len, 0) < 0) return -1;
+	iov_push(c, buf, len);
+	return 0;
+}
+
+static int flush_queued(struct mh_conn *c) {
+	if (c->tls && !tls_ktls_send(c->tls) && c->niov > 0) {
+		int rc = flush_tls(c);
+		c->niov = 0; c->stage_len = 0; c->out_queued = 0;
+		return rc;
+	}
+
+	struct iovec *iov = c->iov;
+	int niov = c->niov;
+
+	while (niov > 0) {
+		struct msghdr mh;
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = iov;
+		mh.msg_iovlen = (size_t)niov;
+		ssize_t n = sendmsg(c->fd, &mh, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN && conn_wait(c, 1) == 0) continue;
+			c->niov = 0; c->stage_len = 0; c->out_queued = 0;
+			return -1;
+		}
+		progress(c);
+		metrics_add_bytes_out((size_t)n);
+
+		// Skip fully written entries, trim the partially written one.
+		size_t left = (size_t)n;
+		while (niov > 0 && left >= iov->iov_len) {
+			left -= iov->iov_len;
+			iov++; niov--;
+		}
+		if (niov > 0) {
+			iov->iov_base = (char *)iov->iov_base + left;
+			iov->iov_len -= left;
+		}
+	}
+	c->niov = 0;
+	c->stage_len = 0;
+	c->out_queued = 0;
+	return 0;
+}
+
+int conn_flush(struct mh_conn *c) {
+	if (c->niov == 0) return flush_queued(c);
+	const uint64_t tr = trace_begin(TR_SEND);
+	int rc = flush_queued(c);
+	trace_end(TR_SEND, tr);
+	return rc;
+}
+
+int conn_sendfile(struct mh_conn *c, int file_fd, off_t off, size_t len) {
+	if (conn_flush(c) < 0) return -1;
+
+	// Zero-copy unless TLS records have to be built in userspace.
+	const int zero_copy = !c->tls || tls_ktls_send(c->tls);
+	while (zero_copy && len > 0) {
+		ssize_t n = c->tls ? tls_sendfile(c->tls, file_fd, off, len)
+		                   : sendfile(c->fd, file_fd, &off, len);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN && conn_wait(c, 1) == 0) continue;
+			if (errno == EINVAL || errno == ENOSYS) break;   // fall back below
+			return -1;
+		}
+		if (n == 0) { errno = EIO; return -1; }          // file shrank under us
+		if (c->tls) off += n;                            // sendfile() advanced it
+		progress(c);
+		metrics_add_bytes_out((size_t)n);
+		len -= (size_t)n;
+	}
+	if (len == 0) return 0;
+
+	// Fallback for descriptors sendfile() refuses: stage-sized pread/send.
+	if (c->stage_cap < CONN_STAGE_MAX && stage_grow(c, CONN_STAGE_MAX) < 0) return -1;
+	while (len > 0) {
+		size_t want = len < c->stage_cap ? len : c->stage_cap;
+		ssize_t r = pread(file_fd, c->stage, want, off);
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		if (r == 0) { errno = EIO; return -1; }
+		if (write_through(c, c->stage, (size_t)r) < 0) return -1;
+		off += r;
+		len -= (size_t)r;
+	}
+	return 0;
+}
@@ -0,0 +1,194 @@
+#ifndef MYHTTP_CONN_H
+#define MYHTTP_CONN_H
+
+#include <stddef.h>     // size_t
+#include <sys/types.h>  // ssize_t, off_t
+#include <sys/uio.h>    // struct iovec
+
+#include "arena.h"
+#include "bufpool.h"
+#include "tls.h"
+#include "twheel.h"
+
+/* Per-connection I/O state for the HTTP/1.1 loop.
+
+   Input: requests are parsed from a read cursor (in_off) over in[0..in_len);
+   the buffer is only compacted when a recv needs room at the tail. It
+   starts at CONN_IN_MIN and moves up a buffer-pool size class only when a
+   header block does not fit, up to the limit given to conn_init().
+
+   Output: responses are queued, in order, into one iovec batch and written
+   with a single sendmsg() per flush. Small payloads are copied into the
+   staging buffer; conn_queue_ref() adds caller-owned memory (string
+   literals) without copying. Queued output is capped at CONN_OUT_MAX; a
+   queue call that would exceed it flushes first.
+
+   Scratch: 'arena' is reset before each request; handlers take their
+   path buffers and other temporaries from it instead of the stack/heap.
+
+   Memory: the input buffer, staging buffer and arena block all come from
+   the buffer pool on demand and go back to it in conn_release_idle(), so
+   a keep-alive connection waiting for its next request costs only this
+   struct (kept under 1 KiB, see CONN_IOV_MAX).
+
+   TLS: after conn_start_tls() every read and write goes through the
+   session. With kernel TLS for sending, batches still leave with one
+   sendmsg() and files with sendfile(); without it, queued output is
+   gathered into full-size records and encrypted in userspace.
+
+   Timeouts: with conn_set_timers() the socket becomes non-blocking and
+   every wait is bounded by a deadline on the worker's timer wheel. One
+   read deadline follows the connection's phase (conn_expect()): idle
+   between requests, header (total time for a request's header block),
+   body (time without progress while a body or HTTP/2 frames are read).
+   A separate write deadline runs while output is blocked on a peer that
+   isn't reading, restarting on every bit of progress. An expired wait
+   fails with ETIMEDOUT, and the caller's ordinary error path then drops
+   the connection, temp files and path locks. */
+
+#ifndef CONN_IOV_MAX
+#define CONN_IOV_MAX   32
+#endif
+
+#ifndef CONN_IN_MIN
+#define CONN_IN_MIN    BUFPOOL_SMALL
+#endif
+
+/* The staging buffer grows by size class up to this. */
+#ifndef CONN_STAGE_MAX
+#define CONN_STAGE_MAX BUFPOOL_LARGE
+#endif
+
+#ifndef CONN_OUT_MAX
+#define CONN_OUT_MAX   (256 * 1024)
+#endif
+
+#ifndef CONN_ARENA_SZ
+#define CONN_ARENA_SZ  BUFPOOL_MEDIUM
+#endif
+
+/* Plaintext per record when TLS is encrypted in userspace (the TLS maximum). */
+#ifndef CONN_TLS_RECORD
+#define CONN_TLS_RECORD BUFPOOL_MEDIUM
+#endif
+
+/* File bodies up to this size are read into the batch instead of sendfile'd. */
+#ifndef CONN_INLINE_MAX
+#define CONN_INLINE_MAX (16 * 1024)
+#endif
+
+enum conn_timer { CONN_T_NONE, CONN_T_IDLE, CONN_T_HEADER, CONN_T_BODY, CONN_T_WRITE };
+
+/* Milliseconds per deadline; 0 disables it. */
+struct conn_timeouts {
+	unsigned idle_ms;
+	unsigned header_ms;
+	unsigned body_ms;
+	unsigned write_ms;
+};
+
+struct mh_conn {
+	int fd;
+	struct mh_tls *tls;   // NULL for plain TCP
+
+	char  *in;            // NULL while idle
+	size_t in_cap;
+	size_t in_max;        // growth limit for 'in'
+	size_t in_off;        // parse cursor
+	size_t in_len;        // bytes buffered
+
+	struct iovec iov[CONN_IOV_MAX];
+	int    niov;
+	char  *stage;         // NULL while idle
+	size_t stage_cap;
+	size_t stage_len;
+	size_t out_queued;    // bytes across all iov entries
+
+	struct mh_arena arena;
+	size_t arena_cap;     // size of the pooled arena block, 0 if none
+
+	struct mh_twheel *wheel;            // NULL: blocking I/O, no deadlines
+	const struct conn_timeouts *to;
+	struct mh_timer rd_timer, wr_timer;
+	unsigned char rd_kind;              // enum conn_timer of rd_timer
+	unsigned char rd_expired, wr_expired;
+};
+
+/* Set up 'fd' (input may grow to in_max bytes) and set TCP_NODELAY: we
+   coalesce writes ourselves, so Nagle would only add latency. Takes no
+   buffers yet. Returns 0, or -1 with errno set. */
+int  conn_init(struct mh_conn *c, int fd, size_t in_max);
+void conn_free(struct mh_conn *c);
+
+/* Bound every wait on 'c' with deadlines from 'to', kept on 'w' (both must
+   outlive the connection); switches the socket to non-blocking mode. 'to'
+   is read each time a deadline starts, so atomic stores to it (a config
+   reload) apply from the next one. Returns 0, or -1 with errno set. */
+int  conn_set_timers(struct mh_conn *c, struct mh_twheel *w, const struct conn_timeouts *to);
+
+/* Take 'c' off its worker's wheel (deadlines cancelled, socket mode kept)
+   so it can move to another thread between requests; there
+   conn_set_timers() puts it on that thread's wheel. No-op without timers. */
+void conn_detach(struct mh_conn *c);
+
+/* Time the next reads as 'kind' (CONN_T_IDLE, _HEADER, _BODY or _NONE). The
+   deadline starts when the kind changes; asking again for the same kind
+   keeps it running. */
+void conn_expect(struct mh_conn *c, enum conn_timer kind);
+
+/* Run the TLS server handshake (within the header deadline); I/O on 'c'
+   is encrypted from here on. Returns 0, or -1 with errno set. */
+int  conn_start_tls(struct mh_conn *c);
+
+/* Bytes buffered but not yet parsed. */
+static inline size_t conn_avail(const struct mh_conn *c) { return c->in_len - c->in_off; }
+
+/* The input buffer is full at its maximum size (header block too large). */
+static inline int conn_in_full(const struct mh_conn *c) {
+	return c->in && c->in_off == 0 && c->in_len == c->in_cap && c->in_cap >= c->in_max;
+}
+
+/* recv() more input, compacting or growing the buffer if the tail is full.
+   An idle connection (no input buffer) first waits for readability, then
+   borrows a CONN_IN_MIN buffer. Returns bytes read, 0 on EOF or when the
+   buffer is full at in_max, -1 on error. */
+ssize_t conn_fill(struct mh_conn *c);
+
+/* Wait up to 'timeout_ms' (-1: forever) for input, counting bytes the TLS
+   session has already buffered. Returns 1 if readable, 0 on timeout, -1
+   on error. */
+int  conn_readable(struct mh_conn *c, int timeout_ms);
+
+/* Read up to 'len' bytes straight into 'buf', bypassing the input buffer
+   (request bodies, timed as CONN_T_BODY). Returns bytes read, 0 on EOF,
+   -1 on error. */
+ssize_t conn_read(struct mh_conn *c, void *buf, size_t len);
+
+/* Start a request (its header block is complete): stop the read deadline,
+   attach a pooled arena block if needed and reset it. */
+void conn_begin_request(struct mh_conn *c);
+
+/* If nothing is buffered or queued, hand every buffer back to the pool. */
+void conn_release_idle(struct mh_conn *c);
+
+/* Reserve up to 'max' contiguous staging bytes (flushing if needed);
+   finish with conn_stage_commit(n). Returns NULL (errno set) on failure. */
+char *conn_stage_reserve(struct mh_conn *c, size_t max);
+void  conn_stage_commit(struct mh_conn *c, size_t n);
+
+/* Queue a copy of buf[0..len). Larger-than-stage payloads are written
+   through after a flush. Returns 0 or -1 (errno set). */
+int  conn_queue_copy(struct mh_conn *c, const void *buf, size_t len);
+
+/* Queue 'buf' by reference; it must outlive the next flush. */
+int  conn_queue_ref(struct mh_conn *c, const void *buf, size_t len);
+
+/* Write everything queued. Returns 0 or -1 (errno set). */
+int  conn_flush(struct mh_conn *c);
+
+/* Flush, then send 'len' bytes of 'file_fd' from 'off' with sendfile()
+   (through kernel TLS on TLS connections; read/write fallback). Returns 0
+   or -1 (errno set). */
+int  conn_sendfile(struct mh_conn *c, int file_fd, off_t off, size_t len);
+
+#endif /* MYHTTP_CONN_H */
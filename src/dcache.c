@@ -0,0 +1,353 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE   // d_type / DT_DIR
+
+#include "dcache.h"
+
+#include <pthread.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define DCACHE_STRIPES   64u   /* mutexes guarding slot i: i % DCACHE_STRIPES */
+/* Tables have at least DCACHE_STRIPES slots, so hash % DCACHE_STRIPES names
+   the stripe of a key's slot whatever the current size: a lookup can take
+   its stripe before reading the table pointer, which dcache_resize() swaps
+   under every stripe. */
+#define DCACHE_MAX_DEPTH 32    /* how deep the watcher descends into docroot */
+
+struct dc_ent {
+	uint64_t hash;
+	uint64_t gen;      /* 0 = empty slot */
+	int      kind;
+	size_t   cap;      /* bytes allocated in blk */
+	char    *key;      /* points into blk */
+	char    *path;     /* points into blk (empty for negatives) */
+	char    *blk;
+};
+
+static struct {
+	int              enabled;
+	uint64_t         gen;
+	uint64_t         file_gen;   /* gen, plus files closed after writing */
+	uint64_t         edits;      /* those closes */
+	size_t           mask;
+	struct dc_ent   *ents;
+	pthread_mutex_t  locks[DCACHE_STRIPES];
+
+	/* watcher state: wd -> directory path (for adding watches on new subdirs) */
+	void           (*hook)(const char *dir, const char *name);
+	int              ifd;
+	char           **wd_paths;
+	size_t           wd_cap;
+} g_dc = { .enabled = 0, .gen = 1, .file_gen = 1, .ifd = -1 };
+
+
+// ---- Internal helpers ----
+
+static uint64_t fnv1a_64(const char *s) {
+	const unsigned char *p = (const unsigned char *)s;
+	uint64_t h = 1469598103934665603ull;
+	while (*p) {
+		h ^= (uint64_t)*p++;
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+static size_t round_pow2(size_t n) {
+	size_t p = DCACHE_STRIPES;
+	while (p < n) p <<= 1;
+	return p;
+}
+
+/* Our own upload temp files (".name.tmp.XXXXXX") come and go on every PUT;
+   only the final rename changes what a URL resolves to. */
+static int is_upload_temp(const char *name) {
+	return name[0] == '.' && strstr(name, ".tmp.") != NULL;
+}
+
+static void wd_remember(int wd, const char *path) {
+	if (wd < 0) return;
+	if ((size_t)wd >= g_dc.wd_cap) {
+		size_t ncap = g_dc.wd_cap ? g_dc.wd_cap : 64;
+		while (ncap <= (size_t)wd) ncap *= 2;
+		char **np = (char **)realloc(g_dc.wd_paths, ncap * sizeof(*np));
+		if (!np) return;
+		memset(np + g_dc.wd_cap, 0, (ncap - g_dc.wd_cap) * sizeof(*np));
+		g_dc.wd_paths = np;
+		g_dc.wd_cap = ncap;
+	}
+	free(g_dc.wd_paths[wd]);
+	g_dc.wd_paths[wd] = strdup(path);
+}
+
+static void wd_forget(int wd) {
+	if (wd < 0 || (size_t)wd >= g_dc.wd_cap) return;
+	free(g_dc.wd_paths[wd]);
+	g_dc.wd_paths[wd] = NULL;
+}
+
+/* Add a watch on 'dir' and (recursively) on every subdirectory below it.
+   IN_CLOSE_WRITE is not a namespace change: it only bumps the file
+   generation (a file edited in place). */
+static int watch_tree(const char *dir, int depth) {
+	const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+	                      IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+	int wd = inotify_add_watch(g_dc.ifd, dir, mask);
+	if (wd < 0) return -1;
+	wd_remember(wd, dir);
+
+	if (depth >= DCACHE_MAX_DEPTH) return 0;
+
+	DIR *d = opendir(dir);
+	if (!d) return 0;
+	struct dirent *de;
+	while ((de = readdir(d)) != NULL) {
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) continue;
+		if (de->d_type == DT_UNKNOWN) {   // filesystems without d_type: ask
+			struct stat st;
+			if (fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISDIR(st.st_mode))
+				continue;
+		} else if (de->d_type != DT_DIR) {
+			continue;
+		}
+		char child[PATH_MAX];
+		int n = snprintf(child, sizeof(child), "%s/%s", dir, de->d_name);
+		if (n < 0 || (size_t)n >= sizeof(child)) continue;
+		(void)watch_tree(child, depth + 1);
+	}
+	closedir(d);
+	return 0;
+}
+
+static void *watcher_main(void *arg) {
+	(void)arg;
+	/* Buffer aligned for struct inotify_event, per inotify(7). */
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+	for (;;) {
+		ssize_t n = read(g_dc.ifd, buf, sizeof(buf));
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		for (char *p = buf; p < buf + n; ) {
+			const struct inotify_event *ev = (const struct inotify_event *)p;
+			p += sizeof(*ev) + ev->len;
+
+			if (ev->mask & IN_Q_OVERFLOW) {
+				dcache_invalidate();
+				if (g_dc.hook) g_dc.hook(NULL, NULL);
+				continue;
+			}
+			if (ev->mask & IN_IGNORED)    { wd_forget(ev->wd); continue; }
+
+			int isdir = (ev->mask & IN_ISDIR) != 0;
+			if (ev->mask & IN_CLOSE_WRITE) {
+				// Contents changed, not names: entries and the hook stay as they are.
+				if (!(ev->len && is_upload_temp(ev->name))) {
+					__atomic_add_fetch(&g_dc.file_gen, 1, __ATOMIC_ACQ_REL);
+					__atomic_add_fetch(&g_dc.edits, 1, __ATOMIC_RELAXED);
+				}
+				continue;
+			}
+			if (!isdir && ev->len && is_upload_temp(ev->name) &&
+			    (ev->mask & (IN_CREATE | IN_DELETE | IN_ATTRIB)))
+				continue;
+
+			dcache_invalidate();
+			if (g_dc.hook && ev->wd >= 0 && (size_t)ev->wd < g_dc.wd_cap && g_dc.wd_paths[ev->wd])
+				g_dc.hook(g_dc.wd_paths[ev->wd], ev->len ? ev->name : "");
+
+			if (isdir && ev->len && (ev->mask & (IN_CREATE | IN_MOVED_TO)) &&
+			    ev->wd >= 0 && (size_t)ev->wd < g_dc.wd_cap && g_dc.wd_paths[ev->wd]) {
+				char child[PATH_MAX];
+				int m = snprintf(child, sizeof(child), "%s/%s",
+				                 g_dc.wd_paths[ev->wd], ev->name);
+				if (m > 0 && (size_t)m < sizeof(child))
+					(void)watch_tree(child, 1);
+			}
+		}
+	}
+
+	/* Watcher died: we can no longer trust negative entries. */
+	__atomic_store_n(&g_dc.enabled, 0, __ATOMIC_RELEASE);
+	if (g_dc.hook) g_dc.hook(NULL, NULL);
+	return NULL;
+}
+
+
+static void free_table(struct dc_ent *ents, size_t mask) {
+	for (size_t i = 0; i <= mask; i++) free(ents[i].blk);
+	free(ents);
+}
+
+
+//----- API ----------
+
+int dcache_init(size_t nentries) {
+	if (nentries == 0) return 0;   // disabled
+	size_t cap = round_pow2(nentries);
+	g_dc.ents = (struct dc_ent *)calloc(cap, sizeof(struct dc_ent));
+	if (!g_dc.ents) { errno = ENOMEM; return -1; }
+	g_dc.mask = cap - 1;
+	for (unsigned i = 0; i < DCACHE_STRIPES; i++)
+		pthread_mutex_init(&g_dc.locks[i], NULL);
+	return 0;
+}
+
+int dcache_watch(const char *docroot_real) {
+	if (!g_dc.ents || !docroot_real) return -1;
+
+	g_dc.ifd = inotify_init1(IN_CLOEXEC);
+	if (g_dc.ifd < 0) return -1;
+	if (watch_tree(docroot_real, 0) < 0) {
+		int e = errno; close(g_dc.ifd); g_dc.ifd = -1; errno = e;
+		return -1;
+	}
+
+	pthread_t tid;
+	if (pthread_create(&tid, NULL, watcher_main, NULL) != 0) {
+		close(g_dc.ifd); g_dc.ifd = -1;
+		return -1;
+	}
+	pthread_detach(tid);
+
+	__atomic_store_n(&g_dc.enabled, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int dcache_resize(size_t nentries) {
+	if (!g_dc.ents || nentries == 0) { errno = EINVAL; return -1; }
+	size_t cap = round_pow2(nentries);
+	if (cap == g_dc.mask + 1) return 0;
+	struct dc_ent *ents = (struct dc_ent *)calloc(cap, sizeof(struct dc_ent));
+	if (!ents) { errno = ENOMEM; return -1; }
+
+	for (unsigned i = 0; i < DCACHE_STRIPES; i++) pthread_mutex_lock(&g_dc.locks[i]);
+	struct dc_ent *old = g_dc.ents;
+	size_t old_mask = g_dc.mask;
+	g_dc.ents = ents;     // starts empty: entries are cheap to re-resolve
+	g_dc.mask = cap - 1;
+	for (unsigned i = DCACHE_STRIPES; i > 0; i--) pthread_mutex_unlock(&g_dc.locks[i - 1]);
+
+	free_table(old, old_mask);
+	return 0;
+}
+
+void dcache_set_change_hook(void (*fn)(const char *dir, const char *name)) {
+	g_dc.hook = fn;
+}
+
+int dcache_watched(void) {
+	return __atomic_load_n(&g_dc.enabled, __ATOMIC_ACQUIRE);
+}
+
+size_t dcache_capacity(void) {
+	return g_dc.ents ? g_dc.mask + 1 : 0;
+}
+
+void dcache_destroy(void) {
+	__atomic_store_n(&g_dc.enabled, 0, __ATOMIC_RELEASE);
+	if (!g_dc.ents) return;
+	free_table(g_dc.ents, g_dc.mask);
+	g_dc.ents = NULL;
+	for (unsigned i = 0; i < DCACHE_STRIPES; i++)
+		pthread_mutex_destroy(&g_dc.locks[i]);
+}
+
+uint64_t dcache_generation(void) {
+	return __atomic_load_n(&g_dc.gen, __ATOMIC_ACQUIRE);
+}
+
+uint64_t dcache_file_generation(void) {
+	return __atomic_load_n(&g_dc.file_gen, __ATOMIC_ACQUIRE);
+}
+
+uint64_t dcache_edits(void) {
+	return __atomic_load_n(&g_dc.edits, __ATOMIC_RELAXED);
+}
+
+void dcache_invalidate(void) {
+	__atomic_add_fetch(&g_dc.gen, 1, __ATOMIC_ACQ_REL);
+	__atomic_add_fetch(&g_dc.file_gen, 1, __ATOMIC_ACQ_REL);
+}
+
+int dcache_lookup(const char *key, char *out, size_t outlen) {
+	if (!key || !__atomic_load_n(&g_dc.enabled, __ATOMIC_ACQUIRE)) return DC_MISS;
+
+	const uint64_t h   = fnv1a_64(key);
+	const uint64_t gen = dcache_generation();
+	int kind = DC_MISS;
+
+	pthread_mutex_t *m = &g_dc.locks[h % DCACHE_STRIPES];
+	pthread_mutex_lock(m);
+	struct dc_ent *e = &g_dc.ents[(size_t)h & g_dc.mask];
+	if (e->gen == gen && e->hash == h && strcmp(e->key, key) == 0) {
+		size_t plen = strlen(e->path);
+		if (plen + 1 <= outlen) {
+			memcpy(out, e->path, plen + 1);
+			kind = e->kind;
+		}
+	}
+	pthread_mutex_unlock(m);
+	return kind;
+}
+
+void dcache_store(const char *key, int kind, const char *canon, uint64_t gen) {
+	if (!key || kind == DC_MISS || !__atomic_load_n(&g_dc.enabled, __ATOMIC_ACQUIRE)) return;
+	if (!canon) canon = "";
+
+	const uint64_t h   = fnv1a_64(key);
+	const size_t   kl  = strlen(key) + 1;
+	const size_t   pl  = strlen(canon) + 1;
+
+	pthread_mutex_t *m = &g_dc.locks[h % DCACHE_STRIPES];
+	pthread_mutex_lock(m);
+	struct dc_ent *e = &g_dc.ents[(size_t)h & g_dc.mask];
+	if (e->cap < kl + pl) {
+		char *nb = (char *)realloc(e->blk, kl + pl);
+		if (!nb) { pthread_mutex_unlock(m); return; }
+		e->blk = nb;
+		e->cap = kl + pl;
+	}
+	e->key  = e->blk;
+	e->path = e->blk + kl;
+	memcpy(e->key, key, kl);
+	memcpy(e->path, canon, pl);
+	e->hash = h;
+	e->kind = kind;
+	e->gen  = gen;   // stale on arrival if the namespace changed meanwhile
+	pthread_mutex_unlock(m);
+}
+
+size_t dcache_foreach(int (*fn)(const char *key, void *ctx), void *ctx) {
+	if (!__atomic_load_n(&g_dc.enabled, __ATOMIC_ACQUIRE)) return 0;
+	const uint64_t gen = dcache_generation();
+	size_t n = 0;
+	int stop = 0;
+	// Slot i belongs to stripe i % DCACHE_STRIPES; holding a stripe also
+	// pins the table against dcache_resize().
+	for (unsigned s = 0; s < DCACHE_STRIPES && !stop; s++) {
+		pthread_mutex_lock(&g_dc.locks[s]);
+		for (size_t i = s; i <= g_dc.mask && !stop; i += DCACHE_STRIPES) {
+			const struct dc_ent *e = &g_dc.ents[i];
+			if (e->gen != gen || e->kind == DC_NOENT || e->kind == DC_FORBIDDEN) continue;
+			n++;
+			stop = fn(e->key, ctx) != 0;
+		}
+		pthread_mutex_unlock(&g_dc.locks[s]);
+	}
+	return n;
+}
@@ -0,0 +1,83 @@
+#ifndef MYHTTP_DCACHE_H
+#define MYHTTP_DCACHE_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+/* Bounded cache of path-resolution results: decoded URL path -> outcome of
+   fs_join_safe() + fs_is_dir() + fs_try_index(). Negative results are cached
+   too, so repeated 404s cost one hash probe.
+
+   Every entry is stamped with the generation it was resolved under. Any
+   namespace change (inotify event or a write through fs.c) bumps the
+   generation, which invalidates all entries at once. */
+
+enum dcache_kind {
+	DC_MISS      = 0,   /* not cached (or stale) */
+	DC_FILE      = 1,   /* canonical path of a non-directory */
+	DC_INDEX     = 2,   /* directory; canonical path of its index.html */
+	DC_DIR       = 3,   /* directory without index -> listing */
+	DC_NOENT     = 4,   /* negative: does not exist */
+	DC_FORBIDDEN = 5    /* negative: escapes docroot / not permitted */
+};
+
+#ifndef DCACHE_ENTRIES
+#define DCACHE_ENTRIES 4096u   /* rounded up to a power of two (min 64); 0 disables */
+#endif
+
+/* Allocate the table. Returns 0 on success, -1 on error (errno set). */
+int  dcache_init(size_t nentries);
+
+/* Replace the table with an empty one of 'nentries' (rounded as above)
+   while lookups continue. The cache must have been enabled by dcache_init()
+   (EINVAL otherwise, or for 0). Returns 0, or -1 with errno set. */
+int  dcache_resize(size_t nentries);
+
+/* Slots in the table, 0 when disabled. */
+size_t dcache_capacity(void);
+
+/* Start an inotify watcher over 'docroot_real' that bumps the generation on
+   every namespace change, and the file generation also whenever a file
+   written to is closed. If the watcher cannot be started the cache is
+   disabled (lookups always miss). Returns 0 on success, -1 otherwise. */
+int  dcache_watch(const char *docroot_real);
+
+/* Have the watcher also report each change it sees: 'name' (possibly
+   empty) in directory 'dir', or (NULL, NULL) when changes may have been
+   missed. Set before dcache_watch(); called on the watcher thread. */
+void dcache_set_change_hook(void (*fn)(const char *dir, const char *name));
+
+/* Nonzero while the watcher is running (changes are being seen). */
+int  dcache_watched(void);
+
+/* Free the table (watcher thread is left to die with the process). */
+void dcache_destroy(void);
+
+/* Current generation; take it *before* resolving and pass it to store. */
+uint64_t dcache_generation(void);
+
+/* Bumped with the generation and also by every in-place edit the watcher
+   sees, for holders of file contents (hot pins) rather than of names. */
+uint64_t dcache_file_generation(void);
+
+/* In-place edits the watcher has seen (counted after the bump). */
+uint64_t dcache_edits(void);
+
+/* Invalidate every entry (O(1): bumps the generation). */
+void dcache_invalidate(void);
+
+/* Probe for 'key'. On a fresh hit returns its kind and, for positive kinds,
+   copies the canonical path into 'out'. Returns DC_MISS otherwise. */
+int  dcache_lookup(const char *key, char *out, size_t outlen);
+
+/* Record a resolution result computed under generation 'gen'.
+   'canon' may be NULL for negative kinds. */
+void dcache_store(const char *key, int kind, const char *canon, uint64_t gen);
+
+/* Call fn(key, ctx) for every fresh positive entry (the hot set, e.g. to
+   warm a successor's cache). Runs under the entry's stripe lock, so 'fn'
+   must not call back into the cache; a nonzero return stops the walk.
+   Returns the number of keys visited. */
+size_t dcache_foreach(int (*fn)(const char *key, void *ctx), void *ctx);
+
+#endif /* MYHTTP_DCACHE_H */
@@ -1,6 +1,15 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE       // realpath
 
+#include "fs.h"
 #include "pathlock.h"
+#include "dcache.h"
+#include "metrics.h"
+#include "arena.h"
+#include "bufpool.h"
+#include "iohint.h"
+#include "trace.h"
+#include "cas.h"
 #include <sys/types.h>
 #include <sys/socket.h>   // recv()
 #include <dirent.h>
@@ -40,6 +49,13 @@ static int write_all(int fd, const void *buf, size_t len) {
     return 0;
 }
 
+/* write_all() to the client socket, counted as bytes out. */
+static int send_all_counted(int client_fd, const void *buf, size_t len) {
+    if (write_all(client_fd, buf, len) < 0) return -1;
+    metrics_add_bytes_out(len);
+    return 0;
+}
+
 static const char* fs_get_ext_lower(const char *path, char *extbuf, size_t extbuflen) {
     if (!path || !extbuf || extbuflen == 0) { return NULL; }
 
@@ -55,10 +71,10 @@ static const char* fs_get_ext_lower(const char *path, char *extbuf, size_t extbu
     return extbuf;
 }
 
-int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
-                 char *out, size_t outlen)
+int fs_join_safe_arena(struct mh_arena *a, const char *docroot_real,
+                       const char *decoded_req_path, char *out, size_t outlen)
 {
-    if (!docroot_real || !out || outlen == 0) {
+    if (!a || !docroot_real || !out || outlen == 0) {
         errno = EINVAL; return -1;
     }
     if (docroot_real[0] != '/') {
@@ -67,16 +83,16 @@ int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
 
     if (!decoded_req_path) decoded_req_path = "";
 
+    /* All scratch below comes from 'a'; nothing is freed individually. */
+
     /* ---- Normalize into relative components (no "", ".", or "..") ---- */
     const char *p = decoded_req_path;
     while (*p == '/') p++;  /* skip leading slashes to make it relative */
 
     size_t comp_cap = strlen(p) + 1;
-    char **comps = comp_cap ? (char **)calloc(comp_cap, sizeof(char*)) : NULL;
-    if (comp_cap && !comps) { errno = ENOMEM; return -1; }
-
-    char *path_copy = strdup(p ? p : "");
-    if (!path_copy) { free(comps); errno = ENOMEM; return -1; }
+    char **comps = (char **)arena_alloc(a, comp_cap * sizeof(char*));
+    char *path_copy = arena_strdup(a, p);
+    if (!comps || !path_copy) { errno = ENOMEM; return -1; }
 
     size_t ncomps = 0;
     char *saveptr = NULL;
@@ -89,7 +105,7 @@ int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
         }
         if (tok[0] == '.' && tok[1] == '.' && tok[2] == '\0') {
             /* ".." -> pop if possible, else reject */
-            if (ncomps == 0) { free(comps); free(path_copy); errno = EINVAL; return -1; }
+            if (ncomps == 0) { errno = EINVAL; return -1; }
             ncomps--;
             continue;
         }
@@ -107,8 +123,8 @@ int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
 
     /* need = docroot + (optional '/' + rel) + NUL */
     size_t need = doclen + (rel_is_dot ? 0 : 1 + rel_len) + 1;
-    char *cand = (char *)malloc(need);
-    if (!cand) { free(comps); free(path_copy); errno = ENOMEM; return -1; }
+    char *cand = (char *)arena_alloc(a, need);
+    if (!cand) { errno = ENOMEM; return -1; }
 
     /* Populate cand */
     size_t pos = 0;
@@ -125,21 +141,22 @@ int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
         }
     }
     cand[pos] = '\0';
+    const size_t cand_len = pos;
 
     /* ---- Find deepest existing directory parent under/at docroot_real ---- */
     struct stat st;
-    char *parent = NULL;
-    char *tail   = NULL;
+    const char *parent = NULL;
+    const char *tail   = NULL;
 
-    char *probe = strdup(cand); /* we’ll insert temporary NULs */
-    if (!probe) { free(cand); free(comps); free(path_copy); errno = ENOMEM; return -1; }
+    char *probe = arena_strndup(a, cand, cand_len); /* we’ll insert temporary NULs */
+    if (!probe) { errno = ENOMEM; return -1; }
 
     size_t min_prefix = doclen;               /* never go above docroot_real */
-    ssize_t i = (ssize_t)strlen(probe);
+    ssize_t i = (ssize_t)cand_len;
     int found = 0;
 
     while (i >= (ssize_t)min_prefix) {
-        if (i == (ssize_t)strlen(probe) || probe[i] == '/') {
+        if (i == (ssize_t)cand_len || probe[i] == '/') {
             char saved = probe[i];
             probe[i] = '\0';
 
@@ -148,19 +165,16 @@ int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
                 break;
             }
             if (stat(probe, &st) == 0 && S_ISDIR(st.st_mode)) {
-                parent = strdup(probe);
-                probe[i] = saved;
-                if (!parent) { free(probe); free(cand); free(comps); free(path_copy); errno = ENOMEM; return -1; }
+                /* probe[0..i) is the parent; keep the NUL, probe is ours */
+                parent = probe;
 
                 /* Compute tail after this parent */
-                if ((size_t)i < strlen(cand)) {
+                if ((size_t)i < cand_len) {
                     size_t start = (saved == '/') ? (size_t)i + 1 : (size_t)i;
-                    tail = strdup(cand + start);
+                    tail = cand + start;
                 } else {
-                    tail = strdup("");
+                    tail = "";
                 }
-                if (!tail) { free(parent); free(probe); free(cand); free(comps); free(path_copy); errno = ENOMEM; return -1; }
-
                 found = 1;
                 break;
             }
@@ -172,38 +186,34 @@ int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
     if (!found) {
         /* Fall back to docroot_real as parent if it exists and is a directory */
         if (stat(docroot_real, &st) == 0 && S_ISDIR(st.st_mode)) {
-            parent = strdup(docroot_real);
-            if (!parent) { free(probe); free(cand); free(comps); free(path_copy); errno = ENOMEM; return -1; }
-            if ((size_t)doclen < strlen(cand)) {
+            parent = docroot_real;
+            if ((size_t)doclen < cand_len) {
                 size_t start = (cand[doclen] == '/') ? doclen + 1 : doclen;
-                tail = strdup(cand + start);
+                tail = cand + start;
             } else {
-                tail = strdup("");
+                tail = "";
             }
-            if (!tail) { free(parent); free(probe); free(cand); free(comps); free(path_copy); errno = ENOMEM; return -1; }
             found = 1;
         } else {
             /* docroot must exist & be a directory */
-            free(probe); free(cand); free(comps); free(path_copy);
             errno = ENOENT; return -1;
         }
     }
 
     /* ---- Canonicalize existing parent with realpath (resolves symlinks) ---- */
-    char canon_parent[PATH_MAX];
+    char *canon_parent = (char *)arena_alloc(a, PATH_MAX);
+    if (!canon_parent) { errno = ENOMEM; return -1; }
     if (!realpath(parent, canon_parent)) {
         int saved = errno;
-        free(parent); free(tail); free(probe); free(cand); free(comps); free(path_copy);
         errno = saved ? saved : EINVAL;
         return -1;
     }
 
     /* ---- Ensure resolved parent is inside docroot_real (no symlink escape) ---- */
-    size_t dl = strlen(docroot_real);
+    size_t dl = doclen;
     if (!(strncmp(canon_parent, docroot_real, dl) == 0 &&
           (canon_parent[dl] == '\0' || canon_parent[dl] == '/')))
     {
-        free(parent); free(tail); free(probe); free(cand); free(comps); free(path_copy);
         errno = EACCES; /* outside of docroot via symlinked parent */
         return -1;
     }
@@ -214,7 +224,6 @@ int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
     size_t final_len = cp_len + (tail_len ? 1 + tail_len : 0);
 
     if (final_len + 1 > outlen) {
-        free(parent); free(tail); free(probe); free(cand); free(comps); free(path_copy);
         errno = ENAMETOOLONG; return -1;
     }
 
@@ -227,12 +236,23 @@ int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
         dst += tail_len;
     }
     *dst = '\0';
-
-    /* ---- Cleanup & success ---- */
-    free(parent); free(tail); free(probe); free(cand); free(comps); free(path_copy);
     return 0;
 }
 
+int fs_join_safe(const char *docroot_real, const char *decoded_req_path,
+                 char *out, size_t outlen)
+{
+    /* One-shot callers (uploads, unlink): a zero-capacity arena spills every
+       allocation to the heap and frees it on destroy. */
+    struct mh_arena a;
+    if (arena_init(&a, 0) < 0) return -1;
+    int rc = fs_join_safe_arena(&a, docroot_real, decoded_req_path, out, outlen);
+    int saved = errno;
+    arena_destroy(&a);
+    errno = saved;
+    return rc;
+}
+
 int fs_is_dir(const char *abs_path) {
     	if (!abs_path) {
        		errno = EINVAL;
@@ -260,16 +280,14 @@ int fs_try_index(const char *dir_abs, const char *index_name, char *out, size_t
     	if (d == -1) return -1; // errno set by fs_is_dir (e.g., ENOENT/EACCES)
     	if (d == 0) { errno = ENOTDIR; return -1; }
 
-    	// BUILD CANIDATE
+    	// BUILD CANIDATE directly in 'out' (no heap on the request path)
     	size_t dlen = strlen(dir_abs);
     	size_t ilen = strlen(index_name);
     	bool need_slash = (dlen == 0 || dir_abs[dlen - 1] != '/');
     	size_t cand_len = dlen + (need_slash ? 1 : 0) + ilen;
+    	if (cand_len + 1 > outlen) { errno = ENAMETOOLONG; return -1; }
 
-    	char *cand = (char *)malloc(cand_len + 1);
-    	if (!cand) { errno = ENOMEM; return -1; }
-
-    	char *p = cand;
+    	char *p = out;
     	memcpy(p, dir_abs, dlen); p += dlen;
     	if (need_slash) *p++ = '/';
     	memcpy(p, index_name, ilen); p += ilen;
@@ -277,9 +295,9 @@ int fs_try_index(const char *dir_abs, const char *index_name, char *out, size_t
 
     	// CHECK STATUS OF CANIDATE
     	struct stat st;
-    	if (stat(cand, &st) == -1) {
+    	if (stat(out, &st) == -1) {
         	int saved = errno;
-        	free(cand);
+        	out[0] = '\0';
         	if (saved == ENOENT) {
             		return 0;
         	}
@@ -289,18 +307,9 @@ int fs_try_index(const char *dir_abs, const char *index_name, char *out, size_t
 
     	if (!S_ISREG(st.st_mode)) {
         	// Present but not a regular file (treat as "not found" for an index)
-        	free(cand);
+        	out[0] = '\0';
 	        return 0;
 	}
-
-    	// COPY ABSOLUTE PATH TO OUT
-    	if (cand_len + 1 > outlen) {
-        	free(cand);
-        	errno = ENAMETOOLONG;
-        	return -1;
-    	}
-    	memcpy(out, cand, cand_len + 1);
-    	free(cand);
     	return 1;
 }
 
@@ -363,7 +372,17 @@ const char* fs_mime_from_path(const char *abs_path) {
 	return "application/octet-stream";
 }
 
-int fs_send_dir_listing(int client_fd, const char *dir_abs, const char *req_path_display) {
+static int sock_sink(void *ctx, const void *buf, size_t len) {
+    return send_all_counted(*(const int *)ctx, buf, len);
+}
+
+int fs_send_dir_listing(struct mh_arena *a, int client_fd, const char *dir_abs,
+                        const char *req_path_display) {
+    return fs_dir_listing(a, dir_abs, req_path_display, sock_sink, &client_fd);
+}
+
+int fs_dir_listing(struct mh_arena *a, const char *dir_abs, const char *req_path_display,
+                   fs_sink_fn sink, void *ctx) {
     DIR *dir = opendir(dir_abs);
     if (!dir) return -1;
 
@@ -372,69 +391,108 @@ int fs_send_dir_listing(int client_fd, const char *dir_abs, const char *req_path
     const char *mid = "</title></head><body><h1>Index of ";
     const char *ul  = "</h1><ul>\n";
 
-    char esc[PATH_MAX];
-    html_escape((req_path_display && *req_path_display) ? req_path_display : "/", esc, sizeof(esc));
-
-    char head[1024];
-    int n = snprintf(head, sizeof(head), "%s%s%s%s", hdr, esc, mid, esc);
-    if (n < 0 || (size_t)n >= sizeof(head)) { closedir(dir); errno = ENOMEM; return -1; }
-    if (write_all(client_fd, head, (size_t)n) < 0) { int e=errno; closedir(dir); errno=e; return -1; }
-    if (write_all(client_fd, ul, strlen(ul)) < 0)  { int e=errno; closedir(dir); errno=e; return -1; }
-
+    /* Scratch comes from the request arena; per-entry buffers are released
+       back to 'entry_mark' after each line. */
+    char *esc  = (char *)arena_alloc(a, PATH_MAX);
+    char *head = (char *)arena_alloc(a, 2 * PATH_MAX + 128);
+    if (!esc || !head) { closedir(dir); errno = ENOMEM; return -1; }
+    html_escape((req_path_display && *req_path_display) ? req_path_display : "/", esc, PATH_MAX);
+    const size_t esc_len = strlen(esc);
+    const char *esc_sep = (esc_len && esc[esc_len - 1] == '/') ? "" : "/";
+    const size_t dir_len = strlen(dir_abs);
+    const char *dir_sep = (dir_len && dir_abs[dir_len - 1] == '/') ? "" : "/";
+
+    int n = snprintf(head, 2 * PATH_MAX + 128, "%s%s%s%s", hdr, esc, mid, esc);
+    if (n < 0 || (size_t)n >= 2 * PATH_MAX + 128) { closedir(dir); errno = ENOMEM; return -1; }
+    if (sink(ctx, head, (size_t)n) < 0) { int e=errno; closedir(dir); errno=e; return -1; }
+    if (sink(ctx, ul, strlen(ul)) < 0)  { int e=errno; closedir(dir); errno=e; return -1; }
+
+    const size_t entry_mark = arena_mark(a);
     struct dirent *de;
     while ((de = readdir(dir)) != NULL) {
         const char *name = de->d_name;
         if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
 
-        char child_abs[PATH_MAX];
-        snprintf(child_abs, sizeof(child_abs), "%s%s%s",
-                 dir_abs, (dir_abs[strlen(dir_abs)-1] == '/' ? "" : "/"), name);
+        arena_release(a, entry_mark);
+        char *child_abs = (char *)arena_alloc(a, PATH_MAX);
+        char *escname   = (char *)arena_alloc(a, PATH_MAX);
+        char *line      = (char *)arena_alloc(a, PATH_MAX + 128 + esc_len);
+        if (!child_abs || !escname || !line) { closedir(dir); errno = ENOMEM; return -1; }
+
+        snprintf(child_abs, PATH_MAX, "%s%s%s", dir_abs, dir_sep, name);
 
         struct stat st_child;
         int is_dir = (stat(child_abs, &st_child) == 0 && S_ISDIR(st_child.st_mode));
 
-        char escname[PATH_MAX];
-        html_escape(name, escname, sizeof(escname));
+        html_escape(name, escname, PATH_MAX);
 
-        char line[PATH_MAX + 128];
-        int m = snprintf(line, sizeof(line),
+        size_t line_cap = PATH_MAX + 128 + esc_len;
+        int m = snprintf(line, line_cap,
                          "<li><a href=\"%s%s%s\">%s%s</a></li>\n",
                          esc,
-                         (esc[strlen(esc)-1] == '/' ? "" : "/"),
+                         esc_sep,
                          escname,
                          escname,
                          (is_dir ? "/" : ""));
-        if (m < 0 || (size_t)m >= sizeof(line)) continue;
-        if (write_all(client_fd, line, (size_t)m) < 0) { int e=errno; closedir(dir); errno=e; return -1; }
+        if (m < 0 || (size_t)m >= line_cap) continue;
+        if (sink(ctx, line, (size_t)m) < 0) { int e=errno; closedir(dir); errno=e; return -1; }
     }
+    arena_release(a, entry_mark);
 
     const char *footer = "</ul></body></html>\n";
-    write_all(client_fd, footer, strlen(footer));
+    sink(ctx, footer, strlen(footer));
     closedir(dir);
     return 0;
 }
 
-static int copy_exact_from_sock(int sock_fd, int dst_fd, size_t len) {
-    char buf[64 * 1024];
+static ssize_t sock_source(void *ctx, void *buf, size_t len) {
+    for (;;) {
+        ssize_t r = recv(*(const int *)ctx, buf, len, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r > 0) metrics_add_bytes_in((size_t)r);
+        return r;
+    }
+}
+
+static ssize_t fd_source(void *ctx, void *buf, size_t len) {
+    for (;;) {
+        ssize_t r = read(*(const int *)ctx, buf, len);
+        if (r < 0 && errno == EINTR) continue;
+        return r;
+    }
+}
+
+/* 'hs' (may be NULL) also gets every byte copied. A hashed body gets no
+   write-behind: until its digest is checked it may turn out to be a copy
+   of a stored blob, and then it is dropped without ever reaching disk. */
+static int copy_exact_from_source(fs_source_fn src, void *src_ctx, int dst_fd, size_t len,
+                                  struct cas_hash *hs) {
+    if (len == 0) return 0;
+    size_t cap;
+    char *buf = (char *)bufpool_get(len < BUFPOOL_LARGE ? len : BUFPOOL_LARGE, &cap);
+    if (!buf) return -1;
+    int rc = 0;
     size_t left = len;
+    struct iohint_write wb;   // keep dirty pages bounded while streaming
+    iohint_write_begin(&wb, dst_fd);
+    if (hs) wb.win = 0;
     while (left) {
-	printf("L: %ld\n", left);
-        size_t want = left < sizeof(buf) ? left : sizeof(buf);
-	printf("want:%ld\n", want);
-        ssize_t r = recv(sock_fd, buf, want, 0);
-	printf("sock:%d\n", sock_fd);
-	printf("WRITING: %s\n", buf);
-	if (r <= 0) {
-            if (r < 0 && errno == EINTR) continue;
+        size_t want = left < cap ? left : cap;
+        ssize_t r = src(src_ctx, buf, want);
+        if (r <= 0) {
             errno = (r == 0) ? EIO : errno;
-	    printf("! WRITE ERROR AT SOCKET LEVEL: %ld\n", r);
-            return -1;
+            rc = -1;
+            break;
         }
-        if (write_all(dst_fd, buf, (size_t)r) < 0) return -1;
+        if (write_all(dst_fd, buf, (size_t)r) < 0) { rc = -1; break; }
+        if (hs) cas_hash_update(hs, buf, (size_t)r);
+        iohint_write_done(&wb, (size_t)r);
         left -= (size_t)r;
-	printf("INFORMATION LEFT: %ld\n", left);
     }
-    return 0;
+    int saved = errno;
+    bufpool_put(buf, cap);
+    errno = saved;
+    return rc;
 }
 
 /*
@@ -468,75 +526,250 @@ static int open_temp_sibling(const char *dst_abs, char *tmp_out, size_t tmp_out_
     return fd;                  // caller unlinks on error paths
 }
 
-/*
- * Returns:
- *    1  -> created new file
- *    0  -> overwrote existing file
- *   -1  -> error, errno set
- *
- * Guarantees exactly 'content_len' bytes are written:
- * - first 'prefill_len' bytes from 'prefill' (already in memory),
- * - then the remaining bytes drained from 'client_fd'.
- */
-int fs_put_from_socket_atomic_prefill(const char *docroot_real,
-                                      const char *decoded_req_path,
-                                      int client_fd,
-                                      size_t content_len,
-                                      const void *prefill,
-                                      size_t prefill_len)
-{
-    if (prefill_len > content_len) { errno = EPROTO; return -1; }
-
-    char dst_abs[PATH_MAX];
-    if (fs_join_safe(docroot_real, decoded_req_path, dst_abs, sizeof(dst_abs)) < 0)
-        return -1;
+static void atomic_max_u64(uint64_t *p, uint64_t v) {
+    uint64_t cur = __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    while (cur < v &&
+           !__atomic_compare_exchange_n(p, &cur, v, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        ;
+}
 
-    // Exclusive writer lock per path
-    if (plock_acquire_wr(dst_abs) != 0)
+int fs_put_begin(struct fs_put *p, const char *docroot_real,
+                 const char *decoded_req_path, size_t content_len)
+{
+    if (fs_join_safe(docroot_real, decoded_req_path, p->dst, sizeof(p->dst)) < 0)
         return -1;
+    p->len = content_len;
+    p->wake = NULL;
+    p->hashing = content_len > 0 && cas_enabled() && cas_hash_init(&p->hs) == 0;
 
-    int rc = -1;
-    int existed = 0;
-    struct stat st;
-    if (stat(dst_abs, &st) == 0) existed = 1;
+    // Keep the per-path entry alive; take its lock only to publish
+    p->lk = plock_ref(p->dst);
+    if (!p->lk) goto fail;
+    p->ticket = __atomic_add_fetch(&p->lk->wr_seq, 1, __ATOMIC_ACQ_REL);
 
     // Disallow directories as target
-    if (existed && S_ISDIR(st.st_mode)) { errno = EISDIR; goto out_unlock; }
+    struct stat st;
+    if (stat(p->dst, &st) == 0 && S_ISDIR(st.st_mode)) { errno = EISDIR; goto fail_unref; }
 
     // Create temp sibling
-    char tmp_path[PATH_MAX];
-    int tmpfd = open_temp_sibling(dst_abs, tmp_path, sizeof(tmp_path));
-    if (tmpfd < 0) goto out_unlock;
+    p->tmpfd = open_temp_sibling(p->dst, p->tmp, sizeof(p->tmp));
+    if (p->tmpfd < 0) goto fail_unref;
+    return 0;
+
+fail_unref:;
+    int e = errno;
+    plock_unref(p->lk);
+    errno = e;
+fail:
+    if (p->hashing) cas_hash_abort(&p->hs);
+    return -1;
+}
+
+int fs_put_body(struct fs_put *p, fs_source_fn src, void *src_ctx,
+                const void *prefill, size_t prefill_len)
+{
+    if (prefill_len > p->len) { fs_put_abort(p); errno = EPROTO; return -1; }
 
     // 1) write prefill (if any)
     if (prefill_len) {
-        if (write_all(tmpfd, prefill, prefill_len) < 0) {
-            int e = errno; close(tmpfd); unlink(tmp_path); errno = e; goto out_unlock;
+        if (write_all(p->tmpfd, prefill, prefill_len) < 0) {
+            int e = errno; fs_put_abort(p); errno = e; return -1;
         }
+        if (p->hashing) cas_hash_update(&p->hs, prefill, prefill_len);
     }
 
-    // 2) drain the remainder from the socket
-    size_t left = content_len - prefill_len;
+    // 2) drain the remainder from the source
+    size_t left = p->len - prefill_len;
     if (left) {
-        if (copy_exact_from_sock(client_fd, tmpfd, left) < 0) {
-            int e = errno; close(tmpfd); unlink(tmp_path); errno = e; goto out_unlock;
+        const uint64_t tr = trace_begin(TR_BODY);
+        int ok = copy_exact_from_source(src, src_ctx, p->tmpfd, left, p->hashing ? &p->hs : NULL);
+        trace_end(TR_BODY, tr);
+        if (ok < 0) { int e = errno; fs_put_abort(p); errno = e; return -1; }
+    }
+
+    // 3) announce completion: older uploads still streaming are superseded
+    atomic_max_u64(&p->lk->wr_done, p->ticket);
+    return 0;
+}
+
+void fs_put_abort(struct fs_put *p)
+{
+    close(p->tmpfd);
+    unlink(p->tmp);
+    plock_unref(p->lk);
+    if (p->hashing > 0) cas_hash_abort(&p->hs);
+}
+
+/* Blocking fs_put_publish(): the waiter sleeps here until woken. */
+static pthread_mutex_t g_wake_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_wake_cv  = PTHREAD_COND_INITIALIZER;
+
+static void put_wake_sync(struct fs_put *p) {
+    pthread_mutex_lock(&g_wake_mtx);
+    p->woken = 1;
+    pthread_cond_broadcast(&g_wake_cv);
+    pthread_mutex_unlock(&g_wake_mtx);
+}
+
+static int put_publish(struct fs_put *p)
+{
+    struct path_lock *lk = p->lk;
+    const uint64_t ticket = p->ticket;
+    int rc = -1;
+    struct stat st;
+
+    // Contend for the right to publish
+    if (plock_lock_wr(lk) != 0) {
+        int e = errno; fs_put_abort(p); errno = e; return -1;
+    }
+
+    if (lk->wr_published > ticket) {
+        // Superseded, and the newer upload is in place: nothing to flush or rename.
+        close(p->tmpfd);
+        unlink(p->tmp);
+        rc = lk->wr_created;
+        plock_unlock(lk);
+        plock_unref(lk);
+        return rc;
+    }
+    const uint64_t done = __atomic_load_n(&lk->wr_done, __ATOMIC_ACQUIRE);
+    if (done > ticket && done != lk->wr_failed) {
+        // A newer upload finished streaming and is on its way: its outcome
+        // decides ours. Keep this body in case it fails.
+        p->woken = 0;
+        p->next_waiter = lk->wr_waiters;
+        lk->wr_waiters = p;
+        plock_unlock(lk);
+        return FS_PUT_WAITING;
+    }
+
+    int existed = (stat(p->dst, &st) == 0);
+
+    // 4a) bytes already in the content store: link the stored copy into
+    //     place and drop this one unflushed
+    unsigned char digest[CAS_DIGEST_LEN];
+    if (p->hashing) {
+        cas_hash_final(&p->hs, digest);
+        p->hashing = 0;
+        char lnk[PATH_MAX];
+        if (snprintf(lnk, sizeof(lnk), "%s.cas", p->tmp) < (int)sizeof(lnk) &&
+            cas_link(digest, p->len, lnk) == 0) {
+            int renamed = rename(lnk, p->dst);
+            int e = errno;
+            unlink(lnk);            // still there if dst already was the blob
+            close(p->tmpfd);
+            unlink(p->tmp);
+            if (renamed < 0) { errno = e; goto out_failed; }
+            goto out_published;
         }
+        p->hashing = -1;            // store this one once it is durable
     }
 
-    // 3) flush + close + atomic rename
-    if (fsync(tmpfd) < 0) { int e = errno; close(tmpfd); unlink(tmp_path); errno = e; goto out_unlock; }
-    if (close(tmpfd)  < 0) { int e = errno;              unlink(tmp_path); errno = e; goto out_unlock; }
-    if (rename(tmp_path, dst_abs) < 0) {
-        int e = errno; unlink(tmp_path); errno = e; goto out_unlock;
+    // 4) flush + close + atomic rename
+    uint64_t tr = trace_begin(TR_FSYNC);
+    int synced = fsync(p->tmpfd);
+    trace_end(TR_FSYNC, tr);
+    if (synced < 0) { int e = errno; close(p->tmpfd); unlink(p->tmp); errno = e; goto out_failed; }
+    if (close(p->tmpfd) < 0) { int e = errno;         unlink(p->tmp); errno = e; goto out_failed; }
+    tr = trace_begin(TR_RENAME);
+    int renamed = rename(p->tmp, p->dst);
+    trace_end(TR_RENAME, tr);
+    if (renamed < 0) {
+        int e = errno; unlink(p->tmp); errno = e; goto out_failed;
     }
+    if (p->hashing < 0) cas_store(digest, p->dst);
 
+out_published:
+    lk->wr_published = ticket;
+    lk->wr_created = !existed;
+    if (!existed) dcache_invalidate();
     rc = existed ? 0 : 1;
+    goto out_unlock;
+
+out_failed:
+    if (ticket > lk->wr_failed) lk->wr_failed = ticket;
+
+out_unlock:;
+    // Older uploads waiting on this one look again: done, or their turn.
+    struct fs_put *w = lk->wr_waiters;
+    lk->wr_waiters = NULL;
+    int e = errno;
+    plock_unlock(lk);
+    plock_unref(lk);
+    while (w) {
+        struct fs_put *next = w->next_waiter;   // w is its owner's once woken
+        w->wake(w);
+        w = next;
+    }
+    errno = e;
+    return rc;
+}
 
-out_unlock:
-    plock_release(dst_abs);
+int fs_put_publish(struct fs_put *p)
+{
+    if (p->wake) return put_publish(p);
+
+    p->wake = put_wake_sync;
+    int rc;
+    while ((rc = put_publish(p)) == FS_PUT_WAITING) {
+        pthread_mutex_lock(&g_wake_mtx);
+        while (!p->woken) pthread_cond_wait(&g_wake_cv, &g_wake_mtx);
+        pthread_mutex_unlock(&g_wake_mtx);
+    }
+    p->wake = NULL;
     return rc;
 }
 
+/*
+ * Returns:
+ *    1  -> created new file
+ *    0  -> overwrote existing file
+ *   -1  -> error, errno set
+ *
+ * Guarantees exactly 'content_len' bytes are consumed:
+ * - first 'prefill_len' bytes from 'prefill' (already in memory),
+ * - then the remaining bytes drained from 'src'.
+ *
+ * Concurrent PUTs to the same path are coalesced, last writer wins: each
+ * upload takes a ticket on arrival and streams into its own temp file
+ * without holding the path lock. Only the newest upload that has finished
+ * streaming is fsync'd and renamed into place; older ones find themselves
+ * superseded, wait until it is in place and discard their temp file (their
+ * bytes would have been overwritten anyway), answering as it did. Should
+ * it fail, they publish their own instead. A burst of N writers costs
+ * ~1 fsync instead of N.
+ *
+ * With a content store (cas.h) the body is hashed on the way in; a body
+ * already stored is linked into place from the store without an fsync,
+ * and a new one is stored once it is published.
+ */
+int fs_put_from_source_atomic_prefill(const char *docroot_real,
+                                      const char *decoded_req_path,
+                                      fs_source_fn src, void *src_ctx,
+                                      size_t content_len,
+                                      const void *prefill,
+                                      size_t prefill_len)
+{
+    if (prefill_len > content_len) { errno = EPROTO; return -1; }
+
+    struct fs_put p;
+    if (fs_put_begin(&p, docroot_real, decoded_req_path, content_len) < 0) return -1;
+    if (fs_put_body(&p, src, src_ctx, prefill, prefill_len) < 0) return -1;
+    return fs_put_publish(&p);
+}
+
+int fs_put_from_socket_atomic_prefill(const char *docroot_real,
+                                      const char *decoded_req_path,
+                                      int client_fd,
+                                      size_t content_len,
+                                      const void *prefill,
+                                      size_t prefill_len)
+{
+    return fs_put_from_source_atomic_prefill(docroot_real, decoded_req_path,
+                                             sock_source, &client_fd, content_len,
+                                             prefill, prefill_len);
+}
+
 /* Back-compat wrapper: old call sites can keep using the original name/signature */
 int fs_put_from_socket_atomic(const char *docroot_real,
                               const char *decoded_req_path,
@@ -548,44 +781,101 @@ int fs_put_from_socket_atomic(const char *docroot_real,
                                              NULL, 0);
 }
 
-int fs_append_from_socket(const char *docroot_real,
-                          const char *decoded_req_path,
-                          int client_fd, size_t content_len)
+/* A file hard-linked from the content store (cas.h) is replaced by a
+   copy of itself before it is appended to, so the stored blob and the
+   other paths holding it keep their bytes. */
+static int unshare_file(const char *abs) {
+    struct stat st;
+    if (stat(abs, &st) < 0 || !S_ISREG(st.st_mode) || st.st_nlink < 2) return 0;
+
+    char tmp_path[PATH_MAX];
+    int out = open_temp_sibling(abs, tmp_path, sizeof(tmp_path));
+    if (out < 0) return -1;
+    int in = open(abs, O_RDONLY | O_CLOEXEC);
+    int rc = in < 0 ? -1 : copy_exact_from_source(fd_source, &in, out, (size_t)st.st_size, NULL);
+    int e = errno;
+    if (in >= 0) close(in);
+    if (rc == 0 && fchmod(out, st.st_mode & 07777) < 0) { rc = -1; e = errno; }
+    if (close(out) < 0 && rc == 0) { rc = -1; e = errno; }
+    if (rc == 0 && rename(tmp_path, abs) < 0) { rc = -1; e = errno; }
+    if (rc < 0) { unlink(tmp_path); errno = e; }
+    return rc;
+}
+
+int fs_append_from_source_prefill(const char *docroot_real,
+                                  const char *decoded_req_path,
+                                  fs_source_fn src, void *src_ctx,
+                                  size_t content_len,
+                                  const void *prefill, size_t prefill_len)
 {
+    if (prefill_len > content_len) { errno = EPROTO; return -1; }
+
     char abs[PATH_MAX];
     if (fs_join_safe(docroot_real, decoded_req_path, abs, sizeof(abs)) < 0) return -1;
-    printf("\nWriting to %s\n", abs);
-    if (plock_acquire_wr(abs) != 0) return -1;
+    struct path_lock *lk = plock_acquire_wr(abs);
+    if (!lk) return -1;
 
+    if (cas_enabled() && unshare_file(abs) < 0) { int e = errno; plock_release(lk); errno = e; return -1; }
     int fd = open(abs, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
-    if (fd < 0) { int e = errno; plock_release(abs); errno = e; return -1; }
-
-    int ok = copy_exact_from_sock(client_fd, fd, content_len);
+    if (fd < 0) { int e = errno; plock_release(lk); errno = e; return -1; }
+
+    int ok = 0;
+    if (prefill_len) ok = write_all(fd, prefill, prefill_len);
+    if (ok == 0 && content_len > prefill_len) {
+        const uint64_t tr = trace_begin(TR_BODY);
+        ok = copy_exact_from_source(src, src_ctx, fd, content_len - prefill_len, NULL);
+        trace_end(TR_BODY, tr);
+    }
     int e  = ok == 0 ? 0 : errno;
-    if (ok == 0) (void)fsync(fd);
+    if (ok == 0) {
+        const uint64_t tr = trace_begin(TR_FSYNC);
+        (void)fsync(fd);
+        trace_end(TR_FSYNC, tr);
+    }
     close(fd);
-    plock_release(abs);
+    dcache_invalidate();   // O_CREAT may have added a name
+    plock_release(lk);
     if (ok != 0) { errno = e; return -1; }
     return 0;
 }
 
+int fs_append_from_socket_prefill(const char *docroot_real,
+                                  const char *decoded_req_path,
+                                  int client_fd, size_t content_len,
+                                  const void *prefill, size_t prefill_len)
+{
+    return fs_append_from_source_prefill(docroot_real, decoded_req_path,
+                                         sock_source, &client_fd, content_len,
+                                         prefill, prefill_len);
+}
+
+int fs_append_from_socket(const char *docroot_real,
+                          const char *decoded_req_path,
+                          int client_fd, size_t content_len)
+{
+    return fs_append_from_socket_prefill(docroot_real, decoded_req_path,
+                                         client_fd, content_len, NULL, 0);
+}
+
 int fs_unlink_safe(const char *docroot_real, const char *decoded_req_path)
 {
     char abs[PATH_MAX];
     if (fs_join_safe(docroot_real, decoded_req_path, abs, sizeof(abs)) < 0) return -1;
 
-    if (plock_acquire_wr(abs) != 0) return -1;
+    struct path_lock *lk = plock_acquire_wr(abs);
+    if (!lk) return -1;
 
     struct stat st;
     if (stat(abs, &st) == 0 && S_ISDIR(st.st_mode)) {
-        plock_release(abs);
+        plock_release(lk);
         errno = EISDIR;
         return -1;
     }
 
     int r = unlink(abs);
     int e = (r == 0) ? 0 : errno;
-    plock_release(abs);
+    if (r == 0) dcache_invalidate();
+    plock_release(lk);
     if (r != 0) { errno = e; return -1; }
     return 0;
 }
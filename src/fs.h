@@ -3,6 +3,18 @@
 
 #include <stddef.h>  // size_t
 #include <stdbool.h>
+#include <stdint.h>     // uint64_t
+#include <limits.h>     // PATH_MAX
+#include <sys/types.h>  // ssize_t
+
+#include "cas.h"        // struct cas_hash
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+struct mh_arena;
+struct path_lock;
 
 /* Safely join docroot (already realpath-resolved) with a decoded request path.
    Ensures the result stays within docroot (no traversal/symlink escape).
@@ -11,6 +23,11 @@
 int  fs_join_safe(const char *docroot_real, const char *decoded_req_path,
                   char *out, size_t outlen);
 
+/* Same as fs_join_safe(), with all scratch memory taken from 'a'
+   (the request arena) instead of the heap. */
+int  fs_join_safe_arena(struct mh_arena *a, const char *docroot_real,
+                        const char *decoded_req_path, char *out, size_t outlen);
+
 /* Returns 1 if 'abs_path' is a directory, 0 if not, -1 on error. */
 int  fs_is_dir(const char *abs_path);
 
@@ -27,11 +44,17 @@ int  fs_open_ro(const char *abs_path);
 const char* fs_mime_from_path(const char *abs_path);
 
 /* Stream a minimal HTML directory listing to 'client_fd'.
-   'req_path_display' is the URL path to show in links.
-   Returns 0 on success, -1 on error. */
-int  fs_send_dir_listing(int client_fd, const char *dir_abs,
+   'req_path_display' is the URL path to show in links; scratch buffers
+   come from 'a'. Returns 0 on success, -1 on error. */
+int  fs_send_dir_listing(struct mh_arena *a, int client_fd, const char *dir_abs,
                          const char *req_path_display);
 
+/* Same listing, written through 'sink' (returns 0, or -1 to abort) instead
+   of to a socket. */
+typedef int (*fs_sink_fn)(void *ctx, const void *buf, size_t len);
+int  fs_dir_listing(struct mh_arena *a, const char *dir_abs, const char *req_path_display,
+                    fs_sink_fn sink, void *ctx);
+
 int fs_put_from_socket_atomic(const char *docroot_real,
                               const char *decoded_req_path,
                               int client_fd,
@@ -48,6 +71,71 @@ int fs_append_from_socket(const char *docroot_real,
                           const char *decoded_req_path,
                           int client_fd, size_t content_len);
 
+/* Like fs_append_from_socket(), but the first 'prefill_len' body bytes were
+   already read off the socket and are passed in 'prefill'. */
+int fs_append_from_socket_prefill(const char *docroot_real,
+                                  const char *decoded_req_path,
+                                  int client_fd, size_t content_len,
+                                  const void *prefill, size_t prefill_len);
+
+/* The upload functions above, reading the body through 'src' (bytes read,
+   0 on EOF, or -1) instead of from a socket, e.g. a TLS connection. */
+typedef ssize_t (*fs_source_fn)(void *ctx, void *buf, size_t len);
+
+int fs_put_from_source_atomic_prefill(const char *docroot_real,
+                                      const char *decoded_req_path,
+                                      fs_source_fn src, void *src_ctx,
+                                      size_t content_len,
+                                      const void *prefill,
+                                      size_t prefill_len);
+
+int fs_append_from_source_prefill(const char *docroot_real,
+                                  const char *decoded_req_path,
+                                  fs_source_fn src, void *src_ctx,
+                                  size_t content_len,
+                                  const void *prefill, size_t prefill_len);
+
+/* fs_put_from_source_atomic_prefill() in three steps, so the body can be
+   read on one thread and the blocking filesystem work done on another
+   (main.c hands begin and publish to the I/O pool):
+     fs_put_begin()   checks the target and creates the temp file;
+     fs_put_body()    streams the body into it;
+     fs_put_publish() flushes and renames it into place, or drops it once
+                      a newer upload is in place.
+   begin and body return 0, or -1 with errno set and nothing left to clean
+   up; publish returns as fs_put_from_source_atomic_prefill() does and
+   always cleans up. fs_put_abort() gives up between steps.
+
+   An upload superseded by a newer one that has not been published yet
+   waits for it: its answer is the newer one's (201 if that created the
+   file), and if the newer one fails it publishes its own body. By default
+   fs_put_publish() blocks meanwhile. With 'wake' set it returns
+   FS_PUT_WAITING instead, and from then on 'p' belongs to the path until
+   wake(p) is called, on whichever thread settled the newer upload; then
+   call fs_put_publish() again. */
+#define FS_PUT_WAITING 2
+
+struct fs_put {
+    struct path_lock *lk;
+    uint64_t          ticket;
+    int               tmpfd;
+    int               hashing;     // 1: hs is running; -1: store once durable
+    size_t            len;
+    void            (*wake)(struct fs_put *p);   // NULL: publish blocks
+    struct fs_put    *next_waiter;
+    int               woken;
+    struct cas_hash   hs;
+    char              dst[PATH_MAX];
+    char              tmp[PATH_MAX];
+};
+
+int  fs_put_begin(struct fs_put *p, const char *docroot_real,
+                  const char *decoded_req_path, size_t content_len);
+int  fs_put_body(struct fs_put *p, fs_source_fn src, void *src_ctx,
+                 const void *prefill, size_t prefill_len);
+int  fs_put_publish(struct fs_put *p);
+void fs_put_abort(struct fs_put *p);
+
 int fs_unlink_safe(const char *docroot_real, const char *decoded_req_path);
 
 #endif /* MYHTTPD_FS_H */
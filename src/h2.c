@@ -0,0 +1,678 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "h2.h"
+#include "hpack.h"
+#include "http_parse.h"
+#include "iohint.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum {
+	H2_DATA = 0x0, H2_HEADERS = 0x1, H2_PRIORITY = 0x2, H2_RST_STREAM = 0x3,
+	H2_SETTINGS = 0x4, H2_PUSH_PROMISE = 0x5, H2_PING = 0x6, H2_GOAWAY = 0x7,
+	H2_WINDOW_UPDATE = 0x8, H2_CONTINUATION = 0x9,
+};
+
+enum {
+	H2F_END_STREAM = 0x1, H2F_ACK = 0x1, H2F_END_HEADERS = 0x4,
+	H2F_PADDED = 0x8, H2F_PRIORITY = 0x20,
+};
+
+enum {
+	H2E_NO_ERROR = 0x0, H2E_PROTOCOL = 0x1, H2E_INTERNAL = 0x2,
+	H2E_FLOW_CONTROL = 0x3, H2E_STREAM_CLOSED = 0x5, H2E_FRAME_SIZE = 0x6,
+	H2E_REFUSED_STREAM = 0x7, H2E_COMPRESSION = 0x9,
+};
+
+enum {
+	H2S_HEADER_TABLE_SIZE = 0x1, H2S_ENABLE_PUSH = 0x2, H2S_MAX_CONCURRENT_STREAMS = 0x3,
+	H2S_INITIAL_WINDOW_SIZE = 0x4, H2S_MAX_FRAME_SIZE = 0x5,
+};
+
+#define H2_FRAME_HDR      9
+#define H2_DEFAULT_FRAME  16384        // our SETTINGS_MAX_FRAME_SIZE (the minimum)
+#define H2_DEFAULT_WINDOW 65535
+#define H2_MAX_WINDOW     0x7fffffff
+#define H2_HEADER_BLOCK_MAX (64 * 1024)
+#define H2_RESP_HDR_MAX   512
+
+enum { ST_IDLE = 0, ST_OPEN, ST_READY, ST_SENDING };
+
+struct h2_stream {
+	uint32_t id;
+	int      state;
+	int      method;
+	char    *path;
+	long     clen;
+	int      bad;             // malformed header block
+	int      too_large;       // body exceeded H2_BODY_MAX (rest is discarded)
+	char    *body;
+	size_t   body_len, body_cap;
+	uint32_t recv_credit;     // DATA bytes not yet returned by WINDOW_UPDATE
+	int64_t  send_win;
+
+	struct mh_reply rep;
+	size_t   mem_off;         // progress through rep.body
+	off_t    file_off;        // progress through rep.fd
+	struct iohint_read io;    // page-cache hints for rep.fd
+	size_t   left;            // body bytes still to send
+};
+
+struct h2_session {
+	struct mh_conn *c;
+	h2_handler_fn   fn;
+	void           *arg;
+	struct hpack_dec dec;
+
+	struct h2_stream st[H2_MAX_STREAMS];
+	int      nactive;
+	unsigned rr;              // round-robin start for the next DATA round
+	uint32_t last_id;         // highest client stream id seen
+
+	int64_t  send_win;        // connection send window
+	uint32_t recv_credit;
+	uint32_t peer_init_win;
+	uint32_t peer_max_frame;
+
+	int      preface_ok;
+	int      goaway;          // no new streams (peer GOAWAY)
+	int      dead;            // connection error: GOAWAY queued
+
+	uint8_t *hb;              // header block being assembled
+	size_t   hb_len, hb_cap;
+	uint32_t hb_stream;
+	int      hb_end_stream;
+	int      hb_active;       // waiting for CONTINUATION
+};
+
+
+// ---- Internal helpers ----
+
+static inline uint32_t rd32(const uint8_t *p) {
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline void wr32(uint8_t *p, uint32_t v) {
+	p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);  p[3] = (uint8_t)v;
+}
+
+static void frame_hdr(uint8_t *p, size_t len, uint8_t type, uint8_t flags, uint32_t sid) {
+	p[0] = (uint8_t)(len >> 16); p[1] = (uint8_t)(len >> 8); p[2] = (uint8_t)len;
+	p[3] = type;
+	p[4] = flags;
+	wr32(p + 5, sid & 0x7fffffffu);
+}
+
+static int put_frame(struct h2_session *s, uint8_t type, uint8_t flags, uint32_t sid,
+                     const void *payload, size_t len) {
+	uint8_t *p = (uint8_t *)conn_stage_reserve(s->c, H2_FRAME_HDR + len);
+	if (!p) return -1;
+	frame_hdr(p, len, type, flags, sid);
+	if (len) memcpy(p + H2_FRAME_HDR, payload, len);
+	conn_stage_commit(s->c, H2_FRAME_HDR + len);
+	return 0;
+}
+
+static int put_u32_frame(struct h2_session *s, uint8_t type, uint32_t sid, uint32_t v) {
+	uint8_t b[4];
+	wr32(b, v);
+	return put_frame(s, type, 0, sid, b, sizeof(b));
+}
+
+static int conn_error(struct h2_session *s, uint32_t code) {
+	uint8_t b[8];
+	wr32(b, s->last_id);
+	wr32(b + 4, code);
+	(void)put_frame(s, H2_GOAWAY, 0, 0, b, sizeof(b));
+	s->dead = 1;
+	return -1;
+}
+
+static struct h2_stream *find_stream(struct h2_session *s, uint32_t id) {
+	for (int i = 0; i < H2_MAX_STREAMS; i++)
+		if (s->st[i].state != ST_IDLE && s->st[i].id == id) return &s->st[i];
+	return NULL;
+}
+
+static struct h2_stream *open_stream(struct h2_session *s, uint32_t id) {
+	for (int i = 0; i < H2_MAX_STREAMS; i++) {
+		struct h2_stream *st = &s->st[i];
+		if (st->state != ST_IDLE) continue;
+		memset(st, 0, sizeof(*st));
+		st->id = id;
+		st->state = ST_OPEN;
+		st->method = MYHTTP_METHOD_UNKNOWN;
+		st->clen = -1;
+		st->send_win = s->peer_init_win;
+		reply_init(&st->rep);
+		s->nactive++;
+		return st;
+	}
+	return NULL;
+}
+
+static void close_stream(struct h2_session *s, struct h2_stream *st) {
+	iohint_read_end(&st->io, (size_t)st->file_off);
+	reply_done(&st->rep);
+	free(st->path);
+	free(st->body);
+	memset(st, 0, sizeof(*st));
+	st->state = ST_IDLE;
+	s->nactive--;
+}
+
+static int reset_stream(struct h2_session *s, struct h2_stream *st, uint32_t sid, uint32_t code) {
+	if (st) close_stream(s, st);
+	return put_u32_frame(s, H2_RST_STREAM, sid, code);
+}
+
+static int apply_settings(struct h2_session *s, const uint8_t *p, size_t len) {
+	for (size_t i = 0; i + 6 <= len; i += 6) {
+		uint16_t id = (uint16_t)(p[i] << 8 | p[i + 1]);
+		uint32_t v = rd32(p + i + 2);
+		switch (id) {
+		case H2S_ENABLE_PUSH:
+			if (v > 1) return conn_error(s, H2E_PROTOCOL);
+			break;
+		case H2S_INITIAL_WINDOW_SIZE: {
+			if (v > H2_MAX_WINDOW) return conn_error(s, H2E_FLOW_CONTROL);
+			int64_t delta = (int64_t)v - (int64_t)s->peer_init_win;
+			for (int k = 0; k < H2_MAX_STREAMS; k++) {
+				if (s->st[k].state == ST_IDLE) continue;
+				s->st[k].send_win += delta;
+				if (s->st[k].send_win > H2_MAX_WINDOW) return conn_error(s, H2E_FLOW_CONTROL);
+			}
+			s->peer_init_win = v;
+			break;
+		}
+		case H2S_MAX_FRAME_SIZE:
+			if (v < 16384 || v > 16777215) return conn_error(s, H2E_PROTOCOL);
+			s->peer_max_frame = v;
+			break;
+		default:   // header table size (our encoder never indexes), limits, unknown
+			break;
+		}
+	}
+	return 0;
+}
+
+// Request header fields of a new stream.
+static int on_field(void *ctx, const char *n, size_t nlen, const char *v, size_t vlen) {
+	struct h2_stream *st = (struct h2_stream *)ctx;
+	if (nlen == 7 && memcmp(n, ":method", 7) == 0) {
+		char tok[16];
+		if (vlen >= sizeof(tok)) { st->bad = 1; return 0; }
+		memcpy(tok, v, vlen);
+		tok[vlen] = '\0';
+		st->method = myhttp_method_from_token(tok);
+	} else if (nlen == 5 && memcmp(n, ":path", 5) == 0) {
+		free(st->path);
+		st->path = (char *)malloc(vlen + 1);
+		if (!st->path) return 1;
+		memcpy(st->path, v, vlen);
+		st->path[vlen] = '\0';
+	} else if (nlen == 14 && memcmp(n, "content-length", 14) == 0) {
+		long cl = 0;
+		if (vlen == 0 || vlen > 15) { st->bad = 1; return 0; }
+		for (size_t i = 0; i < vlen; i++) {
+			if (v[i] < '0' || v[i] > '9') { st->bad = 1; return 0; }
+			cl = cl * 10 + (v[i] - '0');
+		}
+		st->clen = cl;
+	} else if (nlen > 0 && n[0] == ':' &&
+	           !(nlen == 7 && memcmp(n, ":scheme", 7) == 0) &&
+	           !(nlen == 10 && memcmp(n, ":authority", 10) == 0)) {
+		st->bad = 1;   // unknown pseudo-header (or a response one)
+	}
+	return 0;
+}
+
+static int ignore_field(void *ctx, const char *n, size_t nlen, const char *v, size_t vlen) {
+	(void)ctx; (void)n; (void)nlen; (void)v; (void)vlen;
+	return 0;
+}
+
+static int on_header_block(struct h2_session *s) {
+	const uint32_t sid = s->hb_stream;
+	struct h2_stream *st = find_stream(s, sid);
+	int rc;
+
+	if (st) {                                   // trailers
+		if (hpack_decode(&s->dec, s->hb, s->hb_len, ignore_field, NULL) < 0)
+			return conn_error(s, H2E_COMPRESSION);
+		if (st->state != ST_OPEN || !s->hb_end_stream)
+			return reset_stream(s, st, sid, H2E_PROTOCOL);
+		st->state = ST_READY;
+		return 0;
+	}
+	if (sid <= s->last_id) return conn_error(s, H2E_STREAM_CLOSED);
+	s->last_id = sid;
+
+	st = s->goaway ? NULL : open_stream(s, sid);
+	rc = st ? hpack_decode(&s->dec, s->hb, s->hb_len, on_field, st)
+	        : hpack_decode(&s->dec, s->hb, s->hb_len, ignore_field, NULL);
+	if (rc < 0) return conn_error(s, H2E_COMPRESSION);
+	if (!st) return put_u32_frame(s, H2_RST_STREAM, sid, H2E_REFUSED_STREAM);
+	if (st->bad || !st->path || st->path[0] != '/')
+		return reset_stream(s, st, sid, H2E_PROTOCOL);
+	if (s->hb_end_stream) st->state = ST_READY;
+	return 0;
+}
+
+static int hb_append(struct h2_session *s, const uint8_t *p, size_t len) {
+	if (s->hb_len + len > H2_HEADER_BLOCK_MAX) return conn_error(s, H2E_COMPRESSION);
+	if (s->hb_len + len > s->hb_cap) {
+		size_t cap = s->hb_cap ? s->hb_cap : 1024;
+		while (cap < s->hb_len + len) cap *= 2;
+		uint8_t *nb = (uint8_t *)realloc(s->hb, cap);
+		if (!nb) return conn_error(s, H2E_INTERNAL);
+		s->hb = nb;
+		s->hb_cap = cap;
+	}
+	memcpy(s->hb + s->hb_len, p, len);
+	s->hb_len += len;
+	return 0;
+}
+
+static int body_append(struct h2_stream *st, const uint8_t *p, size_t len) {
+	if (st->too_large || len == 0) return 0;
+	if (st->body_len + len > H2_BODY_MAX) {
+		st->too_large = 1;
+		return 0;
+	}
+	if (st->body_len + len > st->body_cap) {
+		size_t cap = st->body_cap ? st->body_cap : 16 * 1024;
+		while (cap < st->body_len + len) cap *= 2;
+		char *nb = (char *)realloc(st->body, cap);
+		if (!nb) return -1;
+		st->body = nb;
+		st->body_cap = cap;
+	}
+	memcpy(st->body + st->body_len, p, len);
+	st->body_len += len;
+	return 0;
+}
+
+static int on_frame(struct h2_session *s, uint8_t type, uint8_t flags, uint32_t sid,
+                    const uint8_t *p, size_t len) {
+	if (s->hb_active && (type != H2_CONTINUATION || sid != s->hb_stream))
+		return conn_error(s, H2E_PROTOCOL);
+
+	switch (type) {
+	case H2_DATA: {
+		if (sid == 0) return conn_error(s, H2E_PROTOCOL);
+		size_t off = 0, pad = 0;
+		if (flags & H2F_PADDED) {
+			if (len < 1) return conn_error(s, H2E_PROTOCOL);
+			pad = p[0];
+			off = 1;
+		}
+		if (off + pad > len) return conn_error(s, H2E_PROTOCOL);
+		s->recv_credit += (uint32_t)len;   // flow control counts padding too
+
+		struct h2_stream *st = find_stream(s, sid);
+		if (!st || st->state != ST_OPEN) {
+			if (sid > s->last_id) return conn_error(s, H2E_PROTOCOL);
+			return st ? reset_stream(s, st, sid, H2E_STREAM_CLOSED)
+			          : put_u32_frame(s, H2_RST_STREAM, sid, H2E_STREAM_CLOSED);
+		}
+		if (body_append(st, p + off, len - off - pad) < 0)
+			return reset_stream(s, st, sid, H2E_INTERNAL);
+		if (flags & H2F_END_STREAM) st->state = ST_READY;
+		else st->recv_credit += (uint32_t)len;
+		return 0;
+	}
+
+	case H2_HEADERS: {
+		if (sid == 0 || !(sid & 1)) return conn_error(s, H2E_PROTOCOL);
+		size_t off = 0, pad = 0;
+		if (flags & H2F_PADDED) {
+			if (len < 1) return conn_error(s, H2E_PROTOCOL);
+			pad = p[0];
+			off = 1;
+		}
+		if (flags & H2F_PRIORITY) off += 5;
+		if (off + pad > len) return conn_error(s, H2E_PROTOCOL);
+		s->hb_len = 0;
+		s->hb_stream = sid;
+		s->hb_end_stream = (flags & H2F_END_STREAM) != 0;
+		if (hb_append(s, p + off, len - off - pad) < 0) return -1;
+		if (flags & H2F_END_HEADERS) return on_header_block(s);
+		s->hb_active = 1;
+		return 0;
+	}
+
+	case H2_CONTINUATION:
+		if (!s->hb_active) return conn_error(s, H2E_PROTOCOL);
+		if (hb_append(s, p, len) < 0) return -1;
+		if (!(flags & H2F_END_HEADERS)) return 0;
+		s->hb_active = 0;
+		return on_header_block(s);
+
+	case H2_PRIORITY:
+		if (sid == 0) return conn_error(s, H2E_PROTOCOL);
+		if (len != 5) return reset_stream(s, find_stream(s, sid), sid, H2E_FRAME_SIZE);
+		return 0;
+
+	case H2_RST_STREAM: {
+		if (sid == 0 || sid > s->last_id) return conn_error(s, H2E_PROTOCOL);
+		if (len != 4) return conn_error(s, H2E_FRAME_SIZE);
+		struct h2_stream *st = find_stream(s, sid);
+		if (st) close_stream(s, st);
+		return 0;
+	}
+
+	case H2_SETTINGS:
+		if (sid != 0) return conn_error(s, H2E_PROTOCOL);
+		if (flags & H2F_ACK) return len ? conn_error(s, H2E_FRAME_SIZE) : 0;
+		if (len % 6) return conn_error(s, H2E_FRAME_SIZE);
+		if (apply_settings(s, p, len) < 0) return -1;
+		return put_frame(s, H2_SETTINGS, H2F_ACK, 0, NULL, 0);
+
+	case H2_PING:
+		if (sid != 0) return conn_error(s, H2E_PROTOCOL);
+		if (len != 8) return conn_error(s, H2E_FRAME_SIZE);
+		if (flags & H2F_ACK) return 0;
+		return put_frame(s, H2_PING, H2F_ACK, 0, p, 8);
+
+	case H2_GOAWAY:
+		s->goaway = 1;
+		return 0;
+
+	case H2_WINDOW_UPDATE: {
+		if (len != 4) return conn_error(s, H2E_FRAME_SIZE);
+		uint32_t inc = rd32(p) & 0x7fffffffu;
+		if (sid == 0) {
+			if (inc == 0) return conn_error(s, H2E_PROTOCOL);
+			s->send_win += inc;
+			if (s->send_win > H2_MAX_WINDOW) return conn_error(s, H2E_FLOW_CONTROL);
+			return 0;
+		}
+		struct h2_stream *st = find_stream(s, sid);
+		if (!st) return sid > s->last_id ? conn_error(s, H2E_PROTOCOL) : 0;
+		if (inc == 0) return reset_stream(s, st, sid, H2E_PROTOCOL);
+		st->send_win += inc;
+		if (st->send_win > H2_MAX_WINDOW) return reset_stream(s, st, sid, H2E_FLOW_CONTROL);
+		return 0;
+	}
+
+	case H2_PUSH_PROMISE:    // clients must not push
+		return conn_error(s, H2E_PROTOCOL);
+
+	default:                 // unknown frame types are ignored
+		return 0;
+	}
+}
+
+// Parse every complete frame in the input buffer.
+static int read_frames(struct h2_session *s) {
+	struct mh_conn *c = s->c;
+	for (;;) {
+		size_t avail = conn_avail(c);
+		const uint8_t *p = (const uint8_t *)c->in + c->in_off;
+		if (!s->preface_ok) {
+			if (avail < H2_PREFACE_LEN) return 0;
+			if (memcmp(p, H2_PREFACE, H2_PREFACE_LEN) != 0) return conn_error(s, H2E_PROTOCOL);
+			c->in_off += H2_PREFACE_LEN;
+			s->preface_ok = 1;
+			continue;
+		}
+		if (avail < H2_FRAME_HDR) return 0;
+		size_t len = (size_t)p[0] << 16 | (size_t)p[1] << 8 | p[2];
+		if (len > H2_DEFAULT_FRAME) return conn_error(s, H2E_FRAME_SIZE);
+		if (avail < H2_FRAME_HDR + len) return 0;
+		c->in_off += H2_FRAME_HDR + len;
+		if (on_frame(s, p[3], p[4], rd32(p + 5) & 0x7fffffffu, p + H2_FRAME_HDR, len) < 0)
+			return -1;
+	}
+}
+
+// Hand back receive window once half of it has been used.
+static int return_credit(struct h2_session *s) {
+	if (s->recv_credit >= H2_WINDOW / 2) {
+		if (put_u32_frame(s, H2_WINDOW_UPDATE, 0, s->recv_credit) < 0) return -1;
+		s->recv_credit = 0;
+	}
+	for (int i = 0; i < H2_MAX_STREAMS; i++) {
+		struct h2_stream *st = &s->st[i];
+		if (st->state != ST_OPEN || st->recv_credit < H2_WINDOW / 2) continue;
+		if (put_u32_frame(s, H2_WINDOW_UPDATE, st->id, st->recv_credit) < 0) return -1;
+		st->recv_credit = 0;
+	}
+	return 0;
+}
+
+// Queue the HEADERS frame of st's reply.
+static int send_headers(struct h2_session *s, struct h2_stream *st) {
+	const struct mh_reply *r = &st->rep;
+	uint8_t *p = (uint8_t *)conn_stage_reserve(s->c, H2_FRAME_HDR + H2_RESP_HDR_MAX);
+	if (!p) return -1;
+	const size_t cap = H2_FRAME_HDR + H2_RESP_HDR_MAX;
+	size_t off = H2_FRAME_HDR;
+	char num[24];
+	int n = snprintf(num, sizeof(num), "%zu", st->left);
+
+	if (hpack_enc_status(p, cap, &off, r->status) < 0 ||
+	    (r->ctype && hpack_enc_field(p, cap, &off, "content-type", r->ctype, strlen(r->ctype)) < 0) ||
+	    (r->etag && hpack_enc_field(p, cap, &off, "etag", r->etag, strlen(r->etag)) < 0) ||
+	    hpack_enc_field(p, cap, &off, "content-length", num, (size_t)n) < 0) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+	frame_hdr(p, off - H2_FRAME_HDR, H2_HEADERS,
+	          (uint8_t)(H2F_END_HEADERS | (st->left == 0 ? H2F_END_STREAM : 0)), st->id);
+	conn_stage_commit(s->c, off);
+	return 0;
+}
+
+// Run the handler for every stream whose request is complete.
+static int dispatch(struct h2_session *s) {
+	for (int i = 0; i < H2_MAX_STREAMS; i++) {
+		struct h2_stream *st = &s->st[i];
+		if (st->state != ST_READY) continue;
+
+		conn_begin_request(s->c);
+		if (st->too_large) {
+			reply_text(&st->rep, 413, "Payload Too Large", "body too large\n");
+		} else {
+			struct h2_request rq = {
+				.method = st->method, .path = st->path,
+				.body = st->body, .body_len = st->body_len,
+				.content_length = st->clen,
+			};
+			s->fn(s->arg, &s->c->arena, &rq, &st->rep);
+		}
+		free(st->body);
+		st->body = NULL;
+		st->body_len = st->body_cap = 0;
+
+		st->left = st->rep.fd >= 0 ? st->rep.file_len : st->rep.body_len;
+		if (st->rep.fd >= 0) iohint_read_begin(&st->io, st->rep.fd, st->rep.file_len);
+		st->state = ST_SENDING;
+		if (send_headers(s, st) < 0) return -1;
+		if (st->left == 0) close_stream(s, st);
+	}
+	return 0;
+}
+
+static size_t sendable(const struct h2_session *s, const struct h2_stream *st) {
+	if (st->state != ST_SENDING || st->send_win <= 0 || s->send_win <= 0) return 0;
+	size_t n = st->left;
+	if (n > (size_t)st->send_win) n = (size_t)st->send_win;
+	if (n > (size_t)s->send_win)  n = (size_t)s->send_win;
+	size_t fmax = s->peer_max_frame < H2_DEFAULT_FRAME ? s->peer_max_frame : H2_DEFAULT_FRAME;
+	return n < fmax ? n : fmax;
+}
+
+static int send_data(struct h2_session *s, struct h2_stream *st, size_t n) {
+	uint8_t *p = (uint8_t *)conn_stage_reserve(s->c, H2_FRAME_HDR + n);
+	if (!p) return -1;
+	if (st->rep.fd >= 0) {
+		(void)iohint_read_at(&st->io, (size_t)st->file_off);
+		size_t got = 0;
+		while (got < n) {
+			ssize_t r = pread(st->rep.fd, p + H2_FRAME_HDR + got, n - got, st->file_off + (off_t)got);
+			if (r < 0 && errno == EINTR) continue;
+			if (r <= 0) break;
+			got += (size_t)r;
+		}
+		if (got < n)   // file shrank: content-length is already promised
+			return reset_stream(s, st, st->id, H2E_INTERNAL);
+		st->file_off += (off_t)n;
+	} else {
+		memcpy(p + H2_FRAME_HDR, st->rep.body + st->mem_off, n);
+		st->mem_off += n;
+	}
+	st->left -= n;
+	st->send_win -= (int64_t)n;
+	s->send_win -= (int64_t)n;
+	frame_hdr(p, n, H2_DATA, st->left == 0 ? H2F_END_STREAM : 0, st->id);
+	conn_stage_commit(s->c, H2_FRAME_HDR + n);
+	if (st->left == 0) close_stream(s, st);
+	return 0;
+}
+
+// Interleave DATA frames: one per sendable stream per round, until the
+// windows close, nothing is left, or a batch worth of output is queued.
+static int pump(struct h2_session *s) {
+	int progress = 1;
+	while (progress && s->c->out_queued < CONN_OUT_MAX / 2) {
+		progress = 0;
+		for (unsigned k = 0; k < H2_MAX_STREAMS; k++) {
+			struct h2_stream *st = &s->st[(s->rr + k) % H2_MAX_STREAMS];
+			size_t n = sendable(s, st);
+			if (!n) continue;
+			if (send_data(s, st, n) < 0) return -1;
+			progress = 1;
+		}
+		s->rr = (s->rr + 1) % H2_MAX_STREAMS;
+	}
+	return 0;
+}
+
+static int any_sendable(const struct h2_session *s) {
+	for (int i = 0; i < H2_MAX_STREAMS; i++)
+		if (sendable(s, &s->st[i])) return 1;
+	return 0;
+}
+
+static int b64url_val(int ch) {
+	if (ch >= 'A' && ch <= 'Z') return ch - 'A';
+	if (ch >= 'a' && ch <= 'z') return ch - 'a' + 26;
+	if (ch >= '0' && ch <= '9') return ch - '0' + 52;
+	if (ch == '-' || ch == '+') return 62;
+	if (ch == '_' || ch == '/') return 63;
+	return -1;
+}
+
+// Decode base64url (padding optional) into out; returns length or -1.
+static long b64url_decode(const char *in, uint8_t *out, size_t outlen) {
+	size_t o = 0;
+	uint32_t acc = 0;
+	int bits = 0;
+	for (; *in && *in != '='; in++) {
+		int v = b64url_val((unsigned char)*in);
+		if (v < 0) return -1;
+		acc = acc << 6 | (uint32_t)v;
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			if (o >= outlen) return -1;
+			out[o++] = (uint8_t)(acc >> bits);
+		}
+	}
+	return (long)o;
+}
+
+static void session_free(struct h2_session *s) {
+	for (int i = 0; i < H2_MAX_STREAMS; i++)
+		if (s->st[i].state != ST_IDLE) close_stream(s, &s->st[i]);
+	hpack_dec_free(&s->dec);
+	free(s->hb);
+	free(s);
+}
+
+
+//----- API ----------
+
+int h2_is_preface(const char *buf, size_t len) {
+	if (len > H2_PREFACE_LEN) len = H2_PREFACE_LEN;
+	return len > 0 && memcmp(buf, H2_PREFACE, len) == 0;
+}
+
+int h2_serve(struct mh_conn *c, h2_handler_fn fn, void *arg,
+             const struct h2_request *upgrade, const char *http2_settings) {
+	struct h2_session *s = (struct h2_session *)calloc(1, sizeof(*s));
+	if (!s) return -1;
+	s->c = c;
+	s->fn = fn;
+	s->arg = arg;
+	s->send_win = H2_DEFAULT_WINDOW;
+	s->peer_init_win = H2_DEFAULT_WINDOW;
+	s->peer_max_frame = H2_DEFAULT_FRAME;
+	hpack_dec_init(&s->dec);
+
+	// Server preface: our SETTINGS, then open the connection window.
+	uint8_t set[18];
+	static const uint16_t ids[3] = { H2S_MAX_CONCURRENT_STREAMS, H2S_INITIAL_WINDOW_SIZE, H2S_ENABLE_PUSH };
+	const uint32_t vals[3] = { H2_MAX_STREAMS, H2_WINDOW, 0 };
+	for (int i = 0; i < 3; i++) {
+		set[i * 6] = (uint8_t)(ids[i] >> 8);
+		set[i * 6 + 1] = (uint8_t)ids[i];
+		wr32(set + i * 6 + 2, vals[i]);
+	}
+	int rc = put_frame(s, H2_SETTINGS, 0, 0, set, sizeof(set));
+	if (rc == 0 && H2_WINDOW > H2_DEFAULT_WINDOW)
+		rc = put_u32_frame(s, H2_WINDOW_UPDATE, 0, H2_WINDOW - H2_DEFAULT_WINDOW);
+
+	if (rc == 0 && upgrade) {
+		// RFC 7540 3.2: the upgraded request is stream 1, half-closed (remote).
+		if (http2_settings) {
+			uint8_t raw[256];
+			long n = b64url_decode(http2_settings, raw, sizeof(raw));
+			if (n < 0 || n % 6 || apply_settings(s, raw, (size_t)n) < 0) rc = -1;
+		}
+		struct h2_stream *st = rc == 0 ? open_stream(s, 1) : NULL;
+		if (st) {
+			st->method = upgrade->method;
+			st->path = strdup(upgrade->path ? upgrade->path : "/");
+			st->state = st->path ? ST_READY : ST_IDLE;
+			s->last_id = 1;
+			if (!st->path) { s->nactive--; rc = -1; }
+		}
+	}
+
+	while (rc == 0) {
+		if (read_frames(s) < 0 || dispatch(s) < 0 || return_credit(s) < 0 || pump(s) < 0) {
+			rc = -1;
+			break;
+		}
+		if (conn_flush(c) < 0) { rc = -1; break; }
+		if (s->goaway && s->nactive == 0) break;
+
+		if (any_sendable(s)) {
+			// More to send: only read what is already waiting (window updates, new requests).
+			if (conn_readable(c, 0) <= 0) continue;
+		} else if (s->nactive == 0 && !s->hb_active) {
+			conn_release_idle(c);
+		}
+		// A quiet session waits under the idle deadline; open streams or a
+		// half-read frame under the body deadline.
+		const int quiet = s->nactive == 0 && !s->hb_active && conn_avail(c) == 0;
+		conn_expect(c, quiet ? CONN_T_IDLE : CONN_T_BODY);
+		ssize_t n = conn_fill(c);
+		if (n <= 0) {
+			if (n < 0) rc = -1;
+			break;
+		}
+	}
+	if (s->dead) (void)conn_flush(c);   // deliver the GOAWAY
+	session_free(s);
+	return rc;
+}
@@ -0,0 +1,63 @@
+#ifndef MYHTTP_H2_H
+#define MYHTTP_H2_H
+
+#include <stddef.h>   // size_t
+
+#include "conn.h"
+#include "reply.h"
+
+/* HTTP/2 over cleartext TCP (h2c), entered either with the prior-knowledge
+   preface or through an HTTP/1.1 "Upgrade: h2c" request.
+
+   The session runs on the worker that owns the connection. Streams are
+   multiplexed: each request is handed to the handler once its header
+   block and body are complete, and the resulting replies are interleaved
+   as DATA frames, one frame per ready stream per round, within the peer's
+   connection and stream flow-control windows. Request bodies are buffered
+   whole (up to H2_BODY_MAX), so the handler sees the same prefilled body
+   the HTTP/1.1 upload path passes to fs.c. */
+
+#define H2_PREFACE      "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define H2_PREFACE_LEN  24
+
+/* SETTINGS_MAX_CONCURRENT_STREAMS; extra streams are refused. */
+#ifndef H2_MAX_STREAMS
+#define H2_MAX_STREAMS  32
+#endif
+
+/* Receive window we grant on the connection and on each stream. */
+#ifndef H2_WINDOW
+#define H2_WINDOW       (1024 * 1024)
+#endif
+
+#ifndef H2_BODY_MAX
+#define H2_BODY_MAX     (16 * 1024 * 1024)
+#endif
+
+struct h2_request {
+	int         method;          // myhttp_method
+	const char *path;            // :path, raw (not decoded)
+	const char *body;            // complete request body, NULL if none
+	size_t      body_len;
+	long        content_length;  // -1 if absent
+};
+
+/* Produce the reply for one complete request. Scratch taken from 'a' stays
+   valid until the handler returns; 'rep' must then own everything it
+   references (static strings, body_owned, fd). Directory listings must
+   already be rendered into body_owned. */
+typedef void (*h2_handler_fn)(void *arg, struct mh_arena *a,
+                              const struct h2_request *rq, struct mh_reply *rep);
+
+/* 1 if buf[0..len) is the client preface or a prefix of it. */
+int h2_is_preface(const char *buf, size_t len);
+
+/* Run an HTTP/2 session on 'c' until the peer closes or a connection error.
+   Prior knowledge: the preface is expected in (or after) c's input buffer;
+   pass upgrade = NULL. Upgrade: the 101 has been sent; 'upgrade' becomes
+   stream 1 and 'http2_settings' is the base64url HTTP2-Settings value.
+   Returns 0 when the session ended cleanly, -1 otherwise. */
+int h2_serve(struct mh_conn *c, h2_handler_fn fn, void *arg,
+             const struct h2_request *upgrade, const char *http2_settings);
+
+#endif /* MYHTTP_H2_H */
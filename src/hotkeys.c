@@ -0,0 +1,451 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE   // MAP_ANONYMOUS
+
+#include "hotkeys.h"
+#include "dcache.h"
+#include "fs.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HOT_DEPTH  4               /* sketch rows */
+#define HOT_WIDTH  2048            /* counters per row (power of two) */
+#define HOT_CANDS  32              /* space-saving slots per thread */
+#define HOT_SLOTS  (2 * HOT_MAX)   /* pin table, open addressing (power of two) */
+
+/* A candidate slot; only its thread writes it. 'seq' is odd while the
+   key is being replaced, so the merging thread can skip torn copies. */
+struct hot_cand {
+	unsigned seq;
+	uint32_t count;
+	uint64_t hash;
+	char     key[HOT_KEY_MAX];
+};
+
+/* Per-thread counts: a Count-Min sketch and the space-saving top list. */
+struct hot_local {
+	unsigned        epoch;     // decays applied to the counts below
+	uint32_t        cms[HOT_DEPTH][HOT_WIDTH];
+	struct hot_cand cand[HOT_CANDS];
+};
+
+/* What the merge makes of one candidate. */
+struct hot_merged {
+	uint64_t       hash;
+	struct hot_key hk;
+};
+
+static struct {
+	size_t            k;          // paths to pin; 0 = off (stored atomically)
+	unsigned          epoch;      // decays due
+	hot_resolve_fn    resolve;
+	struct hot_local *locals[HOT_MAX_THREADS];
+	unsigned          nlocals;
+
+	pthread_rwlock_t  lock;       // the pin table; written by the hot thread only
+	struct hot_pin   *slots[HOT_SLOTS];
+	size_t            npinned;
+	size_t            pinned_bytes;
+	uint64_t          hits, pins, ticks;
+
+	pthread_mutex_t   top_mtx;
+	struct hot_key    top[HOT_MAX];
+	size_t            ntop;
+} g_hot = { .lock = PTHREAD_RWLOCK_INITIALIZER, .top_mtx = PTHREAD_MUTEX_INITIALIZER };
+
+static _Thread_local struct hot_local *tl_hot;
+static _Thread_local int               tl_full;   // no counts to be had
+
+
+// ---- Internal helpers ----
+
+static uint64_t fnv1a_64(const char *s, size_t n) {
+	uint64_t h = 1469598103934665603ull;
+	for (size_t i = 0; i < n; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+// Row 'i' of the sketch: double hashing off the one 64-bit hash.
+static inline unsigned cms_col(uint64_t h, unsigned i) {
+	return (unsigned)(((uint32_t)h + i * ((uint32_t)(h >> 32) | 1u)) & (HOT_WIDTH - 1));
+}
+
+/* Mapped, not malloc'd: a thread's first GET may come well into its life
+   (after the I/O pool took the cold ones), and still makes no heap
+   allocation. Never unmapped; the merge may be reading it. */
+static struct hot_local *my_local(void) {
+	if (tl_hot || tl_full) return tl_hot;
+	const unsigned idx = __atomic_fetch_add(&g_hot.nlocals, 1, __ATOMIC_ACQ_REL);
+	struct hot_local *l = NULL;
+	if (idx < HOT_MAX_THREADS) {
+		void *m = mmap(NULL, sizeof(*l), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (m != MAP_FAILED) l = (struct hot_local *)m;
+	}
+	if (!l) {
+		tl_full = 1;
+		return NULL;
+	}
+	l->epoch = __atomic_load_n(&g_hot.epoch, __ATOMIC_RELAXED);
+	__atomic_store_n(&g_hot.locals[idx], l, __ATOMIC_RELEASE);
+	return tl_hot = l;
+}
+
+// Apply the decays this thread missed: halve every count once per epoch.
+static void catch_up(struct hot_local *l, unsigned epoch) {
+	unsigned d = epoch - l->epoch;
+	if (d > 31) d = 31;
+	for (unsigned i = 0; i < HOT_DEPTH; i++)
+		for (unsigned j = 0; j < HOT_WIDTH; j++) {
+			const uint32_t v = __atomic_load_n(&l->cms[i][j], __ATOMIC_RELAXED);
+			if (v) __atomic_store_n(&l->cms[i][j], v >> d, __ATOMIC_RELAXED);
+		}
+	for (unsigned s = 0; s < HOT_CANDS; s++) {
+		const uint32_t v = __atomic_load_n(&l->cand[s].count, __ATOMIC_RELAXED);
+		__atomic_store_n(&l->cand[s].count, v >> d, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&l->epoch, epoch, __ATOMIC_RELEASE);
+}
+
+// This thread's estimate for 'h', with the decays it has yet to apply.
+static uint32_t cms_estimate(struct hot_local *l, uint64_t h, unsigned epoch) {
+	unsigned d = epoch - __atomic_load_n(&l->epoch, __ATOMIC_ACQUIRE);
+	if (d > 31) return 0;
+	uint32_t min = UINT32_MAX;
+	for (unsigned i = 0; i < HOT_DEPTH; i++) {
+		const uint32_t v = __atomic_load_n(&l->cms[i][cms_col(h, i)], __ATOMIC_RELAXED);
+		if (v < min) min = v;
+	}
+	return min >> d;
+}
+
+static struct hot_pin *find_pin(const char *key, uint64_t h) {
+	for (size_t i = h & (HOT_SLOTS - 1); g_hot.slots[i]; i = (i + 1) & (HOT_SLOTS - 1)) {
+		struct hot_pin *p = g_hot.slots[i];
+		if (p->hash == h && strcmp(p->key, key) == 0) return p;
+	}
+	return NULL;
+}
+
+// Same file, unchanged, as when 'p' was pinned?
+static int pin_matches(const struct hot_pin *p, const struct stat *st) {
+	return S_ISREG(st->st_mode) && (unsigned long long)st->st_dev == p->dev &&
+	       (unsigned long long)st->st_ino == p->ino && (size_t)st->st_size == p->size &&
+	       (long long)st->st_mtim.tv_sec * 1000000000ll + st->st_mtim.tv_nsec == p->mtime_ns;
+}
+
+static void pin_free(struct hot_pin *p) {
+	close(p->fd);
+	free((void *)p->data);
+	free(p->key);
+	free(p);
+}
+
+/* Open (and for small files read) what 'key' resolves to under
+   generation 'gen'. NULL if it is not a regular file or can't be read. */
+static struct hot_pin *pin_open(const char *key, uint64_t h, uint64_t gen) {
+	static char abs[PATH_MAX];   // hot thread only
+	const int kind = g_hot.resolve(key, abs, sizeof(abs));
+	if (kind != DC_FILE && kind != DC_INDEX) return NULL;
+	const int fd = fs_open_ro(abs);
+	if (fd < 0) return NULL;
+
+	struct stat st;
+	struct hot_pin *p = (struct hot_pin *)calloc(1, sizeof(*p));
+	if (!p || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !(p->key = strdup(key))) {
+		if (p) free(p->key);
+		free(p);
+		close(fd);
+		return NULL;
+	}
+	p->fd = fd;
+	p->size = (size_t)st.st_size;
+	p->ctype = fs_mime_from_path(abs);
+	p->hash = h;
+	p->gen = gen;
+	p->refs = 1;   // the table's
+	p->dev = (unsigned long long)st.st_dev;
+	p->ino = (unsigned long long)st.st_ino;
+	p->mtime_ns = (long long)st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+
+	if (p->size <= HOT_FILE_MAX) {
+		char *data = (char *)malloc(p->size ? p->size : 1);
+		size_t got = 0;
+		while (data && got < p->size) {
+			ssize_t r = pread(fd, data + got, p->size - got, (off_t)got);
+			if (r < 0 && errno == EINTR) continue;
+			if (r <= 0) break;
+			got += (size_t)r;
+		}
+		p->data = data;
+		if (!data || got < p->size) {
+			pin_free(p);
+			return NULL;
+		}
+	}
+	return p;
+}
+
+/* Still good under file generation 'gen'? Re-resolve after a change;
+   either way the open file must not have changed underneath. */
+static int pin_still_good(struct hot_pin *p, uint64_t gen) {
+	struct stat st;
+	if (fstat(p->fd, &st) < 0 || !pin_matches(p, &st)) return 0;
+	if (p->gen == gen) return 1;
+	static char abs[PATH_MAX];   // hot thread only
+	const int kind = g_hot.resolve(p->key, abs, sizeof(abs));
+	if ((kind != DC_FILE && kind != DC_INDEX) || stat(abs, &st) < 0 || !pin_matches(p, &st)) return 0;
+	__atomic_store_n(&p->gen, gen, __ATOMIC_RELEASE);
+	return 1;
+}
+
+static int cmp_hash(const void *a, const void *b) {
+	const uint64_t x = ((const struct hot_merged *)a)->hash, y = ((const struct hot_merged *)b)->hash;
+	return x < y ? -1 : x > y;
+}
+
+static int cmp_count_desc(const void *a, const void *b) {
+	const uint64_t x = ((const struct hot_merged *)a)->hk.count, y = ((const struct hot_merged *)b)->hk.count;
+	return x > y ? -1 : x < y;
+}
+
+/* Gather every thread's candidates, dedupe them and rank by the summed
+   sketch estimates. Returns the ranked array (malloc'd) and its length. */
+static struct hot_merged *merge(size_t *nout) {
+	unsigned nl = __atomic_load_n(&g_hot.nlocals, __ATOMIC_ACQUIRE);
+	if (nl > HOT_MAX_THREADS) nl = HOT_MAX_THREADS;
+	*nout = 0;
+	struct hot_merged *m = (struct hot_merged *)malloc(((size_t)nl * HOT_CANDS + 1) * sizeof(*m));
+	if (!m) return NULL;
+
+	size_t n = 0;
+	for (unsigned t = 0; t < nl; t++) {
+		struct hot_local *l = __atomic_load_n(&g_hot.locals[t], __ATOMIC_ACQUIRE);
+		if (!l) continue;
+		for (unsigned s = 0; s < HOT_CANDS; s++) {
+			const struct hot_cand *c = &l->cand[s];
+			const unsigned s1 = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+			if (s1 & 1) continue;
+			m[n].hash = c->hash;
+			memcpy(m[n].hk.key, c->key, HOT_KEY_MAX);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&c->seq, __ATOMIC_RELAXED) != s1 || !m[n].hk.key[0]) continue;
+			m[n].hk.key[HOT_KEY_MAX - 1] = '\0';
+			n++;
+		}
+	}
+
+	qsort(m, n, sizeof(*m), cmp_hash);
+	const unsigned epoch = __atomic_load_n(&g_hot.epoch, __ATOMIC_RELAXED);
+	size_t u = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (u > 0 && m[u - 1].hash == m[i].hash) continue;
+		m[u] = m[i];
+		m[u].hk.count = 0;
+		m[u].hk.pinned = 0;
+		for (unsigned t = 0; t < nl; t++) {
+			struct hot_local *l = __atomic_load_n(&g_hot.locals[t], __ATOMIC_ACQUIRE);
+			if (l) m[u].hk.count += cms_estimate(l, m[u].hash, epoch);
+		}
+		u++;
+	}
+	qsort(m, u, sizeof(*m), cmp_count_desc);
+	*nout = u;
+	return m;
+}
+
+// Replace the pin table's contents with next[0..n).
+static void publish(struct hot_pin **next, size_t n) {
+	size_t bytes = 0;
+	for (size_t i = 0; i < n; i++)
+		if (next[i]->data) bytes += next[i]->size;
+	pthread_rwlock_wrlock(&g_hot.lock);
+	memset(g_hot.slots, 0, sizeof(g_hot.slots));
+	for (size_t i = 0; i < n; i++) {
+		size_t s = next[i]->hash & (HOT_SLOTS - 1);
+		while (g_hot.slots[s]) s = (s + 1) & (HOT_SLOTS - 1);
+		g_hot.slots[s] = next[i];
+	}
+	__atomic_store_n(&g_hot.npinned, n, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_hot.pinned_bytes, bytes, __ATOMIC_RELAXED);
+	pthread_rwlock_unlock(&g_hot.lock);
+}
+
+static void tick(void) {
+	static struct hot_pin *cur[HOT_MAX], *next[HOT_MAX];
+	const uint64_t ticks = __atomic_add_fetch(&g_hot.ticks, 1, __ATOMIC_RELAXED);
+	if (ticks % HOT_DECAY_TICKS == 0) __atomic_add_fetch(&g_hot.epoch, 1, __ATOMIC_RELAXED);
+	size_t k = __atomic_load_n(&g_hot.k, __ATOMIC_RELAXED);
+	if (k > HOT_MAX) k = HOT_MAX;
+
+	size_t n = 0;
+	struct hot_merged *m = k ? merge(&n) : NULL;
+	if (n > k) n = k;
+	while (n > 0 && m[n - 1].hk.count < HOT_MIN_HITS) n--;
+
+	// The table only changes here, so it is read without the lock.
+	size_t ncur = 0;
+	for (size_t i = 0; i < HOT_SLOTS; i++)
+		if (g_hot.slots[i]) cur[ncur++] = g_hot.slots[i];
+
+	/* Pins that are still right are kept; the rest are (re)opened. Only
+	   with the watcher running are generations a safe test of freshness. */
+	const uint64_t gen = dcache_file_generation();
+	const int can_pin = dcache_watched();
+	size_t nnext = 0;
+	int changed = 0;
+	for (size_t i = 0; i < n && can_pin; i++) {
+		struct hot_pin *p = find_pin(m[i].hk.key, m[i].hash);
+		if (!p || !pin_still_good(p, gen)) {
+			changed = 1;
+			p = pin_open(m[i].hk.key, m[i].hash, gen);
+			if (p) __atomic_add_fetch(&g_hot.pins, 1, __ATOMIC_RELAXED);
+		}
+		if (p) {
+			m[i].hk.pinned = 1;
+			next[nnext++] = p;
+		}
+	}
+	if (changed || nnext != ncur) {
+		publish(next, nnext);
+		for (size_t i = 0; i < ncur; i++) {
+			size_t j = 0;
+			while (j < nnext && next[j] != cur[i]) j++;
+			if (j == nnext) hot_release(cur[i]);   // readers may still hold it
+		}
+	}
+
+	pthread_mutex_lock(&g_hot.top_mtx);
+	for (size_t i = 0; i < n; i++) g_hot.top[i] = m[i].hk;
+	g_hot.ntop = n;
+	pthread_mutex_unlock(&g_hot.top_mtx);
+	free(m);
+}
+
+static void *hot_main(void *arg) {
+	(void)arg;
+	const struct timespec ts = { HOT_TICK_MS / 1000, (HOT_TICK_MS % 1000) * 1000000L };
+	for (;;) {
+		nanosleep(&ts, NULL);
+		tick();
+	}
+	return NULL;
+}
+
+
+//----- API ----------
+
+int hot_start(size_t k, hot_resolve_fn resolve) {
+	g_hot.resolve = resolve;
+	hot_configure(k);
+	pthread_t tid;
+	int rc = pthread_create(&tid, NULL, hot_main, NULL);
+	if (rc != 0) { errno = rc; return -1; }
+	pthread_detach(tid);
+	return 0;
+}
+
+void hot_configure(size_t k) {
+	__atomic_store_n(&g_hot.k, k > HOT_MAX ? (size_t)HOT_MAX : k, __ATOMIC_RELAXED);
+}
+
+void hot_observe(const char *key) {
+	if (__atomic_load_n(&g_hot.k, __ATOMIC_RELAXED) == 0) return;
+	const size_t n = strnlen(key, HOT_KEY_MAX);
+	if (n == HOT_KEY_MAX) return;
+	struct hot_local *l = my_local();
+	if (!l) return;
+	const unsigned epoch = __atomic_load_n(&g_hot.epoch, __ATOMIC_RELAXED);
+	if (epoch != l->epoch) catch_up(l, epoch);
+
+	// Conservative update: raise only the counters at the minimum.
+	const uint64_t h = fnv1a_64(key, n);
+	uint32_t *ctr[HOT_DEPTH];
+	uint32_t min = UINT32_MAX;
+	for (unsigned i = 0; i < HOT_DEPTH; i++) {
+		ctr[i] = &l->cms[i][cms_col(h, i)];
+		const uint32_t v = __atomic_load_n(ctr[i], __ATOMIC_RELAXED);
+		if (v < min) min = v;
+	}
+	if (min == UINT32_MAX) return;
+	const uint32_t est = min + 1;
+	for (unsigned i = 0; i < HOT_DEPTH; i++)
+		if (__atomic_load_n(ctr[i], __ATOMIC_RELAXED) < est) __atomic_store_n(ctr[i], est, __ATOMIC_RELAXED);
+
+	// Space-saving: the key's own slot, else the weakest one if it is weaker.
+	struct hot_cand *low = &l->cand[0];
+	for (unsigned s = 0; s < HOT_CANDS; s++) {
+		struct hot_cand *c = &l->cand[s];
+		if (c->hash == h && c->key[0]) {
+			__atomic_store_n(&c->count, est, __ATOMIC_RELAXED);
+			return;
+		}
+		if (c->count < low->count) low = c;
+	}
+	if (low->key[0] && low->count >= est) return;
+	__atomic_store_n(&low->seq, low->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	low->hash = h;
+	memcpy(low->key, key, n + 1);
+	__atomic_store_n(&low->count, est, __ATOMIC_RELAXED);
+	__atomic_store_n(&low->seq, low->seq + 1, __ATOMIC_RELEASE);
+}
+
+struct hot_pin *hot_lookup(const char *key) {
+	if (__atomic_load_n(&g_hot.npinned, __ATOMIC_ACQUIRE) == 0) return NULL;
+	const size_t n = strnlen(key, HOT_KEY_MAX);
+	if (n == HOT_KEY_MAX) return NULL;
+	const uint64_t h = fnv1a_64(key, n);
+	pthread_rwlock_rdlock(&g_hot.lock);
+	struct hot_pin *p = find_pin(key, h);
+	if (p && __atomic_load_n(&p->gen, __ATOMIC_ACQUIRE) == dcache_file_generation())
+		__atomic_add_fetch(&p->refs, 1, __ATOMIC_RELAXED);
+	else
+		p = NULL;
+	pthread_rwlock_unlock(&g_hot.lock);
+	if (p) __atomic_add_fetch(&g_hot.hits, 1, __ATOMIC_RELAXED);
+	return p;
+}
+
+void hot_release(struct hot_pin *p) {
+	if (__atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL) == 0) pin_free(p);
+}
+
+int hot_holds(const char *key) {
+	if (__atomic_load_n(&g_hot.npinned, __ATOMIC_ACQUIRE) == 0) return 0;
+	const size_t n = strnlen(key, HOT_KEY_MAX);
+	if (n == HOT_KEY_MAX) return 0;
+	const uint64_t h = fnv1a_64(key, n);
+	pthread_rwlock_rdlock(&g_hot.lock);
+	const struct hot_pin *p = find_pin(key, h);
+	const int held = p && __atomic_load_n(&p->gen, __ATOMIC_ACQUIRE) == dcache_file_generation();
+	pthread_rwlock_unlock(&g_hot.lock);
+	return held;
+}
+
+size_t hot_top(struct hot_key *out, size_t max) {
+	pthread_mutex_lock(&g_hot.top_mtx);
+	const size_t n = g_hot.ntop < max ? g_hot.ntop : max;
+	memcpy(out, g_hot.top, n * sizeof(*out));
+	pthread_mutex_unlock(&g_hot.top_mtx);
+	return n;
+}
+
+void hot_get_stats(struct hot_stats *out) {
+	out->pinned = __atomic_load_n(&g_hot.npinned, __ATOMIC_RELAXED);
+	out->pinned_bytes = __atomic_load_n(&g_hot.pinned_bytes, __ATOMIC_RELAXED);
+	out->hits = __atomic_load_n(&g_hot.hits, __ATOMIC_RELAXED);
+	out->pins = __atomic_load_n(&g_hot.pins, __ATOMIC_RELAXED);
+	out->ticks = __atomic_load_n(&g_hot.ticks, __ATOMIC_RELAXED);
+	out->edits = dcache_edits();
+}
@@ -0,0 +1,112 @@
+#ifndef MYHTTP_HOTKEYS_H
+#define MYHTTP_HOTKEYS_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+/* Hot-path detection and pinning.
+
+   Every GET is counted, on the serving thread and without locks, in that
+   thread's Count-Min sketch, and the thread keeps its own space-saving
+   list of the paths with the highest estimates. Once a tick a background
+   thread merges the lists (summing each candidate's estimate over every
+   thread's sketch), keeps the top --hot-keys paths asked for at least
+   HOT_MIN_HITS times, and pins them: each file is held open, and files up
+   to HOT_FILE_MAX are kept in memory, so their requests skip resolution,
+   open() and read() and do not depend on the dcache or the page cache
+   that a crawler walking listings churns through. Counts halve every
+   HOT_DECAY_TICKS, so yesterday's hot paths give way.
+
+   A pin is used only under the dcache file generation it was checked in
+   (any namespace change or in-place edit, including the server's own
+   writes, bumps it); each tick re-checks the pins against the file
+   (inode, size, mtime) and refreshes or drops them. Pinning needs the
+   dcache's inotify watcher. */
+
+#ifndef HOT_KEYS
+#define HOT_KEYS          64           /* default --hot-keys; 0 disables */
+#endif
+
+#ifndef HOT_MAX
+#define HOT_MAX           1024
+#endif
+
+#ifndef HOT_FILE_MAX
+#define HOT_FILE_MAX      (64 * 1024)  /* larger pinned files are held open only */
+#endif
+
+#ifndef HOT_MIN_HITS
+#define HOT_MIN_HITS      8            /* estimated requests before a path is pinned */
+#endif
+
+#ifndef HOT_TICK_MS
+#define HOT_TICK_MS       1000
+#endif
+
+#ifndef HOT_DECAY_TICKS
+#define HOT_DECAY_TICKS   10
+#endif
+
+#define HOT_KEY_MAX       256          /* longer paths are not counted */
+#define HOT_MAX_THREADS   512          /* threads beyond this are not counted */
+
+/* A pinned file. 'data' holds its contents when it is at most
+   HOT_FILE_MAX bytes (NULL otherwise); 'fd' is open either way. Both stay
+   valid until hot_release(). */
+struct hot_pin {
+	const char *data;
+	size_t      size;
+	int         fd;
+	const char *ctype;        // static string
+	/* private */
+	uint64_t    hash;
+	uint64_t    gen;          // dcache file generation it is good for
+	int         refs;
+	unsigned long long dev, ino;
+	long long   mtime_ns;
+	char       *key;
+};
+
+/* Resolve decoded URL path 'key' as a GET would (dcache kinds); used on
+   the background thread only. */
+typedef int (*hot_resolve_fn)(const char *key, char *abs, size_t abslen);
+
+/* Start the background thread pinning the top 'k' paths. Returns 0, or -1
+   with errno set. */
+int    hot_start(size_t k, hot_resolve_fn resolve);
+
+/* Change how many paths are pinned (0: stop counting, unpin all). */
+void   hot_configure(size_t k);
+
+/* A GET for 'key' is being served on this thread. */
+void   hot_observe(const char *key);
+
+/* The pin for 'key', referenced, or NULL. Give it back with hot_release(). */
+struct hot_pin *hot_lookup(const char *key);
+void   hot_release(struct hot_pin *p);
+
+/* Nonzero if 'key' is pinned (no reference taken). */
+int    hot_holds(const char *key);
+
+struct hot_key {
+	char     key[HOT_KEY_MAX];
+	uint64_t count;           // decayed estimate
+	int      pinned;
+};
+
+/* Copy up to 'max' of the hottest paths as of the last tick, hottest
+   first. Returns how many. */
+size_t hot_top(struct hot_key *out, size_t max);
+
+struct hot_stats {
+	size_t   pinned;          // files pinned
+	size_t   pinned_bytes;    // contents held in memory
+	uint64_t hits;            // requests answered from a pin
+	uint64_t pins;            // pins made (refreshes included)
+	uint64_t ticks;
+	uint64_t edits;           // in-place edits seen (each retires the pins)
+};
+
+void   hot_get_stats(struct hot_stats *out);
+
+#endif /* MYHTTP_HOTKEYS_H */
@@ -0,0 +1,383 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "hpack.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct hpack_entry {
+	char  *buf;                 // name followed by value
+	size_t nlen, vlen;
+};
+
+#define HPACK_ENTRY_OVERHEAD 32u   // RFC 7541 4.1
+#define HPACK_MAX_STRING     (64u * 1024)
+
+/* RFC 7541 Appendix A. */
+static const struct { const char *name, *value; } k_static[] = {
+	{ ":authority", "" },
+	{ ":method", "GET" },
+	{ ":method", "POST" },
+	{ ":path", "/" },
+	{ ":path", "/index.html" },
+	{ ":scheme", "http" },
+	{ ":scheme", "https" },
+	{ ":status", "200" },
+	{ ":status", "204" },
+	{ ":status", "206" },
+	{ ":status", "304" },
+	{ ":status", "400" },
+	{ ":status", "404" },
+	{ ":status", "500" },
+	{ "accept-charset", "" },
+	{ "accept-encoding", "gzip, deflate" },
+	{ "accept-language", "" },
+	{ "accept-ranges", "" },
+	{ "accept", "" },
+	{ "access-control-allow-origin", "" },
+	{ "age", "" },
+	{ "allow", "" },
+	{ "authorization", "" },
+	{ "cache-control", "" },
+	{ "content-disposition", "" },
+	{ "content-encoding", "" },
+	{ "content-language", "" },
+	{ "content-length", "" },
+	{ "content-location", "" },
+	{ "content-range", "" },
+	{ "content-type", "" },
+	{ "cookie", "" },
+	{ "date", "" },
+	{ "etag", "" },
+	{ "expect", "" },
+	{ "expires", "" },
+	{ "from", "" },
+	{ "host", "" },
+	{ "if-match", "" },
+	{ "if-modified-since", "" },
+	{ "if-none-match", "" },
+	{ "if-range", "" },
+	{ "if-unmodified-since", "" },
+	{ "last-modified", "" },
+	{ "link", "" },
+	{ "location", "" },
+	{ "max-forwards", "" },
+	{ "proxy-authenticate", "" },
+	{ "proxy-authorization", "" },
+	{ "range", "" },
+	{ "referer", "" },
+	{ "refresh", "" },
+	{ "retry-after", "" },
+	{ "server", "" },
+	{ "set-cookie", "" },
+	{ "strict-transport-security", "" },
+	{ "transfer-encoding", "" },
+	{ "user-agent", "" },
+	{ "vary", "" },
+	{ "via", "" },
+	{ "www-authenticate", "" },
+};
+#define HPACK_STATIC_N (sizeof(k_static) / sizeof(k_static[0]))
+
+/* RFC 7541 Appendix B (EOS omitted: decoding it is an error). The code is
+   canonical, so decoding only needs the first code and symbol count of
+   each length (built once in huff_init). */
+static const uint32_t k_huff_code[256] = {
+	0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+	0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+	0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+	0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+	0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+	0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+	0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+	0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+	0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+	0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+	0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+	0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+	0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+	0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+	0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+	0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+	0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+	0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+	0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+	0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+	0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+	0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+	0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+	0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+	0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+	0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+	0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+	0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+	0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+	0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+	0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+	0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+};
+
+static const uint8_t k_huff_len[256] = {
+	13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+	28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+	6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+	5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+	13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+	15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+	6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+	20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+	24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+	22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+	21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+	26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+	19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+	20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+	26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+
+#define HUFF_MAXLEN 30
+
+static uint8_t  g_huff_sym[256];              // symbols ordered by (length, code)
+static uint32_t g_huff_first[HUFF_MAXLEN + 1];
+static uint16_t g_huff_count[HUFF_MAXLEN + 1];
+static uint16_t g_huff_index[HUFF_MAXLEN + 1];
+static pthread_once_t g_huff_once = PTHREAD_ONCE_INIT;
+
+
+// ---- Internal helpers ----
+
+static void huff_init(void) {
+	for (int s = 0; s < 256; s++) g_huff_count[k_huff_len[s]]++;
+	uint16_t idx = 0;
+	for (int l = 1; l <= HUFF_MAXLEN; l++) {
+		g_huff_index[l] = idx;
+		for (int s = 0; s < 256; s++)
+			if (k_huff_len[s] == l) g_huff_sym[idx++] = (uint8_t)s;
+		if (g_huff_count[l]) g_huff_first[l] = k_huff_code[g_huff_sym[g_huff_index[l]]];
+	}
+}
+
+static int dec_int(const uint8_t **p, const uint8_t *end, int prefix, size_t *out) {
+	if (*p >= end) return -1;
+	const unsigned max = (1u << prefix) - 1;
+	uint64_t v = **p & max;
+	(*p)++;
+	if (v < max) { *out = (size_t)v; return 0; }
+	for (unsigned shift = 0; *p < end && shift <= 28; shift += 7) {
+		uint8_t b = *(*p)++;
+		v += (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80)) { *out = (size_t)v; return 0; }
+	}
+	return -1;   // truncated or absurdly large
+}
+
+// Decode a string literal; the result points into 'blk' or into scratch.
+static int dec_str(const uint8_t **p, const uint8_t *end, char **scratch, size_t *scratch_left,
+                   const char **s, size_t *slen) {
+	if (*p >= end) return -1;
+	const int huff = (**p & 0x80) != 0;
+	size_t len;
+	if (dec_int(p, end, 7, &len) < 0 || len > (size_t)(end - *p) || len > HPACK_MAX_STRING) return -1;
+	if (!huff) {
+		*s = (const char *)*p;
+		*slen = len;
+	} else {
+		long n = hpack_huff_decode(*p, len, *scratch, *scratch_left);
+		if (n < 0) return -1;
+		*s = *scratch;
+		*slen = (size_t)n;
+		*scratch += n;
+		*scratch_left -= (size_t)n;
+	}
+	*p += len;
+	return 0;
+}
+
+static struct hpack_entry *dyn_at(struct hpack_dec *d, size_t i) {   // 0 = newest
+	return &d->ents[(d->head + d->cap - i) % d->cap];
+}
+
+static void evict_to(struct hpack_dec *d, size_t limit) {
+	while (d->n > 0 && d->size > limit) {
+		struct hpack_entry *e = dyn_at(d, d->n - 1);
+		d->size -= e->nlen + e->vlen + HPACK_ENTRY_OVERHEAD;
+		free(e->buf);
+		e->buf = NULL;
+		d->n--;
+	}
+}
+
+static int dyn_insert(struct hpack_dec *d, const char *name, size_t nlen,
+                      const char *value, size_t vlen) {
+	size_t esz = nlen + vlen + HPACK_ENTRY_OVERHEAD;
+	if (esz > d->max_size) { evict_to(d, 0); return 0; }   // RFC 7541 4.4
+
+	// Copy before evicting: 'name' may point into an entry about to go.
+	char *buf = (char *)malloc(nlen + vlen + 1);
+	if (!buf) return -1;
+	memcpy(buf, name, nlen);
+	memcpy(buf + nlen, value, vlen);
+	evict_to(d, d->max_size - esz);
+	d->head = (d->head + 1) % d->cap;
+	struct hpack_entry *e = &d->ents[d->head];
+	e->buf = buf;
+	e->nlen = nlen;
+	e->vlen = vlen;
+	d->n++;
+	d->size += esz;
+	return 0;
+}
+
+// Look up index 'idx' (1-based, static then dynamic).
+static int lookup(struct hpack_dec *d, size_t idx, const char **n, size_t *nlen,
+                  const char **v, size_t *vlen) {
+	if (idx == 0) return -1;
+	if (idx <= HPACK_STATIC_N) {
+		*n = k_static[idx - 1].name;   *nlen = strlen(*n);
+		*v = k_static[idx - 1].value;  *vlen = strlen(*v);
+		return 0;
+	}
+	idx -= HPACK_STATIC_N + 1;
+	if (idx >= d->n) return -1;
+	struct hpack_entry *e = dyn_at(d, idx);
+	*n = e->buf;            *nlen = e->nlen;
+	*v = e->buf + e->nlen;  *vlen = e->vlen;
+	return 0;
+}
+
+static int enc_int(uint8_t *out, size_t cap, size_t *off, size_t v, int prefix, uint8_t flags) {
+	const size_t max = (1u << prefix) - 1;
+	if (*off >= cap) return -1;
+	if (v < max) { out[(*off)++] = (uint8_t)(flags | v); return 0; }
+	out[(*off)++] = (uint8_t)(flags | max);
+	v -= max;
+	while (v >= 0x80) {
+		if (*off >= cap) return -1;
+		out[(*off)++] = (uint8_t)(0x80 | (v & 0x7f));
+		v >>= 7;
+	}
+	if (*off >= cap) return -1;
+	out[(*off)++] = (uint8_t)v;
+	return 0;
+}
+
+static int enc_str(uint8_t *out, size_t cap, size_t *off, const char *s, size_t len) {
+	if (enc_int(out, cap, off, len, 7, 0x00) < 0 || cap - *off < len) return -1;
+	memcpy(out + *off, s, len);
+	*off += len;
+	return 0;
+}
+
+
+//----- API ----------
+
+void hpack_dec_init(struct hpack_dec *d) {
+	memset(d, 0, sizeof(*d));
+	d->max_size = HPACK_TABLE_SIZE;
+	(void)pthread_once(&g_huff_once, huff_init);
+}
+
+void hpack_dec_free(struct hpack_dec *d) {
+	if (!d) return;
+	if (d->ents) evict_to(d, 0);
+	free(d->ents);
+	memset(d, 0, sizeof(*d));
+}
+
+long hpack_huff_decode(const uint8_t *in, size_t len, char *out, size_t outlen) {
+	size_t o = 0;
+	uint32_t code = 0;
+	int clen = 0;
+	for (size_t i = 0; i < len; i++) {
+		for (int b = 7; b >= 0; b--) {
+			code = (code << 1) | ((in[i] >> b) & 1u);
+			if (++clen > HUFF_MAXLEN) return -1;   // EOS or garbage
+			uint32_t k = code - g_huff_first[clen];
+			if (g_huff_count[clen] && code >= g_huff_first[clen] && k < g_huff_count[clen]) {
+				if (o >= outlen) return -1;
+				out[o++] = (char)g_huff_sym[g_huff_index[clen] + k];
+				code = 0;
+				clen = 0;
+			}
+		}
+	}
+	// Padding: at most 7 bits, all ones (a prefix of EOS).
+	if (clen > 7 || code != (1u << clen) - 1) return -1;
+	return (long)o;
+}
+
+int hpack_decode(struct hpack_dec *d, const uint8_t *blk, size_t len,
+                 hpack_field_fn fn, void *ctx) {
+	if (!d->ents) {
+		d->cap = HPACK_TABLE_SIZE / HPACK_ENTRY_OVERHEAD;   // most entries that can fit
+		d->ents = (struct hpack_entry *)calloc(d->cap, sizeof(*d->ents));
+		if (!d->ents) return -1;
+	}
+	// Huffman expands at most 8/5; every string of the block shares one scratch area.
+	size_t scratch_cap = len * 8 / 5 + 8;
+	char *scratch = (char *)malloc(scratch_cap);
+	if (!scratch) return -1;
+
+	const uint8_t *p = blk, *end = blk + len;
+	int rc = 0;
+	while (p < end && rc == 0) {
+		char *sp = scratch;
+		size_t sleft = scratch_cap;
+		const char *n = NULL, *v = NULL;
+		size_t nlen = 0, vlen = 0, idx;
+		uint8_t b = *p;
+
+		if (b & 0x80) {                                   // indexed field
+			if (dec_int(&p, end, 7, &idx) < 0 || lookup(d, idx, &n, &nlen, &v, &vlen) < 0) { rc = -1; break; }
+			if (fn(ctx, n, nlen, v, vlen)) rc = -1;
+		} else if ((b & 0xe0) == 0x20) {                  // table size update
+			if (dec_int(&p, end, 5, &idx) < 0 || idx > HPACK_TABLE_SIZE) { rc = -1; break; }
+			d->max_size = idx;
+			evict_to(d, idx);
+		} else {                                          // literal
+			const int incr = (b & 0xc0) == 0x40;
+			if (dec_int(&p, end, incr ? 6 : 4, &idx) < 0) { rc = -1; break; }
+			if (idx) {
+				const char *iv; size_t ivlen;
+				if (lookup(d, idx, &n, &nlen, &iv, &ivlen) < 0) { rc = -1; break; }
+			} else if (dec_str(&p, end, &sp, &sleft, &n, &nlen) < 0) {
+				rc = -1; break;
+			}
+			if (dec_str(&p, end, &sp, &sleft, &v, &vlen) < 0) { rc = -1; break; }
+			if (fn(ctx, n, nlen, v, vlen)) { rc = -1; break; }
+			if (incr && dyn_insert(d, n, nlen, v, vlen) < 0) rc = -1;
+		}
+	}
+	free(scratch);
+	return rc;
+}
+
+int hpack_enc_status(uint8_t *out, size_t cap, size_t *off, int status) {
+	for (size_t i = 7; i < 14; i++) {                     // static :status entries
+		if (atoi(k_static[i].value) == status)
+			return enc_int(out, cap, off, i + 1, 7, 0x80);
+	}
+	char s[4];
+	if (status < 100 || status > 999) { errno = EINVAL; return -1; }
+	s[0] = (char)('0' + status / 100);
+	s[1] = (char)('0' + status / 10 % 10);
+	s[2] = (char)('0' + status % 10);
+	if (enc_int(out, cap, off, 8, 4, 0x00) < 0) return -1;   // literal, name ":status"
+	return enc_str(out, cap, off, s, 3);
+}
+
+int hpack_enc_field(uint8_t *out, size_t cap, size_t *off,
+                    const char *name, const char *value, size_t vlen) {
+	for (size_t i = 0; i < HPACK_STATIC_N; i++) {
+		if (strcmp(k_static[i].name, name) == 0) {
+			if (enc_int(out, cap, off, i + 1, 4, 0x00) < 0) return -1;
+			return enc_str(out, cap, off, value, vlen);
+		}
+	}
+	if (enc_int(out, cap, off, 0, 4, 0x00) < 0) return -1;
+	if (enc_str(out, cap, off, name, strlen(name)) < 0) return -1;
+	return enc_str(out, cap, off, value, vlen);
+}
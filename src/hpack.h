@@ -0,0 +1,51 @@
+#ifndef MYHTTP_HPACK_H
+#define MYHTTP_HPACK_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint8_t, uint32_t
+
+/* HPACK (RFC 7541) for the HTTP/2 server.
+
+   Decoding is complete: static and dynamic tables, table size updates and
+   Huffman-coded strings. Encoding only emits what a server needs for small
+   response header sets: static-table hits and literals "without indexing",
+   never Huffman, so our dynamic table is never touched and the peer's
+   SETTINGS_HEADER_TABLE_SIZE does not matter. */
+
+#ifndef HPACK_TABLE_SIZE
+#define HPACK_TABLE_SIZE 4096   // our SETTINGS_HEADER_TABLE_SIZE (the default)
+#endif
+
+struct hpack_entry;
+
+struct hpack_dec {
+	struct hpack_entry *ents;   // ring buffer, newest at 'head'
+	size_t   cap, n, head;
+	size_t   size;              // RFC 7541 4.1 size of all entries
+	size_t   max_size;          // current limit (<= HPACK_TABLE_SIZE)
+};
+
+/* Called for each decoded field. Strings are not NUL-terminated and are only
+   valid during the call. Return non-zero to stop decoding. */
+typedef int (*hpack_field_fn)(void *ctx, const char *name, size_t nlen,
+                              const char *value, size_t vlen);
+
+void hpack_dec_init(struct hpack_dec *d);
+void hpack_dec_free(struct hpack_dec *d);
+
+/* Decode one complete header block. Returns 0, or -1 on a compression error
+   (the connection must then be torn down: the table is out of sync) or when
+   'fn' stopped early. */
+int  hpack_decode(struct hpack_dec *d, const uint8_t *blk, size_t len,
+                  hpack_field_fn fn, void *ctx);
+
+/* Decode a Huffman-coded string into out[0..outlen). Returns the decoded
+   length, or -1 on invalid input / insufficient room. */
+long hpack_huff_decode(const uint8_t *in, size_t len, char *out, size_t outlen);
+
+/* Encoder: append to out[*off..cap). Each returns 0, or -1 if out of room. */
+int  hpack_enc_status(uint8_t *out, size_t cap, size_t *off, int status);
+int  hpack_enc_field(uint8_t *out, size_t cap, size_t *off,
+                     const char *name, const char *value, size_t vlen);
+
+#endif /* MYHTTP_HPACK_H */
@@ -19,6 +19,9 @@ void myhttp_req_reset(struct myhttp_req *r) {
     r->h_host = NULL;
     r->h_connection = NULL;
     r->h_user_agent = NULL;
+    r->h_upgrade = NULL;
+    r->h_http2_settings = NULL;
+    r->h_accept = NULL;
 
     r->h_content_type = NULL;
     r->h_content_length = NULL;
@@ -84,7 +87,6 @@ int myhttp_parse_request(char *buf, size_t len, struct myhttp_req *out) {
     out->version = version_tok;
 
     /* --- Headers --- */
-    printf("HEADERS: \n");
     const char *hp = line_end + 2; /* first header line */
     while (hp < end) {
         /* End of headers? */
@@ -107,7 +109,6 @@ int myhttp_parse_request(char *buf, size_t len, struct myhttp_req *out) {
 
         /* NUL-terminate value at end-of-line and trim trailing OWS */
         rtrim_ows(val, (char *)hdr_end);
-	printf("[%s:%s]\t", hp, val);
         /* Case-insensitive match on header name by exact length */
         if (key_len == 4  && strncasecmp(hp, "Host", 4) == 0) {
             out->h_host = val;
@@ -121,6 +122,12 @@ int myhttp_parse_request(char *buf, size_t len, struct myhttp_req *out) {
             out->h_expect = val;
         } else if (key_len == 10 && strncasecmp(hp, "User-Agent", 10) == 0) {
             out->h_user_agent = val;
+        } else if (key_len == 7  && strncasecmp(hp, "Upgrade", 7) == 0) {
+            out->h_upgrade = val;
+        } else if (key_len == 14 && strncasecmp(hp, "HTTP2-Settings", 14) == 0) {
+            out->h_http2_settings = val;
+        } else if (key_len == 6  && strncasecmp(hp, "Accept", 6) == 0) {
+            out->h_accept = val;
         }
 
         hp = hdr_end + 2; /* next header line */
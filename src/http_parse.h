@@ -24,6 +24,9 @@ struct myhttp_req {
   char *h_host;
   char *h_connection;
   char *h_user_agent;
+  char *h_upgrade;          /* e.g., "h2c" */
+  char *h_http2_settings;   /* base64url SETTINGS payload (h2c upgrade) */
+  char *h_accept;
 
   /* Body-related (NULL if absent) */
   char *h_content_type;
@@ -0,0 +1,149 @@
+#define _GNU_SOURCE           // readahead, sync_file_range
+
+#include "iohint.h"
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define IOHINT_RECENT   64                        /* huge files remembered at once */
+#define IOHINT_REUSE_NS (60ull * 1000000000ull)   /* asked for again within this: not one-off */
+
+static struct {
+	size_t   readahead, drop_behind, write_behind;
+	uint64_t readahead_bytes, dropped_files, dropped_bytes, writebehind_bytes;
+
+	pthread_mutex_t mtx;   /* recent[] */
+	struct {
+		dev_t    dev;
+		ino_t    ino;
+		uint64_t last_ns;    // last stream started
+		int      active;     // streams in progress
+	} recent[IOHINT_RECENT];
+} g_io = {
+	.readahead = IOHINT_READAHEAD,
+	.drop_behind = IOHINT_DROP_BEHIND,
+	.write_behind = IOHINT_WRITE_BEHIND,
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+};
+
+
+// ---- Internal helpers ----
+
+/* Note a stream of a drop-behind candidate starting: whether it was
+   streamed recently, and the slot tracking it (0: none free, keep it). */
+static void track_begin(struct iohint_read *h) {
+	struct stat st;
+	if (fstat(h->fd, &st) < 0) return;
+	const size_t i = (size_t)(((uint64_t)st.st_ino * 0x9e3779b97f4a7c15ull >> 32) % IOHINT_RECENT);
+	pthread_mutex_lock(&g_io.mtx);
+	if (g_io.recent[i].dev == st.st_dev && g_io.recent[i].ino == st.st_ino) {
+		h->reused = g_io.recent[i].active > 0 || h->start_ns - g_io.recent[i].last_ns < IOHINT_REUSE_NS;
+	} else if (g_io.recent[i].active == 0) {
+		g_io.recent[i].dev = st.st_dev;
+		g_io.recent[i].ino = st.st_ino;
+	} else {
+		pthread_mutex_unlock(&g_io.mtx);   // another file streaming: don't guess
+		return;
+	}
+	g_io.recent[i].last_ns = h->start_ns;
+	g_io.recent[i].active++;
+	h->slot = (int)i + 1;
+	pthread_mutex_unlock(&g_io.mtx);
+}
+
+/* Whether the stream ending may drop the file: nobody asked for it
+   before, nor started streaming it since. */
+static int track_end(const struct iohint_read *h) {
+	const size_t i = (size_t)(h->slot - 1);
+	pthread_mutex_lock(&g_io.mtx);
+	g_io.recent[i].active--;
+	const int drop = !h->reused && g_io.recent[i].last_ns == h->start_ns && g_io.recent[i].active == 0;
+	pthread_mutex_unlock(&g_io.mtx);
+	return drop;
+}
+
+
+//----- API ----------
+
+void iohint_configure(size_t readahead, size_t drop_behind, size_t write_behind) {
+	__atomic_store_n(&g_io.readahead, readahead, __ATOMIC_RELAXED);
+	__atomic_store_n(&g_io.drop_behind, drop_behind, __ATOMIC_RELAXED);
+	__atomic_store_n(&g_io.write_behind, write_behind, __ATOMIC_RELAXED);
+}
+
+void iohint_read_begin(struct iohint_read *h, int fd, size_t size) {
+	memset(h, 0, sizeof(*h));
+	h->fd = fd;
+	h->size = size;
+	const size_t win = __atomic_load_n(&g_io.readahead, __ATOMIC_RELAXED);
+	const size_t drop = __atomic_load_n(&g_io.drop_behind, __ATOMIC_RELAXED);
+	if (win && size > win) {
+		h->win = win;
+		(void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+	if (drop && size >= drop) {
+		h->start_ns = metrics_now_ns();
+		track_begin(h);
+	}
+}
+
+size_t iohint_read_at(struct iohint_read *h, size_t off) {
+	if (!h->win) return h->size - off;
+	/* Once the front is less than a window past the cursor, extend it to
+	   two: one syscall per window whatever the caller's chunk size. */
+	if (h->ahead < off) h->ahead = off;
+	if (h->ahead < off + h->win && h->ahead < h->size) {
+		size_t want = off + 2 * h->win;
+		if (want > h->size) want = h->size;
+		(void)readahead(h->fd, (off_t)h->ahead, want - h->ahead);
+		__atomic_add_fetch(&g_io.readahead_bytes, want - h->ahead, __ATOMIC_RELAXED);
+		h->ahead = want;
+	}
+	return off + h->win < h->size ? h->win : h->size - off;
+}
+
+void iohint_read_end(struct iohint_read *h, size_t sent) {
+	if (!h->slot) return;
+	if (track_end(h) && sent == h->size && posix_fadvise(h->fd, 0, 0, POSIX_FADV_DONTNEED) == 0) {
+		__atomic_add_fetch(&g_io.dropped_files, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&g_io.dropped_bytes, h->size, __ATOMIC_RELAXED);
+	}
+	h->slot = 0;
+}
+
+void iohint_write_begin(struct iohint_write *w, int fd) {
+	memset(w, 0, sizeof(*w));
+	w->fd = fd;
+	w->win = __atomic_load_n(&g_io.write_behind, __ATOMIC_RELAXED);
+}
+
+void iohint_write_done(struct iohint_write *w, size_t n) {
+	if (!w->win) return;
+	w->pending += n;
+	if (w->pending < w->win) return;
+
+	// The file offset is past what was just written (O_APPEND included).
+	const off_t end = lseek(w->fd, 0, SEEK_CUR);
+	if (end < (off_t)w->pending) { w->win = 0; return; }
+	const off_t off = end - (off_t)w->pending;
+	(void)sync_file_range(w->fd, off, (off_t)w->pending, SYNC_FILE_RANGE_WRITE);
+	if (w->prev_len)
+		(void)sync_file_range(w->fd, w->prev_off, (off_t)w->prev_len,
+		                      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+		                      SYNC_FILE_RANGE_WAIT_AFTER);
+	__atomic_add_fetch(&g_io.writebehind_bytes, w->pending, __ATOMIC_RELAXED);
+	w->prev_off = off;
+	w->prev_len = w->pending;
+	w->pending = 0;
+}
+
+void iohint_get_stats(struct iohint_stats *out) {
+	out->readahead_bytes = __atomic_load_n(&g_io.readahead_bytes, __ATOMIC_RELAXED);
+	out->dropped_files = __atomic_load_n(&g_io.dropped_files, __ATOMIC_RELAXED);
+	out->dropped_bytes = __atomic_load_n(&g_io.dropped_bytes, __ATOMIC_RELAXED);
+	out->writebehind_bytes = __atomic_load_n(&g_io.writebehind_bytes, __ATOMIC_RELAXED);
+}
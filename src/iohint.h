@@ -0,0 +1,82 @@
+#ifndef MYHTTP_IOHINT_H
+#define MYHTTP_IOHINT_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+#include <sys/types.h>  // off_t
+
+/* Page-cache hints for large transfers.
+
+   Downloads of files larger than the readahead window are read
+   sequentially (POSIX_FADV_SEQUENTIAL) with an explicit readahead() kept
+   one window ahead of the send cursor, so sendfile() finds its pages
+   resident instead of waiting on the kernel's small default window.
+   Files of at least the drop-behind size are dropped from the page cache
+   (POSIX_FADV_DONTNEED) once streamed, unless they were asked for again
+   recently or by someone else meanwhile: a one-off huge download should
+   not evict the hot set.
+
+   Uploads start writeback of each window as soon as it is written
+   (sync_file_range()) and wait for the window before it, so dirty pages
+   stay bounded to two windows per upload instead of piling up until the
+   final fsync() and stalling unrelated reads behind a flush. */
+
+#ifndef IOHINT_READAHEAD
+#define IOHINT_READAHEAD    (1u << 20)    /* readahead window; 0 disables read hints */
+#endif
+
+#ifndef IOHINT_DROP_BEHIND
+#define IOHINT_DROP_BEHIND  (64u << 20)   /* drop files this large after streaming; 0 never */
+#endif
+
+#ifndef IOHINT_WRITE_BEHIND
+#define IOHINT_WRITE_BEHIND (1u << 20)    /* upload writeback window; 0 disables */
+#endif
+
+/* Set the three sizes above (reloadable; applies to the next transfer). */
+void   iohint_configure(size_t readahead, size_t drop_behind, size_t write_behind);
+
+/* One file download. A zeroed struct is a valid "no hints" state. */
+struct iohint_read {
+	int      fd;
+	size_t   size;
+	size_t   win;        // readahead window; 0 = no hints for this file
+	size_t   ahead;      // readahead issued up to here
+	uint64_t start_ns;
+	int      slot;       // recent-streams slot + 1; 0 = not tracked for drop-behind
+	int      reused;     // streamed recently or concurrently: keep it cached
+};
+
+void   iohint_read_begin(struct iohint_read *h, int fd, size_t size);
+
+/* About to send from 'off': keep readahead one window past it. Returns
+   how many bytes to send from 'off' before calling again. */
+size_t iohint_read_at(struct iohint_read *h, size_t off);
+
+/* Done with the file ('sent' bytes went out); drops it if it qualifies. */
+void   iohint_read_end(struct iohint_read *h, size_t sent);
+
+/* One upload into 'fd', written sequentially. */
+struct iohint_write {
+	int    fd;
+	size_t win;          // 0 = no write-behind
+	size_t pending;      // written since the last window was started
+	off_t  prev_off;     // window started last, to wait for next time
+	size_t prev_len;
+};
+
+void   iohint_write_begin(struct iohint_write *w, int fd);
+
+/* 'n' more bytes were written at the file offset. */
+void   iohint_write_done(struct iohint_write *w, size_t n);
+
+struct iohint_stats {
+	uint64_t readahead_bytes;     // requested ahead of downloads
+	uint64_t dropped_files;       // streamed, then dropped from the page cache
+	uint64_t dropped_bytes;
+	uint64_t writebehind_bytes;   // upload bytes pushed to disk early
+};
+
+void   iohint_get_stats(struct iohint_stats *out);
+
+#endif /* MYHTTP_IOHINT_H */
@@ -0,0 +1,117 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "iopool.h"
+#include "metrics.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+
+static struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t  more;      /* a task was queued, or a thread dismissed */
+	struct iopool_task *head, *tail;
+	size_t   queued;
+	size_t   busy;
+	int      target;           /* started and not dismissed (stored atomically) */
+	int      retire;           /* threads still to leave */
+	uint64_t tasks;
+} g_iop = { .mtx = PTHREAD_MUTEX_INITIALIZER, .more = PTHREAD_COND_INITIALIZER };
+
+
+// ---- Internal helpers ----
+
+/* Run tasks until dismissed. The queue is drained before anyone leaves,
+   so shrinking (even to none) never strands a task. */
+static void *io_thread_main(void *arg) {
+	(void)arg;
+	pthread_mutex_lock(&g_iop.mtx);
+	for (;;) {
+		while (!g_iop.head && g_iop.retire == 0)
+			pthread_cond_wait(&g_iop.more, &g_iop.mtx);
+		if (!g_iop.head) {
+			g_iop.retire--;
+			break;
+		}
+		struct iopool_task *t = g_iop.head;
+		g_iop.head = t->next;
+		if (!g_iop.head) g_iop.tail = NULL;
+		g_iop.queued--;
+		g_iop.busy++;
+		pthread_mutex_unlock(&g_iop.mtx);
+		metrics_observe_io_wait(metrics_now_ns() - t->enq_ns);
+
+		t->fn(t);   // may free 't'
+
+		pthread_mutex_lock(&g_iop.mtx);
+		g_iop.busy--;
+		g_iop.tasks++;
+	}
+	pthread_mutex_unlock(&g_iop.mtx);
+	return NULL;
+}
+
+
+//----- API ----------
+
+int iopool_resize(int n) {
+	if (n < 0) n = 0;
+	if (n > IOPOOL_MAX) n = IOPOOL_MAX;
+	pthread_mutex_lock(&g_iop.mtx);
+	if (g_iop.target < n) {
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		pthread_attr_setstacksize(&attr, IOPOOL_STACK_SZ);
+		while (g_iop.target < n) {
+			pthread_t tid;
+			if (g_iop.retire > 0) {
+				g_iop.retire--;      // a thread still to leave stays instead
+			} else if (pthread_create(&tid, &attr, io_thread_main, NULL) != 0) {
+				fprintf(stderr, "pthread_create failed (I/O thread %d)\n", g_iop.target);
+				break;
+			}
+			__atomic_store_n(&g_iop.target, g_iop.target + 1, __ATOMIC_RELAXED);
+		}
+		pthread_attr_destroy(&attr);
+	}
+	if (g_iop.target > n) {
+		g_iop.retire += g_iop.target - n;
+		__atomic_store_n(&g_iop.target, n, __ATOMIC_RELAXED);
+		pthread_cond_broadcast(&g_iop.more);
+	}
+	n = g_iop.target;
+	pthread_mutex_unlock(&g_iop.mtx);
+	return n;
+}
+
+int iopool_size(void) {
+	return __atomic_load_n(&g_iop.target, __ATOMIC_RELAXED);   // asked per request
+}
+
+int iopool_submit(struct iopool_task *t) {
+	t->next = NULL;
+	t->enq_ns = metrics_now_ns();
+	pthread_mutex_lock(&g_iop.mtx);
+	if (g_iop.target == 0) {
+		pthread_mutex_unlock(&g_iop.mtx);
+		errno = EAGAIN;
+		return -1;
+	}
+	if (g_iop.tail) g_iop.tail->next = t;
+	else            g_iop.head = t;
+	g_iop.tail = t;
+	g_iop.queued++;
+	pthread_cond_signal(&g_iop.more);
+	pthread_mutex_unlock(&g_iop.mtx);
+	return 0;
+}
+
+void iopool_get_stats(struct iopool_stats *out) {
+	pthread_mutex_lock(&g_iop.mtx);
+	out->threads = g_iop.target;
+	out->queued = g_iop.queued;
+	out->busy = g_iop.busy;
+	out->tasks = g_iop.tasks;
+	pthread_mutex_unlock(&g_iop.mtx);
+}
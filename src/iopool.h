@@ -0,0 +1,58 @@
+#ifndef MYHTTP_IOPOOL_H
+#define MYHTTP_IOPOOL_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+/* Blocking-I/O thread pool, sized apart from the network workers.
+
+   Filesystem steps that may sit on the disk (an upload's temp file
+   creation, its fsync and rename; the path walk and open of a GET not in
+   the dentry cache, or the opendir of a listing) are handed here, so a
+   slow or stalled disk ties up these threads instead of the network
+   workers. Socket reads and writes never run here: a slow client holds
+   its network worker, not an I/O thread. A task is an intrusive node:
+   submitting never allocates, and the owner of the task decides where its
+   result goes when 'fn' runs (main.c sends the connection back to its
+   worker queue to finish the request). */
+
+#ifndef IOPOOL_THREADS
+#define IOPOOL_THREADS   4            /* default pool size; 0 = none */
+#endif
+
+#ifndef IOPOOL_MAX
+#define IOPOOL_MAX       256
+#endif
+
+#ifndef IOPOOL_STACK_SZ
+#define IOPOOL_STACK_SZ  (256 * 1024) /* tasks serve requests, as workers do */
+#endif
+
+struct iopool_task {
+	struct iopool_task *next;               // queue link, owned by the pool
+	void              (*fn)(struct iopool_task *t);
+	uint64_t            enq_ns;             // set by iopool_submit()
+};
+
+/* Grow or shrink to 'n' threads (idle ones leave first; busy ones finish
+   their task). Returns the size in effect, which may fall short of 'n' if
+   threads can't be created. */
+int    iopool_resize(int n);
+
+/* Threads started and not dismissed. */
+int    iopool_size(void);
+
+/* Queue 't' (its 'fn' set); one of the threads runs it. Returns 0, or -1
+   with errno = EAGAIN when the pool has no threads. */
+int    iopool_submit(struct iopool_task *t);
+
+struct iopool_stats {
+	int      threads;
+	size_t   queued;       // submitted, not yet picked up
+	size_t   busy;         // running a task
+	uint64_t tasks;        // run to completion
+};
+
+void   iopool_get_stats(struct iopool_stats *out);
+
+#endif /* MYHTTP_IOPOOL_H */
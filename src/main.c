@@ -1,8 +1,31 @@
 #define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE           // memmem, realpath
 
 #include "http_parse.h"
 #include "workq.h"
 #include "fs.h"
+#include "dcache.h"
+#include "metrics.h"
+#include "conn.h"
+#include "arena.h"
+#include "allochook.h"
+#include "reply.h"
+#include "h2.h"
+#include "tls.h"
+#include "admit.h"
+#include "topo.h"
+#include "config.h"
+#include "bufpool.h"
+#include "pathlock.h"
+#include "upgrade.h"
+#include "manifest.h"
+#include "bundle.h"
+#include "iohint.h"
+#include "iopool.h"
+#include "trace.h"
+#include "hotkeys.h"
+#include "batch.h"
+#include "cas.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,44 +36,71 @@
 #include <strings.h>
 
 #include <unistd.h>           // close, write, access
-#include <signal.h>           // signal, SIGPIPE
+#include <signal.h>           // signal, SIGPIPE, sigwait
 #include <arpa/inet.h>        // inet_ntop, htons, htonl
 #include <netinet/in.h>       // sockaddr_in, sockaddr_in6
 #include <sys/socket.h>       // socket, bind, listen, accept, recv, send
+#include <poll.h>             // poll (several listeners)
+#include <fcntl.h>            // fcntl
 #include <sys/stat.h>         // stat, fstat
 #include <limits.h>           // PATH_MAX
+#include <stddef.h>           // offsetof
 #include <pthread.h>          // pthreads
+#include <time.h>             // clock_gettime (drain deadline)
 
-#ifndef BACKLOG
-#define BACKLOG 128
+/* Request scratch lives in the per-connection arena and I/O buffers come
+   from the buffer pool, so workers don't need the default 8 MiB stack. */
+#ifndef WORKER_STACK_SZ
+#define WORKER_STACK_SZ (256 * 1024)
 #endif
 
-#ifndef RECV_BUF_SZ
-#define RECV_BUF_SZ (64 * 1024)
+/* Accept loops at most (one per NUMA node with --reuseport). */
+#ifndef MAX_ACCEPTORS
+#define MAX_ACCEPTORS 64
 #endif
 
-#ifndef N_WORKERS
-#define N_WORKERS 8
-#endif
+static char g_docroot[PATH_MAX];   /* realpath() of the configured root */
 
-struct config {
-	int         port;
-	const char *dir;
+/* Tunables read per connection; a reload stores new values atomically. */
+static struct conn_timeouts g_timeouts = {
+	.idle_ms = IDLE_TIMEOUT_MS, .header_ms = HEADER_TIMEOUT_MS,
+	.body_ms = BODY_TIMEOUT_MS, .write_ms = WRITE_TIMEOUT_MS,
 };
+static size_t g_recv_buf = RECV_BUF_SZ;
+
+/* The configuration in effect and how the last reload went (CONFIG_URL). */
+static struct {
+	pthread_mutex_t   mtx;
+	struct mh_config  cur;        // effective values
+	struct mh_config  boot;       // as built at startup: restart-only keys compare to it
+	int               argc;       // command line, re-applied over the file on reload
+	char            **argv;
+	unsigned          reloads;
+	char              last[320];  // "ok", or why not
+} g_rt = { .mtx = PTHREAD_MUTEX_INITIALIZER, .last = "none" };
+
+/* Binary upgrade (upgrade.h): once a successor has the listeners, the
+   accept loops stop and connections waiting between requests are ended. */
+#ifndef IDLE_SLOTS
+#define IDLE_SLOTS (2 * MAX_WORKERS)   /* dismissed workers may still be finishing */
+#endif
+#ifndef UPGRADE_WARM_MAX
+#define UPGRADE_WARM_MAX (1u << 20)    /* bytes of hot cache keys handed over */
+#endif
+static struct {
+	int             sock;              /* listening for a successor; -1: none */
+	int             wake[2];           /* written once on handoff; -1: upgrades off */
+	pthread_mutex_t mtx;               /* guards idle[] and draining */
+	int             draining;
+	int             idle[IDLE_SLOTS];  /* fd + 1 of connections between requests; 0: free */
+} g_upg = { .sock = -1, .wake = { -1, -1 }, .mtx = PTHREAD_MUTEX_INITIALIZER };
 
-static char g_docroot[PATH_MAX];   /* realpath() of the configured root */
+/* Status of the response the current worker is sending (for metrics). */
+static _Thread_local int tl_status;
 
 static void usage(const char *prog) {
-	fprintf(stderr, "Usage: %s [-p port] [-d root]\n", prog);
-	fprintf(stderr, "Defaults: port=8080, root='.'\n");
-}
-
-static int parse_int(const char *s) {
-	char *end = NULL;
-	long v = strtol(s, &end, 10);
-	if (!s[0] || (end && *end != '\0') || v < 1 || v > 65535)
-		return -1;
-	return (int)v;
+	fprintf(stderr, "Usage: %s [--config file] [-p port] [-d root] [--<key> <value> ...]\n", prog);
+	config_usage(stderr);
 }
 
 static const char *peer_to_str(const struct sockaddr_storage *ss, char *out, size_t outlen, int *port_out) {
@@ -74,28 +124,28 @@ static const char *peer_to_str(const struct sockaddr_storage *ss, char *out, siz
 	return out;
 }
 
-static int send_simple_response(int fd, int code, const char *reason, const char *body) {
-	char hdr[256];
-	size_t blen = body ? strlen(body) : 0;
-	int n = snprintf(hdr, sizeof(hdr),
-        	"HTTP/1.1 %d %s\r\n"
-		"Content-Length: %zu\r\n"
-		"Content-Type: text/plain; charset=utf-8\r\n"
-		"Connection: keep-alive\r\n"
-		"\r\n",
-		code, reason, blen);
-	if (n < 0 || (size_t)n >= sizeof(hdr)) return -1;
-
-	if (send(fd, hdr, (size_t)n, 0) < 0) return -1;
-	if (blen && send(fd, body, blen, 0) < 0) return -1;
+static int send_reply(struct mh_conn *c, struct mh_reply *r);
+static int pool_running(void);
+
+/* Queue a small response on the connection's output batch.
+   'body' must be static storage (string literal): it is queued by reference. */
+static int send_simple_response(struct mh_conn *c, int code, const char *reason, const char *body) {
+	struct mh_reply r;
+	reply_text(&r, code, reason, body);
+	return send_reply(c, &r);
+}
+
+/* reply_text() for handlers that return as they answer. */
+static int reply_status(struct mh_reply *r, int code, const char *reason, const char *body) {
+	reply_text(r, code, reason, body);
 	return 0;
 }
 
 /* Split request-target into a path (no query/fragment), then percent-decode in place. */
-static int extract_decoded_path(const struct myhttp_req *req, char *out, size_t outlen) {
-	if (!req->target) { errno = EINVAL; return -1; }
+static int extract_decoded_path(const char *target, char *out, size_t outlen) {
+	if (!target) { errno = EINVAL; return -1; }
 	size_t n = 0;
-	const char *t = req->target;
+	const char *t = target;
 	while (*t && *t != '?' && *t != '#') {
 		if (n + 1 >= outlen) { errno = ENAMETOOLONG; return -1; }
 		out[n++] = *t++;
@@ -141,402 +191,1395 @@ static int connection_should_close(const struct myhttp_req *r) {
 	return is_http10 ? 1 : 0;
 }
 
-/* Serve a resolved absolute path (may be file or directory).
-   Uses your fs_join_safe, fs_try_index, fs_open_ro, fs_mime_from_path, fs_send_dir_listing. */
-static int serve_resolved_path(int client_fd, const char *docroot_real,
-                               const char *decoded_path) {
-	char abs[PATH_MAX];
-	if (fs_join_safe(docroot_real, decoded_path, abs, sizeof(abs)) < 0) {
-		if (errno == EACCES) return send_simple_response(client_fd, 403, "Forbidden", "forbidden\n");
-		return send_simple_response(client_fd, 404, "Not Found", "not found\n");
+/* Resolve a decoded URL path to what it names on disk (see enum dcache_kind),
+   consulting the dentry cache first. On DC_FILE/DC_INDEX/DC_DIR 'abs' gets the
+   canonical path. Returns -1 (errno set) on errors that must not be cached. */
+static int resolve_path(struct mh_arena *a, const char *docroot_real,
+                        const char *decoded_path, char *abs, size_t abslen) {
+	int kind = dcache_lookup(decoded_path, abs, abslen);
+	if (kind != DC_MISS) return kind;
+
+	const uint64_t gen = dcache_generation();
+
+	/* Not resolved since the last change: the manifest may still know it
+	   without walking the path. */
+	kind = manifest_lookup(decoded_path, abs, abslen);
+	if (kind != DC_MISS) {
+		dcache_store(decoded_path, kind, abs, gen);
+		return kind;
+	}
+
+	if (fs_join_safe_arena(a, docroot_real, decoded_path, abs, abslen) < 0) {
+		if (errno == EACCES) kind = DC_FORBIDDEN;
+		else if (errno == ENOENT || errno == EINVAL || errno == ENOTDIR) kind = DC_NOENT;
+		else return -1;
+		dcache_store(decoded_path, kind, NULL, gen);
+		return kind;
 	}
 
 	int isdir = fs_is_dir(abs);
 	if (isdir < 0) {
-		if (errno == ENOENT) return send_simple_response(client_fd, 404, "Not Found", "not found\n");
-		return send_simple_response(client_fd, 403, "Forbidden", "forbidden\n");
+		if (errno == ENOENT || errno == ENOTDIR) kind = DC_NOENT;
+		else if (errno == EACCES) kind = DC_FORBIDDEN;
+		else return -1;
+		dcache_store(decoded_path, kind, NULL, gen);
+		return kind;
 	}
 
 	if (isdir == 1) {
-		char indexed[PATH_MAX];
-		int tri = fs_try_index(abs, "index.html", indexed, sizeof(indexed));
-	if (tri == 1) {
-		/* Found index.html -> serve it */
-		int fd = fs_open_ro(indexed);
-		if (fd < 0) return send_simple_response(client_fd, 403, "Forbidden", "forbidden\n");
-		struct stat st; fstat(fd, &st);
-		const char *mime = fs_mime_from_path(indexed);
-		char hdr[512];
-		int n = snprintf(hdr, sizeof(hdr),
-				"HTTP/1.1 200 OK\r\n"
-				"Content-Length: %zu\r\n"
-				"Content-Type: %s\r\n"
-				"Connection: keep-alive\r\n"
-				"\r\n",
-				(size_t)st.st_size, mime);
-		if (n < 0 || (size_t)n >= sizeof(hdr)) { close(fd); return -1; }
-		if (send(client_fd, hdr, (size_t)n, 0) < 0) { close(fd); return -1; }
-
-		char buf[64 * 1024];
-		ssize_t r;
-		while ((r = read(fd, buf, sizeof(buf))) > 0) {
-			ssize_t w = 0;
-			while (w < r) {
-				ssize_t s = send(client_fd, buf + w, (size_t)(r - w), 0);
-				if (s <= 0) { close(fd); return -1; }
-				w += s;
-			}
+		char *indexed = (char *)arena_alloc(a, PATH_MAX);
+		if (!indexed) return -1;
+		int tri = fs_try_index(abs, "index.html", indexed, PATH_MAX);
+		if (tri < 0) return -1;
+		if (tri == 1) {
+			size_t ilen = strlen(indexed) + 1;
+			if (ilen > abslen) { errno = ENAMETOOLONG; return -1; }
+			memcpy(abs, indexed, ilen);
+			kind = DC_INDEX;
+		} else {
+			kind = DC_DIR;
 		}
-		close(fd);
-		return (r < 0) ? -1 : 0;
-	} else if (tri == 0) {
-		/* No index -> directory listing. Send header (no len), then HTML via fs_send_dir_listing. */
-		const char *hdr =
+	} else {
+		kind = DC_FILE;
+	}
+	dcache_store(decoded_path, kind, abs, gen);
+	return kind;
+}
+
+/* hot_resolve_fn: resolve_path() for the pinning thread, with its own
+   arena. Paths the bundle holds are in memory already. */
+static int hot_resolve(const char *key, char *abs, size_t abslen) {
+	static struct mh_arena a;
+	static int have_arena;
+	if (!have_arena && arena_init(&a, 16 * 1024) < 0) return -1;
+	have_arena = 1;
+	if (bundle_holds(key)) return DC_MISS;
+	const int kind = resolve_path(&a, g_docroot, key, abs, abslen);
+	arena_reset(&a);
+	return kind;
+}
+
+/* 200 reply for an open file; takes ownership of 'fd'. */
+static int reply_open_file(struct mh_reply *r, int fd, const char *abs) {
+	struct stat st;
+	if (fstat(fd, &st) < 0) { close(fd); return -1; }
+	reply_init(r);
+	r->status = 200;
+	r->reason = "OK";
+	r->ctype = fs_mime_from_path(abs);
+	r->fd = fd;
+	r->file_len = (size_t)st.st_size;
+	return 0;
+}
+
+/* 200 reply for a pinned file (hotkeys.h): its contents from memory, or a
+   duplicate of its descriptor for large ones. Takes the reference. */
+static int reply_pinned(struct mh_reply *r, struct hot_pin *p) {
+	reply_init(r);
+	r->status = 200;
+	r->reason = "OK";
+	r->ctype = p->ctype;
+	if (p->data) {
+		r->body = p->data;
+		r->body_len = p->size;
+		r->pin = p;
+		return 0;
+	}
+	r->fd = fcntl(p->fd, F_DUPFD_CLOEXEC, 0);
+	r->file_len = p->size;
+	hot_release(p);
+	if (r->fd < 0) return reply_status(r, 500, "Internal Server Error", "open failed\n");
+	return 0;
+}
+
+/* Queue a file body: small ones are read straight into the output batch,
+   larger ones go out with sendfile() after the batch is flushed. */
+static int queue_file(struct mh_conn *c, int fd, size_t size) {
+	char *dst;
+	if (size <= CONN_INLINE_MAX && (dst = conn_stage_reserve(c, size)) != NULL) {
+		size_t got = 0;
+		while (got < size) {
+			ssize_t r = pread(fd, dst + got, size - got, (off_t)got);
+			if (r < 0 && errno == EINTR) continue;
+			if (r <= 0) break;
+			got += (size_t)r;
+		}
+		/* A short read means the file shrank: the framing is already promised. */
+		if (got < size) { errno = EIO; return -1; }
+		conn_stage_commit(c, size);
+		return 0;
+	}
+	/* Large: sendfile() a readahead window at a time (iohint.h). */
+	struct iohint_read io;
+	iohint_read_begin(&io, fd, size);
+	size_t off = 0;
+	int rc = 0;
+	while (rc == 0 && off < size) {
+		const size_t n = iohint_read_at(&io, off);
+		rc = conn_sendfile(c, fd, (off_t)off, n);
+		if (rc == 0) off += n;
+	}
+	iohint_read_end(&io, off);
+	return rc;
+}
+
+/* fs.c listing/upload callbacks over the connection (plain or TLS). */
+static int conn_sink(void *ctx, const void *buf, size_t len) {
+	return conn_queue_copy((struct mh_conn *)ctx, buf, len);
+}
+
+static ssize_t conn_source(void *ctx, void *buf, size_t len) {
+	return conn_read((struct mh_conn *)ctx, buf, len);
+}
+
+/* Frame 'r' as HTTP/1.1 on the output batch, then release it.
+   Returns 0, -1 on error, or -2 after a directory listing (the body is
+   close-delimited, so the caller must close the connection). */
+static int send_reply(struct mh_conn *c, struct mh_reply *r) {
+	tl_status = r->status;
+	int rc = 0;
+
+	if (r->dir_abs) {
+		/* No length known up front: header, then the HTML queued as it is generated. */
+		static const char hdr[] =
 			"HTTP/1.1 200 OK\r\n"
 			"Content-Type: text/html; charset=utf-8\r\n"
 			"Connection: close\r\n"
 			"\r\n";
-		if (send(client_fd, hdr, strlen(hdr), 0) < 0) return -1;
+		if (conn_queue_ref(c, hdr, sizeof(hdr) - 1) < 0) {
+			rc = -1;
+		} else {
+			(void)fs_dir_listing(&c->arena, r->dir_abs, r->dir_disp, conn_sink, c);
+			rc = -2;
+		}
+		reply_done(r);
+		return rc;
+	}
 
-		/* Use requested path for display */
-		const char *disp = (decoded_path && decoded_path[0]) ? decoded_path : "/";
-            	(void)fs_send_dir_listing(client_fd, abs, disp);
+	const size_t len = r->fd >= 0 ? r->file_len : r->body_len;
+	char *hdr = conn_stage_reserve(c, 512);
+	int n = hdr ? snprintf(hdr, 512,
+			"HTTP/1.1 %d %s\r\n"
+			"Content-Length: %zu\r\n"
+			"Content-Type: %s\r\n"
+			"%s%s%s"
+			"Connection: keep-alive\r\n"
+			"\r\n",
+			r->status, r->reason, len, r->ctype,
+			r->etag ? "ETag: " : "", r->etag ? r->etag : "", r->etag ? "\r\n" : "") : -1;
+	if (n < 0 || n >= 512) {
+		rc = -1;
+	} else {
+		conn_stage_commit(c, (size_t)n);
+		if (r->fd >= 0)       rc = queue_file(c, r->fd, len);
+		else if (r->pin && len > CONN_INLINE_MAX) rc = queue_file(c, r->pin->fd, len);
+		else if (r->body_owned || r->pin) rc = conn_queue_copy(c, r->body, len);
+		else                  rc = conn_queue_ref(c, r->body, len);
+	}
+	reply_done(r);
+	return rc;
+}
 
-            	return -2; /* signal caller to close connection */
-        	} else {
-            		return send_simple_response(client_fd, 500, "Internal Server Error", "index lookup failed\n");
-        	}
-    	}
+/* Build the reply for a resolved absolute path (may be file or directory).
+   The asset bundle answers first, from its mapping, then the pinned hot
+   files; otherwise resolution goes through resolve_path(); then
+   fs_open_ro, fs_mime_from_path, or a directory listing. Returns 0 with 'rep' filled, -1 on fatal errors. */
+static int serve_resolved_path(struct mh_arena *a, const char *docroot_real,
+                               const char *decoded_path, struct mh_reply *rep) {
+	struct bundle_entry be;
+	if (bundle_lookup(decoded_path, &be)) {
+		reply_init(rep);
+		rep->status = 200;
+		rep->reason = "OK";
+		rep->ctype = be.ctype;
+		rep->etag = be.etag;
+		rep->body = be.data;   // mapped until exit: queued by reference
+		rep->body_len = be.len;
+		return 0;
+	}
+
+	hot_observe(decoded_path);
+	struct hot_pin *pin = hot_lookup(decoded_path);
+	if (pin) return reply_pinned(rep, pin);
+
+	char *abs = (char *)arena_alloc(a, PATH_MAX);
+	if (!abs) return reply_status(rep, 500, "Internal Server Error", "out of memory\n");
+	const uint64_t tr = trace_begin(TR_RESOLVE);
+	int kind = resolve_path(a, docroot_real, decoded_path, abs, PATH_MAX);
+	trace_end(TR_RESOLVE, tr);
+	if (kind == DC_NOENT)     return reply_status(rep, 404, "Not Found", "not found\n");
+	if (kind == DC_FORBIDDEN) return reply_status(rep, 403, "Forbidden", "forbidden\n");
+	if (kind < 0) {
+		if (errno == ENOENT) return reply_status(rep, 404, "Not Found", "not found\n");
+		if (errno == EACCES) return reply_status(rep, 403, "Forbidden", "forbidden\n");
+		return reply_status(rep, 500, "Internal Server Error", "index lookup failed\n");
+	}
+
+	if (kind == DC_INDEX) {
+		/* Found index.html -> serve it */
+		int fd = fs_open_ro(abs);
+		if (fd < 0) return reply_status(rep, 403, "Forbidden", "forbidden\n");
+		return reply_open_file(rep, fd, abs);
+	}
+
+	if (kind == DC_DIR) {
+		/* No index -> directory listing, generated when the reply is sent.
+		   Use requested path for display. */
+		reply_init(rep);
+		rep->status = 200;
+		rep->reason = "OK";
+		rep->ctype = "text/html; charset=utf-8";
+		rep->dir_abs = abs;
+		rep->dir_disp = (decoded_path && decoded_path[0]) ? decoded_path : "/";
+		return 0;
+	}
 
 	/* Regular file */
 	int fd = fs_open_ro(abs);
 	if (fd < 0) {
-		if (errno == EACCES) return send_simple_response(client_fd, 403, "Forbidden", "forbidden\n");
-		if (errno == EISDIR) return send_simple_response(client_fd, 403, "Forbidden", "directory\n");
-		return send_simple_response(client_fd, 404, "Not Found", "not found\n");
+		if (errno == EACCES) return reply_status(rep, 403, "Forbidden", "forbidden\n");
+		if (errno == EISDIR) return reply_status(rep, 403, "Forbidden", "directory\n");
+		return reply_status(rep, 404, "Not Found", "not found\n");
 	}
+	return reply_open_file(rep, fd, abs);
+}
 
-	struct stat st; fstat(fd, &st);
-	const char *mime = fs_mime_from_path(abs);
-	char hdr[512];
-	int n = snprintf(hdr, sizeof(hdr),
-			"HTTP/1.1 200 OK\r\n"
-			"Content-Length: %zu\r\n"
-			"Content-Type: %s\r\n"
-			"Connection: keep-alive\r\n"
-			"\r\n",
-			(size_t)st.st_size, mime);
-	if (n < 0 || (size_t)n >= sizeof(hdr)) { close(fd); return -1; }
-	if (send(client_fd, hdr, (size_t)n, 0) < 0) { close(fd); return -1; }
+/* Reserved METRICS_URL: Prometheus text exposition of metrics.c counters. */
+static void serve_stats(struct mh_reply *rep) {
+	char *body = NULL;
+	size_t blen = 0;
+	if (metrics_render_prometheus(&body, &blen) < 0) {
+		reply_text(rep, 500, "Internal Server Error", "stats unavailable\n");
+		return;
+	}
+	reply_init(rep);
+	rep->status = 200;
+	rep->reason = "OK";
+	rep->ctype = "text/plain; version=0.0.4; charset=utf-8";
+	rep->body = rep->body_owned = body;
+	rep->body_len = blen;
+}
 
-	char b[64 * 1024];
-	ssize_t r;
-	while ((r = read(fd, b, sizeof(b))) > 0) {
-		ssize_t w = 0;
-		while (w < r) {
-			ssize_t s = send(client_fd, b + w, (size_t)(r - w), 0);
-			if (s <= 0) { close(fd); return -1; }
-			w += s;
-		}
+/* Reserved TRACE_URL: the sampled requests' phase spans (see trace.h). */
+static void serve_trace(struct mh_reply *rep) {
+	char *body = NULL;
+	size_t blen = 0;
+	if (trace_render_json(&body, &blen) < 0) {
+		reply_text(rep, 500, "Internal Server Error", "trace unavailable\n");
+		return;
+	}
+	reply_init(rep);
+	rep->status = 200;
+	rep->reason = "OK";
+	rep->ctype = "application/json";
+	rep->body = rep->body_owned = body;
+	rep->body_len = blen;
+}
+
+/* Reserved CONFIG_URL: the configuration in effect, in config file form. */
+static void serve_config(struct mh_reply *rep) {
+	char hdr[PATH_MAX + 512];
+	char *body = NULL;
+	size_t blen = 0;
+	pthread_mutex_lock(&g_rt.mtx);
+	snprintf(hdr, sizeof(hdr),
+	         "MyHTTP configuration in effect\n"
+	         "config file: %s\n"
+	         "reloads: %u\n"
+	         "last reload: %s\n"
+	         "workers running: %d",
+	         g_rt.cur.config_file[0] ? g_rt.cur.config_file : "(none)",
+	         g_rt.reloads, g_rt.last, pool_running());
+	int rc = config_render(&g_rt.cur, hdr, &body, &blen);
+	pthread_mutex_unlock(&g_rt.mtx);
+	if (rc < 0) {
+		reply_text(rep, 500, "Internal Server Error", "config unavailable\n");
+		return;
+	}
+	reply_init(rep);
+	rep->status = 200;
+	rep->reason = "OK";
+	rep->ctype = "text/plain; charset=utf-8";
+	rep->body = rep->body_owned = body;
+	rep->body_len = blen;
+}
+
+/* BATCH_URL itself (POST) or a path under it: a list (GET) or a
+   directory to replace (PUT). */
+static int is_batch(const char *decoded) {
+	return strncmp(decoded, BATCH_URL, sizeof(BATCH_URL) - 1) == 0 &&
+	       (decoded[sizeof(BATCH_URL) - 1] == '\0' || decoded[sizeof(BATCH_URL) - 1] == '/');
+}
+
+/* The path under BATCH_URL ("/..."), or NULL. */
+static const char *batch_tail(const char *decoded) {
+	return is_batch(decoded) && decoded[sizeof(BATCH_URL) - 1] == '/' ? decoded + sizeof(BATCH_URL) - 1 : NULL;
+}
+
+/* URLs answered by the server itself; never written through. */
+static int is_reserved(const char *decoded) {
+	return strcmp(decoded, METRICS_URL) == 0 || strcmp(decoded, CONFIG_URL) == 0 ||
+	       strcmp(decoded, TRACE_URL) == 0 || is_batch(decoded);
+}
+
+/* batch.h callbacks over the connection: listed paths resolve as GETs do
+   (bundle first), and bodies are queued like a GET's. */
+struct batch_ctx {
+	struct mh_conn *c;
+	char           *abs;     // PATH_MAX, from the connection's arena
+};
+
+static int batch_open(void *ctx, const char *path, struct batch_file *f) {
+	struct batch_ctx *b = (struct batch_ctx *)ctx;
+	struct bundle_entry be;
+	if (bundle_lookup(path, &be)) {
+		f->data = be.data;
+		f->size = be.len;
+		f->ctype = be.ctype;
+		return 0;
+	}
+	const size_t mark = arena_mark(&b->c->arena);
+	const int kind = resolve_path(&b->c->arena, g_docroot, path, b->abs, PATH_MAX);
+	arena_release(&b->c->arena, mark);
+	if (kind == DC_NOENT || (kind < 0 && errno == ENOENT)) return 404;
+	if (kind == DC_FORBIDDEN || kind == DC_DIR || (kind < 0 && errno == EACCES)) return 403;
+	if (kind < 0) return 500;
+
+	const int fd = fs_open_ro(b->abs);
+	if (fd < 0) return errno == ENOENT ? 404 : 403;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) { close(fd); return 403; }
+	f->fd = fd;
+	f->size = (size_t)st.st_size;
+	f->mtime = st.st_mtime;
+	f->ctype = fs_mime_from_path(b->abs);
+	return 0;
+}
+
+static void batch_close(void *ctx, struct batch_file *f) {
+	(void)ctx;
+	if (f->fd >= 0) close(f->fd);
+	f->fd = -1;
+}
+
+static int batch_write(void *ctx, const void *buf, size_t len) {
+	return conn_queue_copy(((struct batch_ctx *)ctx)->c, buf, len);
+}
+
+static int batch_write_file(void *ctx, const struct batch_file *f) {
+	struct mh_conn *c = ((struct batch_ctx *)ctx)->c;
+	if (f->data) return conn_queue_ref(c, f->data, f->size);   // bundle: mapped until exit
+	return queue_file(c, f->fd, f->size);
+}
+
+/* Stream the batch response for list[0..len). -1: close the connection. */
+static int serve_batch(struct mh_conn *c, const char *list, size_t len, const char *accept) {
+	static const struct batch_ops ops = { batch_open, batch_close, batch_write, batch_write_file };
+	struct batch_ctx b = { c, (char *)arena_alloc(&c->arena, PATH_MAX) };
+	if (!b.abs) return send_simple_response(c, 500, "Internal Server Error", "out of memory\n");
+	tl_status = 200;
+	return batch_stream(list, len, batch_format_for(accept), &ops, &b);
+}
+
+/* GET BATCH_URL "/<list>": the list is a file in the docroot. */
+static int serve_batch_list(struct mh_conn *c, const char *list_path, const char *accept) {
+	char *abs = (char *)arena_alloc(&c->arena, PATH_MAX);
+	if (!abs) return send_simple_response(c, 500, "Internal Server Error", "out of memory\n");
+	const int kind = resolve_path(&c->arena, g_docroot, list_path, abs, PATH_MAX);
+	if (kind == DC_NOENT || (kind < 0 && errno == ENOENT))
+		return send_simple_response(c, 404, "Not Found", "no such list\n");
+	if (kind != DC_FILE) return send_simple_response(c, 403, "Forbidden", "forbidden\n");
+
+	const int fd = fs_open_ro(abs);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		if (fd >= 0) close(fd);
+		return send_simple_response(c, 403, "Forbidden", "forbidden\n");
+	}
+	if (st.st_size > BATCH_LIST_MAX) {
+		close(fd);
+		return send_simple_response(c, 413, "Payload Too Large", "list too large\n");
+	}
+	const size_t len = (size_t)st.st_size;
+	char *list = (char *)malloc(len ? len : 1);
+	size_t got = 0;
+	while (list && got < len) {
+		ssize_t r = pread(fd, list + got, len - got, (off_t)got);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) break;
+		got += (size_t)r;
 	}
 	close(fd);
-	return (r < 0) ? -1 : 0;
+	int rc = list ? serve_batch(c, list, got, accept)
+	              : send_simple_response(c, 500, "Internal Server Error", "out of memory\n");
+	free(list);
+	return rc;
+}
+
+/* POST BATCH_URL: the list is the body, 'prefill' holding its first bytes. */
+static int serve_batch_post(struct mh_conn *c, size_t clen, const void *prefill, size_t prefill_len,
+                            const char *accept, int *force_close) {
+	if (clen > BATCH_LIST_MAX) {
+		*force_close = 1;   // body not read
+		return send_simple_response(c, 413, "Payload Too Large", "list too large\n");
+	}
+	char *list = (char *)malloc(clen ? clen : 1);
+	if (!list) {
+		*force_close = 1;
+		return send_simple_response(c, 500, "Internal Server Error", "out of memory\n");
+	}
+	memcpy(list, prefill, prefill_len);
+	size_t got = prefill_len;
+	while (got < clen) {
+		ssize_t r = conn_read(c, list + got, clen - got);
+		if (r <= 0) break;
+		got += (size_t)r;
+	}
+	int rc;
+	if (got < clen) {
+		*force_close = 1;
+		rc = errno == ETIMEDOUT ? send_simple_response(c, 408, "Request Timeout", "body timeout\n") : -1;
+	} else {
+		rc = serve_batch(c, list, clen, accept);
+	}
+	free(list);
+	return rc;
+}
+
+/* Paths served from the asset bundle: a write would never be seen. */
+static int is_bundled(const char *decoded) {
+	return bundle_holds(decoded);
+}
+
+/* The answer to a PUT or POST that fs_put_*() returned 'w' for (errno set when < 0). */
+static void put_reply(int w, struct mh_reply *rep) {
+	if (w >= 0) {
+		if (w == 1) reply_text(rep, 201, "Created", "created\n");
+		else        reply_text(rep, 204, "No Content", "");
+	} else if (errno == EISDIR) {
+		reply_text(rep, 409, "Conflict", "target is directory\n");
+	} else if (errno == ENOENT) {
+		reply_text(rep, 404, "Not Found", "parent missing\n");
+	} else if (errno == EACCES || errno == EPERM) {
+		reply_text(rep, 403, "Forbidden", "permission denied\n");
+	} else if (errno == EPROTO) {
+		reply_text(rep, 400, "Bad Request", "invalid Content-Length\n");
+	} else if (errno == ETIMEDOUT) {
+		reply_text(rep, 408, "Request Timeout", "body timeout\n");
+	} else {
+		reply_text(rep, 500, "Internal Server Error", "write failed\n");
+	}
+}
+
+/* PUT/POST/PATCH through fs.c. The first 'prefill_len' body bytes are in
+   'prefill'; the rest is read through 'src' (NULL when the body is complete). */
+static void handle_upload(int method, const char *decoded, fs_source_fn src, void *src_ctx,
+                          size_t clen, const void *prefill, size_t prefill_len,
+                          struct mh_reply *rep) {
+	if (method == MYHTTP_PATCH) {
+		int a = fs_append_from_source_prefill(g_docroot, decoded, src, src_ctx, clen,
+		                                      prefill, prefill_len);
+		if (a == 0)
+			reply_text(rep, 204, "No Content", "");
+		else if (errno == EISDIR)
+			reply_text(rep, 409, "Conflict", "cannot append to directory\n");
+		else if (errno == ETIMEDOUT)
+			reply_text(rep, 408, "Request Timeout", "body timeout\n");
+		else
+			reply_text(rep, 403, "Forbidden", "append failed\n");
+		return;
+	}
+
+	/* Prefill-aware atomic writer for PUT/POST */
+	put_reply(fs_put_from_source_atomic_prefill(g_docroot, decoded, src, src_ctx, clen,
+	                                            prefill, prefill_len), rep);
+}
+
+/* PUT BATCH_URL "/<dir>": replace <dir> with the tar archive in the body. */
+static void handle_unpack(const char *decoded_dir, fs_source_fn src, void *src_ctx,
+                          size_t clen, const void *prefill, size_t prefill_len,
+                          struct mh_reply *rep) {
+	int w = batch_unpack(g_docroot, decoded_dir, src, src_ctx, clen, prefill, prefill_len);
+	if (w >= 0) {
+		if (w == 1) reply_text(rep, 201, "Created", "created\n");
+		else        reply_text(rep, 204, "No Content", "");
+	} else if (errno == EPROTO) {
+		reply_text(rep, 400, "Bad Request", "bad archive\n");
+	} else if (errno == EBUSY) {
+		reply_text(rep, 409, "Conflict", "cannot replace the docroot\n");
+	} else if (errno == ENOTDIR || errno == EISDIR) {
+		reply_text(rep, 409, "Conflict", "not a directory\n");
+	} else if (errno == ENOENT) {
+		reply_text(rep, 404, "Not Found", "parent missing\n");
+	} else if (errno == EACCES || errno == EPERM) {
+		reply_text(rep, 403, "Forbidden", "permission denied\n");
+	} else if (errno == ETIMEDOUT) {
+		reply_text(rep, 408, "Request Timeout", "body timeout\n");
+	} else {
+		reply_text(rep, 500, "Internal Server Error", "unpack failed\n");
+	}
+}
+
+struct membuf {
+	char  *p;
+	size_t len, cap;
+};
+
+static int membuf_sink(void *ctx, const void *buf, size_t len) {
+	struct membuf *m = (struct membuf *)ctx;
+	if (m->len + len > m->cap) {
+		size_t cap = m->cap ? m->cap : 4096;
+		while (cap < m->len + len) cap *= 2;
+		char *np = (char *)realloc(m->p, cap);
+		if (!np) { errno = ENOMEM; return -1; }
+		m->p = np;
+		m->cap = cap;
+	}
+	memcpy(m->p + m->len, buf, len);
+	m->len += len;
+	return 0;
+}
+
+/* One HTTP/2 stream (see h2.c): same handlers as HTTP/1.1, with the body
+   already buffered and directory listings rendered to memory. */
+static void h2_request_handler(void *arg, struct mh_arena *a,
+                               const struct h2_request *rq, struct mh_reply *rep) {
+	(void)arg;
+	const uint64_t t_start = metrics_now_ns();
+	const int method = rq->method;
+	trace_request_begin();
+
+	size_t decoded_cap = strlen(rq->path) + 2;
+	if (decoded_cap > PATH_MAX) decoded_cap = PATH_MAX;
+	char *decoded = (char *)arena_alloc(a, decoded_cap);
+
+	if (!decoded) {
+		reply_text(rep, 500, "Internal Server Error", "out of memory\n");
+	} else if (extract_decoded_path(rq->path, decoded, decoded_cap) < 0) {
+		reply_text(rep, 400, "Bad Request", "bad target\n");
+	} else if (method == MYHTTP_PUT && batch_tail(decoded)) {
+		handle_unpack(batch_tail(decoded), NULL, NULL, rq->body_len, rq->body, rq->body_len, rep);
+	} else if (is_batch(decoded)) {
+		/* Streamed with chunked framing as it is read: HTTP/1.1 only. */
+		reply_text(rep, 501, "Not Implemented", "batch reads need HTTP/1.1\n");
+	} else if (method == MYHTTP_GET) {
+		if (strcmp(decoded, METRICS_URL) == 0)
+			serve_stats(rep);
+		else if (strcmp(decoded, CONFIG_URL) == 0)
+			serve_config(rep);
+		else if (strcmp(decoded, TRACE_URL) == 0)
+			serve_trace(rep);
+		else if (serve_resolved_path(a, g_docroot, decoded, rep) < 0)
+			reply_text(rep, 500, "Internal Server Error", "internal error\n");
+
+		if (rep->dir_abs) {
+			struct membuf m = { 0 };
+			int rc = fs_dir_listing(a, rep->dir_abs, rep->dir_disp, membuf_sink, &m);
+			reply_init(rep);
+			if (rc < 0) {
+				free(m.p);
+				reply_text(rep, 500, "Internal Server Error", "listing failed\n");
+			} else {
+				rep->status = 200;
+				rep->reason = "OK";
+				rep->ctype = "text/html; charset=utf-8";
+				rep->body = rep->body_owned = m.p;
+				rep->body_len = m.len;
+			}
+		}
+	} else if (method == MYHTTP_POST || method == MYHTTP_PUT || method == MYHTTP_PATCH) {
+		if (is_reserved(decoded))
+			reply_text(rep, 403, "Forbidden", "reserved path\n");
+		else if (is_bundled(decoded))
+			reply_text(rep, 409, "Conflict", "served from the asset bundle\n");
+		else
+			handle_upload(method, decoded, NULL, NULL, rq->body_len, rq->body, rq->body_len, rep);
+	} else if (method == MYHTTP_DELETE) {
+		reply_text(rep, 405, "Method Not Allowed", "DELETE disabled\n");
+	} else {
+		reply_text(rep, 405, "Method Not Allowed", "use GET\n");
+	}
+
+	metrics_observe_request(metrics_method_index(method), rep->status, metrics_now_ns() - t_start);
+	trace_request_end(t_start);
+}
+
+/* "Upgrade: h2c" (a token in a comma-separated list). */
+static int wants_h2c(const struct myhttp_req *r) {
+	const char *u = r->h_upgrade;
+	while (u && *u) {
+		while (*u == ' ' || *u == '\t' || *u == ',') u++;
+		size_t n = strcspn(u, " \t,");
+		if (n == 3 && strncasecmp(u, "h2c", 3) == 0) return 1;
+		u += n;
+	}
+	return 0;
+}
+
+/* Any deadline configured? Without one, connections stay blocking. */
+static int timeouts_enabled(void) {
+	return __atomic_load_n(&g_timeouts.idle_ms, __ATOMIC_RELAXED) ||
+	       __atomic_load_n(&g_timeouts.header_ms, __ATOMIC_RELAXED) ||
+	       __atomic_load_n(&g_timeouts.body_ms, __ATOMIC_RELAXED) ||
+	       __atomic_load_n(&g_timeouts.write_ms, __ATOMIC_RELAXED);
+}
+
+/* A connection about to wait for its next request: note it so a drain can
+   end the wait (drain_start()). Returns the slot to pass to idle_leave(),
+   -1 if not noted (upgrades off, or no free slot), or -2 when draining has
+   begun and the connection should close now. */
+static int idle_enter(int fd) {
+	if (g_upg.wake[0] < 0) return -1;
+	int slot = -1;
+	pthread_mutex_lock(&g_upg.mtx);
+	if (g_upg.draining) {
+		slot = -2;
+	} else {
+		for (int i = 0; i < IDLE_SLOTS; i++)
+			if (!g_upg.idle[i]) { g_upg.idle[i] = fd + 1; slot = i; break; }
+	}
+	pthread_mutex_unlock(&g_upg.mtx);
+	return slot;
+}
+
+/* Done waiting; must come before the fd is closed (drain_start() shuts
+   down noted fds, which must not have been reused meanwhile). */
+static void idle_leave(int slot) {
+	if (slot < 0) return;
+	pthread_mutex_lock(&g_upg.mtx);
+	g_upg.idle[slot] = 0;
+	pthread_mutex_unlock(&g_upg.mtx);
+}
+
+/* Whether resolving 'decoded' for a GET may wait on the disk: a directory
+   (opendir for its listing) or a path not in the dentry cache (a path walk
+   and open). Without the dcache there is no telling, and nothing moves. */
+static int resolve_may_block(const char *decoded) {
+	if (dcache_capacity() == 0 || is_reserved(decoded) || is_batch(decoded)) return 0;
+	char abs[PATH_MAX];
+	const int kind = dcache_lookup(decoded, abs, sizeof(abs));
+	return kind == DC_DIR || (kind == DC_MISS && !bundle_holds(decoded) && !hot_holds(decoded));
+}
+
+/* Blocking filesystem steps a network worker hands to the I/O pool. */
+enum io_step { IO_NONE, IO_RESOLVE, IO_PUT_OPEN, IO_PUT_PUBLISH };
+
+/* A request parked on one of those steps: io_step_run() takes it (no
+   socket I/O there), then the network worker picks the connection back up
+   and io_step_done() carries on from what is left here. */
+struct io_req {
+	enum io_step step;
+	int          method;
+	int          close_after;     // the request asked to close, or its body went unread
+	uint64_t     t_start;
+	uint64_t     allocs;          // counted on network workers so far
+	const char  *path;            // decoded target, in the request arena
+	const void  *prefill;         // upload body bytes already buffered
+	size_t       prefill_len, clen;
+	int          result, err;     // the step's return value and errno
+	struct mh_reply rep;          // IO_RESOLVE
+	struct fs_put   put;          // IO_PUT_*
+};
+
+/* Fill in the request about to park on 'step' (serve_conn() returns SERVE_TO_IO). */
+static void io_park(struct io_req *r, enum io_step step, int method, const char *path,
+                    int close_after, uint64_t t_start, uint64_t allocs_start) {
+	r->step = step;
+	r->method = method;
+	r->path = path;
+	r->close_after = close_after;
+	r->t_start = t_start;
+	r->allocs = allochook_thread_allocs() - allocs_start;
+}
+
+/* Listing rendered ahead of sending, so its opendir and readdir run with
+   the rest of the resolution. */
+struct listing_buf {
+	char  *p;
+	size_t len, cap;
+	int    oom;
+};
+
+static int listing_sink(void *ctx, const void *buf, size_t len) {
+	struct listing_buf *b = (struct listing_buf *)ctx;
+	if (b->oom) return -1;
+	if (len > b->cap - b->len) {
+		size_t cap = b->cap ? b->cap : 4096;
+		while (cap - b->len < len) cap *= 2;
+		char *np = (char *)realloc(b->p, cap);
+		if (!np) { b->oom = 1; return -1; }
+		b->p = np;
+		b->cap = cap;
+	}
+	memcpy(b->p + b->len, buf, len);
+	b->len += len;
+	return 0;
 }
 
-/* Handle requests on one socket until the client (or server) closes. */
-static void serve_client_socket(int cfd) {
-    char buf[RECV_BUF_SZ];
-    size_t used = 0;
+/* Turn a listing reply into one with its HTML in memory. */
+static int render_listing(struct mh_arena *a, struct mh_reply *rep) {
+	struct listing_buf b = {0};
+	if (fs_dir_listing(a, rep->dir_abs, rep->dir_disp, listing_sink, &b) < 0 || b.oom) {
+		free(b.p);
+		return reply_status(rep, 500, "Internal Server Error", "listing failed\n");
+	}
+	rep->dir_abs = rep->dir_disp = NULL;
+	rep->body = rep->body_owned = b.p;
+	rep->body_len = b.len;
+	return 0;
+}
+
+/* Take the parked request's filesystem step. Runs on an I/O thread, or
+   on the network worker when there is none to take it. A publish that
+   must wait for a newer upload to the same path blocks, or with 'wake'
+   set hands the request over to it and returns 1: from then on it is
+   touched only once wake() is called (fs.h). */
+static int io_step_run(struct io_req *r, struct mh_conn *c, void (*wake)(struct fs_put *)) {
+	switch (r->step) {
+		case IO_RESOLVE:
+			r->result = serve_resolved_path(&c->arena, g_docroot, r->path, &r->rep);
+			if (r->result == 0 && r->rep.dir_abs) r->result = render_listing(&c->arena, &r->rep);
+			break;
+		case IO_PUT_OPEN:
+			r->result = fs_put_begin(&r->put, g_docroot, r->path, r->clen);
+			r->err = errno;
+			break;
+		case IO_PUT_PUBLISH: {
+			r->put.wake = wake;
+			const int rc = fs_put_publish(&r->put);
+			if (rc == FS_PUT_WAITING) return 1;
+			r->result = rc;
+			r->err = errno;
+			break;
+		}
+		case IO_NONE:
+			break;
+	}
+	return 0;
+}
+
+/* A request whose step ran but that won't be finished (the server is
+   draining, or the connection can't be resumed): let go of what it holds. */
+static void io_req_drop(struct io_req *r) {
+	if (r->result == 0 && r->step == IO_RESOLVE) reply_done(&r->rep);
+	if (r->result == 0 && r->step == IO_PUT_OPEN) fs_put_abort(&r->put);
+	r->step = IO_NONE;
+}
+
+/* What serve_conn() leaves the connection to. */
+enum serve_next { SERVE_CLOSE, SERVE_TO_IO, SERVE_ON };
+
+/* Handle requests on one connection until the client (or server) closes,
+   or until a request reaches a filesystem step that may block: with an
+   I/O pool running, that request is parked in '*r' and SERVE_TO_IO
+   returned (see io_step_run()). '*served' carries over (whether a request
+   came before, for the idle deadline).
+
+   Requests are parsed from a cursor over the input buffer; responses are
+   queued in order and flushed together once the buffered requests run out
+   (one writev per read burst), or earlier when the batch hits its cap or a
+   handler needs the raw socket (uploads, listings, large files). */
+static int serve_conn(struct mh_conn *c, int *served, struct io_req *r) {
     int force_close = 0;
 
     for (;;) {
-        if (used < sizeof(buf)) {
-            ssize_t n = recv(cfd, buf + used, sizeof(buf) - used, 0);
+        size_t avail = conn_avail(c);
+        char  *p     = avail ? c->in + c->in_off : NULL;
+
+        /* Only hand complete header blocks to the parser: it tokenizes in place.
+           (The HTTP/2 preface contains a blank line 6 bytes before its end.) */
+        const int h2 = avail > 0 && h2_is_preface(p, avail);
+        if (avail == 0 || !memmem(p, avail, "\r\n\r\n", 4) || (h2 && avail < H2_PREFACE_LEN)) {
+            if (conn_in_full(c)) {
+                (void)send_simple_response(c, 413, "Payload Too Large", "header too large\n");
+                metrics_observe_request(MX_OTHER, 413, 0);
+                break;
+            }
+            /* End of this read burst: push out everything answered so far. */
+            if (conn_flush(c) < 0) break;
+            /* Nothing half-read: give the buffers back while we wait. */
+            conn_release_idle(c);
+            /* Between requests the idle deadline applies; once a request has
+               started (or for the first one) the header deadline does. */
+            const int idle = avail == 0 && *served;
+            conn_expect(c, idle ? CONN_T_IDLE : CONN_T_HEADER);
+            /* Nothing of a request read yet (kept alive, or just accepted):
+               a drain may end the wait. */
+            const int slot = avail == 0 ? idle_enter(c->fd) : -1;
+            if (slot == -2) break;                 /* draining: done with this one */
+            ssize_t n = conn_fill(c);
+            idle_leave(slot);
             if (n == 0) break;                     /* client closed */
             if (n < 0) {
-                if (errno == EINTR) continue;
-                perror("recv");
+                if (errno != ETIMEDOUT) {
+                    perror("recv");
+                } else if (avail > 0 && !h2) {
+                    (void)send_simple_response(c, 408, "Request Timeout", "header timeout\n");
+                    metrics_observe_request(MX_OTHER, 408, 0);
+                }
                 break;
             }
-            used += (size_t)n;
+            continue;
         }
 
+        if (h2) {
+            /* HTTP/2 with prior knowledge: the session owns the connection from here. */
+            (void)h2_serve(c, h2_request_handler, NULL, NULL, NULL);
+            break;
+        }
+
+        const uint64_t t_start = metrics_now_ns();
+        const uint64_t allocs_start = allochook_thread_allocs();
+        tl_status = 0;
+        conn_begin_request(c);
+        *served = 1;
+        trace_request_begin();
+
         struct myhttp_req req;
         myhttp_req_reset(&req);
-        req.buf = buf;
-        req.buf_len = used;
 
-        int consumed = myhttp_parse_request(buf, used, &req);
-        if (consumed < 0) {
-            (void)send_simple_response(cfd, 400, "Bad Request", "bad request\n");
+        const uint64_t tr_parse = trace_begin(TR_PARSE);
+        int consumed = myhttp_parse_request(p, avail, &req);
+        trace_end(TR_PARSE, tr_parse);
+        if (consumed <= 0) {
+            (void)send_simple_response(c, 400, "Bad Request", "bad request\n");
+            metrics_observe_request(MX_OTHER, 400, metrics_now_ns() - t_start);
             break;
         }
-        if (consumed == 0) {
-            if (used == sizeof(buf)) {
-                (void)send_simple_response(cfd, 413, "Payload Too Large", "header too large\n");
-                break;
-            }
-            continue; /* need more data */
-        }
+        c->in_off += (size_t)consumed;
 
         long clen = myhttp_content_length(&req);
         int method = req.method;
 
+        if (method == MYHTTP_GET && clen <= 0 && req.h_http2_settings && wants_h2c(&req)) {
+            /* h2c upgrade: this request becomes stream 1 of the new session. */
+            static const char sw[] =
+                "HTTP/1.1 101 Switching Protocols\r\n"
+                "Connection: Upgrade\r\n"
+                "Upgrade: h2c\r\n"
+                "\r\n";
+            if (conn_queue_ref(c, sw, sizeof(sw) - 1) < 0 || conn_flush(c) < 0) break;
+            const struct h2_request up = { .method = method, .path = req.target, .content_length = -1 };
+            (void)h2_serve(c, h2_request_handler, NULL, &up, req.h_http2_settings);
+            break;
+        }
+
         /* For body-carrying methods, handle Expect: 100-continue + ensure Content-Length present */
         if (method == MYHTTP_POST || method == MYHTTP_PUT || method == MYHTTP_PATCH) {
-            if (myhttp_expect_100(&req)) {
-                (void)send(cfd, "HTTP/1.1 100 Continue\r\n\r\n", 25, 0);
-            }
             if (clen < 0) {
-                (void)send_simple_response(cfd, 411, "Length Required", "length required\n");
+                (void)send_simple_response(c, 411, "Length Required", "length required\n");
+                metrics_observe_request(metrics_method_index(method), 411, metrics_now_ns() - t_start);
                 break;
             }
+            if (myhttp_expect_100(&req)) {
+                static const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+                if (conn_queue_ref(c, cont, sizeof(cont) - 1) < 0 || conn_flush(c) < 0) break;
+            }
         }
 
         int rc = 0;
+        /* Decoding never lengthens the path; +2 covers the "/" normalization. */
+        size_t decoded_cap = (req.target ? strlen(req.target) : 0) + 2;
+        if (decoded_cap > PATH_MAX) decoded_cap = PATH_MAX;
+        char *decoded = (char *)arena_alloc(&c->arena, decoded_cap);
+        if (!decoded) {
+            (void)send_simple_response(c, 500, "Internal Server Error", "out of memory\n");
+            break;
+        }
+        int is_stats = 0;
 
         switch (method) {
             case MYHTTP_GET: {
-                char decoded[PATH_MAX];
-                if (extract_decoded_path(&req, decoded, sizeof(decoded)) < 0) {
-                    /* Compact pipelined data */
-                    size_t remain = used - (size_t)consumed;
-                    memmove(buf, buf + consumed, remain);
-                    used = remain;
-                    rc = send_simple_response(cfd, 400, "Bad Request", "bad target\n");
+                if (extract_decoded_path(req.target, decoded, decoded_cap) < 0) {
+                    rc = send_simple_response(c, 400, "Bad Request", "bad target\n");
                     break;
                 }
-                /* No request body for GET (beyond headers). Compact and serve. */
-                size_t remain = used - (size_t)consumed;
-                memmove(buf, buf + consumed, remain);
-                used = remain;
-
-                rc = serve_resolved_path(cfd, g_docroot, decoded);
+                struct mh_reply rep;
+                if (strcmp(decoded, METRICS_URL) == 0) {
+                    is_stats = 1;
+                    serve_stats(&rep);
+                } else if (strcmp(decoded, CONFIG_URL) == 0) {
+                    is_stats = 1;
+                    serve_config(&rep);
+                } else if (strcmp(decoded, TRACE_URL) == 0) {
+                    is_stats = 1;
+                    serve_trace(&rep);
+                } else if (is_batch(decoded)) {
+                    if (batch_tail(decoded))
+                        rc = serve_batch_list(c, batch_tail(decoded), req.h_accept);
+                    else
+                        rc = send_simple_response(c, 405, "Method Not Allowed", "POST a path list\n");
+                    break;
+                } else if (iopool_size() > 0 && resolve_may_block(decoded)) {
+                    /* Earlier answers go out first: the disk may take a while. */
+                    if (conn_flush(c) < 0) { rc = -1; break; }
+                    io_park(r, IO_RESOLVE, method, decoded, connection_should_close(&req),
+                            t_start, allocs_start);
+                    return SERVE_TO_IO;
+                } else if (serve_resolved_path(&c->arena, g_docroot, decoded, &rep) < 0) {
+                    rc = -1;
+                    break;
+                }
+                rc = send_reply(c, &rep);
                 if (rc == -2) { force_close = 1; rc = 0; } /* directory listing path—close after */
                 break;
             }
 
             case MYHTTP_DELETE: {
-                size_t remain = used - (size_t)consumed;
-                memmove(buf, buf + consumed, remain);
-                used = remain;
-                rc = send_simple_response(cfd, 405, "Method Not Allowed", "DELETE disabled\n");
+                rc = send_simple_response(c, 405, "Method Not Allowed", "DELETE disabled\n");
                 break;
             }
 
             case MYHTTP_POST:
             case MYHTTP_PUT:
             case MYHTTP_PATCH: {
-                if (clen < 0) {
-                    rc = send_simple_response(cfd, 411, "Length Required", "length required\n");
+                /* Body bytes already buffered after the headers; anything past
+                   Content-Length belongs to the next pipelined request. */
+                const void *prefill_ptr = c->in + c->in_off;
+                size_t      prefill_len = conn_avail(c);
+                if (prefill_len > (size_t)clen) prefill_len = (size_t)clen;
+                c->in_off += prefill_len;
+
+                if (extract_decoded_path(req.target, decoded, decoded_cap) < 0) {
+                    /* body not drained: the stream is out of sync */
+                    force_close = 1;
+                    rc = send_simple_response(c, 400, "Bad Request", "bad target\n");
                     break;
                 }
 
-                /* ---- NEW: compute pre-read body slice after end-of-headers ---- */
-                size_t header_end = (size_t)consumed;            /* body starts here in buf */
-                const void *prefill_ptr = NULL;
-                size_t      prefill_len = 0;
-                if (used > header_end) {
-                    prefill_ptr = buf + header_end;
-                    prefill_len = used - header_end;
+                if (method == MYHTTP_POST && strcmp(decoded, BATCH_URL) == 0) {
+                    if (conn_flush(c) < 0) { rc = -1; break; }
+                    rc = serve_batch_post(c, (size_t)clen, prefill_ptr, prefill_len,
+                                          req.h_accept, &force_close);
+                    break;
                 }
-                if ((size_t)clen < prefill_len) {
-                    /* Client claimed fewer bytes than already delivered: malformed */
-                    rc = send_simple_response(cfd, 400, "Bad Request", "invalid Content-Length\n");
-                    /* drop buffered data */
-                    used = 0;
+                if (method == MYHTTP_PUT && batch_tail(decoded)) {
+                    if (conn_flush(c) < 0) { rc = -1; break; }
+                    struct mh_reply rep;
+                    handle_unpack(batch_tail(decoded), conn_source, c, (size_t)clen,
+                                  prefill_ptr, prefill_len, &rep);
+                    if (rep.status >= 300) force_close = 1;   /* body may be left unread */
+                    rc = send_reply(c, &rep);
                     break;
                 }
-
-                char decoded[PATH_MAX];
-                if (extract_decoded_path(&req, decoded, sizeof(decoded)) < 0) {
-                    size_t remain = used - (size_t)consumed;
-                    memmove(buf, buf + consumed, remain);
-                    used = remain;
-                    rc = send_simple_response(cfd, 400, "Bad Request", "bad target\n");
+                if (is_reserved(decoded)) {
+                    /* Reserved URL: refuse without reading the body, then drop the connection */
+                    force_close = 1;
+                    rc = send_simple_response(c, 403, "Forbidden", "reserved path\n");
+                    break;
+                }
+                if (is_bundled(decoded)) {
+                    force_close = 1;
+                    rc = send_simple_response(c, 409, "Conflict", "served from the asset bundle\n");
                     break;
                 }
 
-                /* For body methods we will hand off body to fs; after that, clear buf. */
-                if (method == MYHTTP_PATCH) {
-                    /* NOTE: PATCH currently ignores prefill bytes unless you add an
-                       fs_append_from_socket_prefill(). For now, keep legacy behavior. */
-                    used = 0; /* discard buffered bytes so append reads from socket */
-                    if (fs_append_from_socket(g_docroot, decoded, cfd, (size_t)clen) == 0)
-                        rc = send_simple_response(cfd, 204, "No Content", "");
-                    else if (errno == EISDIR)
-                        rc = send_simple_response(cfd, 409, "Conflict", "cannot append to directory\n");
-                    else
-                        rc = send_simple_response(cfd, 403, "Forbidden", "append failed\n");
-                } else {
-                    /* ---- NEW: prefill-aware atomic writer for PUT/POST ---- */
-                    int w = fs_put_from_socket_atomic_prefill(
-                                g_docroot,
-                                decoded,
-                                cfd,
-                                (size_t)clen,
-                                prefill_ptr,
-                                prefill_len);
-
-                    /* After fs drains body (prefill + remainder), clear buffer for next req */
-                    used = 0;
-
-                    if (w >= 0) {
-                        rc = (w == 1)
-                            ? send_simple_response(cfd, 201, "Created", "created\n")
-                            : send_simple_response(cfd, 204, "No Content", "");
-                    } else if (errno == EISDIR) {
-                        rc = send_simple_response(cfd, 409, "Conflict", "target is directory\n");
-                    } else if (errno == ENOENT) {
-                        rc = send_simple_response(cfd, 404, "Not Found", "parent missing\n");
-                    } else if (errno == EACCES || errno == EPERM) {
-                        rc = send_simple_response(cfd, 403, "Forbidden", "permission denied\n");
-                    } else if (errno == EPROTO) {
-                        rc = send_simple_response(cfd, 400, "Bad Request", "invalid Content-Length\n");
-                    } else {
-                        rc = send_simple_response(cfd, 500, "Internal Server Error", "write failed\n");
-                    }
+                /* The handlers read the rest of the body off the socket: send
+                   earlier responses first so a waiting client isn't stalled. */
+                if (conn_flush(c) < 0) { rc = -1; break; }
+
+                if (method != MYHTTP_PATCH && iopool_size() > 0) {
+                    /* Temp file created and later published on the I/O pool;
+                       the body is read here in between (io_step_done()). */
+                    io_park(r, IO_PUT_OPEN, method, decoded, connection_should_close(&req),
+                            t_start, allocs_start);
+                    r->prefill = prefill_ptr;
+                    r->prefill_len = prefill_len;
+                    r->clen = (size_t)clen;
+                    return SERVE_TO_IO;
                 }
+
+                struct mh_reply rep;
+                handle_upload(method, decoded, conn_source, c, (size_t)clen,
+                              prefill_ptr, prefill_len, &rep);
+                if (rep.status == 408) force_close = 1;   /* rest of the body never came */
+                rc = send_reply(c, &rep);
                 break;
             }
 
             default: {
-                size_t remain = used - (size_t)consumed;
-                memmove(buf, buf + consumed, remain);
-                used = remain;
-                rc = send_simple_response(cfd, 405, "Method Not Allowed", "use GET\n");
+                rc = send_simple_response(c, 405, "Method Not Allowed", "use GET\n");
                 break;
             }
         }
 
+        metrics_observe_request(metrics_method_index(method),
+                                tl_status ? tl_status : 500, metrics_now_ns() - t_start);
+        trace_request_end(t_start);
+        /* Heap allocations made while serving (0 unless built with the
+           allocation hook). The stats and config pages render into malloc'd
+           memory by design, so they are not counted. */
+        if (!is_stats)
+            metrics_add_request_allocs(allochook_thread_allocs() - allocs_start);
+
         if (rc < 0) break;
 
-        int close_conn = connection_should_close(&req) || force_close;
-        if (used == 0 && close_conn) break;
-        /* else: continue (maybe pipelined next request already in 'buf') */
+        if (connection_should_close(&req) || force_close) break;
+        /* else: continue (maybe pipelined next request already buffered) */
     }
+    return SERVE_CLOSE;
+}
+/* Refuse an accepted connection from the accept loop itself: no worker,
+   no parsing, one pre-rendered write that never blocks. */
+static void shed_connection(int cfd) {
+	static const char resp[] = ADMIT_503;
+	if (!tls_enabled()) {
+		/* Swallow a request that already arrived so close() doesn't reset
+		   the connection before the client reads the 503. */
+		char scratch[2048];
+		(void)recv(cfd, scratch, sizeof(scratch), MSG_DONTWAIT);
+		(void)send(cfd, resp, sizeof(resp) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+		(void)shutdown(cfd, SHUT_WR);
+	}
+	close(cfd);
 }
+
+
 /* --------- Worker thread: pulls sockets from mh_workq --------- */
 
 struct worker_args {
 	struct mh_workq *q;
+	int              cpu;    /* -1: let the scheduler place it */
 };
 
-static void *worker_thread_main(void *arg) {
-	struct worker_args *wa = (struct worker_args *)arg;
-	struct mh_workq *q = wa->q;
+/* Worker threads are detached and come and go with the configured count. */
+static struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t  exited;
+	pthread_attr_t  attr;      /* detached, WORKER_STACK_SZ */
+	int             target;    /* started and not dismissed */
+	int             running;   /* threads alive (dismissed ones finish their connection) */
+	int             pin;       /* place workers with topo_worker_cpu() */
+	int             at_io;     /* connections with the I/O pool (signals 'exited' too) */
+} g_pool = { .mtx = PTHREAD_MUTEX_INITIALIZER, .exited = PTHREAD_COND_INITIALIZER };
+
+/* A connection parked while the I/O pool takes its request's filesystem
+   step; it goes back to the queue it came from as a job carrying this. */
+struct io_conn {
+	struct iopool_task task;     /* first: the pool hands this back */
+	struct mh_conn     c;
+	struct mh_workq   *home;
+	struct mh_job      job;      /* job.resume points here */
+	int                served;
+	int                timed;    /* had deadlines: put it on each thread's wheel */
+	uint64_t           trace_req; /* traced request the step belongs to */
+	struct io_req      req;
+};
 
-	for (;;) {
-		struct mh_job job;
-		if (workq_dequeue(q, &job) != 0) {
-			/* queue closed & empty */
-			break;
-		}
-		/* Log peer info (optional) */
-		char ip[INET6_ADDRSTRLEN] = {0};
-		int port = 0;
-		peer_to_str(&job.peer, ip, sizeof(ip), &port);
-		fprintf(stderr, "[*] Worker handling %s:%d (fd=%d)\n", ip, port, job.client_fd);
+static void io_count(int d) {
+	pthread_mutex_lock(&g_pool.mtx);
+	g_pool.at_io += d;
+	if (g_pool.at_io == 0) pthread_cond_broadcast(&g_pool.exited);
+	pthread_mutex_unlock(&g_pool.mtx);
+}
+
+/* Done with a connection for good: last answers out, then closed and
+   released from admission. */
+static void close_conn(struct mh_conn *c) {
+	(void)conn_flush(c);
+	const int fd = c->fd;
+	conn_free(c);
+	close(fd);
+	admit_done();
+}
 
-		serve_client_socket(job.client_fd);
-		close(job.client_fd);
+
+/* On a network worker, once the request's step was taken: answer it, or
+   (an upload whose temp file is open) read its body and park it again to
+   be published. Returns SERVE_ON when the connection stays open. */
+static int io_step_done(struct mh_conn *c, struct io_req *r) {
+	const uint64_t allocs_start = allochook_thread_allocs();
+	struct mh_reply rep;
+	int rc = 0;
+	tl_status = 0;
+
+	switch (r->step) {
+		case IO_RESOLVE:
+			rep = r->rep;
+			rc = r->result < 0 ? -1 : send_reply(c, &rep);
+			break;
+		case IO_PUT_OPEN:
+			if (r->result == 0) {
+				if (fs_put_body(&r->put, conn_source, c, r->prefill, r->prefill_len) == 0) {
+					r->step = IO_PUT_PUBLISH;
+					r->allocs += allochook_thread_allocs() - allocs_start;
+					return SERVE_TO_IO;
+				}
+				r->result = -1;
+				r->err = errno;
+			}
+			r->close_after = 1;   /* the body was not read to its end */
+			/* fall through */
+		case IO_PUT_PUBLISH:
+			errno = r->err;
+			put_reply(r->result, &rep);
+			rc = send_reply(c, &rep);
+			break;
+		case IO_NONE:
+			return SERVE_ON;
 	}
 
-	return NULL;
+	metrics_observe_request(metrics_method_index(r->method),
+	                        tl_status ? tl_status : 500, metrics_now_ns() - r->t_start);
+	trace_request_end(r->t_start);
+	metrics_add_request_allocs(r->allocs + allochook_thread_allocs() - allocs_start);
+	r->step = IO_NONE;
+	return rc < 0 || r->close_after ? SERVE_CLOSE : SERVE_ON;
 }
 
-/* --------- main() --------- */
+static void io_serve(struct iopool_task *t);
 
-int main(int argc, char *argv[]) {
-	struct config cfg = { .port = 8080, .dir = "." };
-
-	/* Parse args */
-	for (int i = 1; i < argc; i++) {
-		if (strcmp(argv[i], "-p") == 0) {
-			if (i + 1 >= argc) { fprintf(stderr, "Error: -p requires an argument\n"); usage(argv[0]); return 1; }
-			int port = parse_int(argv[++i]);
-			if (port <= 20) { fprintf(stderr, "Error: invalid port number\n"); usage(argv[0]); return 1; }
-			cfg.port = port;
-		} else if (strcmp(argv[i], "-d") == 0) {
-			if (i + 1 >= argc) { fprintf(stderr, "Error: -d requires argument\n"); usage(argv[0]); return 1; }
-			cfg.dir = argv[++i];
-		} else {
-			fprintf(stderr, "Error: unknown argument %s\n", argv[i]);
-			usage(argv[0]);
-			return 1;
+/* A parked PUT was superseded by a newer upload that is now settled: take
+   its publish step again, which tells how that went or publishes this one. */
+static void io_put_wake(struct fs_put *p) {
+	struct io_conn *h = (struct io_conn *)(void *)((char *)p - offsetof(struct io_conn, req.put));
+	if (iopool_submit(&h->task) < 0) io_serve(&h->task);   // the pool was just emptied
+}
+
+/* On an I/O thread: take the parked request's step, then hand the
+   connection back to finish it (or, superseded, to the upload it waits for). */
+static void io_serve(struct iopool_task *t) {
+	static _Thread_local struct mh_twheel wheel;
+	static _Thread_local int wheel_ready;
+	struct io_conn *h = (struct io_conn *)t;
+	trace_tl_req = h->trace_req;
+	if (io_step_run(&h->req, &h->c, io_put_wake)) { trace_tl_req = 0; return; }
+	if (workq_enqueue(h->home, h->job) == 0) { trace_tl_req = 0; io_count(-1); return; }
+
+	/* Queue closed: the server is draining and its workers are leaving.
+	   Finish the request here rather than drop it, then close. */
+	if (!wheel_ready) {
+		twheel_init(&wheel, twheel_now_ms());
+		wheel_ready = 1;
+	}
+	if (h->timed && conn_set_timers(&h->c, &wheel, &g_timeouts) < 0)
+		io_req_drop(&h->req);
+	else
+		while (io_step_done(&h->c, &h->req) == SERVE_TO_IO) (void)io_step_run(&h->req, &h->c, NULL);
+	trace_tl_req = 0;
+	close_conn(&h->c);
+	free(h);
+	io_count(-1);
+}
+
+/* On a network worker: serve a new connection, or one whose request the
+   I/O pool took a step for (job->resume), until it is closed or parks. */
+static void serve_job(struct mh_workq *q, const struct mh_job *job, struct mh_twheel *wheel) {
+	struct io_conn *h = (struct io_conn *)job->resume;
+	struct mh_conn local, *c = &local;
+	struct io_req lreq, *r = &lreq;
+	int served = 0, timed = 0, next = SERVE_ON;
+	if (h) {
+		c = &h->c;
+		r = &h->req;
+		served = h->served;
+		timed = h->timed;
+		trace_tl_req = h->trace_req;   // the parked request goes on here
+		if (timed && conn_set_timers(c, wheel, &g_timeouts) < 0) {
+			perror("conn_set_timers");
+			io_req_drop(r);
+			goto done;
+		}
+		next = io_step_done(c, r);
+	} else {
+		trace_tl_req = 0;
+		if (conn_init(c, job->client_fd, __atomic_load_n(&g_recv_buf, __ATOMIC_RELAXED)) < 0) {
+			perror("conn_init");
+			close(job->client_fd);
+			admit_done();
+			return;
+		}
+		timed = timeouts_enabled();
+		if (timed && conn_set_timers(c, wheel, &g_timeouts) < 0) {
+			perror("conn_set_timers");
+			goto done;
+		}
+		if (tls_enabled() && conn_start_tls(c) < 0) {
+			if (errno != ETIMEDOUT) perror("tls handshake");
+			goto done;
 		}
 	}
 
-	/* Avoid SIGPIPE killing the process if peer closes */
-	signal(SIGPIPE, SIG_IGN);
+	for (;;) {
+		if (next == SERVE_ON) next = serve_conn(c, &served, r);
+		if (next != SERVE_TO_IO) break;
+		conn_detach(c);           // before any copy: the wheel links the timers in place
+		if (!h && (h = (struct io_conn *)malloc(sizeof(*h))) != NULL) {
+			h->c = *c;
+			c = &h->c;
+			h->req = *r;
+			r = &h->req;
+		}
+		if (h) {
+			h->home = q;
+			h->job = *job;
+			h->job.resume = h;
+			h->served = served;
+			h->timed = timed;
+			h->trace_req = trace_tl_req;
+			h->task.fn = io_serve;
+			io_count(1);
+			if (iopool_submit(&h->task) == 0) return;
+			io_count(-1);         // the pool was just emptied
+		}
+		/* No I/O thread to take it (or no memory): take the step here, as
+		   without the pool. */
+		(void)io_step_run(r, c, NULL);
+		if (timed && conn_set_timers(c, wheel, &g_timeouts) < 0) {
+			io_req_drop(r);
+			break;
+		}
+		next = io_step_done(c, r);
+	}
+done:
+	close_conn(c);
+	free(h);
+}
 
-	/* Resolve docroot to an absolute, symlink-free path once */
-	if (!realpath(cfg.dir, g_docroot)) {
-		perror("realpath(docroot)");
-		return 1;
+static void *worker_thread_main(void *arg) {
+	struct worker_args *wa = (struct worker_args *)arg;
+	struct mh_workq *q = wa->q;
+	if (wa->cpu >= 0) {
+		if (topo_pin_cpu(wa->cpu) != 0)
+			fprintf(stderr, "pinning worker to CPU %d: %s\n", wa->cpu, strerror(errno));
+		/* Buffers this worker allocates are first touched here, so they
+		   land on its node; keep reusing that node's cached ones. */
+		bufpool_set_node(topo_node_of(wa->cpu));
 	}
+	free(wa);
+	/* Deadlines of the connection this worker is serving. */
+	struct mh_twheel wheel;
+	twheel_init(&wheel, twheel_now_ms());
 
-	printf("Starting MyHTTP…\n");
-	printf("\t Port: %d\n", cfg.port);
-	printf("\t Root: %s\n", g_docroot);
+	for (;;) {
+		struct mh_job job;
+		if (workq_dequeue(q, &job) != 0) {
+			/* queue closed & empty, or this worker was dismissed */
+			break;
+		}
+		if (!job.resume) {
+			admit_observe_wait(metrics_now_ns() - job.enq_ns);
+			/* Log peer info (optional) */
+			char ip[INET6_ADDRSTRLEN] = {0};
+			int port = 0;
+			peer_to_str(&job.peer, ip, sizeof(ip), &port);
+			fprintf(stderr, "[*] Worker handling %s:%d (fd=%d)\n", ip, port, job.client_fd);
+		}
+		serve_job(q, &job, &wheel);
+	}
 
-	/* Create listening socket */
-	int sfd = socket(AF_INET6, SOCK_STREAM, 0);
-	if (sfd < 0) {
-		/* Fall back to IPv4 if IPv6 not available */
-		sfd = socket(AF_INET, SOCK_STREAM, 0);
-		if (sfd < 0) { perror("socket"); return 1; }
-		int one = 1;
-		setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	pthread_mutex_lock(&g_pool.mtx);
+	g_pool.running--;
+	pthread_cond_broadcast(&g_pool.exited);
+	pthread_mutex_unlock(&g_pool.mtx);
+	return NULL;
+}
 
-		struct sockaddr_in addr4;
-		memset(&addr4, 0, sizeof(addr4));
-		addr4.sin_family = AF_INET;
-		addr4.sin_addr.s_addr = htonl(INADDR_ANY);
-		addr4.sin_port = htons((uint16_t)cfg.port);
+/* --------- Accept loops: listeners -> admission -> work queue --------- */
 
-		if (bind(sfd, (struct sockaddr*)&addr4, sizeof(addr4)) < 0) { perror("bind"); close(sfd); return 1; }
-	} else {
-		int one = 1;
+/* One accept loop and the queue it feeds. By default there is a single
+   one; with --reuseport there is one per NUMA node, listening on a
+   SO_REUSEPORT socket per worker CPU of that node. */
+struct acceptor {
+	int             lfd[MAX_WORKERS];
+	int             nlfd;
+	int             node;            /* -1: not pinned */
+	int             nworkers;        /* serving q (guarded by g_pool.mtx) */
+	struct mh_workq q;
+	pthread_t       tid;
+};
+
+static struct acceptor g_acc[MAX_ACCEPTORS];
+static int             g_nacc = 1;
+
+/* Listening socket on 'port' (dual-stack when possible). With 'cpu' >= 0
+   it joins the port's SO_REUSEPORT group and asks for the connections
+   whose packets arrive on that CPU (SO_INCOMING_CPU), so the NIC queue
+   steered to a CPU feeds the worker running there. Returns -1 on error
+   (reported). */
+static int open_listener(int port, int cpu, int backlog) {
+	int one = 1;
+	int family = AF_INET6;
+	int sfd = socket(family, SOCK_STREAM, 0);
+	if (sfd >= 0) {
 		setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
 		/* Dual-stack if possible */
 		int off = 0; /* 0 = allow v4-mapped on v6 */
 		setsockopt(sfd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
-
-		struct sockaddr_in6 addr6;
-		memset(&addr6, 0, sizeof(addr6));
-		addr6.sin6_family = AF_INET6;
-		addr6.sin6_addr = in6addr_any;
-		addr6.sin6_port = htons((uint16_t)cfg.port);
-
-		if (bind(sfd, (struct sockaddr*)&addr6, sizeof(addr6)) < 0) { perror("bind"); close(sfd); return 1; }
+	} else {
+		/* Fall back to IPv4 if IPv6 not available */
+		family = AF_INET;
+		sfd = socket(family, SOCK_STREAM, 0);
+		if (sfd < 0) { perror("socket"); return -1; }
+		setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
 	}
 
-	if (listen(sfd, BACKLOG) < 0) { perror("listen"); close(sfd); return 1; }
-	fprintf(stderr, "Listening on port %d … (workers=%d)\n", cfg.port, N_WORKERS);
+	if (cpu >= 0) {
+		if (setsockopt(sfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+			perror("SO_REUSEPORT"); close(sfd); return -1;
+		}
+#ifdef SO_INCOMING_CPU
+		if (setsockopt(sfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0)
+			perror("SO_INCOMING_CPU");
+#endif
+		/* Polled together with the node's other listeners. */
+		(void)fcntl(sfd, F_SETFL, fcntl(sfd, F_GETFL) | O_NONBLOCK);
+	}
 
-	/* Initialize work queue and start worker threads */
-	struct mh_workq q;
-	if (workq_init(&q, 1024) != 0) {
-		fprintf(stderr, "workq_init failed: %s\n", strerror(errno));
-		close(sfd);
-		return 1;
+	struct sockaddr_storage ss;
+	socklen_t sslen;
+	memset(&ss, 0, sizeof(ss));
+	if (family == AF_INET6) {
+		struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&ss;
+		addr6->sin6_family = AF_INET6;
+		addr6->sin6_addr = in6addr_any;
+		addr6->sin6_port = htons((uint16_t)port);
+		sslen = sizeof(*addr6);
+	} else {
+		struct sockaddr_in *addr4 = (struct sockaddr_in *)&ss;
+		addr4->sin_family = AF_INET;
+		addr4->sin_addr.s_addr = htonl(INADDR_ANY);
+		addr4->sin_port = htons((uint16_t)port);
+		sslen = sizeof(*addr4);
 	}
+	if (bind(sfd, (struct sockaddr*)&ss, sslen) < 0) { perror("bind"); close(sfd); return -1; }
+	if (listen(sfd, backlog) < 0) { perror("listen"); close(sfd); return -1; }
+	return sfd;
+}
 
-	pthread_t tids[N_WORKERS];
-	struct worker_args wa = { .q = &q };
-	for (int i = 0; i < N_WORKERS; i++) {
-		if (pthread_create(&tids[i], NULL, worker_thread_main, &wa) != 0) {
-			fprintf(stderr, "pthread_create failed (worker %d)\n", i);
+/* Next connection from any of 'a's listeners; -1 on error (errno set),
+   ECANCELED once the listeners have been handed to a successor. */
+static int accept_one(struct acceptor *a, struct sockaddr_storage *peer, socklen_t *plen) {
+	const int wake = g_upg.wake[0];
+	if (a->nlfd == 1 && a->node < 0 && wake < 0) return accept(a->lfd[0], (struct sockaddr*)peer, plen);
+	for (;;) {
+		struct pollfd pfd[MAX_WORKERS + 1];
+		for (int i = 0; i < a->nlfd; i++) pfd[i] = (struct pollfd){ .fd = a->lfd[i], .events = POLLIN };
+		nfds_t n = (nfds_t)a->nlfd;
+		if (wake >= 0) pfd[n++] = (struct pollfd){ .fd = wake, .events = POLLIN };
+		if (poll(pfd, n, -1) < 0) return -1;
+		if (wake >= 0 && (pfd[a->nlfd].revents & POLLIN)) { errno = ECANCELED; return -1; }
+		for (int i = 0; i < a->nlfd; i++) {
+			if (!(pfd[i].revents & POLLIN)) continue;
+			int cfd = accept(a->lfd[i], (struct sockaddr*)peer, plen);
+			if (cfd >= 0) return cfd;
+			if (errno != EAGAIN && errno != ECONNABORTED) return -1;
 		}
 	}
+}
+
+/* Accept loop: enqueue sockets for workers */
+static void *acceptor_main(void *arg) {
+	struct acceptor *a = (struct acceptor *)arg;
+	if (a->node >= 0 && topo_pin_node(a->node) != 0)
+		fprintf(stderr, "pinning acceptor to node %d: %s\n", a->node, strerror(errno));
 
-	/* Accept loop: enqueue sockets for workers */
 	for (;;) {
 		struct sockaddr_storage peer;
 		socklen_t plen = sizeof(peer);
-		int cfd = accept(sfd, (struct sockaddr*)&peer, &plen);
+		int cfd = accept_one(a, &peer, &plen);
 		if (cfd < 0) {
+			if (errno == ECANCELED) break;     /* handed over: the successor accepts */
 			if (errno == EINTR) continue;
 			perror("accept");
 			continue;
@@ -551,18 +1594,613 @@ int main(int argc, char *argv[]) {
 		job.client_fd = cfd;
 		job.peer = peer;
 		job.peerlen = plen;
+		job.resume = NULL;
 
-		if (workq_enqueue(&q, job) != 0) {
-			fprintf(stderr, "workq_enqueue failed; dropping connection\n");
-			close(cfd);
+		/* Over the in-flight limit (or the queue is full): answer 503 now
+		   instead of leaving the client in the queue or the backlog. */
+		if (!admit_try()) {
+			shed_connection(cfd);
 			continue;
 		}
+		if (workq_try_enqueue(&a->q, job) != 0) {
+			admit_cancel();
+			shed_connection(cfd);
+			continue;
+		}
+	}
+	return NULL;
+}
+
+/* The accept loop whose queue a worker on 'cpu' serves: its node's with
+   --reuseport, otherwise (or for a node without one) the first. */
+static int acceptor_for(int cpu) {
+	if (cpu < 0) return 0;
+	const int node = topo_node_of(cpu);
+	for (int g = 0; g < g_nacc; g++)
+		if (g_acc[g].node == node) return g;
+	return 0;
+}
+
+/* --------- Worker pool: resized in place on reload --------- */
+
+static int pool_running(void) {
+	pthread_mutex_lock(&g_pool.mtx);
+	int n = g_pool.running;
+	pthread_mutex_unlock(&g_pool.mtx);
+	return n;
+}
+
+/* Grow or shrink the pool to 'n' workers while it serves. New workers
+   start on their accept loop's queue (pinned like the first ones when
+   placement is on); dismissed ones finish the connection they are serving
+   first, so nothing is dropped. Every accept loop keeps at least one
+   worker. Returns the new size. */
+static int pool_resize(int n) {
+	pthread_mutex_lock(&g_pool.mtx);
+	if (n < g_nacc) n = g_nacc;
+	while (g_pool.target < n) {
+		struct worker_args *wa = (struct worker_args *)malloc(sizeof(*wa));
+		if (!wa) break;
+		wa->cpu = g_pool.pin ? topo_worker_cpu(g_pool.target, n) : -1;
+		const int g = acceptor_for(wa->cpu);
+		wa->q = &g_acc[g].q;
+		pthread_t tid;
+		if (pthread_create(&tid, &g_pool.attr, worker_thread_main, wa) != 0) {
+			fprintf(stderr, "pthread_create failed (worker %d)\n", g_pool.target);
+			free(wa);
+			break;
+		}
+		g_acc[g].nworkers++;
+		g_pool.target++;
+		g_pool.running++;
+	}
+	while (g_pool.target > n) {
+		int g = 0;   /* take from the loop with the most workers */
+		for (int k = 1; k < g_nacc; k++)
+			if (g_acc[k].nworkers > g_acc[g].nworkers) g = k;
+		workq_retire(&g_acc[g].q, 1);
+		g_acc[g].nworkers--;
+		g_pool.target--;
+	}
+	n = g_pool.target;
+	pthread_mutex_unlock(&g_pool.mtx);
+	return n;
+}
+
+/* --------- Configuration: startup and SIGHUP reload --------- */
+
+/* Settings read on the fly by connections and the buffer pool. */
+static void apply_runtime(const struct mh_config *c) {
+	__atomic_store_n(&g_timeouts.idle_ms, c->idle_ms, __ATOMIC_RELAXED);
+	__atomic_store_n(&g_timeouts.header_ms, c->header_ms, __ATOMIC_RELAXED);
+	__atomic_store_n(&g_timeouts.body_ms, c->body_ms, __ATOMIC_RELAXED);
+	__atomic_store_n(&g_timeouts.write_ms, c->write_ms, __ATOMIC_RELAXED);
+	__atomic_store_n(&g_recv_buf, c->recv_buf, __ATOMIC_RELAXED);
+	bufpool_set_limit(c->bufpool_limit);
+	bufpool_set_cache_max(c->bufpool_cache);
+	iohint_configure(c->readahead, c->drop_behind, c->write_behind);
+	hot_configure((size_t)c->hot_keys);
+	trace_configure((unsigned)c->trace_sample);
+}
+
+static size_t max_inflight(const struct mh_config *c) {
+	return c->max_inflight ? c->max_inflight : (size_t)c->workers + c->queue_capacity;
+}
+
+static void apply_admission(const struct mh_config *c) {
+	const size_t max = max_inflight(c);
+	/* Never below one connection per worker: an idle worker is pure loss. */
+	admit_init(max < (size_t)c->workers ? max : (size_t)c->workers, max, c->adaptive);
+}
+
+/* Re-read the configuration (file, then the original flags) and apply the
+   reloadable keys in place. On any error the running configuration stays
+   as it is; keys that need a restart keep their value and are reported. */
+static void reload_config(void) {
+	static struct mh_config next;   /* reload thread only; large */
+	char err[256];
+	const int ok = config_build(&next, g_rt.argc, g_rt.argv, err, sizeof(err)) == 0;
+
+	pthread_mutex_lock(&g_rt.mtx);
+	struct mh_config *cur = &g_rt.cur;
+	g_rt.reloads++;
+	if (!ok) {
+		snprintf(g_rt.last, sizeof(g_rt.last), "error: %s (configuration unchanged)", err);
+	} else {
+		char note[160] = "";
+		const char *rk = config_restart_key(&g_rt.boot, &next);
+		config_keep_restart_keys(&next, cur);
+		/* Restart-only keys adjusted at startup (placement without a
+		   topology) stay as they are in effect. */
+		next.pin_workers = cur->pin_workers;
+		next.reuseport = cur->reuseport;
+
+		if (next.dcache_entries != cur->dcache_entries && dcache_resize(next.dcache_entries) < 0) {
+			snprintf(note, sizeof(note), "; dcache-entries kept: %s",
+			         errno == EINVAL ? "turning the cache on or off needs a restart" : strerror(errno));
+			next.dcache_entries = cur->dcache_entries;
+		}
+		if (next.backlog != cur->backlog) {
+			for (int g = 0; g < g_nacc; g++)
+				for (int k = 0; k < g_acc[g].nlfd; k++)
+					if (listen(g_acc[g].lfd[k], next.backlog) < 0) perror("listen");
+		}
+		if (next.workers != cur->workers) next.workers = pool_resize(next.workers);
+		if (next.io_workers != cur->io_workers) next.io_workers = iopool_resize(next.io_workers);
+		apply_runtime(&next);
+		if (max_inflight(&next) != max_inflight(cur) || next.adaptive != cur->adaptive ||
+		    next.workers != cur->workers)
+			apply_admission(&next);
+
+		*cur = next;
+		snprintf(g_rt.last, sizeof(g_rt.last), "ok%s%s%s", rk ? "; restart needed for " : "",
+		         rk ? rk : "", note);
 	}
+	fprintf(stderr, "Reload %u: %s\n", g_rt.reloads, g_rt.last);
+	pthread_mutex_unlock(&g_rt.mtx);
+}
+
+/* SIGHUP is blocked everywhere and taken here, between requests of no one. */
+static void *reload_thread_main(void *arg) {
+	const sigset_t *set = (const sigset_t *)arg;
+	for (;;) {
+		int sig = 0;
+		if (sigwait(set, &sig) == 0 && sig == SIGHUP) reload_config();
+	}
+	return NULL;
+}
+
+/* --------- Binary upgrade: listener handoff and drain --------- */
+
+/* What a successor needs to rebuild the accept loops around the listening
+   sockets, which travel alongside (g_acc order). */
+#define UPG_LAYOUT_VERSION 1
+struct upg_layout {
+	uint32_t version;
+	int32_t  port;
+	int32_t  reuseport;
+	int32_t  nacc;
+	int32_t  node[MAX_ACCEPTORS];
+	int32_t  nlfd[MAX_ACCEPTORS];
+};
+
+/* Stop accepting (every accept loop wakes and returns) and end the
+   connections waiting for a request, kept alive or just accepted; the
+   ones mid-request finish it, then close. */
+static void drain_start(void) {
+	pthread_mutex_lock(&g_upg.mtx);
+	g_upg.draining = 1;
+	for (int i = 0; i < IDLE_SLOTS; i++)
+		if (g_upg.idle[i]) (void)shutdown(g_upg.idle[i] - 1, SHUT_RD);   /* their recv sees EOF */
+	pthread_mutex_unlock(&g_upg.mtx);
+	if (write(g_upg.wake[1], "x", 1) < 0) perror("upgrade: wake");
+}
+
+struct warm_keys {
+	char   *buf;
+	size_t  len, cap;
+};
+
+static int collect_key(const char *key, void *ctx) {
+	struct warm_keys *w = (struct warm_keys *)ctx;
+	const size_t n = strlen(key) + 1;
+	if (w->len + n > w->cap) return 1;   /* enough: the hottest are as good as any */
+	memcpy(w->buf + w->len, key, n);
+	w->len += n;
+	return 0;
+}
+
+/* Send the dentry cache's live keys in chunks that end on a key. The keys
+   are copied out first so no stripe is held while the peer reads. */
+static int send_warm_keys(int s) {
+	struct warm_keys w = { .buf = (char *)malloc(UPGRADE_WARM_MAX), .cap = UPGRADE_WARM_MAX };
+	if (w.buf) (void)dcache_foreach(collect_key, &w);
+	int rc = 0;
+	for (size_t off = 0; off < w.len && rc == 0; ) {
+		size_t n = 0;
+		while (off + n < w.len) {
+			const size_t k = strlen(w.buf + off + n) + 1;
+			if (n + k > UPGRADE_MAX_MSG - 1) break;
+			n += k;
+		}
+		rc = upgrade_send(s, UPG_CACHE, w.buf + off, n, NULL, 0);
+		off += n;
+	}
+	free(w.buf);
+	return rc;
+}
+
+/* Old side of a handoff on connection 's': listeners, then hot cache keys,
+   then wait for the successor to say it is serving. Returns 0 once we are
+   draining, -1 if it went away first (we keep serving). */
+static int hand_over(int s) {
+	static char msg[UPGRADE_MAX_MSG];
+	int type = 0;
+	if (upgrade_recv(s, &type, msg, sizeof(msg), NULL, 0, NULL) < 0 || type != UPG_HELLO) return -1;
+
+	struct upg_layout lay;
+	memset(&lay, 0, sizeof(lay));
+	lay.version = UPG_LAYOUT_VERSION;
+	int fds[UPGRADE_MAX_FDS];
+	int nfds = 0;
+	pthread_mutex_lock(&g_rt.mtx);
+	lay.port = g_rt.cur.port;
+	lay.reuseport = g_rt.cur.reuseport;
+	pthread_mutex_unlock(&g_rt.mtx);
+	lay.nacc = g_nacc;
+	for (int g = 0; g < g_nacc; g++) {
+		lay.node[g] = g_acc[g].node;
+		lay.nlfd[g] = g_acc[g].nlfd;
+		for (int k = 0; k < g_acc[g].nlfd; k++) {
+			if (nfds == UPGRADE_MAX_FDS) {
+				static const char why[] = "too many listeners to hand over";
+				(void)upgrade_send(s, UPG_REFUSE, why, sizeof(why) - 1, NULL, 0);
+				return -1;
+			}
+			fds[nfds++] = g_acc[g].lfd[k];
+		}
+	}
+	if (upgrade_send(s, UPG_LISTENERS, &lay, sizeof(lay), fds, nfds) < 0 ||
+	    send_warm_keys(s) < 0 || upgrade_send(s, UPG_END, NULL, 0, NULL, 0) < 0)
+		return -1;
+
+	/* The successor accepts on the same sockets from here; we keep
+	   accepting too until it says go, so nothing waits in between. */
+	if (upgrade_recv(s, &type, msg, sizeof(msg), NULL, 0, NULL) < 0 || type != UPG_GO) return -1;
+	drain_start();
+	close(g_upg.sock);   /* the successor binds the path next */
+	g_upg.sock = -1;
+	(void)upgrade_send(s, UPG_OK, NULL, 0, NULL, 0);
+	return 0;
+}
 
-	/* Not normally reached; graceful shutdown pattern for completeness */
-	workq_close(&q);
-	for (int i = 0; i < N_WORKERS; i++) pthread_join(tids[i], NULL);
-	workq_destroy(&q);
-	close(sfd);
+/* Wait for a successor on the upgrade socket; one handoff, then done. */
+static void *upgrade_thread_main(void *arg) {
+	(void)arg;
+	for (;;) {
+		int s = accept(g_upg.sock, NULL, NULL);
+		if (s < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			perror("upgrade: accept");
+			return NULL;
+		}
+		const int done = hand_over(s) == 0;
+		close(s);
+		if (done) {
+			fprintf(stderr, "upgrade: listeners handed over; draining\n");
+			return NULL;
+		}
+		fprintf(stderr, "upgrade: successor went away; still serving\n");
+	}
+}
+
+/* New side: adopt the running server's listeners and accept loops in place
+   of binding, then warm the dentry cache with the keys it sent. Returns 0,
+   or -1 (reported) leaving the old server to carry on. */
+static int take_over(int s, const struct mh_config *cfg) {
+	static char msg[UPGRADE_MAX_MSG];
+	int fds[UPGRADE_MAX_FDS];
+	int nfds = 0, type = 0;
+	if (upgrade_send(s, UPG_HELLO, NULL, 0, NULL, 0) < 0) { perror("upgrade: hello"); return -1; }
+	ssize_t n = upgrade_recv(s, &type, msg, sizeof(msg), fds, UPGRADE_MAX_FDS, &nfds);
+	if (n < 0 || type != UPG_LISTENERS) {
+		if (type == UPG_REFUSE) fprintf(stderr, "upgrade: refused: %.*s\n", (int)n, msg);
+		else fprintf(stderr, "upgrade: no listeners from the running server\n");
+		for (int i = 0; i < nfds; i++) close(fds[i]);
+		return -1;
+	}
+
+	struct upg_layout lay;
+	const char *bad = NULL;
+	memcpy(&lay, msg, (size_t)n < sizeof(lay) ? (size_t)n : sizeof(lay));
+	if ((size_t)n != sizeof(lay) || lay.version != UPG_LAYOUT_VERSION ||
+	    lay.nacc < 1 || lay.nacc > MAX_ACCEPTORS) {
+		bad = "handoff format differs";
+	} else if (lay.port != cfg->port) {
+		bad = "port differs";
+	} else if (!lay.reuseport != !cfg->reuseport) {
+		bad = "reuseport differs";
+	} else {
+		int total = 0;
+		for (int g = 0; g < lay.nacc; g++) {
+			if (lay.nlfd[g] < 1 || lay.nlfd[g] > MAX_WORKERS) total = -1;
+			if (total >= 0) total += lay.nlfd[g];
+		}
+		if (total != nfds) bad = "listener count mismatch";
+	}
+	if (bad) {
+		fprintf(stderr, "Error: upgrade: %s; the running server keeps serving\n", bad);
+		for (int i = 0; i < nfds; i++) close(fds[i]);
+		return -1;
+	}
+
+	g_nacc = lay.nacc;
+	for (int g = 0, i = 0; g < g_nacc; g++) {
+		g_acc[g].node = lay.node[g];
+		g_acc[g].nlfd = lay.nlfd[g];
+		for (int k = 0; k < lay.nlfd[g]; k++) {
+			g_acc[g].lfd[k] = fds[i++];
+			if (listen(g_acc[g].lfd[k], cfg->backlog) < 0) perror("listen");   /* our backlog */
+		}
+	}
+
+	/* Resolve the old server's hot paths now, off the request path. */
+	struct mh_arena a;
+	static char abs[PATH_MAX];
+	size_t warmed = 0;
+	const int have_arena = arena_init(&a, 16 * 1024) == 0;
+	for (;;) {
+		n = upgrade_recv(s, &type, msg, sizeof(msg), NULL, 0, NULL);
+		if (n < 0 || type != UPG_CACHE) break;
+		for (size_t off = 0; have_arena && off < (size_t)n; ) {
+			const char *key = msg + off;
+			const size_t k = strnlen(key, (size_t)n - off);
+			if (off + k == (size_t)n) break;   /* unterminated */
+			const int kind = resolve_path(&a, g_docroot, key, abs, sizeof(abs));
+			if (kind == DC_FILE || kind == DC_INDEX || kind == DC_DIR) warmed++;
+			arena_reset(&a);
+			off += k + 1;
+		}
+	}
+	if (have_arena) arena_destroy(&a);
+	if (type != UPG_END) {
+		fprintf(stderr, "Error: upgrade: the running server went away mid-handoff\n");
+		return -1;
+	}
+	fprintf(stderr, "upgrade: took %d listener(s) from the running server, warmed %zu cache entr%s\n",
+	        nfds, warmed, warmed == 1 ? "y" : "ies");
+	return 0;
+}
+
+/* --------- main() --------- */
+
+int main(int argc, char *argv[]) {
+	char err[256];
+	if (config_build(&g_rt.boot, argc, argv, err, sizeof(err)) != 0) {
+		fprintf(stderr, "Error: %s\n", err);
+		usage(argv[0]);
+		return 1;
+	}
+	g_rt.argc = argc;
+	g_rt.argv = argv;
+	g_rt.cur = g_rt.boot;
+	struct mh_config *cfg = &g_rt.cur;
+
+	/* Every thread from here on inherits the mask; the reload thread
+	   sigwait()s for SIGHUP. */
+	static sigset_t hup;
+	sigemptyset(&hup);
+	sigaddset(&hup, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &hup, NULL);
+
+	if (cfg->tls_cert[0] && tls_init(cfg->tls_cert, cfg->tls_key) != 0) {
+		fprintf(stderr, "TLS setup failed: %s\n", strerror(errno));
+		return 1;
+	}
+
+	/* Avoid SIGPIPE killing the process if peer closes */
+	signal(SIGPIPE, SIG_IGN);
+
+	/* Resolve docroot to an absolute, symlink-free path once */
+	if (!realpath(cfg->root, g_docroot)) {
+		perror("realpath(docroot)");
+		return 1;
+	}
+
+	if (plock_configure(cfg->plock_buckets) != 0)
+		fprintf(stderr, "plock-buckets: %s\n", strerror(errno));
+
+	/* Docroot manifest: mapped now, or crawled in the background; the
+	   dcache watcher tells it what changes from here on. */
+	if (cfg->manifest[0]) {
+		if (manifest_open(cfg->manifest, g_docroot) != 0)
+			fprintf(stderr, "manifest %s: %s\n", cfg->manifest, strerror(errno));
+		dcache_set_change_hook(manifest_note_change);
+	}
+
+	/* Asset bundle: a deploy artifact, so serving without it is an error. */
+	if (cfg->bundle[0] && bundle_open(cfg->bundle) != 0) {
+		fprintf(stderr, "bundle %s: %s\n", cfg->bundle,
+		        errno == EINVAL ? "not a bundle (see tools/mhpack)" : strerror(errno));
+		return 1;
+	}
+
+	/* Content store for uploads: same filesystem as the docroot, outside it. */
+	if (cfg->cas[0] && cas_open(cfg->cas, g_docroot) != 0) {
+		fprintf(stderr, "cas %s: %s\n", cfg->cas,
+		        errno == EXDEV ? "not on the docroot's filesystem" :
+		        errno == EINVAL ? "inside the docroot" : strerror(errno));
+		return 1;
+	}
+
+	/* Path-resolution cache; only trusted while inotify keeps it coherent */
+	if (dcache_init(cfg->dcache_entries) != 0 || (cfg->dcache_entries && dcache_watch(g_docroot) != 0))
+		fprintf(stderr, "dcache disabled: %s\n", strerror(errno));
+	if (hot_start((size_t)cfg->hot_keys, hot_resolve) != 0)
+		fprintf(stderr, "hot-path pinning disabled: %s\n", strerror(errno));
+
+	apply_runtime(cfg);
+
+	printf("Starting MyHTTP…\n");
+	printf("\t Port: %d\n", cfg->port);
+	printf("\t Root: %s\n", g_docroot);
+	printf("\t Config: %s\n", cfg->config_file[0] ? cfg->config_file : "(none)");
+	if (cfg->bundle[0]) {
+		struct bundle_stats bs;
+		bundle_get_stats(&bs);
+		printf("\t Bundle: %s (%zu files)\n", cfg->bundle, bs.entries);
+	}
+	if (cfg->cas[0]) {
+		struct cas_stats cs;
+		cas_get_stats(&cs);
+		printf("\t CAS: %s (%zu blobs)\n", cfg->cas, cs.blobs);
+	}
+	if (cfg->manifest[0]) {
+		struct manifest_stats ms;
+		manifest_get_stats(&ms);
+		if (ms.entries) printf("\t Manifest: %s (%zu entries)\n", cfg->manifest, ms.entries);
+		else            printf("\t Manifest: %s (building)\n", cfg->manifest);
+	}
+	printf("\t TLS:  %s\n", cfg->tls_cert[0] ? cfg->tls_cert : "off");
+	printf("\t Admission: %s, max in flight %zu\n", cfg->adaptive ? "gradient" : "fixed", max_inflight(cfg));
+	printf("\t Timeouts (idle/header/body/write): %g/%g/%g/%gs\n",
+	       cfg->idle_ms / 1e3, cfg->header_ms / 1e3, cfg->body_ms / 1e3, cfg->write_ms / 1e3);
+
+	/* Worker placement: with --pin-workers each worker gets its own CPU,
+	   spread evenly over the CPUs (and NUMA nodes) we may run on. */
+	if (cfg->pin_workers && topo_init() != 0) {
+		fprintf(stderr, "CPU topology unavailable (%s); workers not pinned\n", strerror(errno));
+		cfg->pin_workers = cfg->reuseport = 0;
+	}
+	g_pool.pin = cfg->pin_workers;
+
+	/* With an upgrade socket, a server already running there hands us its
+	   listeners instead of us binding; otherwise we will be the one
+	   listening for a successor. */
+	int upg = -1;
+	if (cfg->upgrade_socket[0]) {
+		upg = upgrade_connect(cfg->upgrade_socket);
+		if (upg < 0 && errno != ENOENT && errno != ECONNREFUSED) {
+			fprintf(stderr, "Error: upgrade socket %s: %s\n", cfg->upgrade_socket, strerror(errno));
+			return 1;
+		}
+		if (pipe2(g_upg.wake, O_CLOEXEC) != 0) { perror("pipe"); return 1; }
+	}
+
+	/* Listeners: one socket and accept loop by default. With --reuseport,
+	   an accept loop and queue per node that has workers, listening on a
+	   socket per worker CPU, so a connection is accepted and served on the
+	   node whose NIC queue received it. */
+	g_acc[0].node = -1;
+	if (upg >= 0) {
+		if (take_over(upg, cfg) != 0) return 1;
+	} else if (cfg->reuseport) {
+		g_nacc = 0;
+		for (int i = 0; i < cfg->workers; i++) {
+			const int cpu = topo_worker_cpu(i, cfg->workers);
+			const int node = topo_node_of(cpu);
+			int g = 0;
+			while (g < g_nacc && g_acc[g].node != node) g++;
+			if (g == g_nacc && g_nacc < MAX_ACCEPTORS) g_acc[g_nacc++].node = node;
+			if (g == MAX_ACCEPTORS) g = node % MAX_ACCEPTORS;
+
+			int seen = 0;
+			for (int k = 0; k < i; k++) seen |= topo_worker_cpu(k, cfg->workers) == cpu;
+			if (seen) continue;
+			int lfd = open_listener(cfg->port, cpu, cfg->backlog);
+			if (lfd < 0) return 1;
+			g_acc[g].lfd[g_acc[g].nlfd++] = lfd;
+		}
+	} else {
+		g_acc[0].lfd[0] = open_listener(cfg->port, -1, cfg->backlog);
+		if (g_acc[0].lfd[0] < 0) return 1;
+		g_acc[0].nlfd = 1;
+	}
+	/* Another process may take a connection between our poll() and
+	   accept(): never block in accept() on a socket that can be shared. */
+	if (g_upg.wake[0] >= 0) {
+		for (int g = 0; g < g_nacc; g++)
+			for (int k = 0; k < g_acc[g].nlfd; k++)
+				(void)fcntl(g_acc[g].lfd[k], F_SETFL, fcntl(g_acc[g].lfd[k], F_GETFL) | O_NONBLOCK);
+	}
+	fprintf(stderr, "Listening on port %d … (workers=%d", cfg->port, cfg->workers);
+	if (cfg->pin_workers) {
+		fprintf(stderr, ", CPUs");
+		for (int i = 0; i < cfg->workers; i++)
+			fprintf(stderr, "%c%d", i ? ',' : ' ', topo_worker_cpu(i, cfg->workers));
+		fprintf(stderr, ", %d node%s", topo_nnodes(), topo_nnodes() == 1 ? "" : "s");
+	}
+	if (cfg->reuseport) fprintf(stderr, ", %d accept loop%s", g_nacc, g_nacc == 1 ? "" : "s");
+	fprintf(stderr, ", I/O threads=%d)\n", cfg->io_workers);
+
+	/* Initialize work queues and start worker threads */
+	for (int g = 0; g < g_nacc; g++) {
+		if (workq_init(&g_acc[g].q, cfg->queue_capacity) != 0) {
+			fprintf(stderr, "workq_init failed: %s\n", strerror(errno));
+			return 1;
+		}
+		metrics_attach_workq(&g_acc[g].q);
+	}
+
+	pthread_attr_init(&g_pool.attr);
+	pthread_attr_setdetachstate(&g_pool.attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_attr_setstacksize(&g_pool.attr, WORKER_STACK_SZ) != 0)
+		fprintf(stderr, "worker stack size %d rejected; using default\n", WORKER_STACK_SZ);
+	cfg->workers = pool_resize(cfg->workers);
+	cfg->io_workers = iopool_resize(cfg->io_workers);
+	apply_admission(cfg);
+
+	/* Accept loops are joined when they stop after a handoff. */
+	pthread_attr_t acc_attr;
+	pthread_attr_init(&acc_attr);
+	(void)pthread_attr_setstacksize(&acc_attr, WORKER_STACK_SZ);
+	int started[MAX_ACCEPTORS] = {0};
+	for (int g = 1; g < g_nacc; g++) {
+		started[g] = pthread_create(&g_acc[g].tid, &acc_attr, acceptor_main, &g_acc[g]) == 0;
+		if (!started[g]) fprintf(stderr, "pthread_create failed (accept loop %d)\n", g);
+	}
+	pthread_attr_destroy(&acc_attr);
+	pthread_t reload_tid;
+	if (pthread_create(&reload_tid, &g_pool.attr, reload_thread_main, &hup) != 0)
+		fprintf(stderr, "pthread_create failed (reload); SIGHUP ignored\n");
+
+	/* Serving on the inherited listeners: the old server can stop. */
+	if (upg >= 0) {
+		int type = 0;
+		char ok[64];
+		if (upgrade_send(upg, UPG_GO, NULL, 0, NULL, 0) < 0 ||
+		    upgrade_recv(upg, &type, ok, sizeof(ok), NULL, 0, NULL) < 0 || type != UPG_OK)
+			fprintf(stderr, "upgrade: no reply from the old server (it may keep accepting)\n");
+		else
+			fprintf(stderr, "upgrade: serving; the old server is draining\n");
+		close(upg);
+	}
+	if (cfg->upgrade_socket[0]) {
+		g_upg.sock = upgrade_listen(cfg->upgrade_socket);
+		pthread_t upg_tid;
+		if (g_upg.sock < 0)
+			fprintf(stderr, "upgrade socket %s: %s; upgrades off\n", cfg->upgrade_socket, strerror(errno));
+		else if (pthread_create(&upg_tid, &g_pool.attr, upgrade_thread_main, NULL) != 0)
+			fprintf(stderr, "pthread_create failed (upgrade); upgrades off\n");
+	}
+
+	/* The first accept loop runs on the main thread. */
+	(void)acceptor_main(&g_acc[0]);
+
+	/* Back here only after handing the listeners to a successor: finish
+	   the connections already accepted (queued ones included), for at
+	   most drain-timeout, then exit. */
+	for (int g = 1; g < g_nacc; g++)
+		if (started[g]) pthread_join(g_acc[g].tid, NULL);
+	for (int g = 0; g < g_nacc; g++) workq_close(&g_acc[g].q);
+
+	pthread_mutex_lock(&g_rt.mtx);
+	const unsigned drain_ms = cfg->drain_ms;
+	pthread_mutex_unlock(&g_rt.mtx);
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_sec += drain_ms / 1000;
+	until.tv_nsec += (long)(drain_ms % 1000) * 1000000L;
+	if (until.tv_nsec >= 1000000000L) { until.tv_sec++; until.tv_nsec -= 1000000000L; }
+
+	pthread_mutex_lock(&g_pool.mtx);
+	int rc = 0;
+	while ((g_pool.running > 0 || g_pool.at_io > 0) && rc != ETIMEDOUT)
+		rc = drain_ms ? pthread_cond_timedwait(&g_pool.exited, &g_pool.mtx, &until)
+		              : pthread_cond_wait(&g_pool.exited, &g_pool.mtx);
+	const int left = g_pool.running + g_pool.at_io;
+	pthread_mutex_unlock(&g_pool.mtx);
+
+	if (left) {
+		/* Exiting takes the stragglers' connections with it. */
+		fprintf(stderr, "upgrade: drain timeout, closing %d connection(s)\n", left);
+		return 0;
+	}
+	for (int g = 0; g < g_nacc; g++) {
+		workq_destroy(&g_acc[g].q);
+		for (int k = 0; k < g_acc[g].nlfd; k++) close(g_acc[g].lfd[k]);
+	}
+	pthread_attr_destroy(&g_pool.attr);
+	fprintf(stderr, "upgrade: drained, exiting\n");
 	return 0;
 }
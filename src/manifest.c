@@ -0,0 +1,520 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "manifest.h"
+#include "dcache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define MF_MAGIC   "MHMANIF"
+#define MF_VERSION 1u
+#define MF_ORDER   0x01020304u    /* as written: same byte order as ours */
+#define MF_NONE    UINT32_MAX
+
+/* On-disk layout: header, then records, slots and strings, each at an
+   offset from the start of the file. */
+struct mf_header {
+	char     magic[8];
+	uint32_t version;
+	uint32_t order;
+	uint64_t size;        /* whole file */
+	uint32_t nrec;
+	uint32_t nslots;      /* power of two, > nrec */
+	uint64_t rec_off;
+	uint64_t slot_off;    /* uint32_t record index per slot, MF_NONE if empty */
+	uint64_t str_off;     /* NUL-terminated strings */
+	uint64_t str_len;
+	uint64_t root_off;    /* docroot it describes, in the string area */
+};
+
+enum { MF_FILE = 1, MF_DIR = 2 };
+
+struct mf_rec {
+	uint64_t hash;        /* of the key */
+	uint64_t ino;
+	uint64_t size;
+	int64_t  mtime_ns;
+	uint32_t key_off;     /* URL path: "/", "/a", "/a/b.txt" */
+	uint32_t parent;      /* record of the containing directory; MF_NONE for "/" */
+	uint32_t kind;
+	uint32_t pad;
+};
+
+/* Per-record validation state, in memory only: the low bits say what the
+   last check found, the rest count changes reported since, so a check
+   racing with a change does not record a stale result. */
+#define MF_VALID 1u
+#define MF_STALE 2u
+#define MF_EPOCH 4u
+
+#define MF_REBUILD_MIN 16   /* stale records tolerated before recrawling, plus 1/8 of them */
+#define MF_NEW_SLOTS   1024 /* names new since the crawl remembered, so each counts once */
+
+struct mf_map {
+	const char             *base;
+	size_t                  len;
+	const struct mf_header *hdr;
+	const struct mf_rec    *rec;
+	const uint32_t         *slot;
+	const char             *str;
+	uint8_t                *state;
+};
+
+static struct {
+	pthread_rwlock_t lock;       /* readers: lookups and the watcher; writer: swapping maps */
+	struct mf_map    m;          /* m.base NULL: none mapped */
+	const char      *mapped;     /* m.base, for a lock-free "none" test */
+	size_t           stale;
+	uint64_t         fresh[MF_NEW_SLOTS];   /* their key hashes, 0 = free; the watcher's */
+	size_t           nfresh;
+	uint64_t         hits;
+	uint64_t         builds;
+	int              building;
+	char             path[PATH_MAX];
+	char             root[PATH_MAX];
+	size_t           rootlen;
+} g_mf = { .lock = PTHREAD_RWLOCK_INITIALIZER };
+
+
+// ---- Internal helpers ----
+
+static uint64_t fnv1a_64(const char *s, size_t n) {
+	uint64_t h = 1469598103934665603ull;
+	for (size_t i = 0; i < n; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+static int is_upload_temp(const char *name) {
+	return name[0] == '.' && strstr(name, ".tmp.") != NULL;
+}
+
+static int64_t mtime_ns(const struct stat *st) {
+	return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+// Record for 'key' (length n), or MF_NONE. Under the read lock.
+static uint32_t find(const struct mf_map *m, const char *key, size_t n) {
+	const uint64_t h = fnv1a_64(key, n);
+	const uint32_t mask = m->hdr->nslots - 1;
+	for (uint32_t i = (uint32_t)h & mask, probes = 0; probes < m->hdr->nslots; i = (i + 1) & mask, probes++) {
+		const uint32_t r = m->slot[i];
+		if (r == MF_NONE) break;
+		if (r >= m->hdr->nrec || m->rec[r].hash != h || m->rec[r].key_off >= m->hdr->str_len) continue;
+		const char *k = m->str + m->rec[r].key_off;
+		if (strncmp(k, key, n) == 0 && k[n] == '\0') return r;
+	}
+	return MF_NONE;
+}
+
+// Absolute path of record r: the docroot, then its key ("/" is the docroot).
+static int rec_path(const struct mf_map *m, uint32_t r, char *out, size_t outlen) {
+	if (m->rec[r].key_off >= m->hdr->str_len) return -1;
+	const char *key = m->str + m->rec[r].key_off;
+	if (strcmp(key, "/") == 0) key = "";
+	int n = snprintf(out, outlen, "%s%s", g_mf.root, key);
+	return n > 0 && (size_t)n < outlen ? 0 : -1;
+}
+
+static void start_build(void);
+
+/* One more difference between the manifest and the tree (a record found
+   changed, or a name it lacks); enough of them and it is recrawled. */
+static void note_stale(const struct mf_map *m) {
+	const size_t stale = __atomic_add_fetch(&g_mf.stale, 1, __ATOMIC_RELAXED);
+	if (stale > MF_REBUILD_MIN + m->hdr->nrec / 8) start_build();
+}
+
+/* The watcher reported 'key' (length n), which the manifest lacks: one
+   more difference the first time only, however many events the new name
+   gets. Past half the set every report counts, which only brings the
+   recrawl forward. Watcher thread, under the read lock. */
+static void note_new(const struct mf_map *m, const char *key, size_t n) {
+	const uint64_t h = fnv1a_64(key, n) | 1;
+	if (g_mf.nfresh < MF_NEW_SLOTS / 2) {
+		size_t i = (size_t)h & (MF_NEW_SLOTS - 1);
+		for (; g_mf.fresh[i]; i = (i + 1) & (MF_NEW_SLOTS - 1))
+			if (g_mf.fresh[i] == h) return;
+		g_mf.fresh[i] = h;
+		g_mf.nfresh++;
+	}
+	note_stale(m);
+}
+
+static void mark(const struct mf_map *m, uint32_t r, uint8_t seen, uint8_t result) {
+	if (__atomic_compare_exchange_n(&m->state[r], &seen, (uint8_t)(seen | result), 0,
+	                                __ATOMIC_RELAXED, __ATOMIC_RELAXED) && result == MF_STALE)
+		note_stale(m);
+}
+
+/* Record r and every directory above it still are what the crawl saw.
+   Checked entries are remembered only while the watcher would tell us
+   about changes. */
+static int trusted(const struct mf_map *m, uint32_t r) {
+	const int watched = dcache_watched();
+	char path[PATH_MAX];
+	for (int depth = 0; r != MF_NONE; r = m->rec[r].parent, depth++) {
+		if (r >= m->hdr->nrec || depth > MANIFEST_MAX_DEPTH + 1) return 0;
+		uint8_t s = __atomic_load_n(&m->state[r], __ATOMIC_RELAXED);
+		if (watched && (s & MF_VALID)) continue;
+		if (s & MF_STALE) return 0;
+
+		const struct mf_rec *e = &m->rec[r];
+		struct stat st;
+		int ok = rec_path(m, r, path, sizeof(path)) == 0 && lstat(path, &st) == 0 &&
+		         (uint64_t)st.st_ino == e->ino;
+		if (ok && e->kind == MF_DIR)
+			ok = S_ISDIR(st.st_mode);
+		else if (ok)
+			ok = S_ISREG(st.st_mode) && (uint64_t)st.st_size == e->size && mtime_ns(&st) == e->mtime_ns;
+		mark(m, r, s, ok ? MF_VALID : MF_STALE);
+		if (!ok) return 0;
+	}
+	return 1;
+}
+
+// Map 'path' if it is a well-formed manifest of our docroot.
+static int map_file(const char *path, struct mf_map *m) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return -1;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct mf_header)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) return -1;
+
+	const size_t len = (size_t)st.st_size;
+	const struct mf_header *h = (const struct mf_header *)p;
+	const char *base = (const char *)p;
+	int ok = memcmp(h->magic, MF_MAGIC, sizeof(h->magic)) == 0 && h->version == MF_VERSION &&
+	         h->order == MF_ORDER && h->size == len && h->nslots && !(h->nslots & (h->nslots - 1)) &&
+	         h->nrec < h->nslots &&
+	         h->rec_off <= len && h->nrec <= (len - h->rec_off) / sizeof(struct mf_rec) &&
+	         h->slot_off <= len && h->nslots <= (len - h->slot_off) / sizeof(uint32_t) &&
+	         h->str_off <= len && h->str_len && h->str_len <= len - h->str_off &&
+	         h->rec_off % 8 == 0 && h->slot_off % 8 == 0 &&
+	         base[h->str_off + h->str_len - 1] == '\0' && h->root_off < h->str_len &&
+	         strcmp(base + h->str_off + h->root_off, g_mf.root) == 0;
+	if (!ok) {
+		munmap(p, len);
+		errno = EINVAL;
+		return -1;
+	}
+	m->state = (uint8_t *)calloc(h->nrec ? h->nrec : 1, 1);
+	if (!m->state) { munmap(p, len); errno = ENOMEM; return -1; }
+	m->base = base;
+	m->len = len;
+	m->hdr = h;
+	m->rec = (const struct mf_rec *)(base + h->rec_off);
+	m->slot = (const uint32_t *)(base + h->slot_off);
+	m->str = base + h->str_off;
+	return 0;
+}
+
+static void unmap(struct mf_map *m) {
+	if (m->base) munmap((void *)m->base, m->len);
+	free(m->state);
+	memset(m, 0, sizeof(*m));
+}
+
+
+// ---- Building ----
+
+struct mf_build {
+	struct mf_rec *rec;
+	size_t         nrec, cap;
+	char          *str;
+	size_t         slen, scap;
+};
+
+static int add_string(struct mf_build *b, const char *s, size_t n, uint32_t *off) {
+	if (b->slen + n + 1 > b->scap) {
+		size_t cap = b->scap ? b->scap * 2 : 1 << 16;
+		while (cap < b->slen + n + 1) cap *= 2;
+		if (cap > UINT32_MAX) { errno = EFBIG; return -1; }
+		char *ns = (char *)realloc(b->str, cap);
+		if (!ns) return -1;
+		b->str = ns;
+		b->scap = cap;
+	}
+	*off = (uint32_t)b->slen;
+	memcpy(b->str + b->slen, s, n);
+	b->str[b->slen + n] = '\0';
+	b->slen += n + 1;
+	return 0;
+}
+
+static int add_rec(struct mf_build *b, const char *key, size_t n, uint32_t parent,
+                   const struct stat *st, uint32_t *idx) {
+	if (b->nrec == b->cap) {
+		size_t cap = b->cap ? b->cap * 2 : 1024;
+		if (cap >= MF_NONE / 2) { errno = EFBIG; return -1; }
+		struct mf_rec *nr = (struct mf_rec *)realloc(b->rec, cap * sizeof(*nr));
+		if (!nr) return -1;
+		b->rec = nr;
+		b->cap = cap;
+	}
+	struct mf_rec *e = &b->rec[b->nrec];
+	memset(e, 0, sizeof(*e));
+	if (add_string(b, key, n, &e->key_off) < 0) return -1;
+	e->hash = fnv1a_64(key, n);
+	e->ino = (uint64_t)st->st_ino;
+	e->size = (uint64_t)st->st_size;
+	e->mtime_ns = mtime_ns(st);
+	e->parent = parent;
+	e->kind = S_ISDIR(st->st_mode) ? MF_DIR : MF_FILE;
+	*idx = (uint32_t)b->nrec++;
+	return 0;
+}
+
+/* Add the entries of directory 'dfd' (consumed), whose key is key[0..klen)
+   ("" for the docroot), and recurse into its subdirectories. Symlinks and
+   special files are left to the normal resolution path. */
+static int crawl(struct mf_build *b, int dfd, char *key, size_t klen, uint32_t parent, int depth) {
+	DIR *d = fdopendir(dfd);
+	if (!d) { close(dfd); return 0; }
+	int rc = 0;
+	struct dirent *de;
+	while (rc == 0 && (de = readdir(d)) != NULL) {
+		const char *name = de->d_name;
+		if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || is_upload_temp(name)) continue;
+		const size_t nl = strlen(name);
+		if (klen + 1 + nl >= PATH_MAX) continue;
+		struct stat st;
+		if (fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+		if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode)) continue;
+
+		key[klen] = '/';
+		memcpy(key + klen + 1, name, nl + 1);
+		uint32_t idx;
+		rc = add_rec(b, key, klen + 1 + nl, parent, &st, &idx);
+		if (rc == 0 && S_ISDIR(st.st_mode) && depth < MANIFEST_MAX_DEPTH) {
+			int cfd = openat(dirfd(d), name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+			if (cfd >= 0) rc = crawl(b, cfd, key, klen + 1 + nl, idx, depth + 1);
+		}
+	}
+	closedir(d);
+	return rc;
+}
+
+// Lay out 'b' as a manifest file at 'path' (written aside, then renamed).
+static int write_file(const struct mf_build *b, const char *path) {
+	uint32_t nslots = 16;
+	while (nslots < 2 * b->nrec) nslots *= 2;
+
+	struct mf_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, MF_MAGIC, sizeof(h.magic));
+	h.version = MF_VERSION;
+	h.order = MF_ORDER;
+	h.nrec = (uint32_t)b->nrec;
+	h.nslots = nslots;
+	h.rec_off = sizeof(h);
+	h.slot_off = h.rec_off + b->nrec * sizeof(struct mf_rec);
+	h.str_off = h.slot_off + (uint64_t)nslots * sizeof(uint32_t);
+	h.str_len = b->slen;
+	h.size = h.str_off + h.str_len;
+	h.root_off = 0;   // the first string
+
+	uint32_t *slot = (uint32_t *)malloc((size_t)nslots * sizeof(uint32_t));
+	if (!slot) return -1;
+	memset(slot, 0xff, (size_t)nslots * sizeof(uint32_t));
+	for (uint32_t r = 0; r < h.nrec; r++) {
+		uint32_t i = (uint32_t)b->rec[r].hash & (nslots - 1);
+		while (slot[i] != MF_NONE) i = (i + 1) & (nslots - 1);
+		slot[i] = r;
+	}
+
+	char tmp[PATH_MAX];
+	int n = snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+	if (n < 0 || (size_t)n >= sizeof(tmp)) { free(slot); errno = ENAMETOOLONG; return -1; }
+	int fd = mkstemp(tmp);
+	if (fd < 0) { free(slot); return -1; }
+	FILE *f = fdopen(fd, "wb");
+	if (!f) { close(fd); unlink(tmp); free(slot); return -1; }
+	int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+	         (b->nrec == 0 || fwrite(b->rec, sizeof(struct mf_rec), b->nrec, f) == b->nrec) &&
+	         fwrite(slot, sizeof(uint32_t), nslots, f) == nslots &&
+	         fwrite(b->str, 1, b->slen, f) == b->slen;
+	free(slot);
+	ok = fflush(f) == 0 && ok;
+	ok = fchmod(fileno(f), 0644) == 0 && ok;
+	ok = fclose(f) == 0 && ok;
+	if (!ok || rename(tmp, path) < 0) {
+		int e = errno;
+		unlink(tmp);
+		errno = e ? e : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+// Crawl the docroot into a new manifest file.
+static int build(void) {
+	struct mf_build b;
+	memset(&b, 0, sizeof(b));
+	char *key = (char *)malloc(PATH_MAX);
+	int rc = -1;
+	uint32_t root_key_off, root_idx;
+	struct stat st;
+	int dfd = -1;
+	if (key && add_string(&b, g_mf.root, g_mf.rootlen, &root_key_off) == 0 &&
+	    (dfd = open(g_mf.root, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) >= 0 &&
+	    fstat(dfd, &st) == 0 && add_rec(&b, "/", 1, MF_NONE, &st, &root_idx) == 0) {
+		rc = crawl(&b, dfd, key, 0, root_idx, 1);
+		dfd = -1;   // consumed
+		if (rc == 0) rc = write_file(&b, g_mf.path);
+	}
+	int e = errno;
+	if (dfd >= 0) close(dfd);
+	free(key);
+	free(b.rec);
+	free(b.str);
+	errno = e;
+	return rc;
+}
+
+static void *build_main(void *arg) {
+	(void)arg;
+	struct mf_map m;
+	memset(&m, 0, sizeof(m));
+	if (build() < 0 || map_file(g_mf.path, &m) < 0) {
+		fprintf(stderr, "manifest %s: build failed: %s\n", g_mf.path, strerror(errno));
+	} else {
+		pthread_rwlock_wrlock(&g_mf.lock);
+		struct mf_map old = g_mf.m;
+		g_mf.m = m;
+		__atomic_store_n(&g_mf.mapped, m.base, __ATOMIC_RELEASE);
+		__atomic_store_n(&g_mf.stale, 0, __ATOMIC_RELAXED);
+		memset(g_mf.fresh, 0, sizeof(g_mf.fresh));
+		g_mf.nfresh = 0;
+		pthread_rwlock_unlock(&g_mf.lock);
+		unmap(&old);
+		__atomic_add_fetch(&g_mf.builds, 1, __ATOMIC_RELAXED);
+		fprintf(stderr, "manifest %s: %u entries\n", g_mf.path, m.hdr->nrec);
+	}
+	__atomic_store_n(&g_mf.building, 0, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+// One crawl at a time, in the background.
+static void start_build(void) {
+	if (__atomic_exchange_n(&g_mf.building, 1, __ATOMIC_ACQ_REL)) return;
+	pthread_t tid;
+	if (pthread_create(&tid, NULL, build_main, NULL) != 0) {
+		__atomic_store_n(&g_mf.building, 0, __ATOMIC_RELEASE);
+		return;
+	}
+	pthread_detach(tid);
+}
+
+
+//----- API ----------
+
+int manifest_open(const char *path, const char *docroot_real) {
+	if (!path || !docroot_real || strlen(path) >= sizeof(g_mf.path) ||
+	    strlen(docroot_real) >= sizeof(g_mf.root)) {
+		errno = EINVAL;
+		return -1;
+	}
+	strcpy(g_mf.path, path);
+	strcpy(g_mf.root, docroot_real);
+	g_mf.rootlen = strlen(docroot_real);
+
+	if (map_file(path, &g_mf.m) == 0) {
+		__atomic_store_n(&g_mf.mapped, g_mf.m.base, __ATOMIC_RELEASE);
+		return 0;
+	}
+	if (errno != ENOENT && errno != EINVAL) return -1;
+	start_build();   // missing, damaged, or another docroot's
+	return 0;
+}
+
+int manifest_lookup(const char *key, char *abs, size_t abslen) {
+	if (!key || key[0] != '/' || !__atomic_load_n(&g_mf.mapped, __ATOMIC_ACQUIRE)) return DC_MISS;
+	size_t n = strlen(key);
+	if (n > 1 && key[n - 1] == '/') n--;   // "/dir/" names the directory
+	if (n + sizeof("/index.html") > PATH_MAX) return DC_MISS;
+
+	int kind = DC_MISS;
+	pthread_rwlock_rdlock(&g_mf.lock);
+	const struct mf_map *m = &g_mf.m;
+	uint32_t r = m->base ? find(m, key, n) : MF_NONE;
+	if (r != MF_NONE && m->rec[r].kind == MF_DIR) {
+		// A directory is only answered for its index; listings resolve normally.
+		char idx[PATH_MAX];
+		memcpy(idx, key, n);
+		const size_t in = (n == 1 ? 0 : n);
+		memcpy(idx + in, "/index.html", sizeof("/index.html"));
+		r = find(m, idx, in + sizeof("/index.html") - 1);
+		kind = DC_INDEX;
+	} else if (r != MF_NONE) {
+		kind = DC_FILE;
+	}
+	if (r == MF_NONE || m->rec[r].kind != MF_FILE || !trusted(m, r) || rec_path(m, r, abs, abslen) < 0)
+		kind = DC_MISS;
+	pthread_rwlock_unlock(&g_mf.lock);
+	if (kind != DC_MISS) __atomic_add_fetch(&g_mf.hits, 1, __ATOMIC_RELAXED);
+	return kind;
+}
+
+void manifest_note_change(const char *dir, const char *name) {
+	if (!__atomic_load_n(&g_mf.mapped, __ATOMIC_ACQUIRE)) return;
+	pthread_rwlock_rdlock(&g_mf.lock);
+	const struct mf_map *m = &g_mf.m;
+	if (!m->base) {
+		// swapped out meanwhile
+	} else if (!dir) {
+		for (uint32_t r = 0; r < m->hdr->nrec; r++)
+			__atomic_store_n(&m->state[r], (uint8_t)((m->state[r] & ~3u) + MF_EPOCH), __ATOMIC_RELAXED);
+	} else if (strncmp(dir, g_mf.root, g_mf.rootlen) == 0 &&
+	           (dir[g_mf.rootlen] == '\0' || dir[g_mf.rootlen] == '/')) {
+		char key[PATH_MAX];
+		const char *rel = dir + g_mf.rootlen;
+		int n = name && name[0] ? snprintf(key, sizeof(key), "%s/%s", rel, name)
+		                        : snprintf(key, sizeof(key), "%s", rel[0] ? rel : "/");
+		const int fits = n > 0 && (size_t)n < sizeof(key);
+		const uint32_t r = fits ? find(m, key, (size_t)n) : MF_NONE;
+		if (r == MF_NONE) {
+			// new since the crawl
+			if (fits) note_new(m, key, (size_t)n);
+			else      note_stale(m);
+		} else {
+			// Forget the last check: the next lookup re-validates.
+			uint8_t s = __atomic_load_n(&m->state[r], __ATOMIC_RELAXED);
+			while (!__atomic_compare_exchange_n(&m->state[r], &s, (uint8_t)((s & ~3u) + MF_EPOCH), 0,
+			                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				;
+		}
+	}
+	pthread_rwlock_unlock(&g_mf.lock);
+}
+
+void manifest_get_stats(struct manifest_stats *out) {
+	memset(out, 0, sizeof(*out));
+	pthread_rwlock_rdlock(&g_mf.lock);
+	if (g_mf.m.base) out->entries = g_mf.m.hdr->nrec;
+	pthread_rwlock_unlock(&g_mf.lock);
+	out->stale = __atomic_load_n(&g_mf.stale, __ATOMIC_RELAXED);
+	out->hits = __atomic_load_n(&g_mf.hits, __ATOMIC_RELAXED);
+	out->builds = __atomic_load_n(&g_mf.builds, __ATOMIC_RELAXED);
+}
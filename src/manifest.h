@@ -0,0 +1,50 @@
+#ifndef MYHTTP_MANIFEST_H
+#define MYHTTP_MANIFEST_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+/* Docroot manifest: a snapshot of every file and directory under the
+   docroot (URL path hash, inode, size, mtime), kept in a file that is
+   mmap'd at startup, so a restart does not have to crawl the tree or walk
+   fs_join_safe() for each first request.
+
+   The file holds only offsets (header, record array, hash slots, key
+   strings), so it maps anywhere. It is built by a background crawl when
+   missing or for another docroot, and recrawled once enough changes it
+   does not reflect pile up; the new file replaces the old by rename().
+
+   Entries are validated lazily: the first lookup of a file lstat()s it
+   against the recorded inode, size and mtime, and each directory above
+   it once against its inode. After that the entry is trusted until the
+   dcache's inotify watcher reports a change to it (manifest_note_change());
+   without a watcher every lookup re-validates. */
+
+#ifndef MANIFEST_MAX_DEPTH
+#define MANIFEST_MAX_DEPTH 32       /* directories deeper than this are left out */
+#endif
+
+/* Map the manifest at 'path' for 'docroot_real', or start building it in
+   the background if it is missing or does not match. Returns 0 (lookups
+   miss until a build completes), or -1 with errno set. */
+int    manifest_open(const char *path, const char *docroot_real);
+
+/* Resolve decoded URL path 'key' from the manifest. Returns DC_FILE or
+   DC_INDEX (dcache.h) with the canonical path in 'abs', or DC_MISS when
+   the manifest has nothing trustworthy (the caller resolves normally). */
+int    manifest_lookup(const char *key, char *abs, size_t abslen);
+
+/* Watcher hook: 'name' in directory 'dir' (absolute) changed; NULL 'dir'
+   means anything may have (queue overflow). */
+void   manifest_note_change(const char *dir, const char *name);
+
+struct manifest_stats {
+	size_t   entries;    // records in the mapped manifest (0 while none)
+	size_t   stale;      // changes it does not reflect, seen since it was mapped
+	uint64_t hits;       // lookups answered from it
+	uint64_t builds;     // crawls completed by this process
+};
+
+void   manifest_get_stats(struct manifest_stats *out);
+
+#endif /* MYHTTP_MANIFEST_H */
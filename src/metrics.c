@@ -0,0 +1,531 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "metrics.h"
+#include "http_parse.h"
+#include "workq.h"
+#include "allochook.h"
+#include "bufpool.h"
+#include "manifest.h"
+#include "bundle.h"
+#include "iohint.h"
+#include "iopool.h"
+#include "trace.h"
+#include "hotkeys.h"
+#include "batch.h"
+#include "cas.h"
+#include "tls.h"
+#include "admit.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+struct mx_hist {
+	uint64_t count;
+	uint64_t sum_us;
+	uint64_t b[MX_HIST_BUCKETS];
+};
+
+/* One per thread; only its owner writes it. */
+struct mx_slot {
+	uint64_t requests[MX_NMETHODS][MX_NCLASSES];
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint64_t connections;
+	uint64_t request_allocs;     // heap allocations while serving (alloc-hook builds)
+	uint64_t timeouts[MX_NTIMEOUTS];
+	struct mx_hist latency[MX_NMETHODS][MX_NCLASSES];
+	struct mx_hist queue_wait;
+	struct mx_hist plock_wait;
+	struct mx_hist io_wait;
+} __attribute__((aligned(64)));
+
+static struct {
+	struct mx_slot  *slots[METRICS_MAX_SLOTS];
+	unsigned         nslots;
+	struct mx_slot   overflow;   // shared by threads beyond METRICS_MAX_SLOTS
+	struct mh_workq *q[METRICS_MAX_QUEUES];
+	unsigned         nq;
+} g_mx;
+
+static _Thread_local struct mx_slot *tl_slot;
+
+
+// ---- Internal helpers ----
+
+#define MX_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define MX_LOAD(p)   __atomic_load_n((p), __ATOMIC_RELAXED)
+
+static struct mx_slot *my_slot(void) {
+	if (tl_slot) return tl_slot;
+
+	unsigned idx = __atomic_fetch_add(&g_mx.nslots, 1, __ATOMIC_ACQ_REL);
+	struct mx_slot *s = NULL;
+	if (idx < METRICS_MAX_SLOTS)
+		s = (struct mx_slot *)aligned_alloc(64, sizeof(struct mx_slot));
+	if (s) {
+		memset(s, 0, sizeof(*s));
+		__atomic_store_n(&g_mx.slots[idx], s, __ATOMIC_RELEASE);
+	} else {
+		s = &g_mx.overflow;
+	}
+	tl_slot = s;
+	return s;
+}
+
+/* Log-linear bucket index for a value in microseconds. */
+static unsigned hist_index(uint64_t us) {
+	if (us < MX_SUB_BUCKETS) return (unsigned)us;
+	unsigned e = 63u - (unsigned)__builtin_clzll(us);
+	if (e > MX_MAX_EXP) return MX_HIST_BUCKETS - 1;
+	unsigned sub = (unsigned)(us >> (e - MX_SUB_BITS)) & (MX_SUB_BUCKETS - 1);
+	return MX_SUB_BUCKETS + (e - MX_SUB_BITS) * MX_SUB_BUCKETS + sub;
+}
+
+/* Lower bound (us) and width of bucket 'i'. */
+static void hist_bounds(unsigned i, double *lo, double *width) {
+	if (i < MX_SUB_BUCKETS) { *lo = (double)i; *width = 1.0; return; }
+	unsigned e   = (i - MX_SUB_BUCKETS) / MX_SUB_BUCKETS + MX_SUB_BITS;
+	unsigned sub = (i - MX_SUB_BUCKETS) % MX_SUB_BUCKETS;
+	*width = (double)(1ull << (e - MX_SUB_BITS));
+	*lo    = (double)(MX_SUB_BUCKETS + sub) * *width;
+}
+
+static void hist_observe(struct mx_hist *h, uint64_t ns) {
+	uint64_t us = ns / 1000u;
+	MX_ADD(&h->count, 1);
+	MX_ADD(&h->sum_us, us);
+	MX_ADD(&h->b[hist_index(us)], 1);
+}
+
+static void hist_accumulate(struct mx_hist *dst, const struct mx_hist *src) {
+	dst->count  += MX_LOAD(&src->count);
+	dst->sum_us += MX_LOAD(&src->sum_us);
+	for (unsigned i = 0; i < MX_HIST_BUCKETS; i++) dst->b[i] += MX_LOAD(&src->b[i]);
+}
+
+/* Estimated value (us) at quantile q: midpoint of the bucket holding it. */
+static double hist_quantile(const struct mx_hist *h, double q) {
+	uint64_t total = 0;
+	for (unsigned i = 0; i < MX_HIST_BUCKETS; i++) total += h->b[i];
+	if (total == 0) return 0.0;
+	uint64_t rank = (uint64_t)(q * (double)total + 0.5);
+	if (rank < 1) rank = 1;
+	uint64_t seen = 0;
+	for (unsigned i = 0; i < MX_HIST_BUCKETS; i++) {
+		seen += h->b[i];
+		if (seen >= rank) {
+			double lo, w;
+			hist_bounds(i, &lo, &w);
+			return lo + w / 2.0;
+		}
+	}
+	return 0.0;
+}
+
+struct sbuf {
+	char  *p;
+	size_t len, cap;
+	int    oom;
+};
+
+static void sb_printf(struct sbuf *sb, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void sb_printf(struct sbuf *sb, const char *fmt, ...) {
+	if (sb->oom) return;
+	for (;;) {
+		va_list ap;
+		va_start(ap, fmt);
+		int n = vsnprintf(sb->p + sb->len, sb->cap - sb->len, fmt, ap);
+		va_end(ap);
+		if (n < 0) { sb->oom = 1; return; }
+		if ((size_t)n < sb->cap - sb->len) { sb->len += (size_t)n; return; }
+		size_t ncap = sb->cap * 2 + (size_t)n;
+		char *np = (char *)realloc(sb->p, ncap);
+		if (!np) { sb->oom = 1; return; }
+		sb->p = np;
+		sb->cap = ncap;
+	}
+}
+
+static const char *k_method_names[MX_NMETHODS] = { "GET", "POST", "PUT", "PATCH", "DELETE", "OTHER" };
+static const char *k_timeout_names[MX_NTIMEOUTS] = { "idle", "header", "body", "write" };
+
+/* Prometheus histogram with power-of-two 'le' edges (8us .. 2^26us). */
+static void sb_histogram(struct sbuf *sb, const char *name, const char *labels,
+                         const struct mx_hist *h) {
+	const char *sep = (labels && *labels) ? "," : "";
+	if (!labels) labels = "";
+	uint64_t cum = 0;
+	unsigned i = 0;
+	for (unsigned k = 3; k <= 26; k++) {
+		unsigned edge = MX_SUB_BUCKETS + (k - MX_SUB_BITS) * MX_SUB_BUCKETS; // first bucket >= 2^k us
+		for (; i < edge; i++) cum += h->b[i];
+		sb_printf(sb, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep,
+		          (double)(1ull << k) / 1e6, (unsigned long long)cum);
+	}
+	sb_printf(sb, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep,
+	          (unsigned long long)h->count);
+	if (*labels) {
+		sb_printf(sb, "%s_sum{%s} %.6f\n", name, labels, (double)h->sum_us / 1e6);
+		sb_printf(sb, "%s_count{%s} %llu\n", name, labels, (unsigned long long)h->count);
+	} else {
+		sb_printf(sb, "%s_sum %.6f\n", name, (double)h->sum_us / 1e6);
+		sb_printf(sb, "%s_count %llu\n", name, (unsigned long long)h->count);
+	}
+}
+
+
+//----- API ----------
+
+uint64_t metrics_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int metrics_method_index(int m) {
+	switch (m) {
+		case MYHTTP_GET:    return MX_GET;
+		case MYHTTP_POST:   return MX_POST;
+		case MYHTTP_PUT:    return MX_PUT;
+		case MYHTTP_PATCH:  return MX_PATCH;
+		case MYHTTP_DELETE: return MX_DELETE;
+		default:            return MX_OTHER;
+	}
+}
+
+void metrics_observe_request(int mx_method, int status, uint64_t dur_ns) {
+	if (mx_method < 0 || mx_method >= MX_NMETHODS) mx_method = MX_OTHER;
+	int cls = status / 100 - 1;
+	if (cls < 0 || cls >= MX_NCLASSES) cls = MX_NCLASSES - 1;
+	struct mx_slot *s = my_slot();
+	MX_ADD(&s->requests[mx_method][cls], 1);
+	hist_observe(&s->latency[mx_method][cls], dur_ns);
+}
+
+void metrics_add_bytes_in(size_t n)  { MX_ADD(&my_slot()->bytes_in, (uint64_t)n); }
+void metrics_add_bytes_out(size_t n) { MX_ADD(&my_slot()->bytes_out, (uint64_t)n); }
+
+void metrics_observe_queue_wait(uint64_t wait_ns) {
+	struct mx_slot *s = my_slot();
+	MX_ADD(&s->connections, 1);
+	hist_observe(&s->queue_wait, wait_ns);
+}
+
+void metrics_add_timeout(int kind) {
+	if (kind >= 0 && kind < MX_NTIMEOUTS) MX_ADD(&my_slot()->timeouts[kind], 1);
+}
+
+void metrics_observe_plock_wait(uint64_t wait_ns) {
+	hist_observe(&my_slot()->plock_wait, wait_ns);
+}
+
+void metrics_observe_io_wait(uint64_t wait_ns) {
+	hist_observe(&my_slot()->io_wait, wait_ns);
+}
+
+void metrics_add_request_allocs(uint64_t n) {
+	if (n) MX_ADD(&my_slot()->request_allocs, n);
+}
+
+void metrics_attach_workq(struct mh_workq *q) {
+	unsigned i = __atomic_load_n(&g_mx.nq, __ATOMIC_ACQUIRE);
+	if (!q || i >= METRICS_MAX_QUEUES) return;
+	__atomic_store_n(&g_mx.q[i], q, __ATOMIC_RELEASE);
+	__atomic_store_n(&g_mx.nq, i + 1, __ATOMIC_RELEASE);
+}
+
+int metrics_render_prometheus(char **out, size_t *outlen) {
+	if (!out || !outlen) { errno = EINVAL; return -1; }
+
+	struct mx_slot *agg = (struct mx_slot *)calloc(1, sizeof(*agg));
+	struct sbuf sb = { .p = (char *)malloc(16 * 1024), .len = 0, .cap = 16 * 1024 };
+	if (!agg || !sb.p) { free(agg); free(sb.p); errno = ENOMEM; return -1; }
+
+	unsigned n = __atomic_load_n(&g_mx.nslots, __ATOMIC_ACQUIRE);
+	if (n > METRICS_MAX_SLOTS) n = METRICS_MAX_SLOTS;
+
+	sb_printf(&sb, "# HELP myhttp_thread_requests_total Requests completed per recording thread.\n");
+	sb_printf(&sb, "# TYPE myhttp_thread_requests_total counter\n");
+	for (unsigned i = 0; i <= n; i++) {
+		const struct mx_slot *s = (i < n) ? __atomic_load_n(&g_mx.slots[i], __ATOMIC_ACQUIRE)
+		                                  : &g_mx.overflow;
+		if (!s) continue;   // registered but not yet published
+		uint64_t mine = 0;
+		for (int m = 0; m < MX_NMETHODS; m++) {
+			for (int c = 0; c < MX_NCLASSES; c++) {
+				uint64_t v = MX_LOAD(&s->requests[m][c]);
+				agg->requests[m][c] += v;
+				mine += v;
+				hist_accumulate(&agg->latency[m][c], &s->latency[m][c]);
+			}
+		}
+		agg->bytes_in    += MX_LOAD(&s->bytes_in);
+		agg->bytes_out   += MX_LOAD(&s->bytes_out);
+		agg->connections += MX_LOAD(&s->connections);
+		agg->request_allocs += MX_LOAD(&s->request_allocs);
+		for (int k = 0; k < MX_NTIMEOUTS; k++) agg->timeouts[k] += MX_LOAD(&s->timeouts[k]);
+		hist_accumulate(&agg->queue_wait, &s->queue_wait);
+		hist_accumulate(&agg->plock_wait, &s->plock_wait);
+		hist_accumulate(&agg->io_wait, &s->io_wait);
+		if (i < n) sb_printf(&sb, "myhttp_thread_requests_total{thread=\"%u\"} %llu\n",
+		                     i, (unsigned long long)mine);
+	}
+
+	sb_printf(&sb, "# HELP myhttp_requests_total Requests completed, by method and status class.\n");
+	sb_printf(&sb, "# TYPE myhttp_requests_total counter\n");
+	for (int m = 0; m < MX_NMETHODS; m++)
+		for (int c = 0; c < MX_NCLASSES; c++)
+			if (agg->requests[m][c])
+				sb_printf(&sb, "myhttp_requests_total{method=\"%s\",class=\"%dxx\"} %llu\n",
+				          k_method_names[m], c + 1, (unsigned long long)agg->requests[m][c]);
+
+	sb_printf(&sb, "# HELP myhttp_request_duration_seconds Request service time.\n");
+	sb_printf(&sb, "# TYPE myhttp_request_duration_seconds histogram\n");
+	for (int m = 0; m < MX_NMETHODS; m++) {
+		for (int c = 0; c < MX_NCLASSES; c++) {
+			if (!agg->latency[m][c].count) continue;
+			char labels[64];
+			snprintf(labels, sizeof(labels), "method=\"%s\",class=\"%dxx\"", k_method_names[m], c + 1);
+			sb_histogram(&sb, "myhttp_request_duration_seconds", labels, &agg->latency[m][c]);
+		}
+	}
+
+	sb_printf(&sb, "# HELP myhttp_request_duration_quantile_seconds Estimated latency quantiles.\n");
+	sb_printf(&sb, "# TYPE myhttp_request_duration_quantile_seconds gauge\n");
+	static const double qs[] = { 0.5, 0.9, 0.99, 0.999 };
+	for (int m = 0; m < MX_NMETHODS; m++) {
+		for (int c = 0; c < MX_NCLASSES; c++) {
+			if (!agg->latency[m][c].count) continue;
+			for (size_t k = 0; k < sizeof(qs) / sizeof(qs[0]); k++)
+				sb_printf(&sb, "myhttp_request_duration_quantile_seconds{method=\"%s\",class=\"%dxx\",quantile=\"%g\"} %.6f\n",
+				          k_method_names[m], c + 1, qs[k], hist_quantile(&agg->latency[m][c], qs[k]) / 1e6);
+		}
+	}
+
+	sb_printf(&sb, "# TYPE myhttp_bytes_received_total counter\n");
+	sb_printf(&sb, "myhttp_bytes_received_total %llu\n", (unsigned long long)agg->bytes_in);
+	sb_printf(&sb, "# TYPE myhttp_bytes_sent_total counter\n");
+	sb_printf(&sb, "myhttp_bytes_sent_total %llu\n", (unsigned long long)agg->bytes_out);
+	sb_printf(&sb, "# TYPE myhttp_connections_total counter\n");
+	sb_printf(&sb, "myhttp_connections_total %llu\n", (unsigned long long)agg->connections);
+	sb_printf(&sb, "# HELP myhttp_timeouts_total Connections closed because a deadline expired, by kind.\n");
+	sb_printf(&sb, "# TYPE myhttp_timeouts_total counter\n");
+	for (int k = 0; k < MX_NTIMEOUTS; k++)
+		sb_printf(&sb, "myhttp_timeouts_total{kind=\"%s\"} %llu\n", k_timeout_names[k],
+		          (unsigned long long)agg->timeouts[k]);
+
+	if (allochook_enabled()) {
+		sb_printf(&sb, "# HELP myhttp_request_heap_allocations_total Heap allocations made while serving requests (excludes %s).\n", METRICS_URL);
+		sb_printf(&sb, "# TYPE myhttp_request_heap_allocations_total counter\n");
+		sb_printf(&sb, "myhttp_request_heap_allocations_total %llu\n", (unsigned long long)agg->request_allocs);
+		sb_printf(&sb, "# TYPE myhttp_heap_allocations_total counter\n");
+		sb_printf(&sb, "myhttp_heap_allocations_total %llu\n", (unsigned long long)allochook_total_allocs());
+	}
+
+	unsigned nq = __atomic_load_n(&g_mx.nq, __ATOMIC_ACQUIRE);
+	if (nq) {
+		size_t depth = 0, cap = 0;
+		for (unsigned i = 0; i < nq; i++) {
+			struct mh_workq *q = __atomic_load_n(&g_mx.q[i], __ATOMIC_ACQUIRE);
+			depth += __atomic_load_n(&q->count, __ATOMIC_RELAXED);
+			cap   += __atomic_load_n(&q->cap, __ATOMIC_RELAXED);
+		}
+		sb_printf(&sb, "# HELP myhttp_workq_depth Accepted connections waiting for a worker.\n");
+		sb_printf(&sb, "# TYPE myhttp_workq_depth gauge\n");
+		sb_printf(&sb, "myhttp_workq_depth %zu\n", depth);
+		sb_printf(&sb, "# TYPE myhttp_workq_capacity gauge\n");
+		sb_printf(&sb, "myhttp_workq_capacity %zu\n", cap);
+	}
+
+	struct admit_stats ad;
+	admit_get_stats(&ad);
+	sb_printf(&sb, "# HELP myhttp_inflight_connections Admitted connections, queued or being served.\n");
+	sb_printf(&sb, "# TYPE myhttp_inflight_connections gauge\n");
+	sb_printf(&sb, "myhttp_inflight_connections %zu\n", ad.inflight);
+	sb_printf(&sb, "# HELP myhttp_admission_limit Current limit on in-flight connections.\n");
+	sb_printf(&sb, "# TYPE myhttp_admission_limit gauge\n");
+	sb_printf(&sb, "myhttp_admission_limit %zu\n", ad.limit);
+	sb_printf(&sb, "# HELP myhttp_connections_shed_total Connections refused with 503 by admission control.\n");
+	sb_printf(&sb, "# TYPE myhttp_connections_shed_total counter\n");
+	sb_printf(&sb, "myhttp_connections_shed_total %llu\n", (unsigned long long)ad.shed);
+
+	struct bufpool_stats bp;
+	bufpool_get_stats(&bp);
+	sb_printf(&sb, "# HELP myhttp_bufpool_buffers I/O buffers per size class, handed out (in_use) or cached for reuse.\n");
+	sb_printf(&sb, "# TYPE myhttp_bufpool_buffers gauge\n");
+	for (int i = 0; i < BUFPOOL_NCLASSES; i++) {
+		sb_printf(&sb, "myhttp_bufpool_buffers{size=\"%zu\",state=\"in_use\"} %zu\n", bp.cls[i].size, bp.cls[i].in_use);
+		sb_printf(&sb, "myhttp_bufpool_buffers{size=\"%zu\",state=\"cached\"} %zu\n", bp.cls[i].size, bp.cls[i].cached);
+	}
+	sb_printf(&sb, "# HELP myhttp_bufpool_gets_total Buffers handed out, and how many came from the cache.\n");
+	sb_printf(&sb, "# TYPE myhttp_bufpool_gets_total counter\n");
+	for (int i = 0; i < BUFPOOL_NCLASSES; i++) {
+		sb_printf(&sb, "myhttp_bufpool_gets_total{size=\"%zu\"} %llu\n", bp.cls[i].size, (unsigned long long)bp.cls[i].gets);
+		sb_printf(&sb, "myhttp_bufpool_hits_total{size=\"%zu\"} %llu\n", bp.cls[i].size, (unsigned long long)bp.cls[i].hits);
+	}
+	sb_printf(&sb, "# TYPE myhttp_bufpool_bytes gauge\n");
+	sb_printf(&sb, "myhttp_bufpool_bytes %zu\n", bp.bytes_total);
+	sb_printf(&sb, "# TYPE myhttp_bufpool_limit_bytes gauge\n");
+	sb_printf(&sb, "myhttp_bufpool_limit_bytes %zu\n", bp.limit);
+	sb_printf(&sb, "# HELP myhttp_bufpool_failures_total Buffer requests refused by the pool limit or malloc.\n");
+	sb_printf(&sb, "# TYPE myhttp_bufpool_failures_total counter\n");
+	sb_printf(&sb, "myhttp_bufpool_failures_total %llu\n", (unsigned long long)bp.failures);
+
+	struct iohint_stats io;
+	iohint_get_stats(&io);
+	sb_printf(&sb, "# HELP myhttp_io_readahead_bytes_total Bytes of large downloads read ahead of the send cursor.\n");
+	sb_printf(&sb, "# TYPE myhttp_io_readahead_bytes_total counter\n");
+	sb_printf(&sb, "myhttp_io_readahead_bytes_total %llu\n", (unsigned long long)io.readahead_bytes);
+	sb_printf(&sb, "# HELP myhttp_io_dropped_files_total One-off large downloads dropped from the page cache after streaming.\n");
+	sb_printf(&sb, "# TYPE myhttp_io_dropped_files_total counter\n");
+	sb_printf(&sb, "myhttp_io_dropped_files_total %llu\n", (unsigned long long)io.dropped_files);
+	sb_printf(&sb, "# TYPE myhttp_io_dropped_bytes_total counter\n");
+	sb_printf(&sb, "myhttp_io_dropped_bytes_total %llu\n", (unsigned long long)io.dropped_bytes);
+	sb_printf(&sb, "# HELP myhttp_io_writebehind_bytes_total Upload bytes whose writeback was started while streaming.\n");
+	sb_printf(&sb, "# TYPE myhttp_io_writebehind_bytes_total counter\n");
+	sb_printf(&sb, "myhttp_io_writebehind_bytes_total %llu\n", (unsigned long long)io.writebehind_bytes);
+
+	struct iopool_stats ip;
+	iopool_get_stats(&ip);
+	sb_printf(&sb, "# HELP myhttp_iopool_threads Threads taking the blocking filesystem steps of requests, apart from the network workers.\n");
+	sb_printf(&sb, "# TYPE myhttp_iopool_threads gauge\n");
+	sb_printf(&sb, "myhttp_iopool_threads %d\n", ip.threads);
+	sb_printf(&sb, "# TYPE myhttp_iopool_queued gauge\n");
+	sb_printf(&sb, "myhttp_iopool_queued %zu\n", ip.queued);
+	sb_printf(&sb, "# TYPE myhttp_iopool_busy gauge\n");
+	sb_printf(&sb, "myhttp_iopool_busy %zu\n", ip.busy);
+	sb_printf(&sb, "# HELP myhttp_iopool_tasks_total Disk-bound requests served by the I/O pool.\n");
+	sb_printf(&sb, "# TYPE myhttp_iopool_tasks_total counter\n");
+	sb_printf(&sb, "myhttp_iopool_tasks_total %llu\n", (unsigned long long)ip.tasks);
+
+	struct trace_stats trs;
+	trace_get_stats(&trs);
+	sb_printf(&sb, "# HELP myhttp_trace_requests_total Requests sampled for phase tracing.\n");
+	sb_printf(&sb, "# TYPE myhttp_trace_requests_total counter\n");
+	sb_printf(&sb, "myhttp_trace_requests_total %llu\n", (unsigned long long)trs.requests);
+	sb_printf(&sb, "# HELP myhttp_trace_spans_total Phase spans recorded (each thread keeps the newest).\n");
+	sb_printf(&sb, "# TYPE myhttp_trace_spans_total counter\n");
+	sb_printf(&sb, "myhttp_trace_spans_total %llu\n", (unsigned long long)trs.spans);
+
+	struct manifest_stats ms;
+	manifest_get_stats(&ms);
+	sb_printf(&sb, "# HELP myhttp_manifest_entries Files and directories in the mapped docroot manifest.\n");
+	sb_printf(&sb, "# TYPE myhttp_manifest_entries gauge\n");
+	sb_printf(&sb, "myhttp_manifest_entries %zu\n", ms.entries);
+	sb_printf(&sb, "# HELP myhttp_manifest_stale Changes under the docroot the manifest does not reflect.\n");
+	sb_printf(&sb, "# TYPE myhttp_manifest_stale gauge\n");
+	sb_printf(&sb, "myhttp_manifest_stale %zu\n", ms.stale);
+	sb_printf(&sb, "# HELP myhttp_manifest_hits_total Paths resolved from the manifest instead of the filesystem.\n");
+	sb_printf(&sb, "# TYPE myhttp_manifest_hits_total counter\n");
+	sb_printf(&sb, "myhttp_manifest_hits_total %llu\n", (unsigned long long)ms.hits);
+	sb_printf(&sb, "# TYPE myhttp_manifest_builds_total counter\n");
+	sb_printf(&sb, "myhttp_manifest_builds_total %llu\n", (unsigned long long)ms.builds);
+
+	struct bundle_stats bs;
+	bundle_get_stats(&bs);
+	sb_printf(&sb, "# HELP myhttp_bundle_entries Files in the mapped asset bundle.\n");
+	sb_printf(&sb, "# TYPE myhttp_bundle_entries gauge\n");
+	sb_printf(&sb, "myhttp_bundle_entries %zu\n", bs.entries);
+	sb_printf(&sb, "# HELP myhttp_bundle_hits_total Paths answered from the asset bundle.\n");
+	sb_printf(&sb, "# TYPE myhttp_bundle_hits_total counter\n");
+	sb_printf(&sb, "myhttp_bundle_hits_total %llu\n", (unsigned long long)bs.hits);
+
+	struct hot_stats hs;
+	hot_get_stats(&hs);
+	sb_printf(&sb, "# HELP myhttp_hot_pinned Hot paths whose files are pinned (held open, small ones in memory).\n");
+	sb_printf(&sb, "# TYPE myhttp_hot_pinned gauge\n");
+	sb_printf(&sb, "myhttp_hot_pinned %zu\n", hs.pinned);
+	sb_printf(&sb, "# TYPE myhttp_hot_pinned_bytes gauge\n");
+	sb_printf(&sb, "myhttp_hot_pinned_bytes %zu\n", hs.pinned_bytes);
+	sb_printf(&sb, "# HELP myhttp_hot_hits_total Requests answered from a pinned file.\n");
+	sb_printf(&sb, "# TYPE myhttp_hot_hits_total counter\n");
+	sb_printf(&sb, "myhttp_hot_hits_total %llu\n", (unsigned long long)hs.hits);
+	sb_printf(&sb, "# TYPE myhttp_hot_pins_total counter\n");
+	sb_printf(&sb, "myhttp_hot_pins_total %llu\n", (unsigned long long)hs.pins);
+	sb_printf(&sb, "# HELP myhttp_hot_edits_total Files under the docroot edited in place; each stops the pins being used until re-checked.\n");
+	sb_printf(&sb, "# TYPE myhttp_hot_edits_total counter\n");
+	sb_printf(&sb, "myhttp_hot_edits_total %llu\n", (unsigned long long)hs.edits);
+	struct hot_key *top = (struct hot_key *)malloc(HOT_MAX * sizeof(*top));
+	const size_t ntop = top ? hot_top(top, HOT_MAX) : 0;
+	sb_printf(&sb, "# HELP myhttp_hot_requests Estimated recent requests for each hot path (decaying count).\n");
+	sb_printf(&sb, "# TYPE myhttp_hot_requests gauge\n");
+	for (size_t i = 0; i < ntop; i++) {
+		char path[2 * HOT_KEY_MAX];
+		size_t o = 0;
+		for (const char *k = top[i].key; *k && o + 2 < sizeof(path); k++) {
+			if (*k == '\\' || *k == '"' || *k == '\n') path[o++] = '\\';   // label escapes
+			path[o++] = *k == '\n' ? 'n' : *k;
+		}
+		path[o] = '\0';
+		sb_printf(&sb, "myhttp_hot_requests{path=\"%s\",pinned=\"%d\"} %llu\n",
+		          path, top[i].pinned, (unsigned long long)top[i].count);
+	}
+	free(top);
+
+	struct batch_stats bts;
+	batch_get_stats(&bts);
+	sb_printf(&sb, "# HELP myhttp_batch_requests_total Batch reads (" BATCH_URL ") answered.\n");
+	sb_printf(&sb, "# TYPE myhttp_batch_requests_total counter\n");
+	sb_printf(&sb, "myhttp_batch_requests_total %llu\n", (unsigned long long)bts.requests);
+	sb_printf(&sb, "# HELP myhttp_batch_files_total Files sent in batch responses.\n");
+	sb_printf(&sb, "# TYPE myhttp_batch_files_total counter\n");
+	sb_printf(&sb, "myhttp_batch_files_total %llu\n", (unsigned long long)bts.files);
+	sb_printf(&sb, "# HELP myhttp_batch_failed_total Listed paths a batch response reported instead of sending.\n");
+	sb_printf(&sb, "# TYPE myhttp_batch_failed_total counter\n");
+	sb_printf(&sb, "myhttp_batch_failed_total %llu\n", (unsigned long long)bts.failed);
+	sb_printf(&sb, "# TYPE myhttp_batch_bytes_total counter\n");
+	sb_printf(&sb, "myhttp_batch_bytes_total %llu\n", (unsigned long long)bts.bytes);
+	sb_printf(&sb, "# HELP myhttp_batch_uploads_total Tar uploads unpacked and swapped into place.\n");
+	sb_printf(&sb, "# TYPE myhttp_batch_uploads_total counter\n");
+	sb_printf(&sb, "myhttp_batch_uploads_total %llu\n", (unsigned long long)bts.uploads);
+	sb_printf(&sb, "# TYPE myhttp_batch_unpacked_files_total counter\n");
+	sb_printf(&sb, "myhttp_batch_unpacked_files_total %llu\n", (unsigned long long)bts.unpacked);
+
+	struct cas_stats cs;
+	cas_get_stats(&cs);
+	sb_printf(&sb, "# HELP myhttp_cas_blobs Distinct upload bodies in the content store.\n");
+	sb_printf(&sb, "# TYPE myhttp_cas_blobs gauge\n");
+	sb_printf(&sb, "myhttp_cas_blobs %zu\n", cs.blobs);
+	sb_printf(&sb, "# TYPE myhttp_cas_stored_total counter\n");
+	sb_printf(&sb, "myhttp_cas_stored_total %llu\n", (unsigned long long)cs.stored);
+	sb_printf(&sb, "# HELP myhttp_cas_dedup_total Uploads linked to a stored body instead of written and flushed.\n");
+	sb_printf(&sb, "# TYPE myhttp_cas_dedup_total counter\n");
+	sb_printf(&sb, "myhttp_cas_dedup_total %llu\n", (unsigned long long)cs.dedups);
+	sb_printf(&sb, "# TYPE myhttp_cas_dedup_bytes_total counter\n");
+	sb_printf(&sb, "myhttp_cas_dedup_bytes_total %llu\n", (unsigned long long)cs.dedup_bytes);
+
+	struct tls_stats ts;
+	tls_get_stats(&ts);
+	sb_printf(&sb, "# HELP myhttp_tls_handshakes_total Completed TLS handshakes, full or resumed (session cache or ticket).\n");
+	sb_printf(&sb, "# TYPE myhttp_tls_handshakes_total counter\n");
+	sb_printf(&sb, "myhttp_tls_handshakes_total{type=\"full\"} %llu\n", (unsigned long long)(ts.handshakes - ts.resumed));
+	sb_printf(&sb, "myhttp_tls_handshakes_total{type=\"resumed\"} %llu\n", (unsigned long long)ts.resumed);
+	sb_printf(&sb, "# TYPE myhttp_tls_handshake_failures_total counter\n");
+	sb_printf(&sb, "myhttp_tls_handshake_failures_total %llu\n", (unsigned long long)ts.failures);
+	sb_printf(&sb, "# HELP myhttp_tls_ktls_sessions_total TLS sessions whose records the kernel encrypts (tx) or decrypts (rx).\n");
+	sb_printf(&sb, "# TYPE myhttp_tls_ktls_sessions_total counter\n");
+	sb_printf(&sb, "myhttp_tls_ktls_sessions_total{dir=\"tx\"} %llu\n", (unsigned long long)ts.ktls_send);
+	sb_printf(&sb, "myhttp_tls_ktls_sessions_total{dir=\"rx\"} %llu\n", (unsigned long long)ts.ktls_recv);
+
+	sb_printf(&sb, "# HELP myhttp_workq_wait_seconds Time a connection spent queued before a worker took it.\n");
+	sb_printf(&sb, "# TYPE myhttp_workq_wait_seconds histogram\n");
+	sb_histogram(&sb, "myhttp_workq_wait_seconds", NULL, &agg->queue_wait);
+
+	sb_printf(&sb, "# HELP myhttp_plock_wait_seconds Time spent waiting for a path lock.\n");
+	sb_printf(&sb, "# TYPE myhttp_plock_wait_seconds histogram\n");
+	sb_histogram(&sb, "myhttp_plock_wait_seconds", NULL, &agg->plock_wait);
+
+	sb_printf(&sb, "# HELP myhttp_iopool_wait_seconds Time a filesystem step waited for an I/O thread.\n");
+	sb_printf(&sb, "# TYPE myhttp_iopool_wait_seconds histogram\n");
+	sb_histogram(&sb, "myhttp_iopool_wait_seconds", NULL, &agg->io_wait);
+
+	free(agg);
+	if (sb.oom) { free(sb.p); errno = ENOMEM; return -1; }
+	*out = sb.p;
+	*outlen = sb.len;
+	return 0;
+}
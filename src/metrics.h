@@ -0,0 +1,73 @@
+#ifndef MYHTTP_METRICS_H
+#define MYHTTP_METRICS_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+struct mh_workq;
+
+/* Process-wide metrics. Every thread records into its own cache-line-aligned
+   slot (allocated on first use), so the hot path never shares a line with
+   another worker. Readers walk all slots with relaxed atomic loads; nothing
+   on either side takes a lock.
+
+   Latencies go into HDR-style log-linear histograms: powers of two in
+   microseconds, each split into MX_SUB_BUCKETS linear sub-buckets. */
+
+enum mx_method { MX_GET, MX_POST, MX_PUT, MX_PATCH, MX_DELETE, MX_OTHER, MX_NMETHODS };
+
+enum mx_timeout { MX_TO_IDLE, MX_TO_HEADER, MX_TO_BODY, MX_TO_WRITE, MX_NTIMEOUTS };
+
+#define MX_NCLASSES     5      /* 1xx .. 5xx */
+#define MX_SUB_BITS     2
+#define MX_SUB_BUCKETS  (1u << MX_SUB_BITS)
+#define MX_MAX_EXP      39     /* ~6 days in microseconds; larger values clamp */
+#define MX_HIST_BUCKETS (MX_SUB_BUCKETS + (MX_MAX_EXP - MX_SUB_BITS + 1) * MX_SUB_BUCKETS)
+
+#ifndef METRICS_MAX_SLOTS
+#define METRICS_MAX_SLOTS 256
+#endif
+
+/* Reserved URL the stats page is served on. */
+#define METRICS_URL "/_stats"
+
+/* Monotonic clock in nanoseconds. */
+uint64_t metrics_now_ns(void);
+
+/* Map an HTTP method (myhttp_method value) to enum mx_method. */
+int  metrics_method_index(int myhttp_method);
+
+/* One finished request: method (enum mx_method), status code, service time. */
+void metrics_observe_request(int mx_method, int status, uint64_t dur_ns);
+
+void metrics_add_bytes_in(size_t n);
+void metrics_add_bytes_out(size_t n);
+
+/* Heap allocations attributed to one request (allochook.h; 0 is a no-op). */
+void metrics_add_request_allocs(uint64_t n);
+
+/* A connection deadline expired (enum mx_timeout). */
+void metrics_add_timeout(int kind);
+
+/* A connection was picked off the work queue after waiting 'wait_ns'. */
+void metrics_observe_queue_wait(uint64_t wait_ns);
+
+/* A path lock was granted after waiting 'wait_ns'. */
+void metrics_observe_plock_wait(uint64_t wait_ns);
+
+/* A task was taken up by the I/O pool after waiting 'wait_ns'. */
+void metrics_observe_io_wait(uint64_t wait_ns);
+
+#ifndef METRICS_MAX_QUEUES
+#define METRICS_MAX_QUEUES 16
+#endif
+
+/* Add a queue to the depth/capacity gauges (summed over all attached;
+   call from one thread, before serving). */
+void metrics_attach_workq(struct mh_workq *q);
+
+/* Render everything in Prometheus text exposition format (version 0.0.4).
+   '*out' is malloc'd; caller frees. Returns 0 on success, -1 on ENOMEM. */
+int  metrics_render_prometheus(char **out, size_t *outlen);
+
+#endif /* MYHTTP_METRICS_H */
@@ -8,42 +8,66 @@
 #include <stdio.h>
 
 #include "pathlock.h"
+#include "metrics.h"
+#include "trace.h"
+
+/* Buckets are striped over PLOCK_NSTRIPES mutexes: bucket i is guarded by
+   stripe (i % PLOCK_NSTRIPES). Uploads to different paths only contend when
+   their buckets share a stripe. */
+#ifndef PLOCK_NSTRIPES
+#define PLOCK_NSTRIPES 64u
+#endif
 
-#ifndef PLOCK_NBUCKETS
-#define PLOCK_NBUCKETS 256u
+/* Recycled entries kept per stripe before we give memory back. */
+#ifndef PLOCK_FREELIST_MAX
+#define PLOCK_FREELIST_MAX 32u
 #endif
 
 struct bucket {
 	struct path_lock *head;
 };
 
+struct stripe {
+	pthread_mutex_t mtx;
+	struct path_lock *free;   // recycled entries (rwlock still initialized)
+	unsigned nfree;
+} __attribute__((aligned(64)));   // one stripe per cache line
+
+static struct bucket g_default_buckets[PLOCK_NBUCKETS];
+
 static struct {
 	int initialized;
-	pthread_mutex_t map_mtx;
-	struct bucket buckets[PLOCK_NBUCKETS];
+	pthread_mutex_t init_mtx;
+	struct stripe stripes[PLOCK_NSTRIPES];
+	struct bucket *buckets;   // g_default_buckets unless configured otherwise
+	unsigned nbuckets;
 } g_plm = {
 	.initialized = 0,
-	.map_mtx = PTHREAD_MUTEX_INITIALIZER
+	.init_mtx = PTHREAD_MUTEX_INITIALIZER,
+	.nbuckets = PLOCK_NBUCKETS
 };
 
 
 // ---- Internal helpers ----
 
-static uint32_t fnv1a_32(const char *s) {
+static uint32_t fnv1a_32(const char *s, size_t *len_out) {
 	const uint8_t *p = (const uint8_t *)s;
 	uint32_t h = 2166136261u;
 	while (*p) {
 		h ^= (uint32_t)*p++;
 		h *= 16777619u;
 	}
+	*len_out = (size_t)(p - (const uint8_t *)s);
 	return h;
 }
 
-static inline unsigned bucket_idx_from_path(const char *abs_path) {
-	return (unsigned)(fnv1a_32(abs_path) % PLOCK_NBUCKETS);
+static inline struct stripe *stripe_of(unsigned idx) {
+	return &g_plm.stripes[idx % PLOCK_NSTRIPES];
 }
+
 // Lookup existing; returns pointer or NULL (does not modify refcnt).
-static struct path_lock *pl_lookup_unlocked(const char *abs_path, unsigned idx) {
+// Requires the bucket's stripe mutex to be held.
+static struct path_lock *pl_lookup_locked(const char *abs_path, unsigned idx) {
 	struct path_lock *pl = g_plm.buckets[idx].head;
 	while (pl) {
 		if (strcmp(pl->path, abs_path) == 0) return pl;
@@ -52,174 +76,235 @@ static struct path_lock *pl_lookup_unlocked(const char *abs_path, unsigned idx)
 	return NULL;
 }
 
-// Create a new entry with refcnt=1; on success returns pointer (inserted).
-// Requires g_plm.map_mtx to be held by the caller.
-static struct path_lock *pl_create_locked(const char *abs_path) {
-	size_t n = strlen(abs_path) + 1;
-	struct path_lock *pl = (struct path_lock *)malloc(sizeof(*pl) + n);
-	if (!pl) { errno = ENOMEM; return NULL; }
-
-	int rc = pthread_rwlock_init(&pl->rw, NULL);
-	if (rc != 0) {
-		free(pl);
-		errno = rc; // map pthread error to errno-ish int
-		return NULL;
+// Take an entry from the stripe freelist (or malloc one), insert it with
+// refcnt=1. Requires the stripe mutex to be held.
+static struct path_lock *pl_create_locked(struct stripe *st, const char *abs_path,
+                                          size_t len, unsigned idx) {
+	struct path_lock *pl = st->free;
+	if (pl) {
+		st->free = pl->next;
+		st->nfree--;
+	} else {
+		pl = (struct path_lock *)calloc(1, sizeof(*pl));
+		if (!pl) { errno = ENOMEM; return NULL; }
+		int rc = pthread_rwlock_init(&pl->rw, NULL);
+		if (rc != 0) {
+			free(pl);
+			errno = rc; // map pthread error to errno-ish int
+			return NULL;
+		}
 	}
 
+	if (pl->pathcap < len + 1) {
+		char *np = (char *)realloc(pl->path, len + 1);
+		if (!np) {
+			pl->next = st->free; st->free = pl; st->nfree++;
+			errno = ENOMEM;
+			return NULL;
+		}
+		pl->path = np;
+		pl->pathcap = len + 1;
+	}
+	memcpy(pl->path, abs_path, len + 1);
 	pl->refcnt = 1;
-	pl->next = NULL;
-	memcpy(pl->path, abs_path, n);
+	pl->bucket = idx;
+	pl->wr_seq = pl->wr_done = pl->wr_published = pl->wr_failed = 0;
+	pl->wr_created = 0;
+	pl->wr_waiters = NULL;
+
 	// Insert at bucket head
-	unsigned idx = bucket_idx_from_path(abs_path);
-	pl->next = g_plm.buckets[idx].head;
-	g_plm.buckets[idx].head = pl;
+	struct bucket *b = &g_plm.buckets[idx];
+	pl->next = b->head;
+	pl->pprev = &b->head;
+	if (b->head) b->head->pprev = &pl->next;
+	b->head = pl;
 	return pl;
 }
 
-// Remove and destroy an entry. Requires g_plm.map_mtx to be held and refcnt==0.
-static void pl_remove_and_destroy_locked(struct path_lock *pl, unsigned idx) {
-    	struct path_lock **pp = &g_plm.buckets[idx].head;
-    	while (*pp) {
-        	if (*pp == pl) {
-            		*pp = pl->next;
-            		pthread_rwlock_destroy(&pl->rw);
-            		free(pl);
-            		return;
-        	}
-        	pp = &(*pp)->next;
-   	}
-   	// If we reach here, something is inconsistent; ignore in release builds.
+static void pl_free(struct path_lock *pl) {
+	pthread_rwlock_destroy(&pl->rw);
+	free(pl->path);
+	free(pl);
+}
+
+// Unlink an entry with refcnt==0 and recycle it. Requires the stripe mutex.
+static void pl_remove_locked(struct stripe *st, struct path_lock *pl) {
+	*pl->pprev = pl->next;
+	if (pl->next) pl->next->pprev = pl->pprev;
+	pl->pprev = NULL;
+
+	if (st->nfree < PLOCK_FREELIST_MAX) {
+		pl->next = st->free;
+		st->free = pl;
+		st->nfree++;
+	} else {
+		pl_free(pl);
+	}
+}
+
+// Take the rwlock, timing only the contended case for metrics.
+static int pl_lock(struct path_lock *pl, int exclusive) {
+	int rc = exclusive ? pthread_rwlock_trywrlock(&pl->rw) : pthread_rwlock_tryrdlock(&pl->rw);
+	if (rc != EBUSY) {
+		if (rc == 0) metrics_observe_plock_wait(0);
+		return rc;
+	}
+	uint64_t t0 = metrics_now_ns();
+	const uint64_t tr = trace_begin(TR_PLOCK);
+	rc = exclusive ? pthread_rwlock_wrlock(&pl->rw) : pthread_rwlock_rdlock(&pl->rw);
+	trace_end(TR_PLOCK, tr);
+	if (rc == 0) metrics_observe_plock_wait(metrics_now_ns() - t0);
+	return rc;
+}
+
+// Find-or-create and bump refcnt under the stripe mutex.
+static struct path_lock *pl_ref(const char *abs_path) {
+	size_t len;
+	const unsigned idx = fnv1a_32(abs_path, &len) % g_plm.nbuckets;
+	struct stripe *st = stripe_of(idx);
+
+	pthread_mutex_lock(&st->mtx);
+	struct path_lock *pl = pl_lookup_locked(abs_path, idx);
+	if (pl) ++pl->refcnt;
+	else pl = pl_create_locked(st, abs_path, len, idx);
+	pthread_mutex_unlock(&st->mtx);
+	return pl; // NULL -> errno already set
+}
+
+static void pl_unref(struct path_lock *pl) {
+	struct stripe *st = stripe_of(pl->bucket);
+	pthread_mutex_lock(&st->mtx);
+	if (--pl->refcnt == 0) pl_remove_locked(st, pl);
+	pthread_mutex_unlock(&st->mtx);
 }
 
 
 //----- API ----------
 
+int plock_configure(size_t nbuckets) {
+	if (nbuckets == 0 || nbuckets > UINT32_MAX) { errno = EINVAL; return -1; }
+	pthread_mutex_lock(&g_plm.init_mtx);
+	int busy = g_plm.initialized;
+	if (!busy) g_plm.nbuckets = (unsigned)nbuckets;
+	pthread_mutex_unlock(&g_plm.init_mtx);
+	if (busy) { errno = EBUSY; return -1; }
+	return 0;
+}
+
 void plock_global_init(void) {
 	if (__atomic_load_n(&g_plm.initialized, __ATOMIC_ACQUIRE)) return;
-	pthread_mutex_lock(&g_plm.map_mtx);
+	pthread_mutex_lock(&g_plm.init_mtx);
 	if (!g_plm.initialized) {
-		for (unsigned i = 0; i < PLOCK_NBUCKETS; ++i) {
+		for (unsigned i = 0; i < PLOCK_NSTRIPES; ++i) {
+			pthread_mutex_init(&g_plm.stripes[i].mtx, NULL);
+			g_plm.stripes[i].free = NULL;
+			g_plm.stripes[i].nfree = 0;
+		}
+		g_plm.buckets = NULL;
+		if (g_plm.nbuckets != PLOCK_NBUCKETS)
+			g_plm.buckets = (struct bucket *)calloc(g_plm.nbuckets, sizeof(struct bucket));
+		if (!g_plm.buckets) {   // default size, or out of memory: the static table
+			g_plm.buckets = g_default_buckets;
+			g_plm.nbuckets = PLOCK_NBUCKETS;
+		}
+		for (unsigned i = 0; i < g_plm.nbuckets; ++i) {
 			g_plm.buckets[i].head = NULL;
 		}
-		g_plm.initialized = 1;
+		__atomic_store_n(&g_plm.initialized, 1, __ATOMIC_RELEASE);
 	}
-	pthread_mutex_unlock(&g_plm.map_mtx);
+	pthread_mutex_unlock(&g_plm.init_mtx);
 }
 
 void plock_global_destroy(void) {
-	pthread_mutex_lock(&g_plm.map_mtx);
-	for (unsigned i = 0; i < PLOCK_NBUCKETS; ++i) {
+	pthread_mutex_lock(&g_plm.init_mtx);
+	if (!g_plm.initialized) { pthread_mutex_unlock(&g_plm.init_mtx); return; }
+	for (unsigned i = 0; i < g_plm.nbuckets; ++i) {
 		struct path_lock *pl = g_plm.buckets[i].head;
 		g_plm.buckets[i].head = NULL;
 		while (pl) {
 			struct path_lock *next = pl->next;
 			// Best-effort: caller should ensure no one holds these locks anymore.
-			pthread_rwlock_destroy(&pl->rw);
-			free(pl);
+			pl_free(pl);
+			pl = next;
+		}
+	}
+	for (unsigned i = 0; i < PLOCK_NSTRIPES; ++i) {
+		struct path_lock *pl = g_plm.stripes[i].free;
+		while (pl) {
+			struct path_lock *next = pl->next;
+			pl_free(pl);
 			pl = next;
 		}
+		g_plm.stripes[i].free = NULL;
+		g_plm.stripes[i].nfree = 0;
+		pthread_mutex_destroy(&g_plm.stripes[i].mtx);
 	}
-	g_plm.initialized = 0;
-	pthread_mutex_unlock(&g_plm.map_mtx);
+	if (g_plm.buckets != g_default_buckets) free(g_plm.buckets);
+	g_plm.buckets = NULL;
+	__atomic_store_n(&g_plm.initialized, 0, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&g_plm.init_mtx);
 }
 
-int plock_acquire_rd(const char *abs_path) {
-	if (!abs_path || !*abs_path) { errno = EINVAL; return -1; }
-	if (!g_plm.initialized) plock_global_init();
+struct path_lock *plock_acquire_rd(const char *abs_path) {
+	if (!abs_path || !*abs_path) { errno = EINVAL; return NULL; }
+	plock_global_init();
 
-	const unsigned idx = bucket_idx_from_path(abs_path);
-
-	// Fast path: find or create under map mutex, bump refcnt.
-	pthread_mutex_lock(&g_plm.map_mtx);
-	struct path_lock *pl = pl_lookup_unlocked(abs_path, idx);
-	if (pl) {
-		++pl->refcnt;
-		pthread_mutex_unlock(&g_plm.map_mtx);
-	} else {
-		pl = pl_create_locked(abs_path);
-		pthread_mutex_unlock(&g_plm.map_mtx);
-		if (!pl) return -1; // errno already set
-	}
+	struct path_lock *pl = pl_ref(abs_path);
+	if (!pl) return NULL;
 
-	// Acquire shared lock outside map mutex to avoid blocking the table.
-	int rc = pthread_rwlock_rdlock(&pl->rw);
+	// Acquire shared lock outside the stripe mutex to avoid blocking the table.
+	int rc = pl_lock(pl, 0);
 	if (rc != 0) {
-		// Roll back refcnt if lock failed.
-		pthread_mutex_lock(&g_plm.map_mtx);
-		// Find again (might have moved only if bugs).
-		struct path_lock *pl2 = pl_lookup_unlocked(abs_path, idx);
-		if (pl2) {
-			if (--pl2->refcnt == 0) {
-				pl_remove_and_destroy_locked(pl2, idx);
-			}
-        	}
-		pthread_mutex_unlock(&g_plm.map_mtx);
+		pl_unref(pl);
 		errno = rc;
-		return -1;
+		return NULL;
 	}
-	return 0;
+	return pl;
 }
 
-int plock_acquire_wr(const char *abs_path) {
-	if (!abs_path || !*abs_path) { errno = EINVAL; return -1; }
-	if (!g_plm.initialized) plock_global_init();
+struct path_lock *plock_acquire_wr(const char *abs_path) {
+	if (!abs_path || !*abs_path) { errno = EINVAL; return NULL; }
+	plock_global_init();
 
-	const unsigned idx = bucket_idx_from_path(abs_path);
+	struct path_lock *pl = pl_ref(abs_path);
+	if (!pl) return NULL;
 
-	pthread_mutex_lock(&g_plm.map_mtx);
-	struct path_lock *pl = pl_lookup_unlocked(abs_path, idx);
-	if (pl) {
-		++pl->refcnt;
-		pthread_mutex_unlock(&g_plm.map_mtx);
-	} else {
-		pl = pl_create_locked(abs_path);
-		pthread_mutex_unlock(&g_plm.map_mtx);
-		if (!pl) return -1;
-	}
-
-	int rc = pthread_rwlock_wrlock(&pl->rw);
+	int rc = pl_lock(pl, 1);
 	if (rc != 0) {
-		pthread_mutex_lock(&g_plm.map_mtx);
-		struct path_lock *pl2 = pl_lookup_unlocked(abs_path, idx);
-		if (pl2) {
-			if (--pl2->refcnt == 0) {
-				pl_remove_and_destroy_locked(pl2, idx);
-			}
-		}
-		pthread_mutex_unlock(&g_plm.map_mtx);
+		pl_unref(pl);
 		errno = rc;
-		return -1;
+		return NULL;
 	}
-	return 0;
+	return pl;
 }
 
-void plock_release(const char *abs_path) {
-    	if (!abs_path || !*abs_path) return;
-    	if (!g_plm.initialized) return;
+void plock_release(struct path_lock *pl) {
+	if (!pl) return;
 
-    	const unsigned idx = bucket_idx_from_path(abs_path);
+	// If this thread didn't hold it, behavior is undefined by pthreads.
+	(void)pthread_rwlock_unlock(&pl->rw);
 
-    	// Locate under map mutex (but do not mutate yet)
-    	pthread_mutex_lock(&g_plm.map_mtx);
-    	struct path_lock *pl = pl_lookup_unlocked(abs_path, idx);
-    	pthread_mutex_unlock(&g_plm.map_mtx);
-    	if (!pl) {
-       		// Nothing to release (maybe double-release or shutdown); ignore
-        	return;
-	}
+	// Now dec refcnt and possibly recycle the entry.
+	pl_unref(pl);
+}
 
-    	// If this thread didn't hold it, behavior is undefined by pthreads.
-	(void)pthread_rwlock_unlock(&pl->rw);
+struct path_lock *plock_ref(const char *abs_path) {
+	if (!abs_path || !*abs_path) { errno = EINVAL; return NULL; }
+	plock_global_init();
+	return pl_ref(abs_path);
+}
 
-	// Now dec refcnt and possibly destroy the entry.
-	pthread_mutex_lock(&g_plm.map_mtx);
-	struct path_lock *pl2 = pl_lookup_unlocked(abs_path, idx);
-	if (pl2) {
-		if (--pl2->refcnt == 0) {
-			pl_remove_and_destroy_locked(pl2, idx);
-		}
-	}
-	pthread_mutex_unlock(&g_plm.map_mtx);
+int plock_lock_wr(struct path_lock *pl) {
+	if (!pl) { errno = EINVAL; return -1; }
+	int rc = pl_lock(pl, 1);
+	if (rc != 0) { errno = rc; return -1; }
+	return 0;
 }
 
+void plock_unlock(struct path_lock *pl) {
+	if (pl) (void)pthread_rwlock_unlock(&pl->rw);
+}
 
+void plock_unref(struct path_lock *pl) {
+	if (pl) pl_unref(pl);
+}
@@ -1,24 +1,58 @@
 #include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifndef MYHTTP_PATHLOCK_H
 #define MYHTTP_PATHLOCK_H
 
-/* Manager object for managing path reading and writing*/
+struct fs_put;
+
+/* Hash buckets of the path table (default; see plock_configure). */
+#ifndef PLOCK_NBUCKETS
+#define PLOCK_NBUCKETS 256u
+#endif
+
+/* Manager object for managing path reading and writing.
+   Acquire returns a handle; release goes through that handle, so it never
+   re-hashes or re-walks the table. Entries are recycled via a per-stripe
+   freelist instead of being malloc'd/free'd on every acquire. */
 struct path_lock {
     pthread_rwlock_t rw;
-    unsigned refcnt;
-    struct path_lock *next; // simple chained hash
-    char path[];            // NUL-terminated key
+    unsigned refcnt;            // guarded by the owning stripe's mutex
+    unsigned bucket;            // index into the bucket array
+    struct path_lock *next;     // simple chained hash (or freelist link)
+    struct path_lock **pprev;   // O(1) unlink on last release
+    size_t pathcap;             // bytes allocated for 'path'
+    char *path;                 // NUL-terminated key
+
+    /* Writer coalescing (see fs_put_from_socket_atomic_prefill): tickets are
+       handed out in arrival order; only the newest finished upload publishes. */
+    uint64_t wr_seq;            // last ticket handed out (atomic)
+    uint64_t wr_done;           // newest ticket that finished streaming (atomic)
+    uint64_t wr_published;      // ticket now in place (guarded by rw as writer)
+    uint64_t wr_failed;         // newest ticket whose publish failed (likewise)
+    int      wr_created;        // publishing wr_published created the file (likewise)
+    struct fs_put *wr_waiters;  // superseded uploads awaiting a newer one (likewise)
 };
 
-// Gives lock to reader
-int  plock_acquire_rd(const char *abs_path);
+// Gives lock to reader; returns handle or NULL (errno set)
+struct path_lock *plock_acquire_rd(const char *abs_path);
+
+// Gives lock to writer; returns handle or NULL (errno set)
+struct path_lock *plock_acquire_wr(const char *abs_path);
+
+// Release lock to writer and or reader (NULL is a no-op)
+void plock_release(struct path_lock *pl);
 
-// Gives lock to writer
-int  plock_acquire_wr(const char *abs_path);
+/* Split form of acquire/release for callers that must keep an entry alive
+   without holding its lock (e.g. while streaming an upload). */
+struct path_lock *plock_ref(const char *abs_path);  // NULL (errno set) on failure
+int  plock_lock_wr(struct path_lock *pl);            // 0 or -1 (errno set)
+void plock_unlock(struct path_lock *pl);
+void plock_unref(struct path_lock *pl);
 
-// Release lock to writer and or reader
-void plock_release(const char *abs_path);
+// Bucket count for the table; only before first use (EBUSY after). 0 or -1
+int  plock_configure(size_t nbuckets);
 
 // INIT
 void plock_global_init(void);
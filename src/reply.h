@@ -0,0 +1,51 @@
+#ifndef MYHTTP_REPLY_H
+#define MYHTTP_REPLY_H
+
+#include <stddef.h>   // size_t
+#include <stdlib.h>   // free
+#include <string.h>   // strlen
+#include <unistd.h>   // close
+
+#include "hotkeys.h"  // hot_release
+
+/* A handler's response before it is framed: main.c writes it as HTTP/1.1,
+   h2.c as HEADERS + DATA frames on a stream. At most one body source is
+   set: memory, an open file, or a directory to list. */
+
+struct mh_reply {
+	int         status;
+	const char *reason;
+	const char *ctype;        // static string
+	const char *etag;         // static string, or NULL for no ETag header
+	const char *body;         // in-memory body: static storage or body_owned
+	size_t      body_len;
+	char       *body_owned;   // malloc'd body, freed by reply_done()
+	int         fd;           // file body (owned), -1 if none
+	size_t      file_len;
+	const char *dir_abs;      // directory listing, generated when sent
+	const char *dir_disp;     // (both in the request arena)
+	struct hot_pin *pin;      // 'body' is this pinned file's, held until reply_done()
+};
+
+static inline void reply_init(struct mh_reply *r) {
+	*r = (struct mh_reply){ .fd = -1 };
+}
+
+/* Plain-text reply; 'body' must be static storage. */
+static inline void reply_text(struct mh_reply *r, int status, const char *reason, const char *body) {
+	reply_init(r);
+	r->status = status;
+	r->reason = reason;
+	r->ctype = "text/plain; charset=utf-8";
+	r->body = body;
+	r->body_len = body ? strlen(body) : 0;
+}
+
+static inline void reply_done(struct mh_reply *r) {
+	if (r->fd >= 0) close(r->fd);
+	free(r->body_owned);
+	if (r->pin) hot_release(r->pin);
+	reply_init(r);
+}
+
+#endif /* MYHTTP_REPLY_H */
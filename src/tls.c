@@ -0,0 +1,229 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tls.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifndef MYHTTP_NO_TLS
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+struct mh_tls {
+	SSL *ssl;
+	int  done;        // handshake completed
+	int  ktls_send;
+	int  ktls_recv;
+};
+
+static SSL_CTX *g_ctx;
+
+static struct {
+	uint64_t handshakes, resumed, failures, ktls_send, ktls_recv;   // atomic
+} g_st;
+
+
+// ---- Internal helpers ----
+
+static void count(uint64_t *ctr) {
+	__atomic_add_fetch(ctr, 1, __ATOMIC_RELAXED);
+}
+
+// Prefer h2 when the client offers it; fall back to http/1.1.
+static int alpn_select(SSL *ssl, const unsigned char **out, unsigned char *outlen,
+                       const unsigned char *in, unsigned int inlen, void *arg) {
+	static const unsigned char protos[] = "\x02h2\x08http/1.1";
+	(void)ssl; (void)arg;
+	if (SSL_select_next_proto((unsigned char **)out, outlen, protos, sizeof(protos) - 1,
+	                          in, inlen) != OPENSSL_NPN_NEGOTIATED)
+		return SSL_TLSEXT_ERR_NOACK;
+	return SSL_TLSEXT_ERR_OK;
+}
+
+// Map a failed SSL_* call to errno (EAGAIN on a non-blocking socket: see
+// tls_want_write()). Returns 0 when the call should simply be retried.
+static int ssl_errno(SSL *ssl, int ret) {
+	int err = SSL_get_error(ssl, ret);
+	if (err == SSL_ERROR_SYSCALL && errno == EINTR) return 0;
+	if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) errno = EAGAIN;
+	else if (err != SSL_ERROR_SYSCALL || errno == 0) errno = EPROTO;
+	ERR_clear_error();
+	return -1;
+}
+
+
+//----- API ----------
+
+int tls_init(const char *cert_file, const char *key_file) {
+	SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+	if (!ctx) goto fail;
+
+	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+	/* SSL_OP_ENABLE_KTLS: OpenSSL hands the record keys to the kernel after
+	   the handshake when it can. SSL_MODE_RELEASE_BUFFERS: like the conn
+	   buffers, record buffers are dropped while the connection is idle. */
+	SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS | SSL_OP_IGNORE_UNEXPECTED_EOF |
+	                         SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE);
+	SSL_CTX_set_mode(ctx, SSL_MODE_RELEASE_BUFFERS | SSL_MODE_ENABLE_PARTIAL_WRITE |
+	                      SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(ctx, TLS_SESSION_CACHE);
+	SSL_CTX_set_timeout(ctx, TLS_SESSION_TIMEOUT);
+	static const unsigned char sid_ctx[] = "MyHTTP";
+	SSL_CTX_set_session_id_context(ctx, sid_ctx, sizeof(sid_ctx) - 1);
+	SSL_CTX_set_num_tickets(ctx, TLS_TICKETS);
+
+	if (SSL_CTX_use_certificate_chain_file(ctx, cert_file) != 1 ||
+	    SSL_CTX_use_PrivateKey_file(ctx, key_file, SSL_FILETYPE_PEM) != 1 ||
+	    SSL_CTX_check_private_key(ctx) != 1)
+		goto fail;
+
+	SSL_CTX_set_alpn_select_cb(ctx, alpn_select, NULL);
+	g_ctx = ctx;
+	return 0;
+
+fail:
+	ERR_print_errors_fp(stderr);
+	SSL_CTX_free(ctx);
+	errno = EINVAL;
+	return -1;
+}
+
+int tls_enabled(void) {
+	return g_ctx != NULL;
+}
+
+struct mh_tls *tls_new(int fd) {
+	if (!g_ctx) { errno = ENOTSUP; return NULL; }
+	struct mh_tls *t = (struct mh_tls *)calloc(1, sizeof(*t));
+	if (!t) return NULL;
+	t->ssl = SSL_new(g_ctx);
+	if (!t->ssl || SSL_set_fd(t->ssl, fd) != 1) {
+		ERR_clear_error();
+		SSL_free(t->ssl);
+		free(t);
+		errno = ENOMEM;
+		return NULL;
+	}
+	return t;
+}
+
+int tls_handshake(struct mh_tls *t) {
+	for (;;) {
+		errno = 0;
+		int r = SSL_accept(t->ssl);
+		if (r == 1) break;
+		if (r == 0) { ERR_clear_error(); errno = ECONNRESET; return -1; }
+		if (ssl_errno(t->ssl, r) < 0) return -1;
+	}
+
+	t->done = 1;
+	t->ktls_send = BIO_get_ktls_send(SSL_get_wbio(t->ssl));
+	t->ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(t->ssl));
+	count(&g_st.handshakes);
+	if (SSL_session_reused(t->ssl)) count(&g_st.resumed);
+	if (t->ktls_send) count(&g_st.ktls_send);
+	if (t->ktls_recv) count(&g_st.ktls_recv);
+	return 0;
+}
+
+void tls_close(struct mh_tls *t) {
+	if (!t) return;
+	if (t->done) (void)SSL_shutdown(t->ssl);   // one-way: don't wait for the peer's reply
+	else count(&g_st.failures);
+	ERR_clear_error();
+	SSL_free(t->ssl);
+	free(t);
+}
+
+int tls_ktls_send(const struct mh_tls *t) { return t->ktls_send; }
+int tls_ktls_recv(const struct mh_tls *t) { return t->ktls_recv; }
+
+int tls_want_write(const struct mh_tls *t) { return SSL_want_write(t->ssl); }
+
+int tls_pending(const struct mh_tls *t) {
+	return SSL_has_pending(t->ssl);
+}
+
+ssize_t tls_read(struct mh_tls *t, void *buf, size_t len) {
+	for (;;) {
+		size_t n;
+		errno = 0;
+		if (SSL_read_ex(t->ssl, buf, len, &n)) return (ssize_t)n;
+		if (SSL_get_error(t->ssl, 0) == SSL_ERROR_ZERO_RETURN) return 0;
+		if (ssl_errno(t->ssl, 0) < 0) return -1;
+	}
+}
+
+ssize_t tls_write(struct mh_tls *t, const void *buf, size_t len) {
+	for (;;) {
+		size_t n;
+		errno = 0;
+		if (SSL_write_ex(t->ssl, buf, len, &n)) return (ssize_t)n;
+		if (ssl_errno(t->ssl, 0) < 0) return -1;
+	}
+}
+
+ssize_t tls_sendfile(struct mh_tls *t, int file_fd, off_t off, size_t len) {
+	errno = 0;
+	ossl_ssize_t n = SSL_sendfile(t->ssl, file_fd, off, len, 0);
+	if (n < 0) {
+		if (ssl_errno(t->ssl, (int)n) == 0) errno = EINTR;   // caller retries
+		return -1;
+	}
+	return (ssize_t)n;
+}
+
+void tls_get_stats(struct tls_stats *out) {
+	out->handshakes = __atomic_load_n(&g_st.handshakes, __ATOMIC_RELAXED);
+	out->resumed    = __atomic_load_n(&g_st.resumed, __ATOMIC_RELAXED);
+	out->failures   = __atomic_load_n(&g_st.failures, __ATOMIC_RELAXED);
+	out->ktls_send  = __atomic_load_n(&g_st.ktls_send, __ATOMIC_RELAXED);
+	out->ktls_recv  = __atomic_load_n(&g_st.ktls_recv, __ATOMIC_RELAXED);
+}
+
+#else /* MYHTTP_NO_TLS */
+
+int tls_init(const char *cert_file, const char *key_file) {
+	(void)cert_file; (void)key_file;
+	errno = ENOTSUP;
+	return -1;
+}
+
+int  tls_enabled(void) { return 0; }
+struct mh_tls *tls_new(int fd) { (void)fd; errno = ENOTSUP; return NULL; }
+int  tls_handshake(struct mh_tls *t) { (void)t; errno = ENOTSUP; return -1; }
+void tls_close(struct mh_tls *t) { (void)t; }
+int  tls_want_write(const struct mh_tls *t) { (void)t; return 0; }
+int  tls_ktls_send(const struct mh_tls *t) { (void)t; return 0; }
+int  tls_ktls_recv(const struct mh_tls *t) { (void)t; return 0; }
+int  tls_pending(const struct mh_tls *t) { (void)t; return 0; }
+
+ssize_t tls_read(struct mh_tls *t, void *buf, size_t len) {
+	(void)t; (void)buf; (void)len;
+	errno = ENOTSUP;
+	return -1;
+}
+
+ssize_t tls_write(struct mh_tls *t, const void *buf, size_t len) {
+	(void)t; (void)buf; (void)len;
+	errno = ENOTSUP;
+	return -1;
+}
+
+ssize_t tls_sendfile(struct mh_tls *t, int file_fd, off_t off, size_t len) {
+	(void)t; (void)file_fd; (void)off; (void)len;
+	errno = ENOTSUP;
+	return -1;
+}
+
+void tls_get_stats(struct tls_stats *out) {
+	memset(out, 0, sizeof(*out));
+}
+
+#endif /* MYHTTP_NO_TLS */
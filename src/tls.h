@@ -0,0 +1,92 @@
+#ifndef MYHTTP_TLS_H
+#define MYHTTP_TLS_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint64_t
+#include <sys/types.h>  // ssize_t, off_t
+
+/* TLS termination (OpenSSL), one session per connection.
+
+   The context asks OpenSSL for kernel TLS: when the kernel accepts the
+   negotiated cipher, record encryption moves into the socket after the
+   handshake and the connection can keep using sendmsg() and sendfile()
+   on its descriptor (tls_ktls_send()). Otherwise every byte goes through
+   tls_read()/tls_write() in userspace.
+
+   Resumption: a server-side session cache (TLS 1.2 session IDs) plus
+   session tickets (TLS 1.2 and 1.3), so returning clients skip the
+   certificate exchange. ALPN offers "h2" and "http/1.1"; an h2 client
+   then opens with the HTTP/2 preface like a prior-knowledge h2c one.
+
+   Built with -DMYHTTP_NO_TLS (make TLS=0), tls_init() fails with ENOTSUP. */
+
+#ifndef TLS_SESSION_CACHE
+#define TLS_SESSION_CACHE   (20 * 1024)    // entries
+#endif
+
+#ifndef TLS_SESSION_TIMEOUT
+#define TLS_SESSION_TIMEOUT (2 * 3600)     // seconds
+#endif
+
+/* TLS 1.3 tickets issued per full handshake. */
+#ifndef TLS_TICKETS
+#define TLS_TICKETS         2
+#endif
+
+struct mh_tls;
+
+struct tls_stats {
+	uint64_t handshakes;    // completed, full or resumed
+	uint64_t resumed;
+	uint64_t failures;      // handshakes that did not complete
+	uint64_t ktls_send;     // sessions with kernel TLS for sending
+	uint64_t ktls_recv;     // ... and for receiving
+};
+
+/* Build the process-wide server context from a PEM certificate chain and
+   private key. OpenSSL's reasons are printed to stderr. Returns 0, or -1
+   with errno set. */
+int  tls_init(const char *cert_file, const char *key_file);
+
+/* 1 once tls_init() has succeeded. */
+int  tls_enabled(void);
+
+/* A server session on socket 'fd'. Returns NULL with errno set. */
+struct mh_tls *tls_new(int fd);
+
+/* Run (or continue) the server handshake. Returns 0 once it completes,
+   or -1 with errno set: EAGAIN on a non-blocking socket that must first
+   become readable (or writable, see tls_want_write()). */
+int  tls_handshake(struct mh_tls *t);
+
+/* Send close_notify and free the session; the socket stays open. A
+   session that never finished its handshake counts as a failure. */
+void tls_close(struct mh_tls *t);
+
+/* The last call failed with EAGAIN waiting to write, not to read. */
+int  tls_want_write(const struct mh_tls *t);
+
+/* Kernel TLS is active for sending / receiving on this session. */
+int  tls_ktls_send(const struct mh_tls *t);
+int  tls_ktls_recv(const struct mh_tls *t);
+
+/* Decrypted bytes (or a partial record) already read off the socket. */
+int  tls_pending(const struct mh_tls *t);
+
+/* Read up to 'len' plaintext bytes. Returns bytes read, 0 on EOF
+   (close_notify or plain TCP close), -1 with errno set (EAGAIN as for
+   tls_handshake()). */
+ssize_t tls_read(struct mh_tls *t, void *buf, size_t len);
+
+/* Write from buf[0..len), at least one record's worth unless it fails.
+   Returns bytes written or -1 (errno set); after EAGAIN, retry with the
+   remaining bytes. */
+ssize_t tls_write(struct mh_tls *t, const void *buf, size_t len);
+
+/* sendfile() through kernel TLS (tls_ktls_send() only). Returns bytes
+   sent or -1 (errno set). */
+ssize_t tls_sendfile(struct mh_tls *t, int file_fd, off_t off, size_t len);
+
+void tls_get_stats(struct tls_stats *out);
+
+#endif /* MYHTTP_TLS_H */
@@ -0,0 +1,117 @@
+#define _GNU_SOURCE           // sched_getaffinity, pthread_setaffinity_np
+
+#include "topo.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct {
+	int ncpus, nnodes;
+	int cpu[TOPO_MAX_CPUS];     // usable CPUs, by node then number
+	int node[TOPO_MAX_CPUS];    // dense node index of cpu[i]
+} g_topo;
+
+
+// ---- Internal helpers ----
+
+// Kernel node number of 'cpu', or 0 when sysfs has no nodeN link.
+static int sysfs_node(int cpu) {
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	DIR *d = opendir(path);
+	if (!d) return 0;
+	int node = 0;
+	struct dirent *e;
+	while ((e = readdir(d)) != NULL) {
+		if (strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9') {
+			node = atoi(e->d_name + 4);
+			break;
+		}
+	}
+	closedir(d);
+	return node;
+}
+
+static int index_of(int cpu) {
+	for (int i = 0; i < g_topo.ncpus; i++)
+		if (g_topo.cpu[i] == cpu) return i;
+	return -1;
+}
+
+
+//----- API ----------
+
+int topo_init(void) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) != 0) return -1;
+
+	int raw[TOPO_MAX_CPUS];
+	int n = 0;
+	for (int c = 0; c < CPU_SETSIZE && n < TOPO_MAX_CPUS; c++) {
+		if (!CPU_ISSET(c, &set)) continue;
+		g_topo.cpu[n] = c;
+		raw[n] = sysfs_node(c);
+		n++;
+	}
+	if (n == 0) { errno = ENODEV; return -1; }
+
+	// Stable insertion sort by kernel node (CPU numbers are already ascending).
+	for (int i = 1; i < n; i++) {
+		int c = g_topo.cpu[i], r = raw[i], j = i - 1;
+		for (; j >= 0 && raw[j] > r; j--) {
+			g_topo.cpu[j + 1] = g_topo.cpu[j];
+			raw[j + 1] = raw[j];
+		}
+		g_topo.cpu[j + 1] = c;
+		raw[j + 1] = r;
+	}
+	// Renumber nodes densely: sparse or offline node numbers are common.
+	int nn = 0;
+	for (int i = 0; i < n; i++) {
+		if (i > 0 && raw[i] != raw[i - 1]) nn++;
+		g_topo.node[i] = nn;
+	}
+	g_topo.ncpus = n;
+	g_topo.nnodes = nn + 1;
+	return 0;
+}
+
+int topo_ncpus(void)  { return g_topo.ncpus; }
+int topo_nnodes(void) { return g_topo.nnodes ? g_topo.nnodes : 1; }
+
+int topo_worker_cpu(int i, int n) {
+	if (g_topo.ncpus == 0 || n <= 0) return -1;
+	if (n <= g_topo.ncpus) return g_topo.cpu[(long)i * g_topo.ncpus / n];
+	return g_topo.cpu[i % g_topo.ncpus];
+}
+
+int topo_node_of(int cpu) {
+	int i = index_of(cpu);
+	return i < 0 ? 0 : g_topo.node[i];
+}
+
+int topo_pin_cpu(int cpu) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (rc != 0) { errno = rc; return -1; }
+	return 0;
+}
+
+int topo_pin_node(int node) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int i = 0; i < g_topo.ncpus; i++)
+		if (g_topo.node[i] == node) CPU_SET(g_topo.cpu[i], &set);
+	if (CPU_COUNT(&set) == 0) { errno = EINVAL; return -1; }
+	int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (rc != 0) { errno = rc; return -1; }
+	return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef MYHTTP_TOPO_H
+#define MYHTTP_TOPO_H
+
+/* CPU and NUMA topology for worker placement (Linux).
+
+   topo_init() reads the CPUs this process may run on (its affinity mask)
+   and the NUMA node of each from /sys/devices/system/cpu/cpuN/nodeM; a
+   kernel without NUMA reports everything as node 0. CPUs are ordered by
+   node, then number, so consecutive workers share a node. */
+
+#ifndef TOPO_MAX_CPUS
+#define TOPO_MAX_CPUS 1024
+#endif
+
+/* Returns 0, or -1 with errno set. */
+int  topo_init(void);
+
+int  topo_ncpus(void);      // usable CPUs
+int  topo_nnodes(void);     // distinct nodes among them
+
+/* CPU for worker 'i' of 'n': workers are spread evenly over the usable
+   CPUs (and so over nodes, in proportion to their CPU count). */
+int  topo_worker_cpu(int i, int n);
+
+/* Dense node index (0 .. topo_nnodes()-1) of a usable CPU, or 0. */
+int  topo_node_of(int cpu);
+
+/* Bind the calling thread to one CPU, or to every usable CPU of a node.
+   Return 0, or -1 with errno set. */
+int  topo_pin_cpu(int cpu);
+int  topo_pin_node(int node);
+
+#endif /* MYHTTP_TOPO_H */
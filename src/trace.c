@@ -0,0 +1,168 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TR_MASK (TRACE_RING - 1)
+
+struct tr_span {
+	uint64_t t0, dur, req;
+	uint64_t phase;
+};
+
+/* One per traced thread; only its owner writes it. Readers copy spans
+   and re-check 'head' to drop the ones overwritten meanwhile. */
+struct tr_ring {
+	uint64_t       head;        // spans ever recorded
+	struct tr_span span[TRACE_RING];
+};
+
+static struct {
+	unsigned        every;
+	uint64_t        next_req;
+	struct tr_ring *rings[TRACE_MAX_THREADS];
+	unsigned        nrings;
+} g_tr;
+
+static const char *const k_phase_names[TR_NPHASES] = {
+	"request", "parse", "resolve", "plock_wait", "body", "fsync", "rename", "send",
+};
+
+_Thread_local uint64_t trace_tl_req;
+static _Thread_local unsigned        tl_seen;   // requests since the last sampled one
+static _Thread_local struct tr_ring *tl_ring;
+static _Thread_local int             tl_full;   // no ring to be had
+
+
+// ---- Internal helpers ----
+
+static struct tr_ring *my_ring(void) {
+	if (tl_ring || tl_full) return tl_ring;
+	const unsigned idx = __atomic_fetch_add(&g_tr.nrings, 1, __ATOMIC_ACQ_REL);
+	struct tr_ring *r = idx < TRACE_MAX_THREADS ? (struct tr_ring *)calloc(1, sizeof(*r)) : NULL;
+	if (!r) {
+		tl_full = 1;
+		if (idx < TRACE_MAX_THREADS) __atomic_store_n(&g_tr.rings[idx], (struct tr_ring *)NULL, __ATOMIC_RELEASE);
+		return NULL;
+	}
+	__atomic_store_n(&g_tr.rings[idx], r, __ATOMIC_RELEASE);
+	return tl_ring = r;
+}
+
+struct tr_buf {
+	char  *p;
+	size_t len, cap;
+	int    oom;
+};
+
+static void tb_printf(struct tr_buf *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void tb_printf(struct tr_buf *b, const char *fmt, ...) {
+	if (b->oom) return;
+	for (;;) {
+		va_list ap;
+		va_start(ap, fmt);
+		int n = vsnprintf(b->p + b->len, b->cap - b->len, fmt, ap);
+		va_end(ap);
+		if (n < 0) { b->oom = 1; return; }
+		if ((size_t)n < b->cap - b->len) { b->len += (size_t)n; return; }
+		size_t cap = b->cap * 2 + (size_t)n;
+		char *np = (char *)realloc(b->p, cap);
+		if (!np) { b->oom = 1; return; }
+		b->p = np;
+		b->cap = cap;
+	}
+}
+
+
+//----- API ----------
+
+void trace_configure(unsigned every) {
+	__atomic_store_n(&g_tr.every, every, __ATOMIC_RELAXED);
+}
+
+void trace_request_begin(void) {
+	const unsigned every = __atomic_load_n(&g_tr.every, __ATOMIC_RELAXED);
+	trace_tl_req = 0;
+	if (every == 0 || ++tl_seen < every) return;
+	tl_seen = 0;
+	if (my_ring()) trace_tl_req = __atomic_add_fetch(&g_tr.next_req, 1, __ATOMIC_RELAXED);
+}
+
+void trace_record(int phase, uint64_t t0_ns) {
+	struct tr_ring *r = my_ring();   // a thread may only send a traced answer
+	if (!r) return;
+	const uint64_t now = metrics_now_ns();
+	const uint64_t h = r->head;
+	struct tr_span *s = &r->span[h & TR_MASK];
+	__atomic_store_n(&s->t0, t0_ns, __ATOMIC_RELAXED);
+	__atomic_store_n(&s->dur, now > t0_ns ? now - t0_ns : 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&s->req, trace_tl_req, __ATOMIC_RELAXED);
+	__atomic_store_n(&s->phase, (uint64_t)phase, __ATOMIC_RELAXED);
+	__atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+int trace_render_json(char **out, size_t *outlen) {
+	struct tr_buf b = { .p = (char *)malloc(64 * 1024), .cap = 64 * 1024 };
+	struct tr_span *snap = (struct tr_span *)malloc(sizeof(struct tr_span) * TRACE_RING);
+	if (!b.p || !snap) { free(b.p); free(snap); errno = ENOMEM; return -1; }
+
+	unsigned n = __atomic_load_n(&g_tr.nrings, __ATOMIC_ACQUIRE);
+	if (n > TRACE_MAX_THREADS) n = TRACE_MAX_THREADS;
+	tb_printf(&b, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	int first = 1;
+	for (unsigned t = 0; t < n; t++) {
+		const struct tr_ring *r = __atomic_load_n(&g_tr.rings[t], __ATOMIC_ACQUIRE);
+		if (!r) continue;
+		const uint64_t h1 = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		const uint64_t from = h1 > TRACE_RING ? h1 - TRACE_RING : 0;
+		for (uint64_t i = from; i < h1; i++) {
+			const struct tr_span *s = &r->span[i & TR_MASK];
+			snap[i - from] = (struct tr_span){
+				.t0 = __atomic_load_n(&s->t0, __ATOMIC_RELAXED),
+				.dur = __atomic_load_n(&s->dur, __ATOMIC_RELAXED),
+				.req = __atomic_load_n(&s->req, __ATOMIC_RELAXED),
+				.phase = __atomic_load_n(&s->phase, __ATOMIC_RELAXED),
+			};
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		// Spans the owner lapped while they were copied are torn: skip them.
+		const uint64_t h2 = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+		const uint64_t valid = h2 > TRACE_RING ? h2 - TRACE_RING : 0;
+
+		tb_printf(&b, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+		              "\"args\":{\"name\":\"thread %u\"}}", first ? "" : ",\n", t, t);
+		first = 0;
+		for (uint64_t i = from > valid ? from : valid; i < h1; i++) {
+			const struct tr_span *s = &snap[i - from];
+			if (s->phase >= TR_NPHASES) continue;
+			tb_printf(&b, ",\n{\"name\":\"%s\",\"cat\":\"myhttp\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+			              "\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"args\":{\"req\":%llu}}",
+			          k_phase_names[s->phase], t,
+			          (unsigned long long)(s->t0 / 1000), (unsigned)(s->t0 % 1000),
+			          (unsigned long long)(s->dur / 1000), (unsigned)(s->dur % 1000),
+			          (unsigned long long)s->req);
+		}
+	}
+	tb_printf(&b, "\n]}\n");
+	free(snap);
+	if (b.oom) { free(b.p); errno = ENOMEM; return -1; }
+	*out = b.p;
+	*outlen = b.len;
+	return 0;
+}
+
+void trace_get_stats(struct trace_stats *out) {
+	memset(out, 0, sizeof(*out));
+	out->requests = __atomic_load_n(&g_tr.next_req, __ATOMIC_RELAXED);
+	unsigned n = __atomic_load_n(&g_tr.nrings, __ATOMIC_ACQUIRE);
+	if (n > TRACE_MAX_THREADS) n = TRACE_MAX_THREADS;
+	for (unsigned t = 0; t < n; t++) {
+		const struct tr_ring *r = __atomic_load_n(&g_tr.rings[t], __ATOMIC_ACQUIRE);
+		if (r) out->spans += __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+	}
+}
@@ -0,0 +1,98 @@
+#ifndef MYHTTP_TRACE_H
+#define MYHTTP_TRACE_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+#include "metrics.h"  // metrics_now_ns
+
+/* Per-request phase tracing.
+
+   One request in every --trace-sample (per thread; 0 = off) is traced:
+   its phases (parse, path resolution, path-lock wait, body, fsync,
+   rename, send) are timed and recorded as spans into a ring owned by the
+   serving thread, the newest TRACE_RING per thread kept. TRACE_URL
+   returns them as Chrome trace JSON, which chrome://tracing and Perfetto
+   open as one track per thread.
+
+   Untraced requests pay one thread-local test per phase boundary. Built
+   with `make USDT=1`, each boundary is also a USDT probe (provider
+   "myhttp": phase__begin/phase__end with the phase number), fired for
+   every request whether sampled or not, for bpftrace and friends. */
+
+/* Reserved URL the recorded spans are served on. */
+#define TRACE_URL "/_trace"
+
+#ifndef TRACE_SAMPLE
+#define TRACE_SAMPLE      0      /* default --trace-sample: off */
+#endif
+
+#ifndef TRACE_RING
+#define TRACE_RING        4096   /* spans kept per thread (power of two) */
+#endif
+
+#ifndef TRACE_MAX_THREADS
+#define TRACE_MAX_THREADS 512    /* threads beyond this are not traced */
+#endif
+
+enum trace_phase {
+	TR_REQUEST,     // the whole request, parse to reply queued
+	TR_PARSE,
+	TR_RESOLVE,     // URL path to file (dcache, manifest, fs_join_safe)
+	TR_PLOCK,       // waiting for a path lock
+	TR_BODY,        // reading an upload body into its file
+	TR_FSYNC,
+	TR_RENAME,
+	TR_SEND,        // flushing queued responses to the socket
+	TR_NPHASES
+};
+
+#ifdef MYHTTP_USDT
+#include <sys/sdt.h>
+#define TRACE_PROBE(name, phase) DTRACE_PROBE1(myhttp, name, (int)(phase))
+#else
+#define TRACE_PROBE(name, phase) ((void)0)
+#endif
+
+/* Id of the sampled request this thread is serving; 0 while none. */
+extern _Thread_local uint64_t trace_tl_req;
+
+/* Trace one request in 'every' on each thread; 0 turns tracing off
+   (reloadable: applies from each thread's next request). */
+void   trace_configure(unsigned every);
+
+/* A request starts on this thread: decide whether it is traced. */
+void   trace_request_begin(void);
+
+/* Record a span of 'phase' from 't0_ns' to now for the current request. */
+void   trace_record(int phase, uint64_t t0_ns);
+
+/* Phase boundaries: 0 from trace_begin() means "not traced". */
+static inline uint64_t trace_begin(int phase) {
+	TRACE_PROBE(phase__begin, phase);
+	(void)phase;
+	return trace_tl_req ? metrics_now_ns() : 0;
+}
+
+static inline void trace_end(int phase, uint64_t t0) {
+	TRACE_PROBE(phase__end, phase);
+	if (t0) trace_record(phase, t0);
+}
+
+/* The request that started at 't_start' (metrics_now_ns()) is answered. */
+static inline void trace_request_end(uint64_t t_start) {
+	if (trace_tl_req) trace_record(TR_REQUEST, t_start);
+}
+
+/* Render every thread's ring as Chrome trace JSON ('*out' malloc'd,
+   caller frees). Returns 0, or -1 on ENOMEM. */
+int    trace_render_json(char **out, size_t *outlen);
+
+struct trace_stats {
+	uint64_t requests;   // sampled
+	uint64_t spans;      // recorded (older ones overwritten)
+};
+
+void   trace_get_stats(struct trace_stats *out);
+
+#endif /* MYHTTP_TRACE_H */
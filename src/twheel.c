@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "twheel.h"
+
+#include <string.h>
+#include <time.h>
+
+_Static_assert((TWHEEL_SLOTS & (TWHEEL_SLOTS - 1)) == 0, "TWHEEL_SLOTS must be a power of two");
+
+#define SLOT_MASK ((uint64_t)TWHEEL_SLOTS - 1)
+
+
+// ---- Internal helpers ----
+
+static void unlink_timer(struct mh_timer *t) {
+	*t->pprev = t->next;
+	if (t->next) t->next->pprev = t->pprev;
+	t->next = NULL;
+	t->pprev = NULL;
+}
+
+
+//----- API ----------
+
+uint64_t twheel_now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+void twheel_init(struct mh_twheel *w, uint64_t now_ms) {
+	memset(w, 0, sizeof(*w));
+	w->tick = now_ms / TWHEEL_TICK_MS;
+}
+
+void twheel_arm(struct mh_twheel *w, struct mh_timer *t, uint64_t expires_ms) {
+	if (t->pprev) unlink_timer(t);
+	else w->count++;
+
+	// Round up so a timer never fires early; anything already due goes in
+	// the next bucket to be processed.
+	uint64_t tick = (expires_ms + TWHEEL_TICK_MS - 1) / TWHEEL_TICK_MS;
+	if (tick <= w->tick) tick = w->tick + 1;
+	t->tick = tick;
+
+	struct mh_timer **head = &w->slot[tick & SLOT_MASK];
+	t->next = *head;
+	if (*head) (*head)->pprev = &t->next;
+	t->pprev = head;
+	*head = t;
+}
+
+void twheel_cancel(struct mh_twheel *w, struct mh_timer *t) {
+	if (!t->pprev) return;
+	unlink_timer(t);
+	w->count--;
+}
+
+void twheel_advance(struct mh_twheel *w, uint64_t now_ms) {
+	const uint64_t target = now_ms / TWHEEL_TICK_MS;
+	if (target <= w->tick) return;
+
+	// Visit each bucket between the last tick and now (each at most once),
+	// moving due timers to a private list so callbacks can re-arm freely.
+	struct mh_timer *due = NULL;
+	uint64_t steps = target - w->tick;
+	if (steps > TWHEEL_SLOTS) steps = TWHEEL_SLOTS;
+	for (uint64_t i = 1; i <= steps && w->count > 0; i++) {
+		struct mh_timer *t = w->slot[(w->tick + i) & SLOT_MASK];
+		while (t) {
+			struct mh_timer *next = t->next;
+			if (t->tick <= target) {
+				unlink_timer(t);
+				w->count--;
+				t->next = due;
+				due = t;
+			}
+			t = next;
+		}
+	}
+	w->tick = target;
+
+	while (due) {
+		struct mh_timer *t = due;
+		due = t->next;
+		t->next = NULL;
+		t->fn(t);
+	}
+}
+
+int twheel_timeout_ms(const struct mh_twheel *w, uint64_t now_ms) {
+	if (w->count == 0) return -1;
+	for (uint64_t i = 1; i <= TWHEEL_SLOTS; i++) {
+		const uint64_t tick = w->tick + i;
+		for (const struct mh_timer *t = w->slot[tick & SLOT_MASK]; t; t = t->next) {
+			if (t->tick > tick) continue;             // a later turn
+			uint64_t at = tick * TWHEEL_TICK_MS;
+			return at > now_ms ? (int)(at - now_ms) : 0;
+		}
+	}
+	// Everything is at least a full turn away.
+	return TWHEEL_SLOTS * TWHEEL_TICK_MS;
+}
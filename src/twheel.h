@@ -0,0 +1,63 @@
+#ifndef MYHTTP_TWHEEL_H
+#define MYHTTP_TWHEEL_H
+
+#include <stddef.h>   // size_t
+#include <stdint.h>   // uint64_t
+
+/* Hashed timer wheel: TWHEEL_SLOTS buckets of TWHEEL_TICK_MS each. A timer
+   lives in the bucket of its expiry tick (modulo the wheel), so arming and
+   cancelling are O(1) list operations; timers further out than one turn
+   share buckets with nearer ones and are skipped until their turn comes.
+
+   Not thread-safe: each worker owns one wheel, and its connections arm
+   their deadlines on it. Callbacks run inside twheel_advance(). Timers
+   never fire early; they may fire up to one tick late. */
+
+#ifndef TWHEEL_SLOTS
+#define TWHEEL_SLOTS    256          // power of two
+#endif
+
+#ifndef TWHEEL_TICK_MS
+#define TWHEEL_TICK_MS  10
+#endif
+
+struct mh_timer {
+	struct mh_timer  *next;
+	struct mh_timer **pprev;          // NULL while not armed
+	uint64_t          tick;           // expiry tick
+	void            (*fn)(struct mh_timer *t);
+	void             *arg;
+};
+
+struct mh_twheel {
+	uint64_t         tick;            // last tick processed
+	size_t           count;           // armed timers
+	struct mh_timer *slot[TWHEEL_SLOTS];
+};
+
+/* Monotonic clock in milliseconds. */
+uint64_t twheel_now_ms(void);
+
+void twheel_init(struct mh_twheel *w, uint64_t now_ms);
+
+static inline void timer_init(struct mh_timer *t, void (*fn)(struct mh_timer *), void *arg) {
+	*t = (struct mh_timer){ .fn = fn, .arg = arg };
+}
+
+static inline int timer_armed(const struct mh_timer *t) { return t->pprev != NULL; }
+
+/* (Re-)arm 't' to fire at 'expires_ms' (twheel_now_ms() clock). */
+void twheel_arm(struct mh_twheel *w, struct mh_timer *t, uint64_t expires_ms);
+
+/* Disarm 't'; a no-op if it isn't armed. */
+void twheel_cancel(struct mh_twheel *w, struct mh_timer *t);
+
+/* Fire every timer due at 'now_ms'. Callbacks may re-arm their timer. */
+void twheel_advance(struct mh_twheel *w, uint64_t now_ms);
+
+/* Milliseconds from 'now_ms' until the next timer is due (0 if overdue),
+   for use as a poll() timeout; -1 if nothing is armed. Past one turn of the
+   wheel this is a lower bound, and the caller simply asks again. */
+int  twheel_timeout_ms(const struct mh_twheel *w, uint64_t now_ms);
+
+#endif /* MYHTTP_TWHEEL_H */
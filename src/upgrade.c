@@ -0,0 +1,120 @@
+#define _GNU_SOURCE           // CMSG_SPACE, MSG_CMSG_CLOEXEC
+
+#include "upgrade.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+// ---- Internal helpers ----
+
+static int make_addr(const char *path, struct sockaddr_un *sa) {
+	memset(sa, 0, sizeof(*sa));
+	sa->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(sa->sun_path)) { errno = ENAMETOOLONG; return -1; }
+	strcpy(sa->sun_path, path);
+	return 0;
+}
+
+
+//----- API ----------
+
+int upgrade_listen(const char *path) {
+	struct sockaddr_un sa;
+	if (make_addr(path, &sa) < 0) return -1;
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	(void)unlink(path);   // a predecessor's, or a stale one after a crash
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, 4) < 0) {
+		int e = errno; close(fd); errno = e;
+		return -1;
+	}
+	return fd;
+}
+
+int upgrade_connect(const char *path) {
+	struct sockaddr_un sa;
+	if (make_addr(path, &sa) < 0) return -1;
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) return -1;
+	if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		int e = errno; close(fd); errno = e;
+		return -1;
+	}
+	return fd;
+}
+
+int upgrade_send(int sock, int type, const void *data, size_t len, const int *fds, int nfds) {
+	if (len + 1 > UPGRADE_MAX_MSG || nfds < 0 || nfds > UPGRADE_MAX_FDS) { errno = EMSGSIZE; return -1; }
+	unsigned char t = (unsigned char)type;
+	struct iovec iov[2] = {
+		{ .iov_base = &t, .iov_len = 1 },
+		{ .iov_base = (void *)data, .iov_len = len },
+	};
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * UPGRADE_MAX_FDS)];
+		struct cmsghdr align;
+	} ctl;
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = len ? 2 : 1 };
+	if (nfds > 0) {
+		msg.msg_control = ctl.buf;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)nfds);
+		struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+		cm->cmsg_level = SOL_SOCKET;
+		cm->cmsg_type = SCM_RIGHTS;
+		cm->cmsg_len = CMSG_LEN(sizeof(int) * (size_t)nfds);
+		memcpy(CMSG_DATA(cm), fds, sizeof(int) * (size_t)nfds);
+	}
+	for (;;) {
+		ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+		if (n >= 0) return 0;
+		if (errno != EINTR) return -1;
+	}
+}
+
+ssize_t upgrade_recv(int sock, int *type, void *buf, size_t cap, int *fds, int maxfds, int *nfds) {
+	unsigned char t = 0;
+	struct iovec iov[2] = {
+		{ .iov_base = &t, .iov_len = 1 },
+		{ .iov_base = buf, .iov_len = cap },
+	};
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * UPGRADE_MAX_FDS)];
+		struct cmsghdr align;
+	} ctl;
+	struct msghdr msg = {
+		.msg_iov = iov, .msg_iovlen = 2,
+		.msg_control = ctl.buf, .msg_controllen = sizeof(ctl.buf),
+	};
+	*type = 0;
+	if (nfds) *nfds = 0;
+	ssize_t n;
+	do n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	while (n < 0 && errno == EINTR);
+	if (n < 0) return -1;
+
+	int got = 0;
+	for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+		if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) continue;
+		const size_t k = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (size_t i = 0; i < k; i++) {
+			int fd;
+			memcpy(&fd, CMSG_DATA(cm) + i * sizeof(int), sizeof(int));
+			if (fds && got < maxfds) fds[got++] = fd;
+			else close(fd);
+		}
+	}
+	if (nfds) *nfds = got;
+	if (n == 0) return 0;   // peer closed
+	if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+		for (int i = 0; i < got; i++) close(fds[i]);
+		if (nfds) *nfds = 0;
+		errno = EMSGSIZE;
+		return -1;
+	}
+	*type = t;
+	return n - 1;
+}
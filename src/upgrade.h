@@ -0,0 +1,48 @@
+#ifndef MYHTTP_UPGRADE_H
+#define MYHTTP_UPGRADE_H
+
+#include <stddef.h>      // size_t
+#include <sys/types.h>   // ssize_t
+
+/* Transport for zero-downtime binary upgrades.
+
+   A running server listens on a Unix socket (SOCK_SEQPACKET, so messages
+   keep their boundaries). A new server started with the same socket path
+   connects to it, is handed the listening sockets (SCM_RIGHTS) and a
+   snapshot of hot cache keys, starts serving on those sockets, then tells
+   the old server to go; the old one stops accepting, drains and exits,
+   and the new one takes over the socket path for the next upgrade.
+
+   Messages are one type byte followed by a payload, with up to
+   UPGRADE_MAX_FDS descriptors attached. */
+
+#define UPGRADE_MAX_FDS 250    // under the kernel's SCM_MAX_FD
+#define UPGRADE_MAX_MSG 65536
+
+enum upgrade_msg {
+	UPG_HELLO     = 'H',   // new -> old: send me your listeners
+	UPG_LISTENERS = 'L',   // old -> new: layout + listening fds
+	UPG_CACHE     = 'C',   // old -> new: NUL-separated hot URL paths
+	UPG_END       = 'E',   // old -> new: snapshot complete
+	UPG_GO        = 'G',   // new -> old: serving now; stop accepting
+	UPG_OK        = 'K',   // old -> new: draining
+	UPG_REFUSE    = 'R',   // old -> new: cannot hand over (text reason)
+};
+
+/* Bind and listen on 'path', replacing a stale socket file. Returns the fd,
+   or -1 with errno set. */
+int     upgrade_listen(const char *path);
+
+/* Connect to a running server at 'path'. Returns the fd, or -1 with errno
+   set (ENOENT or ECONNREFUSED: nobody there). */
+int     upgrade_connect(const char *path);
+
+/* Send one message with 'nfds' descriptors attached. 0, or -1 (errno). */
+int     upgrade_send(int sock, int type, const void *data, size_t len, const int *fds, int nfds);
+
+/* Receive one message into 'buf' (payload only) and up to 'maxfds'
+   descriptors ('*nfds' gets the count; extra ones are closed). Returns the
+   payload length with '*type' set, 0 with '*type' = 0 on EOF, or -1. */
+ssize_t upgrade_recv(int sock, int *type, void *buf, size_t cap, int *fds, int maxfds, int *nfds);
+
+#endif /* MYHTTP_UPGRADE_H */
@@ -1,6 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "workq.h"
+#include "metrics.h"
 
 #include <stdlib.h>
 #include <errno.h>
@@ -82,6 +83,7 @@ int workq_enqueue(struct mh_workq *q, struct mh_job j) {
 		errno = EINVAL; return -1;
 	}
 	// PUSH
+	j.enq_ns = metrics_now_ns();
 	q->ring[q->tail] = j;
 	q->tail = next_index(q->tail, q->cap);
 	q->count++;
@@ -91,13 +93,36 @@ int workq_enqueue(struct mh_workq *q, struct mh_job j) {
 	return 0;
 }
 
+int workq_try_enqueue(struct mh_workq *q, struct mh_job j) {
+	if (!q) { errno = EINVAL; return -1; }
+
+	pthread_mutex_lock(&q->mtx);
+	if (q->closed || q->count == q->cap) {
+		int e = q->closed ? EINVAL : EAGAIN;
+		pthread_mutex_unlock(&q->mtx);
+		errno = e; return -1;
+	}
+	j.enq_ns = metrics_now_ns();
+	q->ring[q->tail] = j;
+	q->tail = next_index(q->tail, q->cap);
+	q->count++;
+	pthread_cond_signal(&q->not_empty);
+	pthread_mutex_unlock(&q->mtx);
+	return 0;
+}
+
 int workq_dequeue(struct mh_workq *q, struct mh_job *out) {
 	if (!q || !out) { errno = EINVAL; return -1; }
 	pthread_mutex_lock(&q->mtx);
-	while (!q->closed && q->count == 0) {
-		// WAIT UNTIL AN ITEM ARRIVES OR QUEUE CLOSES
+	while (!q->closed && q->count == 0 && q->retire == 0) {
+		// WAIT UNTIL AN ITEM ARRIVES, QUEUE CLOSES OR A CONSUMER IS DISMISSED
 		pthread_cond_wait(&q->not_empty, &q->mtx);
 	}
+	if (q->retire > 0) {
+		q->retire--;
+		pthread_mutex_unlock(&q->mtx);
+		errno = ECANCELED; return -1;
+	}
 	if (q->count == 0 && q->closed) {
 		pthread_mutex_unlock(&q->mtx);
 		errno = EINVAL; return -1;
@@ -109,5 +134,14 @@ int workq_dequeue(struct mh_workq *q, struct mh_job *out) {
 	// SIGNAL THAT THERE IS A FREE SLOT
 	pthread_cond_signal(&q->not_full);
 	pthread_mutex_unlock(&q->mtx);
+	metrics_observe_queue_wait(metrics_now_ns() - out->enq_ns);
 	return 0;
 }
+
+void workq_retire(struct mh_workq *q, size_t n) {
+	if (!q || n == 0) return;
+	pthread_mutex_lock(&q->mtx);
+	q->retire += n;
+	pthread_cond_broadcast(&q->not_empty);
+	pthread_mutex_unlock(&q->mtx);
+}
@@ -6,12 +6,15 @@
 #include <sys/socket.h>     // struct sockaddr_storage
 #include <sys/types.h>      // socklen_t
 #include <stddef.h>         // size_t
+#include <stdint.h>         // uint64_t
 
 /* A unit of work: a connected client socket and its peer info. */
 struct mh_job {
     int client_fd;
     struct sockaddr_storage peer;
     socklen_t peerlen;
+    uint64_t enq_ns;        /* set by workq_enqueue (metrics_now_ns) */
+    void *resume;           /* connection coming back from the I/O pool, or NULL */
 };
 
 /* Bounded MPMC ring-buffer work queue. */
@@ -26,6 +29,8 @@ struct mh_workq {
     pthread_cond_t  not_empty;
     pthread_cond_t  not_full;
 
+    size_t retire;   /* consumers still to be dismissed (workq_retire) */
+
     bool closed;     /* when true: enqueue/dequeue return -1 */
 };
 
@@ -41,8 +46,18 @@ void workq_destroy(struct mh_workq *q);
 /* Blocking enqueue; returns 0 on success, -1 if closed. */
 int  workq_enqueue(struct mh_workq *q, struct mh_job j);
 
-/* Blocking dequeue; returns 0 on success, -1 if closed and empty. */
+/* Non-blocking enqueue; returns 0 on success, -1 with errno = EAGAIN if
+   the queue is full or EINVAL if closed. */
+int  workq_try_enqueue(struct mh_workq *q, struct mh_job j);
+
+/* Blocking dequeue; returns 0 on success, -1 if closed and empty, or -1
+   with errno = ECANCELED when the calling consumer is dismissed. */
 int  workq_dequeue(struct mh_workq *q, struct mh_job *out);
 
+/* Dismiss 'n' consumers: the next 'n' dequeue calls (idle consumers first,
+   busy ones when they come back) fail with ECANCELED instead of taking
+   work, so a shrinking pool never abandons a job. */
+void workq_retire(struct mh_workq *q, size_t n);
+
 #endif /* MYHTTPD_WORKQ_H */
 
@@ -4,6 +4,12 @@ from pathlib import Path
 # Path to your compiled server binary (can override with env)
 MYHTTP_BIN = Path(os.environ.get("MYHTTP_BIN", "./MyHTTP")).resolve()
 
+# Allocation-counting build (make MyHTTP-allochook)
+MYHTTP_ALLOCHOOK_BIN = Path(os.environ.get("MYHTTP_ALLOCHOOK_BIN", "./MyHTTP-allochook")).resolve()
+
+# Asset bundle packer (make tools)
+MHPACK_BIN = Path(os.environ.get("MHPACK_BIN", "./build/mhpack")).resolve()
+
 # Optional: fixed port for debugging. Otherwise a free port is chosen for each test module.
 MYHTTP_PORT = int(os.environ.get("MYHTTP_PORT", "0"))  # 0 means auto
 
@@ -0,0 +1,285 @@
+"""Minimal HTTP/2 cleartext client for exercising MyHTTP's h2c support.
+
+Speaks just enough HTTP/2 for tests: prior-knowledge or Upgrade setup,
+HPACK (literal-only encoding; decoding of static/dynamic/literal fields
+without Huffman, which the server never emits), several concurrent
+streams, request bodies, and manual or automatic flow control.
+
+    python3 -m test.h2client http://127.0.0.1:8080/a.txt /b.txt ...
+"""
+import base64
+import socket
+import struct
+import sys
+from urllib.parse import urlsplit
+
+PREFACE = b"PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+
+DATA, HEADERS, PRIORITY, RST_STREAM, SETTINGS, PUSH_PROMISE, PING, GOAWAY, WINDOW_UPDATE, CONTINUATION = range(10)
+END_STREAM, ACK, END_HEADERS = 0x1, 0x1, 0x4
+SETTINGS_INITIAL_WINDOW_SIZE, SETTINGS_MAX_FRAME_SIZE = 0x4, 0x5
+
+STATIC_TABLE = [
+    (":authority", ""), (":method", "GET"), (":method", "POST"), (":path", "/"),
+    (":path", "/index.html"), (":scheme", "http"), (":scheme", "https"), (":status", "200"),
+    (":status", "204"), (":status", "206"), (":status", "304"), (":status", "400"),
+    (":status", "404"), (":status", "500"), ("accept-charset", ""), ("accept-encoding", "gzip, deflate"),
+    ("accept-language", ""), ("accept-ranges", ""), ("accept", ""), ("access-control-allow-origin", ""),
+    ("age", ""), ("allow", ""), ("authorization", ""), ("cache-control", ""),
+    ("content-disposition", ""), ("content-encoding", ""), ("content-language", ""), ("content-length", ""),
+    ("content-location", ""), ("content-range", ""), ("content-type", ""), ("cookie", ""),
+    ("date", ""), ("etag", ""), ("expect", ""), ("expires", ""),
+    ("from", ""), ("host", ""), ("if-match", ""), ("if-modified-since", ""),
+    ("if-none-match", ""), ("if-range", ""), ("if-unmodified-since", ""), ("last-modified", ""),
+    ("link", ""), ("location", ""), ("max-forwards", ""), ("proxy-authenticate", ""),
+    ("proxy-authorization", ""), ("range", ""), ("referer", ""), ("refresh", ""),
+    ("retry-after", ""), ("server", ""), ("set-cookie", ""), ("strict-transport-security", ""),
+    ("transfer-encoding", ""), ("user-agent", ""), ("vary", ""), ("via", ""),
+    ("www-authenticate", ""),
+]
+
+
+class H2Error(Exception):
+    pass
+
+
+def _enc_int(v: int, prefix: int, flags: int) -> bytes:
+    mx = (1 << prefix) - 1
+    if v < mx:
+        return bytes([flags | v])
+    out = [flags | mx]
+    v -= mx
+    while v >= 0x80:
+        out.append(0x80 | (v & 0x7F))
+        v >>= 7
+    out.append(v)
+    return bytes(out)
+
+
+def _dec_int(b: bytes, i: int, prefix: int):
+    mx = (1 << prefix) - 1
+    v = b[i] & mx
+    i += 1
+    if v < mx:
+        return v, i
+    shift = 0
+    while True:
+        c = b[i]
+        i += 1
+        v += (c & 0x7F) << shift
+        shift += 7
+        if not c & 0x80:
+            return v, i
+
+
+def hpack_encode(fields) -> bytes:
+    """Literal header fields without indexing, no Huffman."""
+    out = b""
+    for name, value in fields:
+        n, v = name.encode(), value.encode()
+        out += b"\x00" + _enc_int(len(n), 7, 0) + n + _enc_int(len(v), 7, 0) + v
+    return out
+
+
+class HpackDecoder:
+    def __init__(self):
+        self.dyn = []          # newest first
+        self.max_size = 4096
+
+    def _size(self):
+        return sum(len(n) + len(v) + 32 for n, v in self.dyn)
+
+    def _get(self, idx):
+        if idx <= len(STATIC_TABLE):
+            return STATIC_TABLE[idx - 1]
+        return self.dyn[idx - len(STATIC_TABLE) - 1]
+
+    def _str(self, b, i):
+        huff = b[i] & 0x80
+        n, i = _dec_int(b, i, 7)
+        if huff:
+            raise H2Error("Huffman-coded string (not supported by this client)")
+        return b[i:i + n].decode("latin-1"), i + n
+
+    def decode(self, b: bytes):
+        fields, i = [], 0
+        while i < len(b):
+            c = b[i]
+            if c & 0x80:
+                idx, i = _dec_int(b, i, 7)
+                fields.append(self._get(idx))
+            elif c & 0xE0 == 0x20:
+                self.max_size, i = _dec_int(b, i, 5)
+                while self.dyn and self._size() > self.max_size:
+                    self.dyn.pop()
+            else:
+                incr = c & 0xC0 == 0x40
+                idx, i = _dec_int(b, i, 6 if incr else 4)
+                if idx:
+                    name = self._get(idx)[0]
+                else:
+                    name, i = self._str(b, i)
+                value, i = self._str(b, i)
+                fields.append((name, value))
+                if incr:
+                    self.dyn.insert(0, (name, value))
+                    while self.dyn and self._size() > self.max_size:
+                        self.dyn.pop()
+        return fields
+
+
+class Response:
+    def __init__(self, sid):
+        self.stream_id = sid
+        self.headers = {}
+        self.body = b""
+        self.done = False
+        self.reset = None      # RST_STREAM error code
+
+    @property
+    def status(self):
+        return int(self.headers.get(":status", 0))
+
+
+class H2Connection:
+    def __init__(self, host, port, timeout=3.0, window=None, auto_window=True, upgrade_path=None):
+        """window: our SETTINGS_INITIAL_WINDOW_SIZE (None = protocol default).
+        auto_window: send WINDOW_UPDATEs for every DATA frame received.
+        upgrade_path: start with an HTTP/1.1 'Upgrade: h2c' GET instead of prior knowledge."""
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.host = f"{host}:{port}"
+        self.buf = b""
+        self.dec = HpackDecoder()
+        self.next_id = 1
+        self.responses = {}
+        self.frames = []       # (type, flags, stream_id, length) of every frame received
+        self.auto_window = auto_window
+        self.server_settings = {}
+        self.goaway = None
+
+        settings = b"" if window is None else struct.pack(">HI", SETTINGS_INITIAL_WINDOW_SIZE, window)
+        if upgrade_path is not None:
+            hs = base64.urlsafe_b64encode(settings).rstrip(b"=").decode()
+            req = (f"GET {upgrade_path} HTTP/1.1\r\nHost: {self.host}\r\n"
+                   f"Connection: Upgrade, HTTP2-Settings\r\nUpgrade: h2c\r\nHTTP2-Settings: {hs}\r\n\r\n")
+            self.sock.sendall(req.encode())
+            while b"\r\n\r\n" not in self.buf:
+                self._recv()
+            head, self.buf = self.buf.split(b"\r\n\r\n", 1)
+            if not head.startswith(b"HTTP/1.1 101"):
+                raise H2Error(f"upgrade refused: {head[:40]!r}")
+            self.responses[1] = Response(1)
+            self.next_id = 3
+        self.sock.sendall(PREFACE + self._frame(SETTINGS, 0, 0, settings))
+
+    # -- framing --
+
+    @staticmethod
+    def _frame(ftype, flags, sid, payload=b""):
+        return struct.pack(">I", len(payload))[1:] + bytes([ftype, flags]) + struct.pack(">I", sid) + payload
+
+    def send_frame(self, ftype, flags, sid, payload=b""):
+        self.sock.sendall(self._frame(ftype, flags, sid, payload))
+
+    def _recv(self):
+        chunk = self.sock.recv(65536)
+        if not chunk:
+            raise H2Error("connection closed")
+        self.buf += chunk
+
+    def read_frame(self):
+        while len(self.buf) < 9:
+            self._recv()
+        length = int.from_bytes(self.buf[:3], "big")
+        while len(self.buf) < 9 + length:
+            self._recv()
+        ftype, flags = self.buf[3], self.buf[4]
+        sid = int.from_bytes(self.buf[5:9], "big") & 0x7FFFFFFF
+        payload, self.buf = self.buf[9:9 + length], self.buf[9 + length:]
+        self.frames.append((ftype, flags, sid, length))
+        self._handle(ftype, flags, sid, payload)
+        return ftype, flags, sid, payload
+
+    def _handle(self, ftype, flags, sid, payload):
+        if ftype == SETTINGS and not flags & ACK:
+            for i in range(0, len(payload), 6):
+                k, v = struct.unpack(">HI", payload[i:i + 6])
+                self.server_settings[k] = v
+            self.send_frame(SETTINGS, ACK, 0)
+        elif ftype == PING and not flags & ACK:
+            self.send_frame(PING, ACK, 0, payload)
+        elif ftype == HEADERS:
+            r = self.responses.setdefault(sid, Response(sid))
+            if not flags & END_HEADERS:
+                raise H2Error("CONTINUATION not supported by this client")
+            r.headers.update(self.dec.decode(payload))
+            if flags & END_STREAM:
+                r.done = True
+        elif ftype == DATA:
+            r = self.responses.setdefault(sid, Response(sid))
+            r.body += payload
+            if flags & END_STREAM:
+                r.done = True
+            if self.auto_window and payload:
+                self.window_update(0, len(payload))
+                if not r.done:
+                    self.window_update(sid, len(payload))
+        elif ftype == RST_STREAM:
+            r = self.responses.setdefault(sid, Response(sid))
+            r.reset = struct.unpack(">I", payload)[0]
+            r.done = True
+        elif ftype == GOAWAY:
+            self.goaway = struct.unpack(">II", payload[:8])
+
+    # -- API --
+
+    def window_update(self, sid, inc):
+        self.send_frame(WINDOW_UPDATE, 0, sid, struct.pack(">I", inc))
+
+    def request(self, method, path, body=None, headers=()):
+        sid = self.next_id
+        self.next_id += 2
+        fields = [(":method", method), (":scheme", "http"), (":authority", self.host), (":path", path)]
+        if body is not None:
+            fields.append(("content-length", str(len(body))))
+        fields += list(headers)
+        self.responses[sid] = Response(sid)
+        self.send_frame(HEADERS, END_HEADERS | (0 if body else END_STREAM), sid, hpack_encode(fields))
+        if body:
+            for off in range(0, len(body), 16384):
+                chunk = body[off:off + 16384]
+                last = off + 16384 >= len(body)
+                self.send_frame(DATA, END_STREAM if last else 0, sid, chunk)
+        return sid
+
+    def wait(self, *sids):
+        """Read frames until the given streams (default: all) are complete."""
+        want = sids or tuple(self.responses)
+        while not all(self.responses[s].done for s in want):
+            self.read_frame()
+        return [self.responses[s] for s in want]
+
+    def close(self):
+        try:
+            self.send_frame(GOAWAY, 0, 0, struct.pack(">II", 0, 0))
+        except OSError:
+            pass
+        self.sock.close()
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(f"usage: {argv[0]} http://host:port/path [/more/paths ...]", file=sys.stderr)
+        return 2
+    u = urlsplit(argv[1])
+    paths = [u.path or "/"] + argv[2:]
+    c = H2Connection(u.hostname, u.port or 80)
+    sids = [c.request("GET", p) for p in paths]
+    for r, p in zip(c.wait(*sids), paths):
+        print(f"{p}: {r.status} {len(r.body)} bytes")
+    c.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
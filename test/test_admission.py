@@ -0,0 +1,98 @@
+import socket
+import time
+import unittest
+from concurrent.futures import ThreadPoolExecutor
+from http.client import HTTPConnection
+
+from . import config
+from .utils import start_server, temp_docroot, RequiresServerBinary
+
+N_WORKERS = 8   # config.h default
+WARMUP = 256    # admit.c: samples before the gradient limit moves
+
+
+class TestAdmission(RequiresServerBinary):
+    def _get(self, addr, path):
+        conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+        conn.request("GET", path)
+        r = conn.getresponse()
+        body = r.read()
+        conn.close()
+        return r, body
+
+    def _wait_served(self, addr, path, deadline=3.0):
+        """Retry until a connection is admitted again (workers notice closes asynchronously)."""
+        end = time.monotonic() + deadline
+        while True:
+            r, body = self._get(addr, path)
+            if r.status != 503 or time.monotonic() > end:
+                return r, body
+            time.sleep(0.05)
+
+    def test_overflow_is_shed_with_503(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            args = ["--admission", "fixed", "--max-inflight", str(N_WORKERS)]
+            with start_server(docroot, extra_args=args) as (proc, addr):
+                # Let the startup probe's connection finish before filling the workers.
+                self.assertEqual(self._wait_served(addr, "/a.txt")[0].status, 200)
+
+                # Occupy every worker with a connection that never sends a request.
+                hogs = [socket.create_connection(addr, timeout=config.REQ_TIMEOUT) for _ in range(N_WORKERS)]
+                try:
+                    time.sleep(0.2)
+                    t0 = time.monotonic()
+                    r, body = self._get(addr, "/a.txt")
+                    self.assertLess(time.monotonic() - t0, 1.0)     # refused at once, not queued
+                    self.assertEqual(r.status, 503)
+                    self.assertEqual(r.getheader("Retry-After"), "1")
+                    self.assertEqual(body, b"overloaded\r\n")
+                finally:
+                    for s in hogs:
+                        s.close()
+
+                # Capacity frees up as soon as the hogs are gone.
+                r, body = self._wait_served(addr, "/a.txt")
+                self.assertEqual((r.status, body), (200, b"alpha"))
+                r, stats = self._get(addr, "/_stats")
+                self.assertIn(b"myhttp_connections_shed_total ", stats)
+                self.assertNotIn(b"myhttp_connections_shed_total 0\n", stats)
+                self.assertIn(b"myhttp_admission_limit %d\n" % N_WORKERS, stats)
+
+    def test_gradient_limit_starts_at_ceiling(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=["--max-inflight", "100"]) as (proc, addr):
+                for _ in range(WARMUP + 50):
+                    r, body = self._get(addr, "/a.txt")
+                    self.assertEqual((r.status, body), (200, b"alpha"))
+                r, stats = self._get(addr, "/_stats")
+                # No queueing delay: nothing shed, and the limit stays at its ceiling.
+                self.assertIn(b"myhttp_connections_shed_total 0\n", stats)
+                self.assertIn(b"myhttp_admission_limit 100\n", stats)
+
+    def test_first_upload_burst_is_not_shed(self):
+        def upload(i):
+            with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as s:
+                s.sendall(b"PUT /up/f%d.txt HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\n"
+                          b"Connection: close\r\n\r\n" % (i % 16))
+                time.sleep(0.05)   # holds a worker while the body comes in
+                s.sendall(b"hello")
+                return s.recv(64).split(b" ")[1]
+
+        with temp_docroot({"a.txt": "alpha", "up/.keep": ""}) as docroot:
+            args = ["--workers", "4", "--max-inflight", "64"]
+            with start_server(docroot, extra_args=args) as (proc, addr):
+                # A quiet start puts the baseline at the floor...
+                for _ in range(10):
+                    self.assertEqual(self._get(addr, "/a.txt")[0].status, 200)
+                # ...then a burst six times the workers, well within the
+                # limit and carried on past the warmup, queues rather than
+                # being read as overload.
+                with ThreadPoolExecutor(24) as ex:
+                    statuses = set(ex.map(upload, range(WARMUP + 24)))
+                self.assertEqual(statuses, {b"201", b"204"})
+                r, stats = self._get(addr, "/_stats")
+                self.assertIn(b"myhttp_connections_shed_total 0\n", stats)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,58 @@
+import http.client
+import unittest
+from pathlib import Path
+
+from . import config
+from .utils import start_server, temp_docroot, metric, RequiresServerBinary
+
+
+class TestSteadyStateAllocations(RequiresServerBinary):
+    """Uses the MyHTTP-allochook build, which counts every heap allocation."""
+
+    @classmethod
+    def setUpClass(cls):
+        super().setUpClass()
+        if not config.MYHTTP_ALLOCHOOK_BIN.exists():
+            raise unittest.SkipTest(f"alloc-hook binary not found: {config.MYHTTP_ALLOCHOOK_BIN}")
+
+    def test_get_path_makes_no_heap_allocations(self):
+        files = {
+            "a.txt": "alpha",
+            "sub/b.css": "body{}",
+            "site/index.html": "<h1>hi</h1>",
+            "big.bin": "x" * (64 * 1024),
+        }
+        paths = ["/a.txt", "/sub/b.css", "/site/", "/big.bin", "/missing.txt", "/sub/nope/x.png"]
+        with temp_docroot(files) as docroot:
+            with start_server(Path(docroot), binary=config.MYHTTP_ALLOCHOOK_BIN) as (proc, addr):
+                # One keep-alive connection: one worker, one arena.
+                conn = http.client.HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+
+                def get(path):
+                    conn.request("GET", path)
+                    r = conn.getresponse()
+                    return r.status, r.read()
+
+                def allocs():
+                    st, body = get("/_stats")
+                    self.assertEqual(st, 200)
+                    text = body.decode()
+                    self.assertIn("myhttp_request_heap_allocations_total", text)
+                    return metric(text, "myhttp_request_heap_allocations_total")
+
+                # Warm-up: first touch of per-thread metrics and the path cache.
+                for p in paths:
+                    get(p)
+                before = allocs()
+
+                for _ in range(20):
+                    for p in paths:
+                        st, _ = get(p)
+                        self.assertIn(st, (200, 404))
+
+                self.assertEqual(allocs() - before, 0)
+                conn.close()
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,178 @@
+import io
+import socket
+import tarfile
+import unittest
+from email.parser import BytesParser
+from email.policy import HTTP
+from http.client import HTTPConnection
+
+from .utils import start_server, temp_docroot, http_get, http_request, get_stats, metric, RequiresServerBinary
+
+
+FILES = {
+    "a.txt": "alpha",
+    "sub/b.html": "<p>beta</p>",
+    "big.bin": b"z" * (300 * 1024),   # sent with sendfile
+    "lists/all.txt": "# everything\n/a.txt\nsub/b.html\n\n/big.bin\n",
+}
+
+
+def _make_tar(files, extra=()):
+    buf = io.BytesIO()
+    with tarfile.open(fileobj=buf, mode="w", format=tarfile.PAX_FORMAT) as t:
+        for name, data in files.items():
+            info = tarfile.TarInfo(name)
+            info.size = len(data)
+            info.mtime = 1_000_000_000
+            t.addfile(info, io.BytesIO(data))
+        for info in extra:
+            t.addfile(info)
+    return buf.getvalue()
+
+
+def _pax_tar(records):
+    """A one-file archive whose pax header holds 'records' as they are."""
+    def block(name, size, typ):
+        h = bytearray(512)
+        h[0:len(name)] = name
+        h[100:108] = b"0000644\0"
+        h[124:136] = b"%011o\0" % size
+        h[136:148] = b"00000000000\0"
+        h[148:156] = b" " * 8
+        h[156:157] = typ
+        h[257:265] = b"ustar\x0000"
+        h[148:156] = b"%06o\0 " % sum(h)
+        return bytes(h)
+    pad = lambda b: b + b"\0" * (-len(b) % 512)
+    return (block(b"pax", len(records), b"x") + pad(records) +
+            block(b"f.txt", 1, b"0") + pad(b"f") + b"\0" * 1024)
+
+
+def _tar(body):
+    with tarfile.open(fileobj=io.BytesIO(body), mode="r:") as t:
+        return {m.name: t.extractfile(m).read() for m in t.getmembers()}
+
+
+class TestBatch(RequiresServerBinary):
+    def test_post_list_streams_a_tar(self):
+        with temp_docroot(FILES) as docroot:
+            with start_server(docroot) as (proc, addr):
+                status, headers, body = http_request(*addr, "POST", "/_batch",
+                                                     body="/a.txt\r\n/missing.txt\nsub/b.html\n/big.bin\n")
+                self.assertEqual(status, 200)
+                self.assertEqual(headers.get("Content-Type"), "application/x-tar")
+                self.assertEqual(headers.get("Transfer-Encoding"), "chunked")
+                members = _tar(body)
+                self.assertEqual(members["a.txt"], b"alpha")
+                self.assertEqual(members["sub/b.html"], b"<p>beta</p>")
+                self.assertEqual(members["big.bin"], FILES["big.bin"])
+                self.assertIn(b"404 Not Found /missing.txt", members["_batch_errors.txt"])
+
+                _, _, stats = http_get(*addr, "/_stats")
+                text = stats.decode()
+                self.assertEqual(metric(text, "myhttp_batch_requests_total"), 1)
+                self.assertEqual(metric(text, "myhttp_batch_files_total"), 3)
+                self.assertEqual(metric(text, "myhttp_batch_failed_total"), 1)
+
+    def test_multipart_when_accepted(self):
+        with temp_docroot(FILES) as docroot:
+            with start_server(docroot) as (proc, addr):
+                status, headers, body = http_request(*addr, "POST", "/_batch", body="/a.txt\n/../etc/passwd\n",
+                                                     headers={"Accept": "multipart/mixed"})
+                self.assertEqual(status, 200)
+                ctype = headers.get("Content-Type")
+                self.assertTrue(ctype.startswith("multipart/mixed; boundary="))
+                msg = BytesParser(policy=HTTP).parsebytes(b"Content-Type: " + ctype.encode() + b"\r\n\r\n" + body)
+                parts = list(msg.iter_parts())
+                self.assertEqual(len(parts), 2)
+                self.assertEqual(parts[0]["Content-Location"], "/a.txt")
+                self.assertEqual(parts[0].get_payload(decode=True), b"alpha")
+                self.assertTrue(parts[1]["X-Batch-Status"].startswith("400"))
+
+    def test_rejected_names_are_escaped_when_echoed(self):
+        with temp_docroot(FILES) as docroot:
+            with start_server(docroot) as (proc, addr):
+                name = "/a.txt\rX-Injected: 1\x7f"
+                status, headers, body = http_request(*addr, "POST", "/_batch", body=name + "\n",
+                                                     headers={"Accept": "multipart/mixed"})
+                self.assertEqual(status, 200)
+                ctype = headers.get("Content-Type")
+                msg = BytesParser(policy=HTTP).parsebytes(b"Content-Type: " + ctype.encode() + b"\r\n\r\n" + body)
+                part, = msg.iter_parts()
+                self.assertIsNone(part["X-Injected"])
+                self.assertEqual(part["Content-Location"], "/a.txt%0DX-Injected: 1%7F")
+                self.assertTrue(part["X-Batch-Status"].startswith("400"))
+
+                status, _, body = http_request(*addr, "POST", "/_batch", body=name + "\n")
+                self.assertEqual(status, 200)
+                self.assertEqual(_tar(body)["_batch_errors.txt"], b"400 Bad Request /a.txt%0DX-Injected: 1%7F\n")
+
+    def test_get_list_file_and_keep_alive(self):
+        with temp_docroot(FILES) as docroot:
+            with start_server(docroot) as (proc, addr):
+                conn = HTTPConnection(*addr, timeout=5)
+                try:
+                    conn.request("GET", "/_batch/lists/all.txt")
+                    resp = conn.getresponse()
+                    self.assertEqual(resp.status, 200)
+                    members = _tar(resp.read())
+                    self.assertEqual(sorted(members), ["a.txt", "big.bin", "sub/b.html"])
+                    conn.request("GET", "/a.txt")   # same connection
+                    resp = conn.getresponse()
+                    self.assertEqual(resp.read(), b"alpha")
+                finally:
+                    conn.close()
+
+                self.assertEqual(http_get(*addr, "/_batch/lists/none.txt")[0], 404)
+                self.assertEqual(http_get(*addr, "/_batch")[0], 405)
+                self.assertEqual(http_request(*addr, "POST", "/_batch/x", body="x")[0], 403)
+
+    def test_put_tar_replaces_directory(self):
+        long_name = "deep/" + "n" * 120 + ".txt"   # needs a pax path record
+        with temp_docroot({"site/old.txt": "old", "keep.txt": "keep"}) as docroot:
+            with start_server(docroot) as (proc, addr):
+                archive = _make_tar({"./index.html": b"<h1>v2</h1>", "css/a.css": b"a{}",
+                                     long_name: b"long", "big.bin": b"q" * (200 * 1024)})
+                self.assertEqual(http_request(*addr, "PUT", "/_batch/site", body=archive)[0], 204)
+                self.assertEqual(http_get(*addr, "/site/index.html")[2], b"<h1>v2</h1>")
+                self.assertEqual(http_get(*addr, "/site/css/a.css")[2], b"a{}")
+                self.assertEqual(http_get(*addr, "/site/" + long_name)[2], b"long")
+                self.assertEqual(len(http_get(*addr, "/site/big.bin")[2]), 200 * 1024)
+                self.assertEqual(http_get(*addr, "/site/old.txt")[0], 404)   # replaced, not merged
+                self.assertEqual((docroot / "site/css/a.css").stat().st_mtime, 1_000_000_000)
+
+                self.assertEqual(http_request(*addr, "PUT", "/_batch/new/", body=_make_tar({"x": b"x"}))[0], 201)
+                self.assertEqual(http_get(*addr, "/new/x")[2], b"x")
+                self.assertEqual(sorted(p.name for p in docroot.iterdir()), ["keep.txt", "new", "site"])
+
+                text = get_stats(*addr)
+                self.assertEqual(metric(text, "myhttp_batch_uploads_total"), 2)
+                self.assertEqual(metric(text, "myhttp_batch_unpacked_files_total"), 5)
+
+    def test_put_tar_rejects_unsafe_archives(self):
+        link = tarfile.TarInfo("evil")
+        link.type = tarfile.SYMTYPE
+        link.linkname = "/etc"
+        with temp_docroot({"site/a.txt": "a", "f.txt": "f"}) as docroot:
+            with start_server(docroot) as (proc, addr):
+                for body in (_make_tar({"../escape.txt": b"x"}), _make_tar({}, [link]), b"not a tar" * 100,
+                             _pax_tar(b"2\n z=" + b"y" * 200 + b"\n"), _pax_tar(b"99999999999999999999 path=x\n")):
+                    self.assertEqual(http_request(*addr, "PUT", "/_batch/site", body=body)[0], 400)
+                self.assertEqual(http_get(*addr, "/site/a.txt")[2], b"a")
+                self.assertFalse((docroot.parent / "escape.txt").exists())
+                self.assertEqual(sorted(p.name for p in docroot.iterdir()), ["f.txt", "site"])
+
+                tar = _make_tar({"x": b"x"})
+                self.assertEqual(http_request(*addr, "PUT", "/_batch/", body=tar)[0], 409)
+                self.assertEqual(http_request(*addr, "PUT", "/_batch/f.txt", body=tar)[0], 409)
+
+    def test_list_too_large(self):
+        with temp_docroot(FILES) as docroot:
+            with start_server(docroot) as (proc, addr):
+                with socket.create_connection(addr, timeout=5) as s:
+                    s.sendall(b"POST /_batch HTTP/1.1\r\nHost: x\r\nContent-Length: 99999999\r\n\r\n")
+                    self.assertTrue(s.recv(4096).startswith(b"HTTP/1.1 413"))
+
+
+if __name__ == "__main__":
+    unittest.main()
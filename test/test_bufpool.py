@@ -0,0 +1,62 @@
+import http.client
+import socket
+import unittest
+from pathlib import Path
+
+from . import config
+from .utils import start_server, temp_docroot, http_get, metric, RequiresServerBinary
+
+SIZES = ("4096", "16384", "65536")
+
+
+def _in_use(text: str) -> float:
+    return sum(metric(text, "myhttp_bufpool_buffers", f'size="{s}",state="in_use"') for s in SIZES)
+
+
+class TestBufferPool(RequiresServerBinary):
+    def test_idle_connections_hold_no_buffers(self):
+        with temp_docroot({"a.txt": "alpha" * 1000}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                st, _, body = http_get(*addr, "/_stats")
+                self.assertEqual(st, 200)
+                baseline = _in_use(body.decode())   # just the /_stats request itself
+                self.assertGreater(baseline, 0)
+
+                # Three keep-alive connections, each served once and then idle.
+                idle = []
+                for _ in range(3):
+                    c = http.client.HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                    c.request("GET", "/a.txt")
+                    r = c.getresponse()
+                    self.assertEqual(r.status, 200)
+                    r.read()
+                    idle.append(c)
+
+                st, _, body = http_get(*addr, "/_stats")
+                text = body.decode()
+                self.assertEqual(_in_use(text), baseline)
+                self.assertGreater(metric(text, "myhttp_bufpool_hits_total", 'size="4096"'), 0)
+                for c in idle:
+                    c.close()
+
+    def test_receive_buffer_grows_for_large_headers(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                big = "x" * (20 * 1024)   # past the 4 KiB and 16 KiB classes
+                req = (f"GET /a.txt HTTP/1.1\r\nHost: t\r\nX-Big: {big}\r\n"
+                       "Connection: close\r\n\r\n").encode()
+                with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as s:
+                    s.sendall(req)
+                    data = b""
+                    while chunk := s.recv(65536):
+                        data += chunk
+                self.assertTrue(data.startswith(b"HTTP/1.1 200"), data[:64])
+                self.assertTrue(data.endswith(b"alpha"))
+
+                st, _, body = http_get(*addr, "/_stats")
+                self.assertEqual(st, 200)
+                self.assertGreater(metric(body.decode(), "myhttp_bufpool_gets_total", 'size="65536"'), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
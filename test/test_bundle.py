@@ -0,0 +1,88 @@
+import subprocess
+import tempfile
+import unittest
+from pathlib import Path
+
+from . import config
+from .utils import start_server, temp_docroot, http_get, http_request, RequiresServerBinary
+
+
+class TestBundle(RequiresServerBinary):
+    def setUp(self):
+        if not config.MHPACK_BIN.exists():
+            raise unittest.SkipTest(f"packer not found: {config.MHPACK_BIN}")
+        self._dir = tempfile.TemporaryDirectory(prefix="myhttp-bundle-")
+        self.bundle = Path(self._dir.name) / "site.bundle"
+
+    def tearDown(self):
+        self._dir.cleanup()
+
+    def _pack(self, docroot, *extra):
+        out = subprocess.run([str(config.MHPACK_BIN), *extra, str(docroot), str(self.bundle)],
+                             capture_output=True, text=True, timeout=10)
+        self.assertEqual(out.returncode, 0, out.stderr)
+        return out.stdout
+
+    def test_served_from_bundle_without_the_docroot(self):
+        files = {"index.html": "<h1>home</h1>", "app.js": "let x = 1;", "css/site.css": "body{}",
+                 "docs/index.html": "docs", "big.txt": "x" * 200}
+        with temp_docroot(files) as packed:
+            self.assertIn("4 files", self._pack(packed, "-m", "100"))
+        self.assertEqual(self.bundle.read_bytes()[:8], b"MHBUNDL\0")
+
+        # A different docroot: only what was too big to pack is read from it.
+        with temp_docroot({"big.txt": "from docroot", "extra.txt": "extra"}) as docroot:
+            with start_server(docroot, extra_args=["--bundle", str(self.bundle)]) as (proc, addr):
+                status, headers, body = http_get(*addr, "/app.js")
+                self.assertEqual((status, body), (200, b"let x = 1;"))
+                self.assertEqual(headers["Content-Type"], "application/javascript")
+                self.assertRegex(headers["ETag"], r'^"[0-9a-f]{16}"$')
+
+                self.assertEqual(http_get(*addr, "/")[2], b"<h1>home</h1>")
+                self.assertEqual(http_get(*addr, "/docs")[2], b"docs")
+                self.assertEqual(http_get(*addr, "/docs/")[2], b"docs")
+                status, headers, body = http_get(*addr, "/css/site.css")
+                self.assertEqual((body, headers["Content-Type"]), (b"body{}", "text/css"))
+
+                status, headers, body = http_get(*addr, "/big.txt")
+                self.assertEqual((status, body), (200, b"from docroot"))
+                self.assertNotIn("ETag", headers)
+                self.assertEqual(http_get(*addr, "/extra.txt")[2], b"extra")
+                self.assertEqual(http_get(*addr, "/missing.txt")[0], 404)
+
+                _, _, stats = http_get(*addr, "/_stats")
+                self.assertIn(b"myhttp_bundle_entries 4\n", stats)
+                self.assertIn(b"myhttp_bundle_hits_total 5\n", stats)
+
+    def test_etag_follows_content(self):
+        with temp_docroot({"a.txt": "one", "b.txt": "one"}) as docroot:
+            self._pack(docroot)
+            with start_server(docroot, extra_args=["--bundle", str(self.bundle)]) as (proc, addr):
+                tag_a = http_get(*addr, "/a.txt")[1]["ETag"]
+                self.assertEqual(tag_a, http_get(*addr, "/b.txt")[1]["ETag"])
+            (docroot / "a.txt").write_text("two")
+            self._pack(docroot)
+            with start_server(docroot, extra_args=["--bundle", str(self.bundle)]) as (proc, addr):
+                self.assertNotEqual(http_get(*addr, "/a.txt")[1]["ETag"], tag_a)
+
+    def test_bundled_paths_are_read_only(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            self._pack(docroot)
+            with start_server(docroot, extra_args=["--bundle", str(self.bundle)]) as (proc, addr):
+                self.assertEqual(http_request(*addr, "PUT", "/a.txt", body="changed")[0], 409)
+                self.assertEqual(http_get(*addr, "/a.txt")[2], b"alpha")
+                self.assertEqual((docroot / "a.txt").read_text(), "alpha")
+                self.assertEqual(http_request(*addr, "PUT", "/new.txt", body="new")[0], 201)
+                self.assertEqual(http_get(*addr, "/new.txt")[2], b"new")
+
+    def test_not_a_bundle_is_fatal(self):
+        self.bundle.write_bytes(b"garbage" * 100)
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            proc = subprocess.run([str(config.MYHTTP_BIN), "-p", "8080", "-d", str(docroot),
+                                   "--bundle", str(self.bundle)], capture_output=True, text=True, timeout=5)
+            self.assertEqual(proc.returncode, 1)
+            self.assertIn("not a bundle", proc.stderr)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,82 @@
+import hashlib
+import subprocess
+import tempfile
+import unittest
+from pathlib import Path
+
+from . import config
+from .utils import start_server, temp_docroot, http_get, http_request, get_stats, metric, RequiresServerBinary
+
+
+class TestCas(RequiresServerBinary):
+    def setUp(self):
+        self._dir = tempfile.TemporaryDirectory(prefix="myhttp-cas-")
+        self.store = Path(self._dir.name) / "store"
+
+    def tearDown(self):
+        self._dir.cleanup()
+
+    def _blob(self, data):
+        h = hashlib.sha256(data).hexdigest()
+        return self.store / h[:2] / h[2:]
+
+    def test_identical_uploads_share_one_blob(self):
+        lib = b"/* vendored */" + b"v" * 100_000
+        with temp_docroot({"a/.keep": "", "b/.keep": ""}) as docroot:
+            with start_server(docroot, extra_args=["--cas", str(self.store)]) as (proc, addr):
+                self.assertEqual(http_request(*addr, "PUT", "/a/lib.js", body=lib)[0], 201)
+                self.assertTrue(self._blob(lib).exists())
+                self.assertEqual(http_request(*addr, "PUT", "/b/lib.js", body=lib)[0], 201)
+                self.assertEqual(http_request(*addr, "PUT", "/b/lib.js", body=lib)[0], 204)
+                self.assertEqual(http_get(*addr, "/b/lib.js")[2], lib)
+
+                a, b = (docroot / "a/lib.js").stat(), (docroot / "b/lib.js").stat()
+                self.assertEqual(a.st_ino, b.st_ino)
+                self.assertEqual(a.st_nlink, 3)   # two paths and the blob
+                self.assertEqual(sorted(p.name for p in (docroot / "b").iterdir()), [".keep", "lib.js"])
+                text = get_stats(*addr)
+                self.assertEqual(metric(text, "myhttp_cas_blobs"), 1)
+                self.assertEqual(metric(text, "myhttp_cas_dedup_total"), 2)
+                self.assertEqual(metric(text, "myhttp_cas_dedup_bytes_total"), 2 * len(lib))
+
+                # Appending to one path must not change the others.
+                self.assertEqual(http_request(*addr, "PATCH", "/a/lib.js", body="+")[0], 204)
+                self.assertEqual(http_get(*addr, "/a/lib.js")[2], lib + b"+")
+                self.assertEqual(http_get(*addr, "/b/lib.js")[2], lib)
+                self.assertEqual(self._blob(lib).read_bytes(), lib)
+
+    def test_hashed_uploads_skip_write_behind(self):
+        body = b"w" * (3 << 20)   # three write-behind windows
+        with temp_docroot() as docroot:
+            with start_server(docroot, extra_args=["--cas", str(self.store)]) as (proc, addr):
+                self.assertEqual(http_request(*addr, "PUT", "/one.bin", body=body)[0], 201)
+                self.assertEqual(http_request(*addr, "PUT", "/two.bin", body=body)[0], 201)
+                self.assertEqual(http_get(*addr, "/two.bin")[2], body)
+                text = get_stats(*addr)
+                self.assertEqual(metric(text, "myhttp_cas_dedup_total"), 1)
+                self.assertEqual(metric(text, "myhttp_io_writebehind_bytes_total"), 0)
+
+    def test_unlinked_blobs_are_dropped_at_startup(self):
+        with temp_docroot() as docroot:
+            args = ["--cas", str(self.store)]
+            with start_server(docroot, extra_args=args) as (proc, addr):
+                self.assertEqual(http_request(*addr, "PUT", "/x.txt", body="one")[0], 201)
+                self.assertEqual(http_request(*addr, "PUT", "/x.txt", body="two")[0], 204)
+            self.assertTrue(self._blob(b"one").exists())
+            with start_server(docroot, extra_args=args) as (proc, addr):
+                self.assertFalse(self._blob(b"one").exists())   # nothing links to it
+                self.assertEqual(metric(get_stats(*addr), "myhttp_cas_blobs"), 1)
+                self.assertEqual(http_request(*addr, "PUT", "/y.txt", body="two")[0], 201)
+                self.assertEqual(metric(get_stats(*addr), "myhttp_cas_dedup_total"), 1)
+                self.assertEqual((docroot / "y.txt").stat().st_ino, (docroot / "x.txt").stat().st_ino)
+
+    def test_store_inside_docroot_is_fatal(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            proc = subprocess.run([str(config.MYHTTP_BIN), "-p", "8080", "-d", str(docroot),
+                                   "--cas", str(docroot / "store")], capture_output=True, text=True, timeout=5)
+            self.assertEqual(proc.returncode, 1)
+            self.assertIn("inside the docroot", proc.stderr)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -1,4 +1,4 @@
-import unittest, threading, random
+import unittest, threading, random, socket, time
 from pathlib import Path
 from .utils import start_server, temp_docroot, http_get, http_request, is_unsupported_method, RequiresServerBinary
 
@@ -97,3 +97,50 @@ class TestConcurrencyWrites(RequiresServerBinary):
                 # Ensure server still responds after the stress test
                 st, _, _ = http_get(*addr, "/probe.txt")
                 self.assertIsInstance(st, int)
+
+    def test_parallel_put_same_key_coalesces(self):
+        """Many PUTs to one key: all succeed, the result is one complete payload, no temp files leak."""
+        with temp_docroot({}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                st_probe, _, _ = http_request(*addr, "PUT", "/probe.txt", body="x")
+                if is_unsupported_method(st_probe):
+                    self.skipTest("PUT not supported by server")
+                N = 40
+                payloads = [f"config-{i}-" + "x" * (1000 + i) for i in range(N)]
+                errs = []
+
+                def worker(i):
+                    st, _, _ = http_request(*addr, "PUT", "/hot.conf", body=payloads[i],
+                                            headers={"Content-Type": "text/plain"})
+                    if st not in (201, 204):
+                        errs.append((i, st))
+
+                threads = [threading.Thread(target=worker, args=(i,)) for i in range(N)]
+                for t in threads:
+                    t.start()
+                for t in threads:
+                    t.join()
+
+                self.assertFalse(errs, f"Errors during same-key PUTs (first 5): {errs[:5]}")
+                st, _, body = http_get(*addr, "/hot.conf")
+                self.assertEqual(st, 200)
+                self.assertIn(body.decode(), payloads)
+                leftovers = [p.name for p in Path(docroot).iterdir() if ".tmp." in p.name]
+                self.assertEqual(leftovers, [])
+
+    def test_superseded_put_answers_as_the_published_one(self):
+        """An older PUT overtaken by a newer one reports what the newer one did to the file."""
+        with temp_docroot({"k.txt": "old"}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                body = b"older"
+                with socket.create_connection(addr, timeout=5) as s:
+                    s.sendall(b"PUT /k.txt HTTP/1.1\r\nHost: x\r\nConnection: close\r\n"
+                              b"Content-Length: %d\r\n\r\n" % len(body) + body[:2])
+                    time.sleep(0.3)   # the older upload holds its ticket
+                    (Path(docroot) / "k.txt").unlink()
+                    self.assertEqual(http_request(*addr, "PUT", "/k.txt", body="newer")[0], 201)
+                    s.sendall(body[2:])
+                    reply = s.recv(4096)
+                # The file existed when the older upload arrived, but the newer one created it.
+                self.assertTrue(reply.startswith(b"HTTP/1.1 201"), reply[:40])
+                self.assertEqual(http_get(*addr, "/k.txt")[2], b"newer")
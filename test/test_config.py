@@ -0,0 +1,142 @@
+import signal
+import subprocess
+import tempfile
+import time
+import unittest
+from http.client import HTTPConnection
+from pathlib import Path
+
+from . import config
+from .utils import start_server, temp_docroot, RequiresServerBinary
+
+
+def _config_page(addr):
+    conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+    conn.request("GET", "/_config")
+    r = conn.getresponse()
+    body = r.read().decode()
+    conn.close()
+    return r.status, body
+
+
+def _wait_reloads(addr, n, deadline=3.0):
+    """/_config once the server has handled 'n' reloads (SIGHUP is asynchronous)."""
+    end = time.monotonic() + deadline
+    while True:
+        _, body = _config_page(addr)
+        if f"# reloads: {n}\n" in body or time.monotonic() > end:
+            return body
+        time.sleep(0.05)
+
+
+class TestConfig(RequiresServerBinary):
+    def setUp(self):
+        self._dir = tempfile.TemporaryDirectory(prefix="myhttp-conf-")
+        self.conf = Path(self._dir.name) / "myhttp.conf"
+
+    def tearDown(self):
+        self._dir.cleanup()
+
+    def test_file_then_flags(self):
+        self.conf.write_text("# tuning for this host\n"
+                             "workers = 3\n"
+                             "recv-buf = 16K   # small headers only\n"
+                             "idle-timeout = 5\n"
+                             "admission = fixed\n")
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            args = ["--config", str(self.conf), "--idle-timeout", "7"]
+            with start_server(docroot, extra_args=args) as (proc, addr):
+                status, body = _config_page(addr)
+                self.assertEqual(status, 200)
+                self.assertIn("workers         = 3\n", body)
+                self.assertIn("recv-buf        = 16K\n", body)
+                self.assertIn("admission       = fixed\n", body)
+                self.assertIn("idle-timeout    = 7\n", body)      # the flag wins over the file
+                self.assertIn("# workers running: 3\n", body)
+
+                # Reserved like /_stats.
+                conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                conn.request("PUT", "/_config", body=b"workers = 1\n")
+                self.assertEqual(conn.getresponse().status, 403)
+                conn.close()
+
+    def test_invalid_settings_refuse_to_start(self):
+        self.conf.write_text("workers = lots\n")
+        for args in (["--config", str(self.conf)], ["--workers", "0"], ["--no-such-knob", "1"]):
+            out = subprocess.run([str(config.MYHTTP_BIN), *args], capture_output=True, text=True, timeout=5)
+            self.assertEqual(out.returncode, 1, args)
+            self.assertIn("Error:", out.stderr)
+
+    def test_sighup_resizes_without_dropping_connections(self):
+        self.conf.write_text("workers = 2\nheader-timeout = 15\n")
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=["--config", str(self.conf)]) as (proc, addr):
+                kept = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                kept.request("GET", "/a.txt")
+                self.assertEqual(kept.getresponse().read(), b"alpha")
+
+                self.conf.write_text("workers = 5\nheader-timeout = 4\ndcache-entries = 128\n")
+                proc.send_signal(signal.SIGHUP)
+                body = _wait_reloads(addr, 1)
+                self.assertIn("# last reload: ok\n", body)
+                self.assertIn("workers         = 5\n", body)
+                self.assertIn("header-timeout  = 4\n", body)
+                self.assertIn("dcache-entries  = 128\n", body)
+
+                # The connection opened before the reload is still served.
+                kept.request("GET", "/a.txt")
+                self.assertEqual(kept.getresponse().read(), b"alpha")
+
+                # Shrinking dismisses idle workers; the busy one keeps its connection.
+                # It may be the only worker left, so ask it, not a new connection.
+                self.conf.write_text("workers = 1\nidle-timeout = 1\n")
+                proc.send_signal(signal.SIGHUP)
+                end = time.monotonic() + 3.0
+                while True:
+                    kept.request("GET", "/_config")
+                    body = kept.getresponse().read().decode()
+                    if "# reloads: 2\n" in body or time.monotonic() > end:
+                        break
+                    time.sleep(0.05)
+                self.assertIn("workers         = 1\n", body)
+                kept.request("GET", "/a.txt")
+                r = kept.getresponse()
+                self.assertEqual((r.status, r.read()), (200, b"alpha"))
+
+                # A new connection waits for that worker at most as long as the
+                # kept one may idle.
+                t0 = time.monotonic()
+                _, body = _config_page(addr)
+                self.assertLess(time.monotonic() - t0, 2.5)
+                self.assertEqual(kept.sock.recv(1), b"")   # closed by its idle deadline
+                kept.close()
+
+                end = time.monotonic() + 3.0
+                while "# workers running: 1\n" not in body and time.monotonic() < end:
+                    time.sleep(0.05)
+                    _, body = _config_page(addr)
+                self.assertIn("# workers running: 1\n", body)
+
+    def test_bad_reload_keeps_running_config(self):
+        self.conf.write_text("workers = 2\n")
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=["--config", str(self.conf)]) as (proc, addr):
+                self.conf.write_text("workers = 4\nrecv-buf = 1G\n")
+                proc.send_signal(signal.SIGHUP)
+                body = _wait_reloads(addr, 1)
+                self.assertIn("# last reload: error: ", body)
+                self.assertIn("recv-buf", body.splitlines()[3])
+                self.assertIn("workers         = 2\n", body)
+
+                # Keys that need a restart keep their value and are reported.
+                self.conf.write_text("workers = 3\nqueue-capacity = 16\n")
+                proc.send_signal(signal.SIGHUP)
+                body = _wait_reloads(addr, 2)
+                self.assertIn("# last reload: ok; restart needed for queue-capacity\n", body)
+                self.assertIn("workers         = 3\n", body)
+                self.assertIn("queue-capacity  = 1K\n", body)
+                self.assertEqual(proc.poll(), None)
+
+
+if __name__ == "__main__":
+    unittest.main()
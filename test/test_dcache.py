@@ -0,0 +1,43 @@
+import unittest
+from pathlib import Path
+from .utils import start_server, temp_docroot, http_get, http_request, eventually, RequiresServerBinary
+
+
+class TestDentryCache(RequiresServerBinary):
+    def test_negative_entry_invalidated_by_external_create(self):
+        with temp_docroot({"index.html": "ok"}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                for _ in range(3):  # warm the negative entry
+                    st, _, _ = http_get(*addr, "/wp-login.php")
+                    self.assertEqual(st, 404)
+                (Path(docroot) / "wp-login.php").write_text("now here", encoding="utf-8")
+                ok = eventually(lambda: http_get(*addr, "/wp-login.php")[0] == 200)
+                self.assertTrue(ok, "cached 404 survived an external create")
+
+    def test_negative_entry_invalidated_by_put(self):
+        with temp_docroot({}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                self.assertEqual(http_get(*addr, "/new.txt")[0], 404)
+                st, _, _ = http_request(*addr, "PUT", "/new.txt", body="fresh")
+                self.assertIn(st, (201, 204))
+                st, _, body = http_get(*addr, "/new.txt")
+                self.assertEqual(st, 200)
+                self.assertEqual(body, b"fresh")
+
+    def test_directory_picks_up_new_index(self):
+        with temp_docroot({"sub/a.txt": "a"}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                st, _, body = http_get(*addr, "/sub/")
+                self.assertEqual(st, 200)
+                self.assertIn(b"a.txt", body)  # listing
+                (Path(docroot) / "sub" / "index.html").write_text("<p>idx</p>", encoding="utf-8")
+                ok = eventually(lambda: http_get(*addr, "/sub/")[2] == b"<p>idx</p>")
+                self.assertTrue(ok, "directory listing entry not replaced by index.html")
+
+    def test_deleted_file_becomes_404(self):
+        with temp_docroot({"gone.txt": "bye"}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                self.assertEqual(http_get(*addr, "/gone.txt")[0], 200)
+                (Path(docroot) / "gone.txt").unlink()
+                ok = eventually(lambda: http_get(*addr, "/gone.txt")[0] == 404)
+                self.assertTrue(ok)
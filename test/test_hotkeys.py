@@ -0,0 +1,72 @@
+import time
+import unittest
+
+from .utils import start_server, temp_docroot, http_get, http_request, get_stats, eventually, metric, RequiresServerBinary
+
+PIN_WAIT = 4.0   # pins are made once a second
+
+
+class TestHotKeys(RequiresServerBinary):
+    def test_hot_paths_are_pinned_and_served(self):
+        big = "y" * (200 * 1024)   # held open, not in memory
+        files = {"hot.txt": "hot", "big.bin": big, "cold.txt": "cold"}
+        with temp_docroot(files) as docroot:
+            with start_server(docroot) as (proc, addr):
+                for _ in range(20):
+                    self.assertEqual(http_get(*addr, "/hot.txt")[2], b"hot")
+                    self.assertEqual(http_get(*addr, "/big.bin")[2], big.encode())
+                self.assertEqual(http_get(*addr, "/cold.txt")[2], b"cold")
+
+                def pinned():
+                    t = get_stats(*addr)
+                    return metric(t, "myhttp_hot_pinned") == 2 and t
+                text = eventually(pinned, timeout=PIN_WAIT)
+                self.assertTrue(text)
+                self.assertGreaterEqual(metric(text, "myhttp_hot_requests", 'path="/hot.txt",pinned="1"'), 20)
+                self.assertEqual(metric(text, "myhttp_hot_pinned_bytes"), 3)
+                self.assertNotIn('path="/cold.txt"', text)   # asked for once
+
+                hits = metric(text, "myhttp_hot_hits_total")
+                self.assertEqual(http_get(*addr, "/hot.txt")[2], b"hot")
+                self.assertEqual(http_get(*addr, "/big.bin")[2], big.encode())
+                self.assertEqual(metric(get_stats(*addr), "myhttp_hot_hits_total"), hits + 2)
+
+    def test_overwrite_is_seen_at_once(self):
+        with temp_docroot({"hot.txt": "old"}) as docroot:
+            with start_server(docroot) as (proc, addr):
+                for _ in range(20):
+                    http_get(*addr, "/hot.txt")
+                self.assertTrue(eventually(lambda: metric(get_stats(*addr), "myhttp_hot_pinned") == 1, timeout=PIN_WAIT))
+
+                self.assertLess(http_request(*addr, "PUT", "/hot.txt", body="new!")[0], 300)
+                self.assertEqual(http_get(*addr, "/hot.txt")[2], b"new!")
+                self.assertEqual(http_request(*addr, "PATCH", "/hot.txt", body="+")[0], 204)
+                self.assertEqual(http_get(*addr, "/hot.txt")[2], b"new!+")
+
+    def test_in_place_edit_drops_the_pin(self):
+        with temp_docroot({"hot.txt": "old"}) as docroot:
+            with start_server(docroot) as (proc, addr):
+                for _ in range(20):
+                    http_get(*addr, "/hot.txt")
+                self.assertTrue(eventually(lambda: metric(get_stats(*addr), "myhttp_hot_pinned") == 1, timeout=PIN_WAIT))
+
+                edits = metric(get_stats(*addr), "myhttp_hot_edits_total")
+                with open(docroot / "hot.txt", "r+") as f:   # same inode, no rename
+                    f.write("new")
+                # Once the watcher has the close, the pin is not used again before the tick re-checks it.
+                self.assertTrue(eventually(lambda: metric(get_stats(*addr), "myhttp_hot_edits_total") == edits + 1))
+                self.assertEqual(http_get(*addr, "/hot.txt")[2], b"new")
+
+    def test_disabled(self):
+        with temp_docroot({"hot.txt": "hot"}) as docroot:
+            with start_server(docroot, extra_args=["--hot-keys", "0"]) as (proc, addr):
+                for _ in range(20):
+                    self.assertEqual(http_get(*addr, "/hot.txt")[2], b"hot")
+                time.sleep(1.5)
+                text = get_stats(*addr)
+                self.assertEqual(metric(text, "myhttp_hot_pinned"), 0)
+                self.assertNotIn("myhttp_hot_requests{", text)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,117 @@
+import os
+import shutil
+import socket
+import subprocess
+import unittest
+from pathlib import Path
+
+from . import config
+from .h2client import H2Connection, DATA
+from .utils import start_server, temp_docroot, http_get, RequiresServerBinary
+
+
+def _curl_has_http2() -> bool:
+    curl = shutil.which("curl")
+    if not curl:
+        return False
+    out = subprocess.run([curl, "-V"], capture_output=True, text=True).stdout
+    return "HTTP2" in out
+
+
+class TestHttp2(RequiresServerBinary):
+    def test_prior_knowledge_multiplexed_streams(self):
+        big1, big2 = os.urandom(200 * 1024), os.urandom(150 * 1024)
+        files = {"a.txt": "alpha", "big1.bin": big1, "big2.bin": big2, "sub/x.txt": "x"}
+        with temp_docroot(files) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                c = H2Connection(*addr, timeout=config.REQ_TIMEOUT)
+                s1 = c.request("GET", "/big1.bin")
+                s2 = c.request("GET", "/big2.bin")
+                s3 = c.request("GET", "/a.txt")
+                s4 = c.request("GET", "/missing")
+                s5 = c.request("GET", "/sub/")
+                r1, r2, r3, r4, r5 = c.wait(s1, s2, s3, s4, s5)
+
+                self.assertEqual((r1.status, r1.body), (200, big1))
+                self.assertEqual((r2.status, r2.body), (200, big2))
+                self.assertEqual((r3.status, r3.body), (200, b"alpha"))
+                self.assertTrue(r3.headers["content-type"].startswith("text/plain"))
+                self.assertEqual(r4.status, 404)
+                self.assertEqual(r5.status, 200)
+                self.assertIn(b'href="/sub/x.txt"', r5.body)
+
+                # The two large bodies were interleaved, not sent back to back.
+                order = [sid for (t, _, sid, n) in c.frames if t == DATA and n and sid in (s1, s2)]
+                first_done = min(len(order) - order[::-1].index(s1), len(order) - order[::-1].index(s2))
+                self.assertEqual({s1, s2}, set(order[:first_done]))
+                c.close()
+
+    def test_stream_flow_control(self):
+        body = os.urandom(5000)
+        with temp_docroot({"f.bin": body}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                c = H2Connection(*addr, timeout=config.REQ_TIMEOUT, window=1000, auto_window=False)
+                sid = c.request("GET", "/f.bin")
+                r = c.responses[sid]
+                while len(r.body) < 1000:
+                    c.read_frame()
+                self.assertEqual(len(r.body), 1000)
+
+                # Window exhausted: nothing more until we open it.
+                c.sock.settimeout(0.3)
+                with self.assertRaises(socket.timeout):
+                    while True:
+                        t, _, s, _ = c.read_frame()
+                        self.assertNotEqual((t, s), (DATA, sid))
+                c.sock.settimeout(config.REQ_TIMEOUT)
+
+                c.window_update(sid, 4000)
+                c.window_update(0, 4000)
+                c.wait(sid)
+                self.assertEqual(r.body, body)
+                c.close()
+
+    def test_uploads_reuse_fs_handlers(self):
+        data = os.urandom(100 * 1024)
+        with temp_docroot({}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                c = H2Connection(*addr, timeout=config.REQ_TIMEOUT)
+                (r,) = c.wait(c.request("PUT", "/up.bin", body=data))
+                self.assertEqual(r.status, 201)
+                (r,) = c.wait(c.request("PATCH", "/up.bin", body=b"tail"))
+                self.assertEqual(r.status, 204)
+                (r,) = c.wait(c.request("PUT", "/_stats", body=b"no"))
+                self.assertEqual(r.status, 403)
+                (r,) = c.wait(c.request("GET", "/up.bin"))
+                self.assertEqual(r.body, data + b"tail")
+                c.close()
+                self.assertEqual((Path(docroot) / "up.bin").read_bytes(), data + b"tail")
+
+    def test_upgrade_from_http1(self):
+        with temp_docroot({"a.txt": "alpha", "b.txt": "beta"}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                c = H2Connection(*addr, timeout=config.REQ_TIMEOUT, upgrade_path="/a.txt")
+                (r1,) = c.wait(1)
+                self.assertEqual((r1.status, r1.body), (200, b"alpha"))
+                (r3,) = c.wait(c.request("GET", "/b.txt"))
+                self.assertEqual((r3.status, r3.body), (200, b"beta"))
+                c.close()
+
+                # Plain HTTP/1.1 is unaffected.
+                self.assertEqual(http_get(*addr, "/b.txt")[2], b"beta")
+
+    @unittest.skipUnless(_curl_has_http2(), "curl without HTTP/2 support")
+    def test_curl_prior_knowledge(self):
+        """curl (nghttp2) Huffman-codes its request headers. One transfer per
+        invocation: curl 7.88 fails reusing a prior-knowledge connection."""
+        with temp_docroot({"dir/page.html": "<p>hi</p>"}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                url = f"http://{addr[0]}:{addr[1]}/dir/page.html"
+                for _ in range(2):
+                    out = subprocess.run(["curl", "-s", "--http2-prior-knowledge", "-w", "%{http_version}", url],
+                                         capture_output=True, timeout=10)
+                    self.assertEqual(out.returncode, 0)
+                    self.assertEqual(out.stdout, b"<p>hi</p>2")
+
+if __name__ == "__main__":
+    unittest.main()
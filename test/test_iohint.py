@@ -0,0 +1,68 @@
+import os
+import unittest
+from pathlib import Path
+
+from . import config
+from .h2client import H2Connection
+from .utils import start_server, temp_docroot, http_get, http_request, get_stat, eventually, RequiresServerBinary
+
+MiB = 1024 * 1024
+
+
+class TestIoHints(RequiresServerBinary):
+    ARGS = ["--readahead", "1M", "--drop-behind", "2M", "--write-behind", "1M"]
+
+    def test_large_downloads_read_ahead_and_one_offs_dropped(self):
+        big, mid = os.urandom(3 * MiB), os.urandom(MiB + 1)
+        with temp_docroot({"big.bin": big, "mid.bin": mid, "small.txt": "s"}) as docroot:
+            with start_server(Path(docroot), extra_args=self.ARGS) as (proc, addr):
+                self.assertEqual(http_get(*addr, "/big.bin")[2], big)
+                # The whole file was requested ahead, a window at a time; once streamed it went.
+                self.assertEqual(get_stat(*addr, "myhttp_io_readahead_bytes_total"), 3 * MiB)
+                self.assertTrue(eventually(lambda: get_stat(*addr, "myhttp_io_dropped_files_total") == 1))
+
+                # Asked for again soon after: no longer a one-off, so it stays cached.
+                self.assertEqual(http_get(*addr, "/big.bin")[2], big)
+                self.assertEqual(get_stat(*addr, "myhttp_io_dropped_files_total"), 1)
+
+                # Above the window but below drop-behind: read ahead, never dropped.
+                self.assertEqual(http_get(*addr, "/mid.bin")[2], mid)
+                self.assertEqual(http_get(*addr, "/small.txt")[2], b"s")
+                self.assertEqual(get_stat(*addr, "myhttp_io_readahead_bytes_total"), 6 * MiB + MiB + 1)
+                self.assertEqual(get_stat(*addr, "myhttp_io_dropped_bytes_total"), 3 * MiB)
+
+    def test_http2_streams_read_ahead(self):
+        big = os.urandom(3 * MiB)
+        with temp_docroot({"big.bin": big}) as docroot:
+            with start_server(Path(docroot), extra_args=self.ARGS) as (proc, addr):
+                c = H2Connection(*addr, timeout=config.REQ_TIMEOUT)
+                r, = c.wait(c.request("GET", "/big.bin"))
+                self.assertEqual((r.status, r.body), (200, big))
+                c.close()
+                self.assertEqual(get_stat(*addr, "myhttp_io_readahead_bytes_total"), 3 * MiB)
+                self.assertTrue(eventually(lambda: get_stat(*addr, "myhttp_io_dropped_files_total") == 1))
+
+    def test_upload_write_behind(self):
+        body = os.urandom(3 * MiB + 12345)
+        with temp_docroot({}) as docroot:
+            with start_server(Path(docroot), extra_args=self.ARGS) as (proc, addr):
+                self.assertEqual(http_request(*addr, "PUT", "/up.bin", body=body)[0], 201)
+                self.assertEqual((Path(docroot) / "up.bin").read_bytes(), body)
+                self.assertGreaterEqual(get_stat(*addr, "myhttp_io_writebehind_bytes_total"), 2 * MiB)
+                self.assertEqual(http_request(*addr, "PATCH", "/up.bin", body=body)[0], 204)
+                self.assertEqual((Path(docroot) / "up.bin").read_bytes(), body + body)
+                self.assertGreaterEqual(get_stat(*addr, "myhttp_io_writebehind_bytes_total"), 4 * MiB)
+
+    def test_disabled(self):
+        big = os.urandom(3 * MiB)
+        with temp_docroot({"big.bin": big}) as docroot:
+            args = ["--readahead", "0", "--drop-behind", "0", "--write-behind", "0"]
+            with start_server(Path(docroot), extra_args=args) as (proc, addr):
+                self.assertEqual(http_get(*addr, "/big.bin")[2], big)
+                self.assertEqual(http_request(*addr, "PUT", "/up.bin", body=big)[0], 201)
+                for name in ("readahead_bytes", "dropped_files", "writebehind_bytes"):
+                    self.assertEqual(get_stat(*addr, f"myhttp_io_{name}_total"), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,86 @@
+import socket
+import time
+import unittest
+from http.client import HTTPConnection
+
+from . import config
+from .utils import start_server, temp_docroot, http_get, http_request, get_stat, RequiresServerBinary
+
+
+IOPOOL_THREADS = 4   # iopool.h
+
+
+class TestIoPool(RequiresServerBinary):
+    def test_disk_bound_requests_go_to_the_pool(self):
+        with temp_docroot({"a.txt": "alpha", "sub/b.txt": "beta"}) as docroot:
+            with start_server(docroot, extra_args=["--io-workers", "2"]) as (proc, addr):
+                self.assertEqual(get_stat(*addr, "myhttp_iopool_threads"), 2)
+                self.assertEqual(get_stat(*addr, "myhttp_iopool_tasks_total"), 0)
+
+                # One keep-alive connection: each request moves over only if it needs the disk.
+                conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                try:
+                    for method, path, body, want in [
+                        ("GET", "/a.txt", None, b"alpha"),      # cold: path walk and open
+                        ("GET", "/a.txt", None, b"alpha"),      # hot: stays on the worker
+                        ("PUT", "/c.txt", b"gamma", None),     # temp file, then fsync and rename
+                        ("GET", "/c.txt", None, b"gamma"),
+                    ]:
+                        conn.request(method, path, body=body)
+                        r = conn.getresponse()
+                        data = r.read()
+                        self.assertLess(r.status, 300)
+                        if want is not None:
+                            self.assertEqual(data, want)
+                finally:
+                    conn.close()
+                self.assertEqual(get_stat(*addr, "myhttp_iopool_tasks_total"), 4)
+
+                status, _, body = http_get(*addr, "/sub/")   # listing
+                self.assertEqual(status, 200)
+                self.assertIn(b"b.txt", body)
+                self.assertEqual(get_stat(*addr, "myhttp_iopool_tasks_total"), 5)
+
+    def test_stalled_uploads_leave_the_pool_free(self):
+        with temp_docroot({"a.txt": "alpha", "sub/b.txt": "beta"}) as docroot:
+            args = ["--workers", str(IOPOOL_THREADS + 1), "--io-workers", str(IOPOOL_THREADS),
+                    "--body-timeout", "10"]
+            with start_server(docroot, extra_args=args) as (proc, addr):
+                # As many uploads as there are I/O threads, each stopping halfway:
+                # their bodies are read on network workers...
+                slow = []
+                try:
+                    for i in range(IOPOOL_THREADS):
+                        s = socket.create_connection(addr, timeout=config.REQ_TIMEOUT)
+                        s.sendall(b"PUT /slow%d.txt HTTP/1.1\r\nHost: x\r\n"
+                                  b"Content-Length: 10\r\n\r\nhello" % i)
+                        slow.append(s)
+                    time.sleep(0.2)
+                    # ...so the pool is free for a cold GET and a listing.
+                    t0 = time.monotonic()
+                    self.assertEqual(http_get(*addr, "/a.txt")[2], b"alpha")
+                    self.assertIn(b"b.txt", http_get(*addr, "/sub/")[2])
+                    self.assertLess(time.monotonic() - t0, 1.0)
+                    self.assertEqual(get_stat(*addr, "myhttp_iopool_busy"), 0)
+
+                    for s in slow:
+                        s.sendall(b"world")
+                        self.assertTrue(s.recv(4096).startswith(b"HTTP/1.1 201 "))
+                finally:
+                    for s in slow:
+                        s.close()
+                for i in range(IOPOOL_THREADS):
+                    self.assertEqual(http_get(*addr, "/slow%d.txt" % i)[2], b"helloworld")
+
+    def test_without_pool_workers_do_the_io(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=["--io-workers", "0"]) as (proc, addr):
+                self.assertEqual(http_get(*addr, "/a.txt")[2], b"alpha")
+                self.assertLess(http_request(*addr, "PUT", "/b.txt", body="beta")[0], 300)
+                self.assertEqual(http_get(*addr, "/b.txt")[2], b"beta")
+                self.assertEqual(get_stat(*addr, "myhttp_iopool_threads"), 0)
+                self.assertEqual(get_stat(*addr, "myhttp_iopool_tasks_total"), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
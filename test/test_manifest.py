@@ -0,0 +1,98 @@
+import os
+import shutil
+import tempfile
+import unittest
+from pathlib import Path
+
+from .utils import start_server, temp_docroot, http_get, get_stat, eventually, RequiresServerBinary
+
+
+class TestManifest(RequiresServerBinary):
+    def setUp(self):
+        self._dir = tempfile.TemporaryDirectory(prefix="myhttp-mf-")
+        self.manifest = Path(self._dir.name) / "docroot.manifest"
+        self.outside = Path(self._dir.name) / "outside"
+        self.outside.mkdir()
+        (self.outside / "x.txt").write_text("secret")
+
+    def tearDown(self):
+        self._dir.cleanup()
+
+    def _args(self):
+        return ["--manifest", str(self.manifest)]
+
+    def test_built_then_mapped_and_checked_on_restart(self):
+        files = {"index.html": "home", "a.txt": "alpha", "b.txt": "beta", "c.txt": "gamma",
+                 "sub/x.txt": "inside", "deep/er/y.txt": "why"}
+        with temp_docroot(files) as docroot:
+            with start_server(docroot, extra_args=self._args()) as (proc, addr):
+                self.assertTrue(eventually(lambda: get_stat(*addr, "myhttp_manifest_entries")))
+                self.assertEqual(get_stat(*addr, "myhttp_manifest_builds_total"), 1)
+            self.assertEqual(self.manifest.read_bytes()[:8], b"MHMANIF\0")
+
+            # Changed while the server was down.
+            (docroot / "b.txt").write_text("beta, longer now")
+            (docroot / "c.txt").unlink()
+            (docroot / "d.txt").write_text("delta")
+            shutil.rmtree(docroot / "sub")
+            os.symlink(self.outside, docroot / "sub")
+
+            with start_server(docroot, extra_args=self._args()) as (proc, addr):
+                # Mapped at startup, not recrawled.
+                self.assertEqual(get_stat(*addr, "myhttp_manifest_entries"), 10)
+                self.assertEqual(get_stat(*addr, "myhttp_manifest_builds_total"), 0)
+
+                self.assertEqual(http_get(*addr, "/a.txt")[2], b"alpha")
+                self.assertEqual(http_get(*addr, "/deep/er/y.txt")[2], b"why")
+                self.assertEqual(http_get(*addr, "/")[2], b"home")
+                self.assertGreaterEqual(get_stat(*addr, "myhttp_manifest_hits_total"), 3)
+
+                self.assertEqual(http_get(*addr, "/b.txt")[2], b"beta, longer now")
+                self.assertEqual(http_get(*addr, "/c.txt")[0], 404)
+                self.assertEqual(http_get(*addr, "/d.txt")[2], b"delta")
+                self.assertEqual(http_get(*addr, "/sub/x.txt")[0], 403)
+                self.assertGreaterEqual(get_stat(*addr, "myhttp_manifest_stale"), 2)
+
+    def test_directory_swapped_while_serving(self):
+        with temp_docroot({"sub/x.txt": "inside", "a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=self._args()) as (proc, addr):
+                self.assertTrue(eventually(lambda: get_stat(*addr, "myhttp_manifest_entries")))
+            with start_server(docroot, extra_args=self._args()) as (proc, addr):
+                self.assertEqual(http_get(*addr, "/sub/x.txt")[2], b"inside")
+                self.assertEqual(get_stat(*addr, "myhttp_manifest_hits_total"), 1)
+
+                shutil.rmtree(docroot / "sub")
+                os.symlink(self.outside, docroot / "sub")
+                self.assertTrue(eventually(lambda: http_get(*addr, "/sub/x.txt")[0] == 403))
+                # A change elsewhere drops the dcache; a.txt still comes from the manifest.
+                self.assertEqual(http_get(*addr, "/a.txt")[2], b"alpha")
+                self.assertEqual(get_stat(*addr, "myhttp_manifest_hits_total"), 2)
+
+    def test_recrawled_once_changes_pile_up(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=self._args()) as (proc, addr):
+                self.assertTrue(eventually(lambda: get_stat(*addr, "myhttp_manifest_entries") == 2))
+                for i in range(20):
+                    (docroot / f"new{i}.txt").write_text(str(i))
+                # Past the threshold (16 + 1/8 of the entries) the tree is crawled again.
+                self.assertTrue(eventually(lambda: get_stat(*addr, "myhttp_manifest_builds_total") == 2))
+                self.assertGreater(get_stat(*addr, "myhttp_manifest_entries"), 2 + 16)
+                self.assertEqual(http_get(*addr, "/new7.txt")[2], b"7")
+
+                # A new name counts once, however many events it gets.
+                edits = get_stat(*addr, "myhttp_hot_edits_total")
+                late = docroot / "late.txt"
+                late.write_text("late")
+                for i in range(40):
+                    os.chmod(late, 0o600 if i % 2 else 0o644)
+                (docroot / "marker.txt").write_text("m")
+                # The watcher takes events in order: once it has the marker's close, it has late's.
+                self.assertTrue(eventually(lambda: get_stat(*addr, "myhttp_hot_edits_total") == edits + 2))
+                # At most every name the recrawl missed: the root, a.txt, 20 + 2 files.
+                self.assertLessEqual(get_stat(*addr, "myhttp_manifest_stale"),
+                                     24 - get_stat(*addr, "myhttp_manifest_entries"))
+                self.assertEqual(get_stat(*addr, "myhttp_manifest_builds_total"), 2)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,74 @@
+import socket
+import unittest
+from pathlib import Path
+
+from . import config
+from .utils import start_server, temp_docroot, RequiresServerBinary
+
+
+def _read_all(s: socket.socket) -> bytes:
+    chunks = []
+    while True:
+        data = s.recv(65536)
+        if not data:
+            return b"".join(chunks)
+        chunks.append(data)
+
+
+def _split_responses(raw: bytes):
+    """Split a stream of Content-Length framed responses into (status, body)."""
+    out = []
+    while raw:
+        head, sep, rest = raw.partition(b"\r\n\r\n")
+        if not sep:
+            break
+        lines = head.decode("iso-8859-1").split("\r\n")
+        status = int(lines[0].split(" ", 2)[1])
+        clen = 0
+        for line in lines[1:]:
+            k, _, v = line.partition(":")
+            if k.strip().lower() == "content-length":
+                clen = int(v.strip())
+        out.append((status, rest[:clen]))
+        raw = rest[clen:]
+    return out
+
+
+class TestPipelining(RequiresServerBinary):
+    def test_mixed_pipeline_keeps_order(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                reqs = (
+                    b"GET /a.txt HTTP/1.1\r\nHost: x\r\n\r\n"
+                    b"PUT /b.txt HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\n\r\nbravo"
+                    b"GET /b.txt HTTP/1.1\r\nHost: x\r\n\r\n"
+                    b"GET /missing.txt HTTP/1.1\r\nHost: x\r\n\r\n"
+                    b"GET /a.txt HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n"
+                )
+                with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as s:
+                    s.sendall(reqs)
+                    resps = _split_responses(_read_all(s))
+
+                self.assertEqual([st for st, _ in resps], [200, 201, 200, 404, 200])
+                self.assertEqual(resps[0][1], b"alpha")
+                self.assertEqual(resps[2][1], b"bravo")
+                self.assertEqual(resps[4][1], b"alpha")
+
+    def test_many_small_gets_in_one_write(self):
+        files = {f"f{i}.txt": f"file-{i}" for i in range(100)}
+        with temp_docroot(files) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                reqs = b"".join(
+                    f"GET /f{i}.txt HTTP/1.1\r\nHost: x\r\n\r\n".encode() for i in range(100)
+                ) + b"GET /f0.txt HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n"
+                with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as s:
+                    s.sendall(reqs)
+                    resps = _split_responses(_read_all(s))
+
+                self.assertEqual(len(resps), 101)
+                for i in range(100):
+                    self.assertEqual(resps[i], (200, f"file-{i}".encode()))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,32 @@
+import unittest
+from http.client import HTTPConnection
+
+from . import config
+from .utils import start_server, temp_docroot, RequiresServerBinary
+
+
+class TestPlacement(RequiresServerBinary):
+    def _check(self, args):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=args) as (proc, addr):
+                for _ in range(3):       # fresh connections, whichever listener gets them
+                    conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                    conn.request("GET", "/a.txt")
+                    r = conn.getresponse()
+                    self.assertEqual((r.status, r.read()), (200, b"alpha"))
+                    conn.close()
+                conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                conn.request("GET", "/_stats")
+                stats = conn.getresponse().read()
+                conn.close()
+                self.assertIn(b"myhttp_workq_capacity ", stats)
+
+    def test_pinned_workers(self):
+        self._check(["--pin-workers"])
+
+    def test_reuseport_listeners(self):
+        self._check(["--reuseport"])
+
+
+if __name__ == "__main__":
+    unittest.main()
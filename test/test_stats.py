@@ -0,0 +1,43 @@
+import unittest, re
+from pathlib import Path
+from .utils import start_server, temp_docroot, http_get, http_request, metric, RequiresServerBinary
+
+
+class TestStatsEndpoint(RequiresServerBinary):
+    def test_prometheus_counters(self):
+        with temp_docroot({"a.txt": "hello"}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                for _ in range(5):
+                    self.assertEqual(http_get(*addr, "/a.txt")[0], 200)
+                for _ in range(3):
+                    self.assertEqual(http_get(*addr, "/missing")[0], 404)
+                st, _ , _ = http_request(*addr, "PUT", "/b.txt", body="xyz")
+                self.assertIn(st, (201, 204))
+
+                st, headers, body = http_get(*addr, "/_stats")
+                self.assertEqual(st, 200)
+                self.assertTrue(headers.get("Content-Type", "").startswith("text/plain"))
+                text = body.decode()
+
+                self.assertEqual(metric(text, "myhttp_requests_total", 'method="GET",class="2xx"'), 5)
+                self.assertEqual(metric(text, "myhttp_requests_total", 'method="GET",class="4xx"'), 3)
+                self.assertEqual(metric(text, "myhttp_requests_total", 'method="PUT",class="2xx"'), 1)
+                self.assertEqual(metric(text, "myhttp_request_duration_seconds_count",
+                                        'method="GET",class="2xx"'), 5)
+                self.assertGreater(metric(text, "myhttp_bytes_sent_total"), 0)
+                self.assertGreater(metric(text, "myhttp_bytes_received_total"), 0)
+                self.assertGreaterEqual(metric(text, "myhttp_workq_wait_seconds_count"), 9)
+                self.assertGreaterEqual(metric(text, "myhttp_plock_wait_seconds_count"), 1)
+                self.assertIn("myhttp_workq_depth", text)
+
+                # Every histogram's +Inf bucket equals its _count
+                for m in re.finditer(r'^(\w+)_bucket\{(.*?),?le="\+Inf"\} (\d+)$', text, re.M):
+                    name, labels, inf = m.group(1), m.group(2).rstrip(","), float(m.group(3))
+                    self.assertEqual(inf, metric(text, name + "_count", labels))
+
+    def test_reserved_path_not_writable(self):
+        with temp_docroot({}) as docroot:
+            with start_server(Path(docroot)) as (proc, addr):
+                st, _, _ = http_request(*addr, "PUT", "/_stats", body="nope")
+                self.assertEqual(st, 403)
+                self.assertFalse((Path(docroot) / "_stats").exists())
@@ -0,0 +1,120 @@
+import socket
+import time
+import unittest
+from http.client import HTTPConnection
+
+from . import config
+from .utils import start_server, temp_docroot, RequiresServerBinary
+
+# Short deadlines so the tests run quickly; the gaps are well above a timer tick.
+TIMEOUT_ARGS = ["--idle-timeout", "0.6", "--header-timeout", "0.4",
+                "--body-timeout", "0.4", "--write-timeout", "0.4"]
+
+
+def _recv_all(s, limit=5.0):
+    """Read until the server closes (or 'limit' seconds pass)."""
+    s.settimeout(limit)
+    chunks = []
+    try:
+        while True:
+            b = s.recv(65536)
+            if not b:
+                break
+            chunks.append(b)
+    except (ConnectionResetError, socket.timeout):
+        pass
+    return b"".join(chunks)
+
+
+class TestTimeouts(RequiresServerBinary):
+    def _stats(self, addr):
+        conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+        conn.request("GET", "/_stats")
+        body = conn.getresponse().read()
+        conn.close()
+        return body
+
+    def test_slow_headers_get_408(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=TIMEOUT_ARGS) as (proc, addr):
+                with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as s:
+                    # A byte at a time, never finishing the header block: the
+                    # header deadline runs from the start, not the last byte.
+                    t0 = time.monotonic()
+                    for b in b"GET /a.txt HTTP/1.1\r\nHost":
+                        try:
+                            s.sendall(bytes([b]))
+                        except (BrokenPipeError, ConnectionResetError):
+                            break
+                        time.sleep(0.05)
+                    data = _recv_all(s)
+                    self.assertLess(time.monotonic() - t0, 3.0)
+                self.assertTrue(data.startswith(b"HTTP/1.1 408 "), data)
+                self.assertIn(b'myhttp_timeouts_total{kind="header"} 1', self._stats(addr))
+
+    def test_idle_keepalive_is_closed(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=TIMEOUT_ARGS) as (proc, addr):
+                with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as s:
+                    s.sendall(b"GET /a.txt HTTP/1.1\r\nHost: x\r\n\r\n")
+                    first = s.recv(4096)
+                    self.assertTrue(first.startswith(b"HTTP/1.1 200 "), first)
+                    # Longer than the header deadline, shorter than the idle one.
+                    time.sleep(0.45)
+                    s.sendall(b"GET /a.txt HTTP/1.1\r\nHost: x\r\n\r\n")
+                    second = s.recv(4096)
+                    self.assertTrue(second.startswith(b"HTTP/1.1 200 "), second)
+                    t0 = time.monotonic()
+                    self.assertEqual(_recv_all(s), b"")      # closed without a response
+                    self.assertLess(time.monotonic() - t0, 3.0)
+                self.assertIn(b'myhttp_timeouts_total{kind="idle"} 1', self._stats(addr))
+
+    def test_stalled_upload_is_abandoned(self):
+        with temp_docroot({}) as docroot:
+            with start_server(docroot, extra_args=TIMEOUT_ARGS) as (proc, addr):
+                with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as s:
+                    s.sendall(b"PUT /up.bin HTTP/1.1\r\nHost: x\r\nContent-Length: 100000\r\n\r\n")
+                    s.sendall(b"x" * 1000)
+                    time.sleep(0.2)
+                    s.sendall(b"x" * 1000)           # progress keeps it alive...
+                    data = _recv_all(s)              # ...until the body stalls
+                self.assertTrue(data.startswith(b"HTTP/1.1 408 "), data)
+
+                # No temp file left behind, and the path is free for the next writer.
+                self.assertEqual([p.name for p in docroot.iterdir()], [])
+                conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                conn.request("PUT", "/up.bin", body=b"done")
+                r = conn.getresponse()
+                r.read()
+                conn.close()
+                self.assertEqual(r.status, 201)
+                self.assertEqual((docroot / "up.bin").read_bytes(), b"done")
+                self.assertIn(b'myhttp_timeouts_total{kind="body"} 1', self._stats(addr))
+
+    def test_stalled_reader_is_dropped(self):
+        big = b"z" * (32 * 1024 * 1024)            # far more than the socket buffers hold
+        with temp_docroot({"big.bin": big}) as docroot:
+            with start_server(docroot, extra_args=TIMEOUT_ARGS) as (proc, addr):
+                with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as s:
+                    s.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 64 * 1024)
+                    s.sendall(b"GET /big.bin HTTP/1.1\r\nHost: x\r\n\r\n")
+                    time.sleep(1.5)                  # never read: the send stalls
+                    got = len(_recv_all(s))
+                self.assertLess(got, len(big))
+                self.assertIn(b'myhttp_timeouts_total{kind="write"} 1', self._stats(addr))
+
+    def test_disabled_timeouts_keep_connection(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            args = ["--idle-timeout", "0", "--header-timeout", "0", "--body-timeout", "0", "--write-timeout", "0"]
+            with start_server(docroot, extra_args=args) as (proc, addr):
+                conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                conn.request("GET", "/a.txt")
+                self.assertEqual(conn.getresponse().read(), b"alpha")
+                time.sleep(0.8)
+                conn.request("GET", "/a.txt")
+                self.assertEqual(conn.getresponse().read(), b"alpha")
+                conn.close()
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,127 @@
+import os
+import shutil
+import socket
+import ssl
+import subprocess
+import tempfile
+import unittest
+from http.client import HTTPSConnection
+from pathlib import Path
+
+from . import config
+from .utils import start_server, temp_docroot, RequiresServerBinary
+
+
+def _make_cert(d: Path):
+    """Self-signed P-256 certificate for 127.0.0.1."""
+    cert, key = d / "cert.pem", d / "key.pem"
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:P-256",
+                    "-nodes", "-days", "1", "-subj", "/CN=localhost", "-addext", "subjectAltName=IP:127.0.0.1",
+                    "-keyout", str(key), "-out", str(cert)], check=True, capture_output=True)
+    return cert, key
+
+
+@unittest.skipUnless(shutil.which("openssl"), "openssl CLI needed to make a test certificate")
+class TestTls(RequiresServerBinary):
+    @classmethod
+    def setUpClass(cls):
+        super().setUpClass()
+        cls.certdir = Path(tempfile.mkdtemp(prefix="myhttp-tls-"))
+        cls.cert, cls.key = _make_cert(cls.certdir)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.certdir, ignore_errors=True)
+
+    def _server(self, docroot):
+        return start_server(Path(docroot), extra_args=["--tls-cert", str(self.cert), "--tls-key", str(self.key)])
+
+    def _ctx(self, version=None):
+        ctx = ssl.create_default_context(cafile=str(self.cert))
+        if version:
+            ctx.minimum_version = ctx.maximum_version = version
+        return ctx
+
+    def _get(self, conn, path):
+        conn.request("GET", path)
+        r = conn.getresponse()
+        return r.status, r.read()
+
+    def test_keepalive_files_and_uploads(self):
+        big = os.urandom(2 * 1024 * 1024)     # sendfile path (or its userspace fallback)
+        with temp_docroot({"a.txt": "alpha", "big.bin": big, "d/x.txt": "x"}) as docroot:
+            with self._server(docroot) as (proc, addr):
+                conn = HTTPSConnection(*addr, context=self._ctx(), timeout=config.REQ_TIMEOUT)
+                self.assertEqual(self._get(conn, "/a.txt"), (200, b"alpha"))
+                self.assertEqual(self._get(conn, "/big.bin"), (200, big))
+                status, body = self._get(conn, "/d/")
+                self.assertEqual(status, 200)
+                self.assertIn(b'href="/d/x.txt"', body)
+                conn.close()
+
+                data = os.urandom(300 * 1024)   # larger than what arrives with the headers
+                conn = HTTPSConnection(*addr, context=self._ctx(), timeout=config.REQ_TIMEOUT)
+                conn.request("PUT", "/up.bin", body=data)
+                r = conn.getresponse()
+                r.read()
+                self.assertEqual(r.status, 201)
+                conn.request("PATCH", "/up.bin", body=b"tail")
+                r = conn.getresponse()
+                r.read()
+                self.assertEqual(r.status, 204)
+                self.assertEqual(self._get(conn, "/up.bin"), (200, data + b"tail"))
+                conn.close()
+
+    def test_plaintext_client_is_dropped(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with self._server(docroot) as (proc, addr):
+                with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as s:
+                    s.sendall(b"GET /a.txt HTTP/1.1\r\nHost: x\r\n\r\n")
+                    try:
+                        data = s.recv(4096)      # a TLS alert, or nothing
+                    except ConnectionResetError:
+                        data = b""
+                    self.assertNotIn(b"alpha", data)
+
+                # The worker is free again.
+                conn = HTTPSConnection(*addr, context=self._ctx(), timeout=config.REQ_TIMEOUT)
+                self.assertEqual(self._get(conn, "/a.txt"), (200, b"alpha"))
+                conn.close()
+
+    def test_session_resumption(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with self._server(docroot) as (proc, addr):
+                for version in (ssl.TLSVersion.TLSv1_2, ssl.TLSVersion.TLSv1_3):
+                    ctx = self._ctx(version)
+                    conn = HTTPSConnection(*addr, context=ctx, timeout=config.REQ_TIMEOUT)
+                    self._get(conn, "/a.txt")   # TLS 1.3 tickets arrive after the handshake
+                    session = conn.sock.session
+                    self.assertFalse(conn.sock.session_reused)
+                    conn.close()
+
+                    with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as raw:
+                        with ctx.wrap_socket(raw, server_hostname="127.0.0.1", session=session) as s:
+                            self.assertTrue(s.session_reused, version)
+
+                conn = HTTPSConnection(*addr, context=self._ctx(), timeout=config.REQ_TIMEOUT)
+                status, body = self._get(conn, "/_stats")
+                conn.close()
+                self.assertEqual(status, 200)
+                self.assertIn(b'myhttp_tls_handshakes_total{type="resumed"} 2', body)
+                self.assertIn(b'myhttp_tls_ktls_sessions_total{dir="tx"}', body)
+
+    def test_alpn_h2(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with self._server(docroot) as (proc, addr):
+                ctx = self._ctx()
+                ctx.set_alpn_protocols(["h2", "http/1.1"])
+                with socket.create_connection(addr, timeout=config.REQ_TIMEOUT) as raw:
+                    with ctx.wrap_socket(raw, server_hostname="127.0.0.1") as s:
+                        self.assertEqual(s.selected_alpn_protocol(), "h2")
+                        s.sendall(b"PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n" + b"\x00\x00\x00\x04\x00\x00\x00\x00\x00")
+                        hdr = s.recv(9)
+                        self.assertEqual(hdr[3], 0x4)   # server SETTINGS
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,48 @@
+import json
+import unittest
+
+from .utils import start_server, temp_docroot, http_get, http_request, get_stat, RequiresServerBinary
+
+
+def _spans(addr):
+    status, headers, body = http_get(*addr, "/_trace")
+    assert status == 200, status
+    events = json.loads(body)["traceEvents"]
+    return [e for e in events if e["ph"] == "X"]
+
+
+class TestTrace(RequiresServerBinary):
+    def test_sampled_requests_export_their_phases(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=["--trace-sample", "1"]) as (proc, addr):
+                self.assertEqual(http_get(*addr, "/a.txt")[2], b"alpha")
+                self.assertLess(http_request(*addr, "PUT", "/b.txt", body="beta")[0], 300)
+
+                spans = _spans(addr)
+                names = {e["name"] for e in spans}
+                for phase in ("request", "parse", "resolve", "send", "fsync", "rename"):
+                    self.assertIn(phase, names)
+                for e in spans:
+                    self.assertGreater(e["args"]["req"], 0)
+                    self.assertGreaterEqual(e["dur"], 0)
+
+                # The phases of one request nest inside its whole-request span.
+                put = [e for e in spans if e["name"] == "fsync"][0]
+                req = [e for e in spans if e["name"] == "request" and e["args"]["req"] == put["args"]["req"]][0]
+                self.assertGreaterEqual(put["ts"], req["ts"])
+                self.assertLessEqual(put["ts"] + put["dur"], req["ts"] + req["dur"] + 0.001)
+
+                self.assertGreaterEqual(get_stat(*addr, "myhttp_trace_requests_total"), 2)
+                self.assertGreater(get_stat(*addr, "myhttp_trace_spans_total"), 0)
+
+    def test_off_by_default(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot) as (proc, addr):
+                self.assertEqual(http_get(*addr, "/a.txt")[2], b"alpha")
+                self.assertEqual(_spans(addr), [])
+                self.assertEqual(get_stat(*addr, "myhttp_trace_requests_total"), 0)
+                self.assertEqual(http_request(*addr, "PUT", "/_trace", body="x")[0], 403)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,102 @@
+import socket
+import subprocess
+import tempfile
+import time
+import unittest
+from http.client import HTTPConnection
+from pathlib import Path
+
+from . import config
+from .utils import start_server, temp_docroot, RequiresServerBinary
+
+
+def _wait_for_text(path, text, deadline=5.0):
+    end = time.monotonic() + deadline
+    while time.monotonic() < end:
+        if text in path.read_text():
+            return True
+        time.sleep(0.05)
+    return False
+
+
+class TestUpgrade(RequiresServerBinary):
+    def setUp(self):
+        self._dir = tempfile.TemporaryDirectory(prefix="myhttp-upg-")
+        self.sock = str(Path(self._dir.name) / "upgrade.sock")
+        self.log = Path(self._dir.name) / "new.log"
+
+    def tearDown(self):
+        self._dir.cleanup()
+
+    def _successor(self, docroot, port, *extra):
+        args = [str(config.MYHTTP_BIN), "-p", str(port), "-d", str(docroot),
+                "--upgrade-socket", self.sock, *extra]
+        with open(self.log, "w") as err:
+            return subprocess.Popen(args, stdout=subprocess.DEVNULL, stderr=err)
+
+    def test_handoff_drains_old_and_warms_new(self):
+        with temp_docroot({"a.txt": "alpha", "b.txt": "beta"}) as docroot:
+            with start_server(docroot, extra_args=["--upgrade-socket", self.sock]) as (old, addr):
+                conn = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                conn.request("GET", "/a.txt")
+                self.assertEqual(conn.getresponse().read(), b"alpha")
+                conn.close()
+
+                # An upload in progress, a kept-alive connection between requests,
+                # and one that has not sent its first request yet.
+                upload = socket.create_connection(addr, timeout=config.REQ_TIMEOUT)
+                upload.sendall(b"PUT /up.txt HTTP/1.1\r\nHost: x\r\nContent-Length: 10\r\n\r\nhello")
+                idle = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                idle.request("GET", "/b.txt")
+                self.assertEqual(idle.getresponse().read(), b"beta")
+                fresh = socket.create_connection(addr, timeout=config.REQ_TIMEOUT)
+                time.sleep(0.2)   # all picked up by workers
+
+                new = self._successor(docroot, addr[1], "--workers", "3")
+                try:
+                    self.assertTrue(_wait_for_text(self.log, "upgrade: serving"), self.log.read_text())
+                    self.assertRegex(self.log.read_text(), r"took 1 listener\(s\).*warmed [1-9]")
+
+                    # The old server finishes the upload it started...
+                    upload.sendall(b"world")
+                    status = upload.recv(4096).split(b"\r\n", 1)[0]
+                    self.assertRegex(status, rb"^HTTP/1\.1 20[01] ")
+                    upload.close()
+                    # ...ends the idle connections, and exits on its own.
+                    self.assertEqual(idle.sock.recv(1), b"")
+                    idle.close()
+                    self.assertEqual(fresh.recv(1), b"")
+                    fresh.close()
+                    self.assertEqual(old.wait(timeout=5), 0)
+                    self.assertIn("upgrade: drained, exiting", old.stderr.read())
+
+                    # The successor serves the same port, with its own settings.
+                    c = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                    c.request("GET", "/up.txt")
+                    self.assertEqual(c.getresponse().read(), b"helloworld")
+                    c.request("GET", "/_config")
+                    self.assertIn("workers         = 3\n", c.getresponse().read().decode())
+                    c.close()
+
+                    # And listens for the next upgrade.
+                    self.assertTrue(Path(self.sock).exists())
+                finally:
+                    new.terminate()
+                    new.wait(timeout=5)
+
+    def test_incompatible_successor_leaves_old_serving(self):
+        with temp_docroot({"a.txt": "alpha"}) as docroot:
+            with start_server(docroot, extra_args=["--upgrade-socket", self.sock]) as (old, addr):
+                new = self._successor(docroot, addr[1] + 1)
+                self.assertEqual(new.wait(timeout=5), 1)
+                self.assertIn("Error: upgrade: port differs", self.log.read_text())
+
+                c = HTTPConnection(*addr, timeout=config.REQ_TIMEOUT)
+                c.request("GET", "/a.txt")
+                self.assertEqual(c.getresponse().read(), b"alpha")
+                c.close()
+                self.assertEqual(old.poll(), None)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -43,12 +43,14 @@ def wait_for_port(host: str, port: int, timeout: float) -> None:
 
 
 @contextlib.contextmanager
-def start_server(docroot: Path, port: Optional[int] = None, extra_args: Optional[list] = None):
-    if not config.MYHTTP_BIN.exists():
-        raise unittest.SkipTest(f"Server binary not found: {config.MYHTTP_BIN}")
+def start_server(docroot: Path, port: Optional[int] = None, extra_args: Optional[list] = None,
+                 binary: Optional[Path] = None):
+    binary = binary or config.MYHTTP_BIN
+    if not binary.exists():
+        raise unittest.SkipTest(f"Server binary not found: {binary}")
 
     port = port or _find_free_port()
-    args = [str(config.MYHTTP_BIN), "-p", str(port), "-d", str(docroot)]
+    args = [str(binary), "-p", str(port), "-d", str(docroot)]
     if extra_args:
         args += extra_args
 
@@ -118,6 +120,33 @@ def http_request(host: str, port: int, method: str, path: str, body: bytes | str
         conn.close()
 
 
+def get_stats(host: str, port: int) -> str:
+    """The /_stats body, as text."""
+    return http_get(host, port, "/_stats")[2].decode()
+
+def metric(text: str, name: str, labels: str = "") -> float:
+    """Value of one sample line, e.g. metric(t, 'myhttp_requests_total', 'method="GET",class="2xx"'); 0 if absent."""
+    key = f"{name}{{{labels}}}" if labels else name
+    for line in text.splitlines():
+        if line.startswith(key + " "):
+            return float(line.split()[-1])
+    return 0.0
+
+def get_stat(host: str, port: int, name: str, labels: str = "") -> float:
+    """Value of the sample 'name' (see metric()) in a fresh /_stats."""
+    return metric(get_stats(host, port), name, labels)
+
+def eventually(fn, timeout: float = 3.0, interval: float = 0.05):
+    """Retry fn() until it returns truthy or 'timeout' seconds pass; returns its last value.
+    For state the server updates asynchronously (inotify, background ticks, stream teardown)."""
+    deadline = time.time() + timeout
+    while True:
+        v = fn()
+        if v or time.time() >= deadline:
+            return v
+        time.sleep(interval)
+
+
 def is_unsupported_method(status: int) -> bool:
     """Check for HTTP status codes that mean the method isn't implemented."""
     return status in (405, 501)
@@ -0,0 +1,42 @@
+/* Asset bundle packer.
+   Packs the regular files under a docroot into one bundle file (see
+   src/bundle.h) for `MyHTTP --bundle`. Files larger than the limit, and
+   symlinks, are left out and keep being served from the docroot.
+
+   Usage: mhpack [-m max-file-bytes] <docroot> <bundle>   (default 1 MiB) */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../src/bundle.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+	size_t max_file = BUNDLE_MAX_FILE;
+	int opt;
+	while ((opt = getopt(argc, argv, "m:")) != -1) {
+		switch (opt) {
+			case 'm': max_file = (size_t)strtoull(optarg, NULL, 10); break;
+			default:
+				fprintf(stderr, "Usage: %s [-m max-file-bytes] <docroot> <bundle>\n", argv[0]);
+				return 2;
+		}
+	}
+	if (argc - optind != 2) {
+		fprintf(stderr, "Usage: %s [-m max-file-bytes] <docroot> <bundle>\n", argv[0]);
+		return 2;
+	}
+
+	long n = bundle_write(argv[optind], argv[optind + 1], max_file);
+	if (n < 0) {
+		fprintf(stderr, "mhpack: %s: %s%s\n", argv[optind + 1], strerror(errno),
+		        errno == EAGAIN ? " (a file changed while packing; run again)" : "");
+		return 1;
+	}
+	printf("%s: %ld files\n", argv[optind + 1], n);
+	return 0;
+}